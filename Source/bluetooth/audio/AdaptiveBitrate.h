@@ -0,0 +1,225 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2021 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+#include "IAudioCodec.h"
+
+namespace Thunder {
+
+namespace Bluetooth {
+
+namespace A2DP {
+
+    // Steers the bitrate of a codec (through IAudioCodec::QOS()) to what the link carries at the
+    // moment. It is told about every packet sent: what is still queued on the transport channel
+    // (RTP::ClientSocket::Queued()) and how long the send took, and about the packets the
+    // controller flushed (e.g. the HCI Flush Occurred events of the connection). The quality
+    // goes down as soon as the link congests, and up again one step at a time, only after the
+    // link has been clear for the hold time. An increase that congests the link doubles the hold
+    // time, so a link that only just carries a bitrate is not probed over and over again.
+    class EXTERNAL AdaptiveBitrate {
+    private:
+        // Time (ms) the queue gets to drain after a decrease, before the next one.
+        static constexpr uint32_t SETTLE = 500;
+
+    public:
+        AdaptiveBitrate() = delete;
+        AdaptiveBitrate(const AdaptiveBitrate&) = delete;
+        AdaptiveBitrate& operator=(const AdaptiveBitrate&) = delete;
+
+        // highWater: queued audio (ms) or send time (ms) that is congestion, lowWater: below this
+        // (both) the link is clear, holdTime: time (ms) the link is clear before an increase,
+        // maxHoldTime: the hold time after repeated failed increases.
+        AdaptiveBitrate(IAudioCodec& codec, const uint16_t highWater = 60, const uint16_t lowWater = 15, const uint32_t holdTime = 5000, const uint32_t maxHoldTime = 60000)
+            : _adminLock()
+            , _codec(codec)
+            , _highWater(highWater * 1000)
+            , _lowWater(lowWater * 1000)
+            , _minHold(holdTime * Core::Time::TicksPerMillisecond)
+            , _maxHold(maxHoldTime * Core::Time::TicksPerMillisecond)
+            , _hold(_minHold)
+            , _backlog(0)
+            , _queued(0)
+            , _latency(0)
+            , _draining(0)
+            , _clearSince(0)
+            , _settled(0)
+            , _probe(0)
+            , _flushes(0)
+            , _adaptive(true)
+        {
+            ASSERT(lowWater < highWater);
+            ASSERT(holdTime <= maxHoldTime);
+        }
+        ~AdaptiveBitrate() = default;
+
+    public:
+        // Back at the preferred quality, e.g. when the stream (re)starts.
+        void Reset()
+        {
+            _adminLock.Lock();
+
+            _hold = _minHold;
+            _backlog = 0;
+            _queued = 0;
+            _latency = 0;
+            _draining = 0;
+            _clearSince = 0;
+            _settled = 0;
+            _probe = 0;
+            _flushes = 0;
+            _adaptive = (_codec.QOS(0) == Core::ERROR_NONE);
+
+            _adminLock.Unlock();
+        }
+        // Any thread, the next packet sent takes it into account.
+        void Flushed(const uint16_t packets = 1)
+        {
+            _flushes += packets;
+        }
+        // The thread that streams the audio, after each packet. queued: bytes on the transport
+        // channel, latency: time (us) the send took.
+        void Sent(const uint32_t queued, const uint32_t latency)
+        {
+            _adminLock.Lock();
+
+            const uint32_t bitRate = _codec.BitRate();
+
+            if ((_adaptive == true) && (bitRate != 0)) {
+                const uint64_t now = Core::Time::Now().Ticks();
+                const uint16_t flushes = _flushes.exchange(0);
+
+                // Smoothed (1/8), a single slow send is no congestion yet.
+                _queued = (((_queued * 7) + queued) / 8);
+                _latency = (((_latency * 7) + latency) / 8);
+
+                // In microseconds of audio, so the water marks hold for any codec and bitrate.
+                _backlog = static_cast<uint32_t>((static_cast<uint64_t>(_queued) * 8 * 1000000) / bitRate);
+
+                if (_clearSince == 0) {
+                    _clearSince = now;
+                }
+
+                const uint32_t pressure = std::max(_backlog, _latency);
+
+                if ((flushes != 0) || (pressure > _highWater)) {
+                    // Lowered already, but the queue is still draining, give it time.
+                    if ((now >= _settled) && ((flushes != 0) || (_queued >= _draining))) {
+                        TRACE(Trace::Information, (_T("Link congested (%d flushed, %d us queued, %d us send time), lowering the bitrate"), flushes, _backlog, _latency));
+
+                        if ((_probe != 0) && ((now - _probe) < _hold)) {
+                            // The last increase was too much for the link.
+                            _hold = std::min(_hold * 2, _maxHold);
+                        }
+
+                        Step(-1);
+
+                        _probe = 0;
+                        _draining = _queued;
+                        _settled = now + (SETTLE * Core::Time::TicksPerMillisecond);
+                    }
+
+                    _clearSince = now;
+                }
+                else if (pressure < _lowWater) {
+                    _draining = 0;
+
+                    if ((now - _clearSince) >= _hold) {
+                        if (_probe != 0) {
+                            // The last increase held, back to the short hold time.
+                            _hold = _minHold;
+                        }
+
+                        if (Step(1) == Core::ERROR_NONE) {
+                            TRACE(Trace::Information, (_T("Link clear for %d ms, raised the bitrate"), static_cast<uint32_t>((now - _clearSince) / Core::Time::TicksPerMillisecond)));
+                            _probe = now;
+                        }
+
+                        _clearSince = now;
+                    }
+                }
+                else {
+                    // In between the water marks the bitrate stays as it is.
+                    _draining = 0;
+                    _clearSince = now;
+                }
+            }
+
+            _adminLock.Unlock();
+        }
+
+    public:
+        bool IsAdaptive() const
+        {
+            return (_adaptive);
+        }
+        // Smoothed, in microseconds.
+        uint32_t Backlog() const
+        {
+            return (_backlog);
+        }
+        uint32_t Latency() const
+        {
+            return (_latency);
+        }
+        uint32_t HoldTime() const
+        {
+            return (static_cast<uint32_t>(_hold / Core::Time::TicksPerMillisecond));
+        }
+
+    private:
+        uint32_t Step(const int8_t policy)
+        {
+            const uint32_t result = _codec.QOS(policy);
+
+            if (result == Core::ERROR_NOT_SUPPORTED) {
+                // A codec of which the bitrate is fixed.
+                _adaptive = false;
+            }
+
+            return (result);
+        }
+
+    private:
+        mutable Core::CriticalSection _adminLock;
+        IAudioCodec& _codec;
+        const uint32_t _highWater;
+        const uint32_t _lowWater;
+        const uint64_t _minHold;
+        const uint64_t _maxHold;
+        uint64_t _hold;
+        uint32_t _backlog;
+        uint32_t _queued;
+        uint32_t _latency;
+        // What was queued (bytes) at the last decrease.
+        uint32_t _draining;
+        uint64_t _clearSince;
+        uint64_t _settled;
+        uint64_t _probe;
+        std::atomic<uint16_t> _flushes;
+        std::atomic<bool> _adaptive;
+    }; // class AdaptiveBitrate
+
+} // namespace A2DP
+
+} // namespace Bluetooth
+
+}
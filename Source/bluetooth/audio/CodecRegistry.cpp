@@ -0,0 +1,217 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2021 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Module.h"
+#include "CodecRegistry.h"
+
+#include "codecs/SBC.h"
+
+#ifdef BLUETOOTH_AUDIO_AAC
+#include "codecs/AAC.h"
+#endif
+
+#ifdef BLUETOOTH_AUDIO_APTX
+#include "codecs/AptX.h"
+#endif
+
+namespace Thunder {
+
+namespace Bluetooth {
+
+namespace A2DP {
+
+    namespace {
+
+        template<typename CODEC, const IAudioCodec::codectype TYPE>
+        class FactoryType : public CodecRegistry::IFactory {
+        public:
+            FactoryType(const FactoryType&) = delete;
+            FactoryType& operator=(const FactoryType&) = delete;
+
+            FactoryType() = default;
+            ~FactoryType() override = default;
+
+        public:
+            IAudioCodec::codectype Type() const override
+            {
+                return (TYPE);
+            }
+            bool IsCodec(const uint8_t stream[], const uint16_t length) const override
+            {
+                return (CODEC::Format::IsCodec(stream, length));
+            }
+            IAudioCodec* Create(const Buffer& capabilities) const override
+            {
+                return (new CODEC(capabilities));
+            }
+            IAudioCodec* Create() const override
+            {
+                return (new CODEC());
+            }
+        };
+
+        template<>
+        IAudioCodec* FactoryType<SBC, IAudioCodec::LC_SBC>::Create() const
+        {
+            // Enough for the high quality preset, in joint stereo at 44.1 kHz.
+            return (new SBC(53));
+        }
+
+    }
+
+    CodecRegistry::CodecRegistry()
+        : _adminLock()
+        , _factories()
+    {
+        static FactoryType<SBC, IAudioCodec::LC_SBC> sbc;
+        Announce(&sbc, PRIORITY_SBC);
+
+#ifdef BLUETOOTH_AUDIO_AAC
+        static FactoryType<AAC, IAudioCodec::MPEG_AAC> aac;
+        Announce(&aac, PRIORITY_AAC);
+#endif
+
+#ifdef BLUETOOTH_AUDIO_APTX
+        static FactoryType<AptX, IAudioCodec::APTX> aptx;
+        Announce(&aptx, PRIORITY_APTX);
+#endif
+    }
+
+    /* static */ CodecRegistry& CodecRegistry::Instance()
+    {
+        static CodecRegistry registry;
+        return (registry);
+    }
+
+    void CodecRegistry::Announce(IFactory* factory, const uint8_t priority)
+    {
+        ASSERT(factory != nullptr);
+        ASSERT(priority != 0);
+
+        _adminLock.Lock();
+
+        Factories::iterator index(std::find_if(_factories.begin(), _factories.end(),
+            [factory](const Entry& entry) { return (entry.Factory->Type() == factory->Type()); }));
+
+        if (index != _factories.end()) {
+            _factories.erase(index);
+        }
+
+        index = std::find_if(_factories.begin(), _factories.end(),
+            [priority](const Entry& entry) { return (entry.Priority < priority); });
+
+        _factories.insert(index, Entry{ factory, priority });
+
+        _adminLock.Unlock();
+    }
+
+    void CodecRegistry::Revoke(const IFactory* factory)
+    {
+        _adminLock.Lock();
+
+        _factories.remove_if([factory](const Entry& entry) { return (entry.Factory == factory); });
+
+        _adminLock.Unlock();
+    }
+
+    void CodecRegistry::Codecs(const std::function<void(const IFactory& factory, const uint8_t priority)>& inspector) const
+    {
+        _adminLock.Lock();
+
+        for (const Entry& entry : _factories) {
+            inspector(*entry.Factory, entry.Priority);
+        }
+
+        _adminLock.Unlock();
+    }
+
+    uint8_t CodecRegistry::Priority(const Buffer& params) const
+    {
+        uint8_t result = 0;
+
+        _adminLock.Lock();
+
+        for (const Entry& entry : _factories) {
+            if (entry.Factory->IsCodec(params.data(), params.length()) == true) {
+                result = entry.Priority;
+                break;
+            }
+        }
+
+        _adminLock.Unlock();
+
+        return (result);
+    }
+
+    uint8_t CodecRegistry::Priority(const AVDTP::StreamEndPointData& endpoint) const
+    {
+        const Buffer* params = MediaCodec(endpoint);
+
+        return ((params != nullptr) && (endpoint.IsFree() == true) ? Priority(*params) : 0);
+    }
+
+    IAudioCodec* CodecRegistry::Create(const Buffer& capabilities) const
+    {
+        IAudioCodec* result = nullptr;
+
+        _adminLock.Lock();
+
+        for (const Entry& entry : _factories) {
+            if (entry.Factory->IsCodec(capabilities.data(), capabilities.length()) == true) {
+                result = entry.Factory->Create(capabilities);
+                break;
+            }
+        }
+
+        _adminLock.Unlock();
+
+        if (result == nullptr) {
+            TRACE_L1("No codec for %s", capabilities.ToString().c_str());
+        }
+
+        return (result);
+    }
+
+    IAudioCodec* CodecRegistry::Create(const AVDTP::StreamEndPointData& endpoint) const
+    {
+        const Buffer* params = MediaCodec(endpoint);
+
+        return (params != nullptr ? Create(*params) : nullptr);
+    }
+
+    /* static */ const Buffer* CodecRegistry::MediaCodec(const AVDTP::StreamEndPointData& endpoint)
+    {
+        const Buffer* result = nullptr;
+
+        if (endpoint.MediaType() == AVDTP::StreamEndPointData::AUDIO) {
+            AVDTP::StreamEndPointData::ServiceMap::const_iterator index(endpoint.Capabilities().find(AVDTP::StreamEndPointData::Service::MEDIA_CODEC));
+
+            if (index != endpoint.Capabilities().end()) {
+                result = &(index->second.Params());
+            }
+        }
+
+        return (result);
+    }
+
+} // namespace A2DP
+
+} // namespace Bluetooth
+
+}
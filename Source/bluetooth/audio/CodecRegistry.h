@@ -0,0 +1,121 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2021 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "Module.h"
+#include "IAudioCodec.h"
+#include "AVDTPProfile.h"
+
+namespace Thunder {
+
+namespace Bluetooth {
+
+namespace A2DP {
+
+    // The codecs a stream can be set up with: SBC always, AAC and aptX if the library is built
+    // with them, and whatever else is announced. Out of the stream end points of a remote device
+    // the one with the codec of the highest priority is picked, SBC being the last resort.
+    class EXTERNAL CodecRegistry {
+    public:
+        struct IFactory {
+            virtual ~IFactory() = default;
+
+            virtual IAudioCodec::codectype Type() const = 0;
+
+            // Tells if MEDIA_CODEC service parameters (capabilities or configuration) are of this codec.
+            virtual bool IsCodec(const uint8_t stream[], const uint16_t length) const = 0;
+
+            // A codec limited to the capabilities of the remote end point.
+            virtual IAudioCodec* Create(const Buffer& capabilities) const = 0;
+
+            // A codec with the capabilities of this end, e.g. to announce on a local end point.
+            virtual IAudioCodec* Create() const = 0;
+        };
+
+        // Priorities of the codecs of the library, AAC gives the best quality per bit.
+        static constexpr uint8_t PRIORITY_SBC = 10;
+        static constexpr uint8_t PRIORITY_APTX = 20;
+        static constexpr uint8_t PRIORITY_AAC = 30;
+
+    private:
+        struct Entry {
+            IFactory* Factory;
+            uint8_t Priority;
+        };
+
+        using Factories = std::list<Entry>;
+
+        CodecRegistry();
+
+    public:
+        CodecRegistry(const CodecRegistry&) = delete;
+        CodecRegistry& operator=(const CodecRegistry&) = delete;
+        ~CodecRegistry() = default;
+
+        static CodecRegistry& Instance();
+
+    public:
+        // An announced codec type replaces the one there is, e.g. to change its priority.
+        void Announce(IFactory* factory, const uint8_t priority);
+        void Revoke(const IFactory* factory);
+
+        // Highest priority first.
+        void Codecs(const std::function<void(const IFactory& factory, const uint8_t priority)>& inspector) const;
+
+        // The priority of the codec for the MEDIA_CODEC service parameters, 0 if it is not known.
+        uint8_t Priority(const Buffer& params) const;
+        uint8_t Priority(const AVDTP::StreamEndPointData& endpoint) const;
+
+        // The caller owns the codec, nullptr if it is not known.
+        IAudioCodec* Create(const Buffer& capabilities) const;
+        IAudioCodec* Create(const AVDTP::StreamEndPointData& endpoint) const;
+
+        // Out of the (discovered) end points, the free audio end point with the preferred codec.
+        template<typename CONTAINER>
+        const AVDTP::StreamEndPointData* Negotiate(const CONTAINER& endpoints) const
+        {
+            const AVDTP::StreamEndPointData* result = nullptr;
+            uint8_t best = 0;
+
+            for (const AVDTP::StreamEndPointData& endpoint : endpoints) {
+                const uint8_t priority = Priority(endpoint);
+
+                if (priority > best) {
+                    best = priority;
+                    result = &endpoint;
+                }
+            }
+
+            return (result);
+        }
+
+    private:
+        static const Buffer* MediaCodec(const AVDTP::StreamEndPointData& endpoint);
+
+    private:
+        mutable Core::CriticalSection _adminLock;
+        Factories _factories;
+    }; // class CodecRegistry
+
+} // namespace A2DP
+
+} // namespace Bluetooth
+
+}
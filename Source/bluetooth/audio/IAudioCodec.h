@@ -30,9 +30,13 @@ namespace A2DP {
     struct IAudioCodec {
 
         static constexpr uint8_t MEDIA_TYPE = 0x00; // audio
+        static constexpr uint8_t VENDOR_CODEC_TYPE = 0xFF; // followed by the vendor and codec id
 
+        // The A2DP codec type for the standard codecs, vendor specific codecs from 0x80 on.
         enum codectype : uint8_t {
-            LC_SBC = 0
+            LC_SBC = 0,
+            MPEG_AAC = 2,
+            APTX = 0x80
         };
 
         struct StreamFormat {
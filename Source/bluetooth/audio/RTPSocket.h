@@ -22,6 +22,9 @@
 #include "Module.h"
 #include "IAudioCodec.h"
 
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+
 namespace Thunder {
 
 namespace Bluetooth {
@@ -253,6 +256,21 @@ namespace RTP {
         uint16_t OutputMTU() const {
             return (_outputMTU);
         }
+        // Bytes handed to the channel, but not sent out yet. Note that on a Bluetooth socket
+        // SIOCOUTQ tells the room left in the send buffer, not what is in it.
+        uint32_t Queued() const
+        {
+            uint32_t result = 0;
+            int room = 0;
+            int size = 0;
+            socklen_t length = sizeof(size);
+
+            if ((::ioctl(Handle(), SIOCOUTQ, &room) == 0) && (::getsockopt(Handle(), SOL_SOCKET, SO_SNDBUF, &size, &length) == 0) && (size > room)) {
+                result = (size - room);
+            }
+
+            return (result);
+        }
 
     public:
         virtual void Operational(const bool upAndRunning) = 0;
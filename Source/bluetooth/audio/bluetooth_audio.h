@@ -32,6 +32,8 @@
 #include "DataRecord.h"
 
 #include "IAudioCodec.h"
+#include "CodecRegistry.h"
+#include "AdaptiveBitrate.h"
 #include "IAudioContentProtection.h"
 
 #ifdef __WINDOWS__
@@ -15,20 +15,20 @@
 # See the License for the specific language governing permissions and
 # limitations under the License.
 
-# - Try to find sbc
+# - Try to find fdk-aac
 # Once done this will define
-#  SBC_FOUND - System has libsbc
-#  SBC_INCLUDE_DIRS - The libsbc include directories
-#  SBC_LIBRARIES - The libraries needed to use libsbc
+#  FDKAAC_FOUND - System has libfdk-aac
+#  FDKAAC_INCLUDE_DIRS - The libfdk-aac include directories
+#  FDKAAC_LIBRARIES - The libraries needed to use libfdk-aac
 
 find_package(PkgConfig)
-pkg_check_modules(SBC REQUIRED sbc IMPORTED_TARGET)
+pkg_check_modules(FDKAAC REQUIRED fdk-aac IMPORTED_TARGET)
 
 include(FindPackageHandleStandardArgs)
-find_package_handle_standard_args(SBC DEFAULT_MSG SBC_LIBRARIES)
+find_package_handle_standard_args(FDKAAC DEFAULT_MSG FDKAAC_LIBRARIES)
 
-mark_as_advanced(SBC_FOUND SBC_LIBRARIES)
+mark_as_advanced(FDKAAC_FOUND FDKAAC_LIBRARIES)
 
-if(SBC_FOUND)
-   add_library(SBC::SBC ALIAS PkgConfig::SBC)
-endif()
\ No newline at end of file
+if(FDKAAC_FOUND)
+   add_library(FDKAAC::FDKAAC ALIAS PkgConfig::FDKAAC)
+endif()
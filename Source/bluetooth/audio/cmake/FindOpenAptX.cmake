@@ -0,0 +1,34 @@
+# If not stated otherwise in this file or this component's LICENSE file the
+# following copyright and licenses apply:
+#
+# Copyright 2021 Metrological
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+
+# - Try to find libopenaptx
+# Once done this will define
+#  OPENAPTX_FOUND - System has libopenaptx
+#  OPENAPTX_INCLUDE_DIRS - The libopenaptx include directories
+#  OPENAPTX_LIBRARIES - The libraries needed to use libopenaptx
+
+find_package(PkgConfig)
+pkg_check_modules(OPENAPTX REQUIRED libopenaptx IMPORTED_TARGET)
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(OpenAptX DEFAULT_MSG OPENAPTX_LIBRARIES)
+
+mark_as_advanced(OPENAPTX_FOUND OPENAPTX_LIBRARIES)
+
+if(OPENAPTX_FOUND)
+   add_library(OpenAptX::OpenAptX ALIAS PkgConfig::OPENAPTX)
+endif()
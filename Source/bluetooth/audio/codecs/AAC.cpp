@@ -0,0 +1,551 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2021 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../Module.h"
+
+#include "AAC.h"
+
+#include <fdk-aac/aacenc_lib.h>
+#include <fdk-aac/aacdecoder_lib.h>
+
+namespace Thunder {
+
+namespace Bluetooth {
+
+namespace A2DP {
+
+    namespace {
+
+        // Room for the StreamMuxConfig and the payload length of an AudioMuxElement.
+        constexpr uint16_t LATM_OVERHEAD = 16;
+
+        const struct {
+            AAC::Format::samplingfrequency Flag;
+            uint32_t Rate;
+        } Frequencies[] = {
+            { AAC::Format::SF_96000_HZ, 96000 },
+            { AAC::Format::SF_88200_HZ, 88200 },
+            { AAC::Format::SF_64000_HZ, 64000 },
+            { AAC::Format::SF_48000_HZ, 48000 },
+            { AAC::Format::SF_44100_HZ, 44100 },
+            { AAC::Format::SF_32000_HZ, 32000 },
+            { AAC::Format::SF_24000_HZ, 24000 },
+            { AAC::Format::SF_22050_HZ, 22050 },
+            { AAC::Format::SF_16000_HZ, 16000 },
+            { AAC::Format::SF_12000_HZ, 12000 },
+            { AAC::Format::SF_11025_HZ, 11025 },
+            { AAC::Format::SF_8000_HZ, 8000 }
+        };
+
+        constexpr uint8_t FREQUENCIES = (sizeof(Frequencies) / sizeof(Frequencies[0]));
+
+        // The bitrate, the sampling frequency and the channels, in 32 bits, so it can be swapped atomically.
+        class Setup {
+        public:
+            Setup(const uint32_t packed)
+                : _packed(packed)
+            {
+            }
+            Setup(const uint32_t bitRate, const uint8_t frequency, const uint8_t channels)
+                : _packed((bitRate & 0x7FFFFF) | ((frequency & 0xF) << 23) | ((channels == 1 ? 1 : 0) << 27))
+            {
+                ASSERT(frequency < FREQUENCIES);
+            }
+            ~Setup() = default;
+
+        public:
+            bool IsValid() const
+            {
+                return (BitRate() != 0);
+            }
+            // Only the bitrate differs, the encoder is not opened again.
+            bool IsCompatible(const Setup& other) const
+            {
+                return ((_packed >> 23) == (other._packed >> 23));
+            }
+            uint32_t Packed() const
+            {
+                return (_packed);
+            }
+            uint32_t BitRate() const
+            {
+                return (_packed & 0x7FFFFF);
+            }
+            uint32_t SampleRate() const
+            {
+                return (Frequencies[(_packed >> 23) & 0xF].Rate);
+            }
+            uint8_t Channels() const
+            {
+                return (((_packed >> 27) & 0x1) != 0 ? 1 : 2);
+            }
+            // Bytes of 16 bit PCM going into a frame.
+            uint16_t CodeSize() const
+            {
+                return (AAC::SAMPLES * Channels() * sizeof(int16_t));
+            }
+            // Bytes of an encoded frame, at most (the peak bitrate is the bitrate).
+            uint16_t FrameLength() const
+            {
+                return (((BitRate() * AAC::SAMPLES) / (8 * SampleRate())) + 1 + LATM_OVERHEAD);
+            }
+
+        private:
+            uint32_t _packed;
+        };
+
+        uint32_t DefaultBitRate(const uint8_t channels)
+        {
+            return (channels == 1 ? 128000 : 256000);
+        }
+
+    }
+
+    /* virtual */ uint32_t AAC::Configure(const StreamFormat& format, const string& settings)
+    {
+        uint32_t result = Core::ERROR_NONE;
+
+        Core::JSON::String Data;
+        Core::JSON::Container container;
+        container.Add("MPEG-AAC", &Data);
+        container.FromString(settings);
+
+        Config config;
+        config.FromString(Data.Value());
+
+        _lock.Lock();
+
+        Format::samplingfrequency frequency = Format::SF_INVALID;
+        Format::channels channels = Format::CH_INVALID;
+        Format::objecttype objectType = Format::OT_INVALID;
+
+        for (uint8_t index = 0; index < FREQUENCIES; index++) {
+            if (Frequencies[index].Rate == format.SampleRate) {
+                frequency = Frequencies[index].Flag;
+                break;
+            }
+        }
+
+        frequency = static_cast<Format::samplingfrequency>(frequency & _supported.SamplingFrequency());
+
+        switch (format.Channels) {
+        case 1:
+            channels = Format::CH_1;
+            break;
+        case 2:
+            channels = Format::CH_2;
+            break;
+        default:
+            break;
+        }
+
+        channels = static_cast<Format::channels>(channels & _supported.Channels());
+
+        // Both are coded the same, MPEG-2 AAC LC is the one every sink has.
+        if ((_supported.ObjectType() & Format::OT_MPEG4_AAC_LC) != 0) {
+            objectType = Format::OT_MPEG4_AAC_LC;
+        }
+        else if ((_supported.ObjectType() & Format::OT_MPEG2_AAC_LC) != 0) {
+            objectType = Format::OT_MPEG2_AAC_LC;
+        }
+
+        if ((channels != Format::CH_INVALID) && (frequency != Format::SF_INVALID) && (objectType != Format::OT_INVALID) && (format.Resolution == 16)) {
+            uint32_t bitRate = DefaultBitRate(format.Channels);
+
+            if ((config.BitRate.IsSet() == true) && (config.BitRate.Value() != 0)) {
+                bitRate = config.BitRate.Value();
+            }
+
+            // A maximum of 0 means the sink did not tell.
+            if ((_supported.BitRate() != 0) && (bitRate > _supported.BitRate())) {
+                bitRate = _supported.BitRate();
+            }
+
+            if (bitRate > MAX_BITRATE) {
+                bitRate = MAX_BITRATE;
+            }
+            else if (bitRate < MIN_BITRATE) {
+                bitRate = MIN_BITRATE;
+            }
+
+            _actuals.ObjectType(objectType);
+            _actuals.SamplingFrequency(frequency);
+            _actuals.Channels(channels);
+            _actuals.VBR(false);
+            _actuals.BitRate(bitRate);
+            _preferredBitRate = bitRate;
+
+            BitRate(bitRate);
+        }
+        else {
+            result = Core::ERROR_NOT_SUPPORTED;
+            TRACE(Trace::Error, (_T("Unsupported AAC parameters requested")));
+        }
+
+        _lock.Unlock();
+
+        return (result);
+    }
+
+    /* virtual */ uint32_t AAC::Configure(const uint8_t stream[], const uint16_t length)
+    {
+        uint32_t result = Core::ERROR_NONE;
+
+        _lock.Lock();
+
+        _actuals.Deserialize(stream, length);
+
+        uint32_t bitRate = _actuals.BitRate();
+
+        if (bitRate == 0) {
+            bitRate = DefaultBitRate(_actuals.Channels() == Format::CH_1 ? 1 : 2);
+        }
+
+        if (bitRate > MAX_BITRATE) {
+            bitRate = MAX_BITRATE;
+        }
+        else if (bitRate < MIN_BITRATE) {
+            bitRate = MIN_BITRATE;
+        }
+
+        _preferredBitRate = bitRate;
+
+        BitRate(bitRate);
+
+        _lock.Unlock();
+
+        return (result);
+    }
+
+    /* virtual */ void AAC::Configuration(StreamFormat& format, string& settings) const
+    {
+        Config config;
+
+        _lock.Lock();
+
+        format.FrameRate = 0;
+        format.Resolution = 16; // Always 16-bit samples
+        format.SampleRate = _sampleRate;
+        format.Channels = _channels;
+
+        config.BitRate = _bitRate.load();
+
+        _lock.Unlock();
+
+        config.ToString(settings);
+    }
+
+    /* virtual */ uint16_t AAC::Serialize(const bool capabilities, uint8_t stream[], const uint16_t length) const
+    {
+        _lock.Lock();
+
+        const uint16_t result = (capabilities? _supported.Serialize(stream, length) : _actuals.Serialize(stream, length));
+
+        _lock.Unlock();
+
+        return (result);
+    }
+
+    /* virtual */ uint16_t AAC::Encode(const uint16_t inBufferSize, const uint8_t inBuffer[],
+                                       uint16_t& outSize, uint8_t outBuffer[]) const
+    {
+        // Taken once, a configuration change applies to the next frame.
+        const Setup setup(_setup.load(std::memory_order_acquire));
+
+        ASSERT(setup.IsValid() == true);
+
+        ASSERT(inBuffer != nullptr);
+        ASSERT(outBuffer != nullptr);
+
+        uint16_t consumed = 0;
+        uint16_t produced = 0;
+
+        // One frame per packet, the encoder delay makes the first few come out empty.
+        if ((setup.IsValid() == true) && (inBufferSize >= setup.CodeSize()) && (AACEncoder(setup.Packed()) == true)) {
+
+            void* inPointer = const_cast<uint8_t*>(inBuffer);
+            INT inIdentifier = IN_AUDIO_DATA;
+            INT inSize = setup.CodeSize();
+            INT inElementSize = sizeof(INT_PCM);
+
+            void* outPointer = outBuffer;
+            INT outIdentifier = OUT_BITSTREAM_DATA;
+            INT outBytes = outSize;
+            INT outElementSize = sizeof(UCHAR);
+
+            AACENC_BufDesc input{};
+            input.numBufs = 1;
+            input.bufs = &inPointer;
+            input.bufferIdentifiers = &inIdentifier;
+            input.bufSizes = &inSize;
+            input.bufElSizes = &inElementSize;
+
+            AACENC_BufDesc output{};
+            output.numBufs = 1;
+            output.bufs = &outPointer;
+            output.bufferIdentifiers = &outIdentifier;
+            output.bufSizes = &outBytes;
+            output.bufElSizes = &outElementSize;
+
+            AACENC_InArgs inArgs{};
+            inArgs.numInSamples = (SAMPLES * setup.Channels());
+
+            AACENC_OutArgs outArgs{};
+
+            if (aacEncEncode(static_cast<HANDLE_AACENCODER>(_encoder), &input, &output, &inArgs, &outArgs) == AACENC_OK) {
+                consumed = (outArgs.numInSamples * sizeof(INT_PCM));
+                produced = outArgs.numOutBytes;
+            }
+            else {
+                TRACE_L1("Failed to encode an AAC frame!");
+            }
+        }
+
+        outSize = produced;
+
+        return (consumed);
+    }
+
+    /* virtual */ uint16_t AAC::Decode(const uint16_t inBufferSize, const uint8_t inBuffer[],
+                                       uint16_t& outSize, uint8_t outBuffer[]) const
+    {
+        const Setup setup(_setup.load(std::memory_order_acquire));
+
+        ASSERT(setup.IsValid() == true);
+
+        ASSERT(inBuffer != nullptr);
+        ASSERT(outBuffer != nullptr);
+
+        uint16_t consumed = 0;
+        uint16_t produced = 0;
+        uint16_t available = outSize;
+
+        if ((setup.IsValid() == true) && (AACDecoder(setup.Packed()) == true)) {
+            HANDLE_AACDECODER decoder = static_cast<HANDLE_AACDECODER>(_decoder);
+
+            UCHAR* data = const_cast<UCHAR*>(inBuffer);
+            UINT size = inBufferSize;
+            UINT left = inBufferSize;
+
+            if (aacDecoder_Fill(decoder, &data, &size, &left) == AAC_DEC_OK) {
+                consumed = (inBufferSize - left);
+
+                // The frames describe themselves (StreamMuxConfig), the decoder follows whatever the source sends.
+                while (available >= setup.CodeSize()) {
+                    const AAC_DECODER_ERROR error = aacDecoder_DecodeFrame(decoder, reinterpret_cast<INT_PCM*>(outBuffer + produced),
+                                                                           (available / sizeof(INT_PCM)), 0);
+
+                    if (error != AAC_DEC_OK) {
+                        if (error != AAC_DEC_NOT_ENOUGH_BITS) {
+                            TRACE_L1("Failed to decode an AAC frame [0x%04x]!", error);
+                        }
+                        break;
+                    }
+                    else {
+                        const CStreamInfo* info = aacDecoder_GetStreamInfo(decoder);
+                        const uint16_t written = (info->frameSize * info->numChannels * sizeof(INT_PCM));
+
+                        available -= written;
+                        produced += written;
+                    }
+                }
+            }
+        }
+
+        outSize = produced;
+
+        return (consumed);
+    }
+
+    /* virtual */ uint32_t AAC::QOS(const int8_t policy)
+    {
+        uint32_t result = Core::ERROR_NONE;
+
+        _lock.Lock();
+
+        ASSERT(_preferredBitRate != 0);
+
+        const uint32_t STEP = (_preferredBitRate / 10);
+
+        uint32_t newBitRate = _bitRate;
+
+        if (policy == 0) {
+            // reset quality
+            newBitRate = _preferredBitRate;
+        }
+        else if (policy < 0) {
+            // decrease quality
+            if (newBitRate == MIN_BITRATE) {
+                result = Core::ERROR_UNAVAILABLE;
+            }
+            else if ((newBitRate - STEP) < MIN_BITRATE) {
+                newBitRate = MIN_BITRATE;
+            }
+            else {
+                newBitRate -= STEP;
+            }
+        }
+        else {
+            // increase quality
+            if (newBitRate == _preferredBitRate) {
+                result = Core::ERROR_UNAVAILABLE;
+            }
+            else if ((newBitRate + STEP) >= _preferredBitRate) {
+                newBitRate = _preferredBitRate;
+            }
+            else {
+                newBitRate += STEP;
+            }
+        }
+
+        if (result == Core::ERROR_NONE) {
+            BitRate(newBitRate);
+        }
+
+        _lock.Unlock();
+
+        return (result);
+    }
+
+    void AAC::BitRate(const uint32_t value)
+    {
+        uint8_t frequency = 0;
+
+        while ((frequency < (FREQUENCIES - 1)) && (Frequencies[frequency].Flag != _actuals.SamplingFrequency())) {
+            frequency++;
+        }
+
+        ASSERT(Frequencies[frequency].Flag == _actuals.SamplingFrequency());
+
+        const Setup setup(value, frequency, (_actuals.Channels() == Format::CH_1 ? 1 : 2));
+
+        _sampleRate = setup.SampleRate();
+        _channels = setup.Channels();
+        _rawFrameSize = setup.CodeSize(); /* bytes */
+        _encodedFrameSize = setup.FrameLength(); /* bytes */
+        _bitRate = setup.BitRate(); /* bits per second */
+
+        TRACE(Trace::Information, (_T("New bitrate for AAC: %d bps (%d Hz, %d channels)"), _bitRate.load(), _sampleRate, _channels));
+
+        // The streaming side picks it up from the next frame on.
+        _setup.store(setup.Packed(), std::memory_order_release);
+    }
+
+    bool AAC::AACEncoder(const uint32_t packed) const
+    {
+        if ((_encoder != nullptr) && (packed != _encoderSetup)) {
+            const Setup setup(packed);
+
+            if (setup.IsCompatible(Setup(_encoderSetup)) == true) {
+                HANDLE_AACENCODER encoder = static_cast<HANDLE_AACENCODER>(_encoder);
+
+                // A new bitrate only, the encoder carries on.
+                if ((aacEncoder_SetParam(encoder, AACENC_BITRATE, setup.BitRate()) == AACENC_OK)
+                        && (aacEncoder_SetParam(encoder, AACENC_PEAK_BITRATE, setup.BitRate()) == AACENC_OK)) {
+                    _encoderSetup = packed;
+                }
+            }
+
+            if (packed != _encoderSetup) {
+                HANDLE_AACENCODER encoder = static_cast<HANDLE_AACENCODER>(_encoder);
+                aacEncClose(&encoder);
+                _encoder = nullptr;
+            }
+        }
+
+        if (_encoder == nullptr) {
+            const Setup setup(packed);
+            HANDLE_AACENCODER encoder = nullptr;
+
+            if (aacEncOpen(&encoder, 0, setup.Channels()) == AACENC_OK) {
+                // Constant bitrate, capped per frame, so a frame never outgrows a packet.
+                if ((aacEncoder_SetParam(encoder, AACENC_AOT, AOT_AAC_LC) == AACENC_OK)
+                        && (aacEncoder_SetParam(encoder, AACENC_SAMPLERATE, setup.SampleRate()) == AACENC_OK)
+                        && (aacEncoder_SetParam(encoder, AACENC_CHANNELMODE, (setup.Channels() == 1 ? MODE_1 : MODE_2)) == AACENC_OK)
+                        && (aacEncoder_SetParam(encoder, AACENC_CHANNELORDER, 1 /* WAV */) == AACENC_OK)
+                        && (aacEncoder_SetParam(encoder, AACENC_BITRATEMODE, 0 /* CBR */) == AACENC_OK)
+                        && (aacEncoder_SetParam(encoder, AACENC_BITRATE, setup.BitRate()) == AACENC_OK)
+                        && (aacEncoder_SetParam(encoder, AACENC_PEAK_BITRATE, setup.BitRate()) == AACENC_OK)
+                        && (aacEncoder_SetParam(encoder, AACENC_TRANSMUX, TT_MP4_LATM_MCP1) == AACENC_OK)
+                        && (aacEncoder_SetParam(encoder, AACENC_HEADER_PERIOD, 1) == AACENC_OK)
+                        && (aacEncoder_SetParam(encoder, AACENC_AFTERBURNER, 1) == AACENC_OK)
+                        && (aacEncEncode(encoder, nullptr, nullptr, nullptr, nullptr) == AACENC_OK)) {
+                    _encoder = encoder;
+                    _encoderSetup = packed;
+                }
+                else {
+                    TRACE_L1("Failed to set up the AAC encoder!");
+                    aacEncClose(&encoder);
+                }
+            }
+        }
+
+        return (_encoder != nullptr);
+    }
+
+    bool AAC::AACDecoder(const uint32_t packed) const
+    {
+        // The bitstream carries its own configuration, only a new stream starts over.
+        if ((_decoder != nullptr) && (Setup(packed).IsCompatible(Setup(_decoderSetup)) == false)) {
+            aacDecoder_Close(static_cast<HANDLE_AACDECODER>(_decoder));
+            _decoder = nullptr;
+        }
+
+        if (_decoder == nullptr) {
+            HANDLE_AACDECODER decoder = aacDecoder_Open(TT_MP4_LATM_MCP1, 1);
+
+            if (decoder == nullptr) {
+                TRACE_L1("Failed to set up the AAC decoder!");
+            }
+            else {
+                aacDecoder_SetParam(decoder, AAC_PCM_MAX_OUTPUT_CHANNELS, Setup(packed).Channels());
+                _decoder = decoder;
+            }
+        }
+
+        _decoderSetup = packed;
+
+        return (_decoder != nullptr);
+    }
+
+    void AAC::AACDeinitialize()
+    {
+        _lock.Lock();
+
+        _setup.store(0, std::memory_order_release);
+
+        if (_encoder != nullptr) {
+            HANDLE_AACENCODER encoder = static_cast<HANDLE_AACENCODER>(_encoder);
+            aacEncClose(&encoder);
+            _encoder = nullptr;
+        }
+
+        if (_decoder != nullptr) {
+            aacDecoder_Close(static_cast<HANDLE_AACDECODER>(_decoder));
+            _decoder = nullptr;
+        }
+
+        _lock.Unlock();
+    }
+
+} // namespace A2DP
+
+} // namespace Bluetooth
+
+}
@@ -0,0 +1,345 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2021 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "../Module.h"
+#include "../IAudioCodec.h"
+#include "../DataRecord.h"
+
+namespace Thunder {
+
+namespace Bluetooth {
+
+namespace A2DP {
+
+    // MPEG-2/4 AAC LC, encoded with the Fraunhofer FDK AAC library (only built with
+    // BLUETOOTH_AUDIO_AAC). A packet holds one frame, in a LATM AudioMuxElement that carries
+    // its own StreamMuxConfig. As with SBC, Encode() and Decode() run without a lock, a new
+    // configuration (or bitrate) is taken over from the next frame on.
+    class EXTERNAL AAC : public IAudioCodec {
+    public:
+        static constexpr uint8_t CODEC_TYPE = 0x02; // MPEG-2,4 AAC
+
+        static constexpr uint32_t MIN_BITRATE = 32000;
+        static constexpr uint32_t MAX_BITRATE = 320000;
+
+        static constexpr uint16_t SAMPLES = 1024; // per channel, in a frame
+
+    public:
+        class Config : public Core::JSON::Container {
+        public:
+            Config(const Config&) = delete;
+            Config& operator=(const Config&) = delete;
+            Config()
+                : Core::JSON::Container()
+                , BitRate(0)
+            {
+                Add(_T("bitrate"), &BitRate);
+            }
+            ~Config() = default;
+
+        public:
+            Core::JSON::DecUInt32 BitRate;
+        }; // class Config
+
+        class Format {
+        public:
+            enum objecttype : uint8_t {
+                OT_INVALID              = 0,
+                OT_MPEG4_AAC_SCALABLE   = 0x10,
+                OT_MPEG4_AAC_LTP        = 0x20,
+                OT_MPEG4_AAC_LC         = 0x40,
+                OT_MPEG2_AAC_LC         = 0x80 // mandatory
+            };
+
+            enum samplingfrequency : uint16_t {
+                SF_INVALID      = 0,
+                SF_96000_HZ     = 0x001,
+                SF_88200_HZ     = 0x002,
+                SF_64000_HZ     = 0x004,
+                SF_48000_HZ     = 0x008, // mandatory for sink
+                SF_44100_HZ     = 0x010, // mandatory for sink
+                SF_32000_HZ     = 0x020,
+                SF_24000_HZ     = 0x040,
+                SF_22050_HZ     = 0x080,
+                SF_16000_HZ     = 0x100,
+                SF_12000_HZ     = 0x200,
+                SF_11025_HZ     = 0x400,
+                SF_8000_HZ      = 0x800
+            };
+
+            enum channels : uint8_t {
+                CH_INVALID      = 0,
+                CH_2            = 1, // all mandatory for sink
+                CH_1            = 2
+            };
+
+        public:
+            Format()
+                : _objectType(OT_MPEG2_AAC_LC)
+                , _samplingFrequency(SF_44100_HZ)
+                , _channels(CH_2)
+                , _vbr(false)
+                , _bitRate(0)
+            {
+            }
+            Format(const uint8_t stream[], const uint16_t length)
+                : _objectType(OT_MPEG2_AAC_LC)
+                , _samplingFrequency(SF_44100_HZ)
+                , _channels(CH_2)
+                , _vbr(false)
+                , _bitRate(0)
+            {
+                Deserialize(stream, length);
+            }
+            Format(const uint32_t maxBitRate)
+                : _objectType(OT_MPEG2_AAC_LC | OT_MPEG4_AAC_LC)
+                , _samplingFrequency(SF_8000_HZ | SF_11025_HZ | SF_12000_HZ | SF_16000_HZ | SF_22050_HZ | SF_24000_HZ
+                                     | SF_32000_HZ | SF_44100_HZ | SF_48000_HZ | SF_64000_HZ | SF_88200_HZ | SF_96000_HZ)
+                , _channels(CH_1 | CH_2)
+                , _vbr(false)
+                , _bitRate(maxBitRate)
+            {
+            }
+            ~Format() = default;
+            Format(const Format&) = default;
+            Format& operator=(const Format&) = default;
+
+        public:
+            static bool IsCodec(const uint8_t stream[], const uint16_t length)
+            {
+                return ((length >= 8) && ((stream[0] >> 4) == IAudioCodec::MEDIA_TYPE) && (stream[1] == CODEC_TYPE));
+            }
+
+        public:
+            uint16_t Serialize(uint8_t stream[], const uint16_t length) const
+            {
+                ASSERT(length >= 8);
+
+                uint8_t octet;
+                Bluetooth::DataRecord data(stream, length, 0);
+
+                data.Push(IAudioCodec::MEDIA_TYPE);
+                data.Push(CODEC_TYPE);
+
+                data.Push(_objectType);
+
+                octet = (_samplingFrequency >> 4);
+                data.Push(octet);
+
+                octet = (((_samplingFrequency & 0xF) << 4) | (_channels << 2));
+                data.Push(octet);
+
+                // A bitrate of 0 means: not known.
+                octet = (((_vbr == true) ? 0x80 : 0x00) | ((_bitRate >> 16) & 0x7F));
+                data.Push(octet);
+
+                octet = (_bitRate >> 8);
+                data.Push(octet);
+
+                octet = _bitRate;
+                data.Push(octet);
+
+                return (data.Length());
+            }
+            uint16_t Deserialize(const uint8_t stream[], const uint16_t length)
+            {
+                ASSERT(length >= 8);
+
+                Bluetooth::DataRecord data(stream, length);
+
+                uint8_t octet{};
+
+                data.Pop(octet);
+                ASSERT((octet >> 4) == IAudioCodec::MEDIA_TYPE);
+
+                data.Pop(octet);
+                ASSERT(octet == CODEC_TYPE);
+
+                data.Pop(_objectType);
+
+                data.Pop(octet);
+                _samplingFrequency = (octet << 4);
+
+                data.Pop(octet);
+                _samplingFrequency |= (octet >> 4);
+                _channels = ((octet >> 2) & 0x3);
+
+                data.Pop(octet);
+                _vbr = ((octet & 0x80) != 0);
+                _bitRate = ((octet & 0x7F) << 16);
+
+                data.Pop(octet);
+                _bitRate |= (octet << 8);
+
+                data.Pop(octet);
+                _bitRate |= octet;
+
+                return (8);
+            }
+
+        public:
+            uint8_t ObjectType() const {
+                return (_objectType);
+            }
+            uint16_t SamplingFrequency() const {
+                return (_samplingFrequency);
+            }
+            uint8_t Channels() const {
+                return (_channels);
+            }
+            bool VBR() const {
+                return (_vbr);
+            }
+            uint32_t BitRate() const {
+                return (_bitRate);
+            }
+
+        public:
+            void ObjectType(const objecttype ot)
+            {
+                _objectType = ot;
+            }
+            void SamplingFrequency(const samplingfrequency sf)
+            {
+                _samplingFrequency = sf;
+            }
+            void Channels(const channels ch)
+            {
+                _channels = ch;
+            }
+            void VBR(const bool value)
+            {
+                _vbr = value;
+            }
+            void BitRate(const uint32_t value)
+            {
+                _bitRate = (value & 0x7FFFFF);
+            }
+
+        private:
+            uint8_t _objectType;
+            uint16_t _samplingFrequency;
+            uint8_t _channels;
+            bool _vbr;
+            uint32_t _bitRate;
+        }; // class Format
+
+    public:
+        AAC(const uint32_t maxBitRate = MAX_BITRATE)
+            : _lock()
+            , _supported(maxBitRate)
+            , _actuals()
+            , _preferredBitRate(0)
+            , _setup(0)
+            , _bitRate(0)
+            , _sampleRate(0)
+            , _channels(0)
+            , _rawFrameSize(0)
+            , _encodedFrameSize(0)
+            , _encoder(nullptr)
+            , _encoderSetup(0)
+            , _decoder(nullptr)
+            , _decoderSetup(0)
+        {
+        }
+        AAC(const Bluetooth::Buffer& config)
+            : _lock()
+            , _supported(config.data(), config.length())
+            , _actuals()
+            , _preferredBitRate(0)
+            , _setup(0)
+            , _bitRate(0)
+            , _sampleRate(0)
+            , _channels(0)
+            , _rawFrameSize(0)
+            , _encodedFrameSize(0)
+            , _encoder(nullptr)
+            , _encoderSetup(0)
+            , _decoder(nullptr)
+            , _decoderSetup(0)
+        {
+        }
+        ~AAC() override
+        {
+            AACDeinitialize();
+        }
+
+    public:
+        IAudioCodec::codectype Type() const override {
+            return (IAudioCodec::codectype::MPEG_AAC);
+        }
+        uint32_t BitRate() const override {
+            return (_bitRate);
+        }
+        uint16_t RawFrameSize() const override {
+            return (_rawFrameSize);
+        }
+        uint16_t EncodedFrameSize() const override {
+            return (_encodedFrameSize);
+        }
+
+        uint32_t Configure(const uint8_t stream[], const uint16_t length) override;
+        uint32_t Configure(const StreamFormat& format, const string& settings) override;
+
+        void Configuration(StreamFormat& format, string& settings) const override;
+
+        uint32_t QOS(const int8_t policy) override;
+
+        uint16_t Encode(const uint16_t inBufferSize, const uint8_t inBuffer[],
+                        uint16_t& outBufferSize, uint8_t outBuffer[]) const override;
+
+        uint16_t Decode(const uint16_t inBufferSize, const uint8_t inBuffer[],
+                        uint16_t& outBufferSize, uint8_t outBuffer[]) const override;
+
+        uint16_t Serialize(const bool capabilities, uint8_t stream[], const uint16_t length) const override;
+
+    private:
+        void BitRate(const uint32_t value);
+
+    private:
+        void AACDeinitialize();
+        bool AACEncoder(const uint32_t setup) const;
+        bool AACDecoder(const uint32_t setup) const;
+
+    private:
+        mutable Core::CriticalSection _lock;
+        Format _supported;
+        Format _actuals;
+        uint32_t _preferredBitRate;
+        // The bitrate, sampling frequency, channels and object type the audio is coded with.
+        std::atomic<uint32_t> _setup;
+        std::atomic<uint32_t> _bitRate;
+        uint32_t _sampleRate;
+        uint8_t _channels;
+        std::atomic<uint16_t> _rawFrameSize;
+        std::atomic<uint16_t> _encodedFrameSize;
+        // Only touched by the thread that streams the audio.
+        mutable void* _encoder;
+        mutable uint32_t _encoderSetup;
+        mutable void* _decoder;
+        mutable uint32_t _decoderSetup;
+    }; // class AAC
+
+} // namespace A2DP
+
+} // namespace Bluetooth
+
+}
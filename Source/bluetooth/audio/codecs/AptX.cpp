@@ -0,0 +1,281 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2021 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../Module.h"
+
+#include "AptX.h"
+
+#include <openaptx.h>
+
+namespace Thunder {
+
+namespace Bluetooth {
+
+namespace A2DP {
+
+    namespace {
+
+        // libopenaptx takes (and gives) 24 bit samples, converted in chunks of this many frames.
+        constexpr uint16_t CHUNK = 64;
+        constexpr uint8_t SAMPLE_SIZE = 3;
+
+    }
+
+    /* virtual */ uint32_t AptX::Configure(const StreamFormat& format, const string& /* settings */)
+    {
+        uint32_t result = Core::ERROR_NONE;
+
+        _lock.Lock();
+
+        Format::samplingfrequency frequency = Format::SF_INVALID;
+
+        switch (format.SampleRate) {
+        case 16000:
+            frequency = Format::SF_16000_HZ;
+            break;
+        case 32000:
+            frequency = Format::SF_32000_HZ;
+            break;
+        case 44100:
+            frequency = Format::SF_44100_HZ;
+            break;
+        case 48000:
+            frequency = Format::SF_48000_HZ;
+            break;
+        default:
+            break;
+        }
+
+        frequency = static_cast<Format::samplingfrequency>(frequency & _supported.SamplingFrequency());
+
+        if ((frequency != Format::SF_INVALID) && (format.Channels == 2) && ((_supported.ChannelMode() & Format::CM_STEREO) != 0) && (format.Resolution == 16)) {
+            _actuals.SamplingFrequency(frequency);
+            _actuals.ChannelMode(Format::CM_STEREO);
+
+            _sampleRate = format.SampleRate;
+
+            TRACE(Trace::Information, (_T("aptX at %d Hz, %d bps"), _sampleRate.load(), BitRate()));
+        }
+        else {
+            result = Core::ERROR_NOT_SUPPORTED;
+            TRACE(Trace::Error, (_T("Unsupported aptX parameters requested")));
+        }
+
+        _lock.Unlock();
+
+        return (result);
+    }
+
+    /* virtual */ uint32_t AptX::Configure(const uint8_t stream[], const uint16_t length)
+    {
+        uint32_t result = Core::ERROR_NONE;
+
+        _lock.Lock();
+
+        _actuals.Deserialize(stream, length);
+
+        switch (_actuals.SamplingFrequency()) {
+        case Format::SF_48000_HZ:
+            _sampleRate = 48000;
+            break;
+        case Format::SF_44100_HZ:
+            _sampleRate = 44100;
+            break;
+        case Format::SF_32000_HZ:
+            _sampleRate = 32000;
+            break;
+        case Format::SF_16000_HZ:
+            _sampleRate = 16000;
+            break;
+        default:
+            _sampleRate = 0;
+            result = Core::ERROR_NOT_SUPPORTED;
+            break;
+        }
+
+        if (_actuals.ChannelMode() != Format::CM_STEREO) {
+            _sampleRate = 0;
+            result = Core::ERROR_NOT_SUPPORTED;
+        }
+
+        _lock.Unlock();
+
+        return (result);
+    }
+
+    /* virtual */ void AptX::Configuration(StreamFormat& format, string& settings) const
+    {
+        _lock.Lock();
+
+        format.FrameRate = 0;
+        format.Resolution = 16; // Always 16-bit samples
+        format.SampleRate = _sampleRate;
+        format.Channels = 2;
+
+        _lock.Unlock();
+
+        // Nothing to tune.
+        settings.clear();
+    }
+
+    /* virtual */ uint16_t AptX::Serialize(const bool capabilities, uint8_t stream[], const uint16_t length) const
+    {
+        _lock.Lock();
+
+        const uint16_t result = (capabilities? _supported.Serialize(stream, length) : _actuals.Serialize(stream, length));
+
+        _lock.Unlock();
+
+        return (result);
+    }
+
+    /* virtual */ uint16_t AptX::Encode(const uint16_t inBufferSize, const uint8_t inBuffer[],
+                                        uint16_t& outSize, uint8_t outBuffer[]) const
+    {
+        ASSERT(_sampleRate != 0);
+
+        ASSERT(inBuffer != nullptr);
+        ASSERT(outBuffer != nullptr);
+
+        uint16_t consumed = 0;
+        uint16_t produced = 0;
+
+        if (_sampleRate != 0) {
+            uint16_t frames = std::min<uint16_t>((inBufferSize / RawFrameSize()), (outSize / EncodedFrameSize()));
+            uint8_t samples[CHUNK * SAMPLES * 2 * SAMPLE_SIZE];
+
+            while (frames > 0) {
+                const uint16_t chunk = std::min<uint16_t>(frames, CHUNK);
+                const uint16_t count = (chunk * SAMPLES * 2);
+                const uint8_t* source = (inBuffer + consumed);
+
+                for (uint16_t index = 0; index < count; index++) {
+                    samples[(index * SAMPLE_SIZE) + 0] = 0;
+                    samples[(index * SAMPLE_SIZE) + 1] = source[(index * 2) + 0];
+                    samples[(index * SAMPLE_SIZE) + 2] = source[(index * 2) + 1];
+                }
+
+                size_t written = 0;
+                const size_t processed = aptx_encode(static_cast<struct aptx_context*>(_encoder), samples, (count * SAMPLE_SIZE),
+                                                     (outBuffer + produced), (outSize - produced), &written);
+
+                if (processed != (count * SAMPLE_SIZE)) {
+                    TRACE_L1("Failed to encode aptX samples!");
+                    break;
+                }
+
+                consumed += (count * sizeof(int16_t));
+                produced += written;
+                frames -= chunk;
+            }
+        }
+
+        outSize = produced;
+
+        return (consumed);
+    }
+
+    /* virtual */ uint16_t AptX::Decode(const uint16_t inBufferSize, const uint8_t inBuffer[],
+                                        uint16_t& outSize, uint8_t outBuffer[]) const
+    {
+        ASSERT(_sampleRate != 0);
+
+        ASSERT(inBuffer != nullptr);
+        ASSERT(outBuffer != nullptr);
+
+        uint16_t consumed = 0;
+        uint16_t produced = 0;
+
+        if (_sampleRate != 0) {
+            uint16_t frames = std::min<uint16_t>((inBufferSize / EncodedFrameSize()), (outSize / RawFrameSize()));
+            uint8_t samples[CHUNK * SAMPLES * 2 * SAMPLE_SIZE];
+
+            while (frames > 0) {
+                const uint16_t chunk = std::min<uint16_t>(frames, CHUNK);
+
+                size_t written = 0;
+                const size_t processed = aptx_decode(static_cast<struct aptx_context*>(_decoder), (inBuffer + consumed), (chunk * EncodedFrameSize()),
+                                                     samples, sizeof(samples), &written);
+
+                if (processed != (chunk * EncodedFrameSize())) {
+                    TRACE_L1("Failed to decode aptX codewords!");
+                    break;
+                }
+
+                const uint16_t count = (written / SAMPLE_SIZE);
+                uint8_t* target = (outBuffer + produced);
+
+                for (uint16_t index = 0; index < count; index++) {
+                    target[(index * 2) + 0] = samples[(index * SAMPLE_SIZE) + 1];
+                    target[(index * 2) + 1] = samples[(index * SAMPLE_SIZE) + 2];
+                }
+
+                consumed += processed;
+                produced += (count * sizeof(int16_t));
+                frames -= chunk;
+            }
+        }
+
+        outSize = produced;
+
+        return (consumed);
+    }
+
+    /* virtual */ uint32_t AptX::QOS(const int8_t policy)
+    {
+        // The bitrate is fixed, only the sampling frequency sets it.
+        return (policy == 0 ? Core::ERROR_NONE : Core::ERROR_NOT_SUPPORTED);
+    }
+
+    void AptX::AptXInitialize()
+    {
+        _lock.Lock();
+
+        ASSERT(_encoder == nullptr);
+        ASSERT(_decoder == nullptr);
+
+        _encoder = aptx_init(0 /* not HD */);
+        ASSERT(_encoder != nullptr);
+
+        _decoder = aptx_init(0 /* not HD */);
+        ASSERT(_decoder != nullptr);
+
+        _lock.Unlock();
+    }
+
+    void AptX::AptXDeinitialize()
+    {
+        _lock.Lock();
+
+        _sampleRate = 0;
+
+        aptx_finish(static_cast<struct aptx_context*>(_encoder));
+        _encoder = nullptr;
+
+        aptx_finish(static_cast<struct aptx_context*>(_decoder));
+        _decoder = nullptr;
+
+        _lock.Unlock();
+    }
+
+} // namespace A2DP
+
+} // namespace Bluetooth
+
+}
@@ -0,0 +1,233 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2021 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "../Module.h"
+#include "../IAudioCodec.h"
+#include "../DataRecord.h"
+
+namespace Thunder {
+
+namespace Bluetooth {
+
+namespace A2DP {
+
+    // aptX (stereo, 4:1 ADPCM in four subbands), encoded with the open source libopenaptx (only
+    // built with BLUETOOTH_AUDIO_APTX). The packets carry the bare codewords, a frame is one
+    // codeword pair: four stereo samples. The bitrate follows from the sampling frequency only.
+    class EXTERNAL AptX : public IAudioCodec {
+    public:
+        static constexpr uint8_t CODEC_TYPE = IAudioCodec::VENDOR_CODEC_TYPE;
+        static constexpr uint32_t VENDOR_ID = 0x0000004F; // APT Licensing Ltd.
+        static constexpr uint16_t CODEC_ID = 0x0001;
+
+        static constexpr uint8_t SAMPLES = 4; // per channel, in a frame
+
+    public:
+        class Format {
+        public:
+            enum samplingfrequency : uint8_t {
+                SF_INVALID      = 0,
+                SF_48000_HZ     = 1,
+                SF_44100_HZ     = 2,
+                SF_32000_HZ     = 4,
+                SF_16000_HZ     = 8
+            };
+
+            enum channelmode : uint8_t {
+                CM_INVALID      = 0,
+                CM_MONO         = 1,
+                CM_STEREO       = 2
+            };
+
+        public:
+            Format()
+                : _samplingFrequency(SF_44100_HZ)
+                , _channelMode(CM_STEREO)
+            {
+            }
+            Format(const uint8_t stream[], const uint16_t length)
+                : _samplingFrequency(SF_44100_HZ)
+                , _channelMode(CM_STEREO)
+            {
+                Deserialize(stream, length);
+            }
+            Format(const uint8_t samplingFrequencies, const uint8_t channelModes)
+                : _samplingFrequency(samplingFrequencies)
+                , _channelMode(channelModes)
+            {
+            }
+            ~Format() = default;
+            Format(const Format&) = default;
+            Format& operator=(const Format&) = default;
+
+        public:
+            static bool IsCodec(const uint8_t stream[], const uint16_t length)
+            {
+                return ((length >= 9) && ((stream[0] >> 4) == IAudioCodec::MEDIA_TYPE) && (stream[1] == CODEC_TYPE)
+                        && (stream[2] == (VENDOR_ID & 0xFF)) && (stream[3] == ((VENDOR_ID >> 8) & 0xFF))
+                        && (stream[4] == ((VENDOR_ID >> 16) & 0xFF)) && (stream[5] == ((VENDOR_ID >> 24) & 0xFF))
+                        && (stream[6] == (CODEC_ID & 0xFF)) && (stream[7] == ((CODEC_ID >> 8) & 0xFF)));
+            }
+
+        public:
+            uint16_t Serialize(uint8_t stream[], const uint16_t length) const
+            {
+                ASSERT(length >= 9);
+
+                uint8_t octet;
+                Bluetooth::DataRecordLE data(stream, length, 0);
+
+                data.Push(IAudioCodec::MEDIA_TYPE);
+                data.Push(CODEC_TYPE);
+                data.Push(VENDOR_ID);
+                data.Push(CODEC_ID);
+
+                octet = ((static_cast<uint8_t>(_samplingFrequency) << 4) | static_cast<uint8_t>(_channelMode));
+                data.Push(octet);
+
+                return (data.Length());
+            }
+            uint16_t Deserialize(const uint8_t stream[], const uint16_t length)
+            {
+                ASSERT(length >= 9);
+
+                Bluetooth::DataRecordLE data(stream, length);
+
+                uint8_t octet{};
+                uint32_t vendor{};
+                uint16_t codec{};
+
+                data.Pop(octet);
+                ASSERT((octet >> 4) == IAudioCodec::MEDIA_TYPE);
+
+                data.Pop(octet);
+                ASSERT(octet == CODEC_TYPE);
+
+                data.Pop(vendor);
+                ASSERT(vendor == VENDOR_ID);
+
+                data.Pop(codec);
+                ASSERT(codec == CODEC_ID);
+
+                data.Pop(octet);
+                _samplingFrequency = (octet >> 4);
+                _channelMode = (octet & 0xF);
+
+                return (9);
+            }
+
+        public:
+            uint8_t SamplingFrequency() const {
+                return (_samplingFrequency);
+            }
+            uint8_t ChannelMode() const {
+                return (_channelMode);
+            }
+
+        public:
+            void SamplingFrequency(const samplingfrequency sf)
+            {
+                _samplingFrequency = sf;
+            }
+            void ChannelMode(const channelmode cm)
+            {
+                _channelMode = cm;
+            }
+
+        private:
+            uint8_t _samplingFrequency;
+            uint8_t _channelMode;
+        }; // class Format
+
+    public:
+        AptX()
+            : _lock()
+            , _supported((Format::SF_16000_HZ | Format::SF_32000_HZ | Format::SF_44100_HZ | Format::SF_48000_HZ), Format::CM_STEREO)
+            , _actuals()
+            , _sampleRate(0)
+            , _encoder(nullptr)
+            , _decoder(nullptr)
+        {
+            AptXInitialize();
+        }
+        AptX(const Bluetooth::Buffer& config)
+            : _lock()
+            , _supported(config.data(), config.length())
+            , _actuals()
+            , _sampleRate(0)
+            , _encoder(nullptr)
+            , _decoder(nullptr)
+        {
+            AptXInitialize();
+        }
+        ~AptX() override
+        {
+            AptXDeinitialize();
+        }
+
+    public:
+        IAudioCodec::codectype Type() const override {
+            return (IAudioCodec::codectype::APTX);
+        }
+        uint32_t BitRate() const override {
+            // Four bits per sample, always two channels.
+            return (_sampleRate * 4 * 2);
+        }
+        uint16_t RawFrameSize() const override {
+            return (SAMPLES * 2 * sizeof(int16_t));
+        }
+        uint16_t EncodedFrameSize() const override {
+            return (2 * sizeof(uint16_t));
+        }
+
+        uint32_t Configure(const uint8_t stream[], const uint16_t length) override;
+        uint32_t Configure(const StreamFormat& format, const string& settings) override;
+
+        void Configuration(StreamFormat& format, string& settings) const override;
+
+        uint32_t QOS(const int8_t policy) override;
+
+        uint16_t Encode(const uint16_t inBufferSize, const uint8_t inBuffer[],
+                        uint16_t& outBufferSize, uint8_t outBuffer[]) const override;
+
+        uint16_t Decode(const uint16_t inBufferSize, const uint8_t inBuffer[],
+                        uint16_t& outBufferSize, uint8_t outBuffer[]) const override;
+
+        uint16_t Serialize(const bool capabilities, uint8_t stream[], const uint16_t length) const override;
+
+    private:
+        void AptXInitialize();
+        void AptXDeinitialize();
+
+    private:
+        mutable Core::CriticalSection _lock;
+        Format _supported;
+        Format _actuals;
+        std::atomic<uint32_t> _sampleRate;
+        void* _encoder;
+        void* _decoder;
+    }; // class AptX
+
+} // namespace A2DP
+
+} // namespace Bluetooth
+
+}
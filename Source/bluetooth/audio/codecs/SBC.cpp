@@ -20,8 +20,7 @@
 #include "../Module.h"
 
 #include "SBC.h"
-
-#include <sbc/sbc.h>
+#include "sbc/Codec.h"
 
 namespace Thunder {
 
@@ -303,8 +302,10 @@ namespace A2DP {
     /* virtual */ uint16_t SBC::Encode(const uint16_t inBufferSize, const uint8_t inBuffer[],
                                        uint16_t& outSize, uint8_t outBuffer[]) const
     {
-        ASSERT(_rawFrameSize != 0);
-        ASSERT(_encodedFrameSize != 0);
+        // Taken once, a configuration change applies to the next packet.
+        const SBCCodec::Parameters parameters(_parameters.load(std::memory_order_acquire));
+
+        ASSERT(parameters.IsValid() == true);
 
         ASSERT(inBuffer != nullptr);
         ASSERT(outBuffer != nullptr);
@@ -313,46 +314,35 @@ namespace A2DP {
         uint16_t produced = sizeof(SBCHeader);
         uint16_t count = 0;
 
-        _lock.Lock();
-
-        if ((_rawFrameSize != 0) && (_encodedFrameSize != 0)) {
+        if (parameters.IsValid() == true) {
 
             const uint8_t MAX_FRAMES = 15; // only a four bit number holds the number of frames in a packet
 
-            uint16_t frames = (inBufferSize / _rawFrameSize);
-            uint16_t available = (outSize - produced);
+            const uint16_t rawFrameSize = parameters.CodeSize();
+            const uint16_t encodedFrameSize = parameters.FrameLength();
 
             ASSERT(outSize >= sizeof(SBCHeader));
 
+            uint16_t frames = (inBufferSize / rawFrameSize);
+            uint16_t available = (outSize - produced);
+
             if (frames > MAX_FRAMES) {
                 frames = MAX_FRAMES;
             }
 
             while ((frames-- > 0)
-                    && (inBufferSize >= (consumed + _rawFrameSize))
-                    && (available >= _encodedFrameSize)) {
+                    && (inBufferSize >= (consumed + rawFrameSize))
+                    && (available >= encodedFrameSize)) {
 
-                ssize_t written = 0;
-                ssize_t read = ::sbc_encode(static_cast<::sbc_t*>(_sbcHandle),
-                                            (inBuffer + consumed), _rawFrameSize,
-                                            (outBuffer + produced), available,
-                                            &written);
+                const uint16_t written = _encoder->Encode(parameters, (inBuffer + consumed), (outBuffer + produced));
 
-                if (read < 0) {
-                    TRACE_L1("Failed to encode an SBC frame!");
-                    break;
-                }
-                else {
-                    consumed += read;
-                    available -= written;
-                    produced += written;
-                    count++;
-                }
+                consumed += rawFrameSize;
+                available -= written;
+                produced += written;
+                count++;
             }
         }
 
-        _lock.Unlock();
-
         if (count > 0) {
             SBCHeader* header = reinterpret_cast<SBCHeader*>(outBuffer);
             header->frameCount = (count & 0xF);
@@ -368,8 +358,9 @@ namespace A2DP {
     /* virtual */ uint16_t SBC::Decode(const uint16_t inBufferSize, const uint8_t inBuffer[],
                                        uint16_t& outSize, uint8_t outBuffer[]) const
     {
-        ASSERT(_rawFrameSize != 0);
-        ASSERT(_encodedFrameSize != 0);
+        const SBCCodec::Parameters parameters(_parameters.load(std::memory_order_acquire));
+
+        ASSERT(parameters.IsValid() == true);
 
         ASSERT(inBuffer != nullptr);
         ASSERT(outBuffer != nullptr);
@@ -378,26 +369,27 @@ namespace A2DP {
         uint16_t produced = 0;
         uint16_t available = outSize;
 
-        _lock.Lock();
-
-        if ((_rawFrameSize != 0) && (_encodedFrameSize != 0)) {
+        if (parameters.IsValid() == true) {
 
             ASSERT(outSize >= sizeof(SBCHeader));
             const SBCHeader* header = reinterpret_cast<const SBCHeader*>(inBuffer);
 
+            const uint16_t rawFrameSize = parameters.CodeSize();
+            const uint16_t encodedFrameSize = parameters.FrameLength();
+
             uint8_t frames =  header->frameCount;
             consumed = sizeof(SBCHeader);
 
             while ((frames != 0)
-                    && (inBufferSize >= (consumed + _encodedFrameSize))
-                    && (available >= _rawFrameSize)) {
-
-                size_t written = 0;
-                ssize_t read = ::sbc_decode(static_cast<::sbc_t*>(_sbcHandle),
-                                            (inBuffer + consumed), _encodedFrameSize,
-                                            (outBuffer + produced), available,
-                                            &written);
+                    && (inBufferSize >= (consumed + encodedFrameSize))
+                    && (available >= rawFrameSize)) {
 
+                // The frames describe themselves, the decoder follows whatever the source sends.
+                SBCCodec::Parameters frame;
+                uint16_t written = 0;
+                const int32_t read = _decoder->Decode((inBuffer + consumed), (inBufferSize - consumed),
+                                                      (outBuffer + produced), available,
+                                                      written, frame);
 
                 if (read < 0) {
                     TRACE_L1("Failed to decode an SBC frame!");
@@ -415,8 +407,6 @@ namespace A2DP {
             ASSERT(frames == 0);
         }
 
-        _lock.Unlock();
-
         outSize = produced;
 
         return (consumed);
@@ -426,11 +416,11 @@ namespace A2DP {
     {
         uint32_t result = Core::ERROR_NONE;
 
+        _lock.Lock();
+
         ASSERT(_preferredBitpool != 0);
 
-        const uint8_t STEP = (_preferredBitpool / 10);
-
-        _lock.Lock();
+        const uint8_t STEP = (_preferredBitpool >= 10 ? (_preferredBitpool / 10) : 1);
 
         uint8_t newBitpool = _bitpool;
 
@@ -453,7 +443,7 @@ namespace A2DP {
         else {
             // increase quality
             if (_bitpool == _preferredBitpool) {
-                newBitpool = Core::ERROR_UNAVAILABLE;
+                result = Core::ERROR_UNAVAILABLE;
             }
             else if ((_bitpool + STEP) >= _preferredBitpool) {
                 newBitpool = _preferredBitpool;
@@ -491,12 +481,14 @@ namespace A2DP {
     {
         _lock.Lock();
 
-        ASSERT(_sbcHandle == nullptr);
+        ASSERT(_encoder == nullptr);
+        ASSERT(_decoder == nullptr);
 
-        _sbcHandle = static_cast<void*>(new ::sbc_t);
-        ASSERT(_sbcHandle != nullptr);
+        _encoder = new SBCCodec::Encoder();
+        ASSERT(_encoder != nullptr);
 
-        ::sbc_init(static_cast<::sbc_t*>(_sbcHandle), 0L);
+        _decoder = new SBCCodec::Decoder();
+        ASSERT(_decoder != nullptr);
 
         _lock.Unlock();
     }
@@ -505,13 +497,13 @@ namespace A2DP {
     {
         _lock.Lock();
 
-        if (_sbcHandle != nullptr) {
-            ::sbc_finish(static_cast<::sbc_t*>(_sbcHandle));
+        _parameters.store(0, std::memory_order_release);
 
-            delete static_cast<::sbc_t*>(_sbcHandle);
+        delete _encoder;
+        _encoder = nullptr;
 
-            _sbcHandle = nullptr;
-        }
+        delete _decoder;
+        _decoder = nullptr;
 
         _lock.Unlock();
     }
@@ -520,46 +512,33 @@ namespace A2DP {
     {
         _lock.Lock();
 
-        ASSERT(_sbcHandle != nullptr);
-        ::sbc_reinit(static_cast<::sbc_t*>(_sbcHandle), 0L);
-
         uint32_t rate;
-        uint32_t blocks;
-        uint32_t bands;
-
-        ::sbc_t* sbc = static_cast<::sbc_t*>(_sbcHandle);
-
-        sbc->bitpool = _bitpool;
-        sbc->allocation = (_actuals.AllocationMethod() == Format::AM_LOUDNESS? SBC_AM_LOUDNESS : SBC_AM_SNR);
+        uint8_t blocks;
+        uint8_t bands;
+        SBCCodec::Parameters::channelmode mode;
 
         switch (_actuals.SubBands()) {
         default:
         case Format::SB_8:
-            sbc->subbands = SBC_SB_8;
             bands = 8;
             break;
         case Format::SB_4:
-            sbc->subbands = SBC_SB_4;
             bands = 4;
             break;
         }
 
         switch (_actuals.SamplingFrequency()) {
         case Format::SF_48000_HZ:
-            sbc->frequency = SBC_FREQ_48000;
             rate = 48000;
             break;
         default:
         case Format::SF_44100_HZ:
-            sbc->frequency = SBC_FREQ_44100;
             rate = 44100;
             break;
         case Format::SF_32000_HZ:
-            sbc->frequency = SBC_FREQ_32000;
             rate = 32000;
             break;
         case Format::SF_16000_HZ:
-            sbc->frequency = SBC_FREQ_16000;
             rate = 16000;
             break;
         }
@@ -567,19 +546,15 @@ namespace A2DP {
         switch (_actuals.BlockLength()) {
         default:
         case Format::BL_16:
-            sbc->blocks = SBC_BLK_16;
             blocks = 16;
             break;
         case Format::BL_12:
-            sbc->blocks = SBC_BLK_12;
             blocks = 12;
             break;
         case Format::BL_8:
-            sbc->blocks = SBC_BLK_8;
             blocks = 8;
             break;
         case Format::BL_4:
-            sbc->blocks = SBC_BLK_4;
             blocks = 4;
             break;
         }
@@ -587,27 +562,34 @@ namespace A2DP {
         switch (_actuals.ChannelMode()) {
         default:
         case Format::CM_JOINT_STEREO:
-            sbc->mode = SBC_MODE_JOINT_STEREO;
+            mode = SBCCodec::Parameters::JOINT_STEREO;
             break;
         case Format::CM_STEREO:
-            sbc->mode = SBC_MODE_STEREO;
+            mode = SBCCodec::Parameters::STEREO;
             break;
         case Format::CM_DUAL_CHANNEL:
-            sbc->mode = SBC_MODE_DUAL_CHANNEL;
+            mode = SBCCodec::Parameters::DUAL_CHANNEL;
             break;
         case Format::CM_MONO:
-            sbc->mode = SBC_MODE_MONO;
+            mode = SBCCodec::Parameters::MONO;
             break;
         }
 
-        _frameDuration = ::sbc_get_frame_duration(sbc); /* microseconds */
-        _rawFrameSize = ::sbc_get_codesize(sbc); /* bytes */
-        _encodedFrameSize = ::sbc_get_frame_length(sbc); /* bytes */
+        const SBCCodec::Parameters parameters(rate, blocks, mode,
+                                              (_actuals.AllocationMethod() == Format::AM_SNR? SBCCodec::Parameters::SNR : SBCCodec::Parameters::LOUDNESS),
+                                              bands, _bitpool);
 
-        _bitRate = ((8L * _encodedFrameSize * rate) / (bands * blocks)); /* bits per second */
-        _channels = (sbc->mode == SBC_MODE_MONO? 1 : 2);
+        _frameDuration = parameters.Duration(); /* microseconds */
+        _rawFrameSize = parameters.CodeSize(); /* bytes */
+        _encodedFrameSize = parameters.FrameLength(); /* bytes */
+
+        _bitRate = parameters.BitRate(); /* bits per second */
+        _channels = parameters.Channels();
         _sampleRate = rate;
 
+        // The streaming side picks it up from the next packet on.
+        _parameters.store(parameters.Packed(), std::memory_order_release);
+
         _lock.Unlock();
     }
 
@@ -642,8 +624,8 @@ namespace A2DP {
         Core::EnumerateType<preset> preset(_preset);
         TRACE(Trace::Information, (_T("Quality preset: %s"), (preset.IsSet() == true? preset.Data() : "(custom)")));
         TRACE(Trace::Information, (_T("Bitpool value: %d"), _bitpool));
-        TRACE(Trace::Information, (_T("Bitrate: %d bps"), _bitRate));
-        TRACE(Trace::Information, (_T("Frame size: raw %d bytes, encoded %d bytes (%d us)"), _rawFrameSize, _encodedFrameSize, _frameDuration));
+        TRACE(Trace::Information, (_T("Bitrate: %d bps"), _bitRate.load()));
+        TRACE(Trace::Information, (_T("Frame size: raw %d bytes, encoded %d bytes (%d us)"), _rawFrameSize.load(), _encodedFrameSize.load(), _frameDuration));
     }
 #endif // __DEBUG__
 
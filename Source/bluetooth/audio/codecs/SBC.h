@@ -29,6 +29,13 @@ namespace Bluetooth {
 
 namespace A2DP {
 
+    namespace SBCCodec {
+        class Encoder;
+        class Decoder;
+    }
+
+    // Encode() and Decode() run without a lock, on the (one) thread that streams the audio, a
+    // new configuration is taken over from the next packet on.
     class EXTERNAL SBC : public IAudioCodec {
     public:
         static constexpr uint8_t CODEC_TYPE = 0x00; // SBC
@@ -149,6 +156,12 @@ namespace A2DP {
             Format(const Format&) = default;
             Format& operator=(const Format&) = default;
 
+        public:
+            static bool IsCodec(const uint8_t stream[], const uint16_t length)
+            {
+                return ((length >= 6) && ((stream[0] >> 4) == IAudioCodec::MEDIA_TYPE) && (stream[1] == CODEC_TYPE));
+            }
+
         public:
             uint16_t Serialize(uint8_t stream[], const uint16_t length) const
             {
@@ -269,7 +282,9 @@ namespace A2DP {
             , _supported(maxBitpool, minBitpool)
             , _actuals()
             , _preset(COMPATIBLE)
-            , _sbcHandle(nullptr)
+            , _encoder(nullptr)
+            , _decoder(nullptr)
+            , _parameters(0)
             , _preferredBitpool(0)
             , _bitpool(0)
             , _bitRate(0)
@@ -286,7 +301,9 @@ namespace A2DP {
             , _supported(config.data(), config.length())
             , _actuals()
             , _preset(COMPATIBLE)
-            , _sbcHandle(nullptr)
+            , _encoder(nullptr)
+            , _decoder(nullptr)
+            , _parameters(0)
             , _preferredBitpool(0)
             , _bitpool(0)
             , _bitRate(0)
@@ -351,14 +368,17 @@ namespace A2DP {
         Format _supported;
         Format _actuals;
         preset _preset;
-        void* _sbcHandle;
+        SBCCodec::Encoder* _encoder;
+        SBCCodec::Decoder* _decoder;
+        // The frame header (SBCCodec::Parameters) the audio is coded with.
+        std::atomic<uint16_t> _parameters;
         uint8_t _preferredBitpool;
         uint8_t _bitpool;
-        uint32_t _bitRate;
+        std::atomic<uint32_t> _bitRate;
         uint32_t _sampleRate;
         uint8_t _channels;
-        uint16_t _rawFrameSize;
-        uint16_t _encodedFrameSize;
+        std::atomic<uint16_t> _rawFrameSize;
+        std::atomic<uint16_t> _encodedFrameSize;
         uint32_t _frameDuration;
 
     private:
@@ -0,0 +1,731 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2021 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Codec.h"
+
+#include <cmath>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SBC_NEON
+#elif defined(__SSE__) || defined(__x86_64__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define SBC_SSE
+#endif
+
+namespace Thunder {
+
+namespace Bluetooth {
+
+namespace A2DP {
+
+namespace SBCCodec {
+
+namespace {
+
+    // Four floats, handled at once where the target allows.
+#if defined(SBC_NEON)
+    typedef float32x4_t Lanes;
+
+    inline Lanes Load(const float data[]) { return (vld1q_f32(data)); }
+    inline void Store(float data[], const Lanes value) { vst1q_f32(data, value); }
+    inline Lanes Splat(const float value) { return (vdupq_n_f32(value)); }
+    inline Lanes MultiplyAdd(const Lanes sum, const Lanes a, const Lanes b) { return (vmlaq_f32(sum, a, b)); }
+#elif defined(SBC_SSE)
+    typedef __m128 Lanes;
+
+    inline Lanes Load(const float data[]) { return (_mm_loadu_ps(data)); }
+    inline void Store(float data[], const Lanes value) { _mm_storeu_ps(data, value); }
+    inline Lanes Splat(const float value) { return (_mm_set1_ps(value)); }
+    inline Lanes MultiplyAdd(const Lanes sum, const Lanes a, const Lanes b) { return (_mm_add_ps(sum, _mm_mul_ps(a, b))); }
+#else
+    struct Lanes {
+        float Value[4];
+    };
+
+    inline Lanes Load(const float data[]) { return (Lanes { { data[0], data[1], data[2], data[3] } }); }
+    inline void Store(float data[], const Lanes value) { ::memcpy(data, value.Value, sizeof(value.Value)); }
+    inline Lanes Splat(const float value) { return (Lanes { { value, value, value, value } }); }
+    inline Lanes MultiplyAdd(const Lanes sum, const Lanes a, const Lanes b)
+    {
+        return (Lanes { { sum.Value[0] + (a.Value[0] * b.Value[0]), sum.Value[1] + (a.Value[1] * b.Value[1]),
+                          sum.Value[2] + (a.Value[2] * b.Value[2]), sum.Value[3] + (a.Value[3] * b.Value[3]) } });
+    }
+#endif
+
+    // Half of the (symmetric) prototype filters, h[i] == h[10 * M - i], the windows of the
+    // specification (tables 12.23 and 12.24) alternate the sign every 2 * M coefficients.
+    const float Prototype4[21] = {
+        0.00000000E+00f, 5.36548976E-04f, 1.49188357E-03f, 2.73370904E-03f,
+        3.83720193E-03f, 3.89205149E-03f, 1.86581691E-03f, -3.06012286E-03f,
+        -1.09137620E-02f, -2.04385087E-02f, -2.88757392E-02f, -3.21939290E-02f,
+        -2.58767811E-02f, -6.13245186E-03f, 2.88217274E-02f, 7.76463494E-02f,
+        1.35593274E-01f, 1.94987841E-01f, 2.46636662E-01f, 2.81828203E-01f,
+        2.94315332E-01f
+    };
+    const float Prototype8[41] = {
+        0.00000000E+00f, 1.56575398E-04f, 3.43256425E-04f, 5.54620202E-04f,
+        8.23919506E-04f, 1.13992507E-03f, 1.47640169E-03f, 1.78371725E-03f,
+        2.01182542E-03f, 2.10371989E-03f, 1.99454554E-03f, 1.61656283E-03f,
+        9.02154502E-04f, -1.78805361E-04f, -1.64973098E-03f, -3.49717454E-03f,
+        -5.65949473E-03f, -8.02941163E-03f, -1.04584443E-02f, -1.27472335E-02f,
+        -1.46525263E-02f, -1.59045603E-02f, -1.62208471E-02f, -1.53184106E-02f,
+        -1.29371806E-02f, -8.85757540E-03f, -2.92408442E-03f, 4.91578024E-03f,
+        1.46404076E-02f, 2.61098752E-02f, 3.90751381E-02f, 5.31873032E-02f,
+        6.79989431E-02f, 8.29847578E-02f, 9.75753918E-02f, 1.11196689E-01f,
+        1.23264548E-01f, 1.33264415E-01f, 1.40753505E-01f, 1.45389847E-01f,
+        1.46955068E-01f
+    };
+
+    // Loudness offsets (table 12.21), per sampling frequency and subband.
+    const int8_t Offset4[4][4] = {
+        { -1, 0, 0, 0 },
+        { -2, 0, 0, 1 },
+        { -2, 0, 0, 1 },
+        { -2, 0, 0, 1 }
+    };
+    const int8_t Offset8[4][8] = {
+        { -2, 0, 0, 0, 0, 0, 0, 1 },
+        { -3, 0, 0, 0, 0, 0, 1, 2 },
+        { -4, 0, 0, 0, 0, 0, 1, 2 },
+        { -4, 0, 0, 0, 0, 0, 1, 2 }
+    };
+
+    template <const uint8_t M>
+    class Filterbank {
+    private:
+        Filterbank(const Filterbank&) = delete;
+        Filterbank& operator=(const Filterbank&) = delete;
+
+        // Windows and matrices, the matrices transposed so the outputs are in the lanes.
+        struct Tables {
+            Tables()
+            {
+                const float* prototype = (M == 4 ? Prototype4 : Prototype8);
+
+                for (uint8_t i = 0; i < (10 * M); i++) {
+                    const float h = prototype[i <= (5 * M) ? i : ((10 * M) - i)];
+
+                    Analysis[i] = (((i / (2 * M)) & 1) != 0 ? -h : h);
+                    // D[i] = -M * C[i]
+                    Synthesis[i] = Analysis[i] * -static_cast<float>(M);
+                }
+                for (uint8_t k = 0; k < M; k++) {
+                    for (uint8_t i = 0; i < (2 * M); i++) {
+                        Matrix[i][k] = static_cast<float>(std::cos((k + 0.5) * (i - (M / 2.0)) * M_PI / M));
+                        Inverse[k][i] = static_cast<float>(std::cos((i + (M / 2.0)) * (k + 0.5) * M_PI / M));
+                    }
+                }
+            }
+
+            float Analysis[10 * M];
+            float Synthesis[10 * M];
+            float Matrix[2 * M][M];
+            float Inverse[M][2 * M];
+        };
+
+        static const Tables& Instance()
+        {
+            static const Tables tables;
+            return (tables);
+        }
+
+    public:
+        // X: the last 10 * M input samples, the latest first, S: the M subband samples.
+        static void Analyze(const float X[], float S[])
+        {
+            const Tables& tables(Instance());
+            float Y[2 * M];
+
+            for (uint8_t i = 0; i < (2 * M); i += 4) {
+                Lanes sum(Splat(0));
+
+                for (uint8_t j = 0; j < 10; j += 2) {
+                    sum = MultiplyAdd(sum, Load(&(tables.Analysis[i + (j * M)])), Load(&(X[i + (j * M)])));
+                }
+
+                Store(&(Y[i]), sum);
+            }
+
+            Lanes out[M / 4];
+
+            for (uint8_t k = 0; k < (M / 4); k++) {
+                out[k] = Splat(0);
+            }
+            for (uint8_t i = 0; i < (2 * M); i++) {
+                const Lanes y(Splat(Y[i]));
+
+                for (uint8_t k = 0; k < (M / 4); k++) {
+                    out[k] = MultiplyAdd(out[k], Load(&(tables.Matrix[i][k * 4])), y);
+                }
+            }
+            for (uint8_t k = 0; k < (M / 4); k++) {
+                Store(&(S[k * 4]), out[k]);
+            }
+        }
+        // S: the M subband samples, V: the last 20 * M values of the matrixing, the first
+        // 2 * M are calculated here, x: the M output samples.
+        static void Synthesize(const float S[], float V[], float x[])
+        {
+            const Tables& tables(Instance());
+            Lanes out[M / 2];
+
+            for (uint8_t i = 0; i < (M / 2); i++) {
+                out[i] = Splat(0);
+            }
+            for (uint8_t k = 0; k < M; k++) {
+                const Lanes s(Splat(S[k]));
+
+                for (uint8_t i = 0; i < (M / 2); i++) {
+                    out[i] = MultiplyAdd(out[i], Load(&(tables.Inverse[k][i * 4])), s);
+                }
+            }
+            for (uint8_t i = 0; i < (M / 2); i++) {
+                Store(&(V[i * 4]), out[i]);
+            }
+
+            for (uint8_t j = 0; j < M; j += 4) {
+                Lanes sum(Splat(0));
+
+                for (uint8_t i = 0; i < 5; i++) {
+                    sum = MultiplyAdd(sum, Load(&(tables.Synthesis[j + (i * 2 * M)])), Load(&(V[j + (i * 4 * M)])));
+                    sum = MultiplyAdd(sum, Load(&(tables.Synthesis[j + (i * 2 * M) + M])), Load(&(V[j + (i * 4 * M) + (3 * M)])));
+                }
+
+                Store(&(x[j]), sum);
+            }
+        }
+    };
+
+    class BitWriter {
+    public:
+        BitWriter(const BitWriter&) = delete;
+        BitWriter& operator=(const BitWriter&) = delete;
+
+        BitWriter(uint8_t buffer[])
+            : _buffer(buffer)
+            , _bits(0)
+            , _value(0)
+            , _pending(0)
+        {
+        }
+        ~BitWriter() = default;
+
+    public:
+        inline uint16_t Bits() const
+        {
+            return (_bits);
+        }
+        void Write(const uint16_t value, const uint8_t bits)
+        {
+            _value = (_value << bits) | (value & ((1 << bits) - 1));
+            _pending += bits;
+            _bits += bits;
+
+            while (_pending >= 8) {
+                _pending -= 8;
+                *_buffer++ = static_cast<uint8_t>(_value >> _pending);
+            }
+        }
+        // Pads the last octet with zeroes, returns the octets written.
+        uint16_t Flush()
+        {
+            if (_pending != 0) {
+                Write(0, 8 - _pending);
+            }
+            return (_bits / 8);
+        }
+
+    private:
+        uint8_t* _buffer;
+        uint16_t _bits;
+        uint32_t _value;
+        uint8_t _pending;
+    };
+
+    class BitReader {
+    public:
+        BitReader(const BitReader&) = delete;
+        BitReader& operator=(const BitReader&) = delete;
+
+        BitReader(const uint8_t buffer[])
+            : _buffer(buffer)
+            , _bits(0)
+            , _value(0)
+            , _pending(0)
+        {
+        }
+        ~BitReader() = default;
+
+    public:
+        inline uint16_t Bits() const
+        {
+            return (_bits);
+        }
+        uint16_t Read(const uint8_t bits)
+        {
+            while (_pending < bits) {
+                _value = (_value << 8) | *_buffer++;
+                _pending += 8;
+            }
+
+            _pending -= bits;
+            _bits += bits;
+
+            return ((_value >> _pending) & ((1 << bits) - 1));
+        }
+
+    private:
+        const uint8_t* _buffer;
+        uint16_t _bits;
+        uint32_t _value;
+        uint8_t _pending;
+    };
+
+    // CRC-8 (x^8 + x^4 + x^3 + x^2 + 1) over the frame header, without the syncword and the
+    // CRC itself, and the given bits following it (join flags and scale factors).
+    uint8_t CRC(const uint8_t frame[], uint16_t bits)
+    {
+        uint8_t crc = 0x0F;
+        uint16_t index = 1;
+
+        bits += 16;
+
+        while (bits > 0) {
+            const uint8_t octet = frame[index++];
+            const uint8_t count = (bits > 8 ? 8 : bits);
+
+            for (uint8_t bit = 0; bit < count; bit++) {
+                const bool top = (((crc ^ (octet << bit)) & 0x80) != 0);
+
+                crc = (top == true ? ((crc << 1) ^ 0x1D) : (crc << 1));
+            }
+
+            bits -= count;
+
+            if (index == 3) {
+                // Step over the CRC
+                index = 4;
+            }
+        }
+
+        return (crc);
+    }
+
+    // Smallest scale factor so the value fits in 2^(scale factor + 1).
+    inline uint8_t Scale(const float value)
+    {
+        uint8_t result = 0;
+
+        while ((result < 15) && (value >= static_cast<float>(2 << result))) {
+            result++;
+        }
+
+        return (result);
+    }
+
+    // Hands out the bitpool over the bitneed of the given subbands, of one channel, or of two
+    // channels together (interleaved per subband) for stereo and joint stereo.
+    void Distribute(const uint8_t bitpool, const uint8_t count, const int8_t need[], uint8_t bits[])
+    {
+        // More would never end, a subband takes 16 bits at most.
+        const int16_t pool = std::min(static_cast<uint16_t>(bitpool), static_cast<uint16_t>(count * 16));
+        int8_t maximum = need[0];
+
+        for (uint8_t index = 1; index < count; index++) {
+            maximum = std::max(maximum, need[index]);
+        }
+
+        int16_t bitcount = 0;
+        int16_t slicecount = 0;
+        int16_t bitslice = maximum + 1;
+
+        do {
+            bitslice--;
+            bitcount += slicecount;
+            slicecount = 0;
+
+            for (uint8_t index = 0; index < count; index++) {
+                if ((need[index] > (bitslice + 1)) && (need[index] < (bitslice + 16))) {
+                    slicecount++;
+                } else if (need[index] == (bitslice + 1)) {
+                    slicecount += 2;
+                }
+            }
+        } while ((bitcount + slicecount) < pool);
+
+        if ((bitcount + slicecount) == pool) {
+            bitcount += slicecount;
+            bitslice--;
+        }
+
+        for (uint8_t index = 0; index < count; index++) {
+            bits[index] = (need[index] < (bitslice + 2) ? 0 : std::min(need[index] - bitslice, 16));
+        }
+
+        for (uint8_t index = 0; (index < count) && (bitcount < pool); index++) {
+            if ((bits[index] >= 2) && (bits[index] < 16)) {
+                bits[index]++;
+                bitcount++;
+            } else if ((need[index] == (bitslice + 1)) && (pool > (bitcount + 1))) {
+                bits[index] = 2;
+                bitcount += 2;
+            }
+        }
+        for (uint8_t index = 0; (index < count) && (bitcount < pool); index++) {
+            if (bits[index] < 16) {
+                bits[index]++;
+                bitcount++;
+            }
+        }
+    }
+
+    void Allocate(const Parameters& parameters, const uint8_t scales[MAX_CHANNELS][MAX_SUBBANDS], uint8_t bits[MAX_CHANNELS][MAX_SUBBANDS])
+    {
+        const uint8_t subbands = parameters.Subbands();
+        const uint8_t channels = parameters.Channels();
+        // Both channels in one, interleaved per subband.
+        int8_t need[MAX_CHANNELS * MAX_SUBBANDS];
+        uint8_t result[MAX_CHANNELS * MAX_SUBBANDS];
+
+        for (uint8_t ch = 0; ch < channels; ch++) {
+            for (uint8_t sb = 0; sb < subbands; sb++) {
+                const uint8_t scale = scales[ch][sb];
+                int8_t& entry(need[(sb * channels) + ch]);
+
+                if (parameters.Method() == Parameters::SNR) {
+                    entry = scale;
+                } else if (scale == 0) {
+                    entry = -5;
+                } else {
+                    const int8_t loudness = scale - (subbands == 4 ? Offset4[parameters.Frequency()][sb] : Offset8[parameters.Frequency()][sb]);
+                    entry = (loudness > 0 ? (loudness / 2) : loudness);
+                }
+            }
+        }
+
+        if ((parameters.Mode() == Parameters::MONO) || (parameters.Mode() == Parameters::DUAL_CHANNEL)) {
+            for (uint8_t ch = 0; ch < channels; ch++) {
+                int8_t single[MAX_SUBBANDS];
+
+                for (uint8_t sb = 0; sb < subbands; sb++) {
+                    single[sb] = need[(sb * channels) + ch];
+                }
+
+                Distribute(parameters.Bitpool(), subbands, single, bits[ch]);
+            }
+        } else {
+            Distribute(parameters.Bitpool(), subbands * 2, need, result);
+
+            for (uint8_t sb = 0; sb < subbands; sb++) {
+                bits[0][sb] = result[sb * 2];
+                bits[1][sb] = result[(sb * 2) + 1];
+            }
+        }
+    }
+
+    inline int16_t Sample(const uint8_t buffer[], const uint16_t index)
+    {
+        return (static_cast<int16_t>(buffer[index * 2] | (buffer[(index * 2) + 1] << 8)));
+    }
+    inline void Sample(uint8_t buffer[], const uint16_t index, const float value)
+    {
+        const int32_t sample = std::max(std::min(static_cast<int32_t>(std::lrint(value)), 32767), -32768);
+
+        buffer[index * 2] = static_cast<uint8_t>(sample & 0xFF);
+        buffer[(index * 2) + 1] = static_cast<uint8_t>((sample >> 8) & 0xFF);
+    }
+
+} // namespace
+
+    void Encoder::Reset(const Parameters& parameters)
+    {
+        ::memset(_history, 0, sizeof(_history));
+
+        _layout = parameters;
+        _position = (HISTORY - (10 * parameters.Subbands()));
+    }
+
+    uint16_t Encoder::Encode(const Parameters& parameters, const uint8_t input[], uint8_t output[])
+    {
+        ASSERT(parameters.IsValid() == true);
+
+        if (parameters.Octet() != _layout.Octet()) {
+            Reset(parameters);
+        }
+
+        const uint8_t subbands = parameters.Subbands();
+        const uint8_t blocks = parameters.Blocks();
+        const uint8_t channels = parameters.Channels();
+
+        float samples[MAX_BLOCKS][MAX_CHANNELS][MAX_SUBBANDS];
+
+        for (uint8_t blk = 0; blk < blocks; blk++) {
+            if (_position < subbands) {
+                // Move the history to the end again, only once every so many blocks.
+                for (uint8_t ch = 0; ch < channels; ch++) {
+                    ::memmove(&(_history[ch][HISTORY - (9 * subbands)]), &(_history[ch][_position]), (9 * subbands) * sizeof(float));
+                }
+                _position = (HISTORY - (9 * subbands));
+            }
+
+            _position -= subbands;
+
+            for (uint8_t ch = 0; ch < channels; ch++) {
+                float* X = &(_history[ch][_position]);
+
+                for (uint8_t n = 0; n < subbands; n++) {
+                    X[subbands - 1 - n] = Sample(input, (((blk * subbands) + n) * channels) + ch);
+                }
+
+                if (subbands == 4) {
+                    Filterbank<4>::Analyze(X, samples[blk][ch]);
+                } else {
+                    Filterbank<8>::Analyze(X, samples[blk][ch]);
+                }
+            }
+        }
+
+        uint8_t scales[MAX_CHANNELS][MAX_SUBBANDS];
+        uint8_t join = 0;
+
+        for (uint8_t ch = 0; ch < channels; ch++) {
+            for (uint8_t sb = 0; sb < subbands; sb++) {
+                float peak = 0;
+
+                for (uint8_t blk = 0; blk < blocks; blk++) {
+                    peak = std::max(peak, std::fabs(samples[blk][ch][sb]));
+                }
+
+                scales[ch][sb] = Scale(peak);
+            }
+        }
+
+        if (parameters.Mode() == Parameters::JOINT_STEREO) {
+            // Code the sum and the difference, if that takes less, the last subband never is.
+            for (uint8_t sb = 0; sb < (subbands - 1); sb++) {
+                float mid = 0;
+                float side = 0;
+
+                for (uint8_t blk = 0; blk < blocks; blk++) {
+                    mid = std::max(mid, std::fabs((samples[blk][0][sb] + samples[blk][1][sb]) * 0.5f));
+                    side = std::max(side, std::fabs((samples[blk][0][sb] - samples[blk][1][sb]) * 0.5f));
+                }
+
+                const uint8_t scaleMid = Scale(mid);
+                const uint8_t scaleSide = Scale(side);
+
+                if ((scaleMid + scaleSide) < (scales[0][sb] + scales[1][sb])) {
+                    join |= (1 << sb);
+                    scales[0][sb] = scaleMid;
+                    scales[1][sb] = scaleSide;
+
+                    for (uint8_t blk = 0; blk < blocks; blk++) {
+                        const float left = samples[blk][0][sb];
+                        const float right = samples[blk][1][sb];
+
+                        samples[blk][0][sb] = (left + right) * 0.5f;
+                        samples[blk][1][sb] = (left - right) * 0.5f;
+                    }
+                }
+            }
+        }
+
+        output[0] = SYNCWORD;
+        output[1] = parameters.Octet();
+        output[2] = parameters.Bitpool();
+
+        BitWriter writer(&(output[4]));
+
+        if (parameters.Mode() == Parameters::JOINT_STEREO) {
+            for (uint8_t sb = 0; sb < subbands; sb++) {
+                writer.Write((join >> sb) & 1, 1);
+            }
+        }
+        for (uint8_t ch = 0; ch < channels; ch++) {
+            for (uint8_t sb = 0; sb < subbands; sb++) {
+                writer.Write(scales[ch][sb], 4);
+            }
+        }
+
+        const uint16_t protectedBits = writer.Bits();
+
+        uint8_t bits[MAX_CHANNELS][MAX_SUBBANDS];
+        float factors[MAX_CHANNELS][MAX_SUBBANDS];
+
+        Allocate(parameters, scales, bits);
+
+        for (uint8_t ch = 0; ch < channels; ch++) {
+            for (uint8_t sb = 0; sb < subbands; sb++) {
+                // (sample / 2^(scale + 1) + 1) * levels / 2
+                factors[ch][sb] = (static_cast<float>((1 << bits[ch][sb]) - 1) * 0.5f) / static_cast<float>(2 << scales[ch][sb]);
+            }
+        }
+
+        for (uint8_t blk = 0; blk < blocks; blk++) {
+            for (uint8_t ch = 0; ch < channels; ch++) {
+                for (uint8_t sb = 0; sb < subbands; sb++) {
+                    const uint8_t count = bits[ch][sb];
+
+                    if (count != 0) {
+                        const int32_t levels = ((1 << count) - 1);
+                        const float half = (static_cast<float>(levels) * 0.5f);
+                        const int32_t value = static_cast<int32_t>((samples[blk][ch][sb] * factors[ch][sb]) + half);
+
+                        writer.Write(static_cast<uint16_t>(std::max(std::min(value, levels - 1), 0)), count);
+                    }
+                }
+            }
+        }
+
+        const uint16_t length = parameters.FrameLength();
+        const uint16_t written = (4 + writer.Flush());
+
+        ASSERT(written <= length);
+
+        if (written < length) {
+            ::memset(&(output[written]), 0, length - written);
+        }
+
+        output[3] = CRC(output, protectedBits);
+
+        return (length);
+    }
+
+    void Decoder::Reset(const Parameters& parameters)
+    {
+        ::memset(_history, 0, sizeof(_history));
+
+        _layout = parameters;
+        _position = (HISTORY - (20 * parameters.Subbands()));
+    }
+
+    int32_t Decoder::Decode(const uint8_t input[], const uint16_t length, uint8_t output[], const uint16_t available, uint16_t& written, Parameters& parameters)
+    {
+        int32_t result = -1;
+
+        written = 0;
+
+        if ((length >= 4) && (input[0] == SYNCWORD)) {
+            const Parameters frame((input[1] << 8) | input[2]);
+
+            if ((frame.IsValid() == true) && (length >= frame.FrameLength()) && (available >= frame.CodeSize())) {
+                const uint8_t subbands = frame.Subbands();
+                const uint8_t blocks = frame.Blocks();
+                const uint8_t channels = frame.Channels();
+
+                BitReader reader(&(input[4]));
+                uint8_t join = 0;
+                uint8_t scales[MAX_CHANNELS][MAX_SUBBANDS];
+
+                if (frame.Mode() == Parameters::JOINT_STEREO) {
+                    for (uint8_t sb = 0; sb < subbands; sb++) {
+                        join |= (reader.Read(1) << sb);
+                    }
+                }
+                for (uint8_t ch = 0; ch < channels; ch++) {
+                    for (uint8_t sb = 0; sb < subbands; sb++) {
+                        scales[ch][sb] = static_cast<uint8_t>(reader.Read(4));
+                    }
+                }
+
+                if (CRC(input, reader.Bits()) != input[3]) {
+                    TRACE_L1("SBC frame with a CRC error");
+                } else {
+                    uint8_t bits[MAX_CHANNELS][MAX_SUBBANDS];
+                    float factors[MAX_CHANNELS][MAX_SUBBANDS];
+
+                    Allocate(frame, scales, bits);
+
+                    for (uint8_t ch = 0; ch < channels; ch++) {
+                        for (uint8_t sb = 0; sb < subbands; sb++) {
+                            // 2^(scale + 1) * ((2 * value + 1) / levels - 1)
+                            factors[ch][sb] = (bits[ch][sb] != 0 ? static_cast<float>(2 << scales[ch][sb]) / static_cast<float>((1 << bits[ch][sb]) - 1) : 0.0f);
+                        }
+                    }
+
+                    if (frame.Octet() != _layout.Octet()) {
+                        Reset(frame);
+                    }
+
+                    for (uint8_t blk = 0; blk < blocks; blk++) {
+                        float samples[MAX_CHANNELS][MAX_SUBBANDS];
+
+                        for (uint8_t ch = 0; ch < channels; ch++) {
+                            for (uint8_t sb = 0; sb < subbands; sb++) {
+                                if (bits[ch][sb] != 0) {
+                                    const uint16_t value = reader.Read(bits[ch][sb]);
+                                    samples[ch][sb] = (factors[ch][sb] * ((2 * value) + 1)) - static_cast<float>(2 << scales[ch][sb]);
+                                } else {
+                                    samples[ch][sb] = 0;
+                                }
+                            }
+                        }
+
+                        for (uint8_t sb = 0; sb < subbands; sb++) {
+                            if ((join & (1 << sb)) != 0) {
+                                const float mid = samples[0][sb];
+                                const float side = samples[1][sb];
+
+                                samples[0][sb] = (mid + side);
+                                samples[1][sb] = (mid - side);
+                            }
+                        }
+
+                        if (_position < (2 * subbands)) {
+                            for (uint8_t ch = 0; ch < channels; ch++) {
+                                ::memmove(&(_history[ch][HISTORY - (18 * subbands)]), &(_history[ch][_position]), (18 * subbands) * sizeof(float));
+                            }
+                            _position = (HISTORY - (18 * subbands));
+                        }
+
+                        _position -= (2 * subbands);
+
+                        for (uint8_t ch = 0; ch < channels; ch++) {
+                            float pcm[MAX_SUBBANDS];
+
+                            if (subbands == 4) {
+                                Filterbank<4>::Synthesize(samples[ch], &(_history[ch][_position]), pcm);
+                            } else {
+                                Filterbank<8>::Synthesize(samples[ch], &(_history[ch][_position]), pcm);
+                            }
+
+                            for (uint8_t n = 0; n < subbands; n++) {
+                                Sample(output, (((blk * subbands) + n) * channels) + ch, pcm[n]);
+                            }
+                        }
+                    }
+
+                    written = frame.CodeSize();
+                    parameters = frame;
+                    result = frame.FrameLength();
+                }
+            }
+        }
+
+        return (result);
+    }
+
+} // namespace SBCCodec
+
+} // namespace A2DP
+
+} // namespace Bluetooth
+
+}
@@ -0,0 +1,235 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2021 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#pragma once
+
+#include "../../Module.h"
+
+// SBC as specified in the A2DP specification (appendix B). The filterbanks run in single
+// precision floating point, four lanes at a time (NEON or SSE, if the target has it).
+// Not installed, only the A2DP::SBC codec uses it.
+
+namespace Thunder {
+
+namespace Bluetooth {
+
+namespace A2DP {
+
+namespace SBCCodec {
+
+    static constexpr uint8_t SYNCWORD = 0x9C;
+    static constexpr uint8_t MAX_SUBBANDS = 8;
+    static constexpr uint8_t MAX_BLOCKS = 16;
+    static constexpr uint8_t MAX_CHANNELS = 2;
+
+    // The second octet (sampling frequency, blocks, channel mode, allocation and subbands)
+    // and the bitpool of the frame header, in 16 bits, so it can be swapped atomically.
+    class Parameters {
+    public:
+        enum channelmode : uint8_t {
+            MONO = 0,
+            DUAL_CHANNEL = 1,
+            STEREO = 2,
+            JOINT_STEREO = 3
+        };
+
+        enum allocation : uint8_t {
+            LOUDNESS = 0,
+            SNR = 1
+        };
+
+    public:
+        Parameters()
+            : _packed(0)
+        {
+        }
+        Parameters(const uint16_t packed)
+            : _packed(packed)
+        {
+        }
+        // frequency: 16000, 32000, 44100 or 48000, blocks: 4, 8, 12 or 16, subbands: 4 or 8
+        Parameters(const uint32_t frequency, const uint8_t blocks, const channelmode mode, const allocation method, const uint8_t subbands, const uint8_t bitpool)
+            : _packed(0)
+        {
+            const uint8_t rate = (frequency == 16000 ? 0 : frequency == 32000 ? 1 : frequency == 44100 ? 2 : 3);
+            const uint8_t octet = ((rate << 6) | ((((blocks / 4) - 1) & 0x3) << 4) | (mode << 2) | (method << 1) | (subbands == 8 ? 1 : 0));
+
+            _packed = ((octet << 8) | bitpool);
+        }
+        ~Parameters() = default;
+        Parameters(const Parameters&) = default;
+        Parameters& operator=(const Parameters&) = default;
+
+        inline bool operator==(const Parameters& rhs) const
+        {
+            return (_packed == rhs._packed);
+        }
+        inline bool operator!=(const Parameters& rhs) const
+        {
+            return (!operator==(rhs));
+        }
+
+    public:
+        inline bool IsValid() const
+        {
+            return (Bitpool() >= 2);
+        }
+        inline uint16_t Packed() const
+        {
+            return (_packed);
+        }
+        // The octet following the syncword in the frame header.
+        inline uint8_t Octet() const
+        {
+            return (_packed >> 8);
+        }
+        inline uint8_t Frequency() const
+        {
+            return ((_packed >> 14) & 0x3);
+        }
+        inline uint32_t SampleRate() const
+        {
+            static const uint32_t rates[] = { 16000, 32000, 44100, 48000 };
+            return (rates[Frequency()]);
+        }
+        inline uint8_t Blocks() const
+        {
+            return ((((_packed >> 12) & 0x3) + 1) * 4);
+        }
+        inline channelmode Mode() const
+        {
+            return (static_cast<channelmode>((_packed >> 10) & 0x3));
+        }
+        inline allocation Method() const
+        {
+            return (static_cast<allocation>((_packed >> 9) & 0x1));
+        }
+        inline uint8_t Subbands() const
+        {
+            return (((_packed >> 8) & 0x1) != 0 ? 8 : 4);
+        }
+        inline uint8_t Bitpool() const
+        {
+            return (_packed & 0xFF);
+        }
+        inline uint8_t Channels() const
+        {
+            return (Mode() == MONO ? 1 : 2);
+        }
+        // Bytes of 16 bit PCM going into a frame.
+        inline uint16_t CodeSize() const
+        {
+            return (Blocks() * Subbands() * Channels() * sizeof(int16_t));
+        }
+        // Bytes of an encoded frame.
+        uint16_t FrameLength() const
+        {
+            uint32_t bits;
+
+            if ((Mode() == MONO) || (Mode() == DUAL_CHANNEL)) {
+                bits = (Blocks() * Channels() * Bitpool());
+            } else {
+                bits = (((Mode() == JOINT_STEREO) ? Subbands() : 0) + (Blocks() * Bitpool()));
+            }
+
+            return (4 + ((4 * Subbands() * Channels()) / 8) + ((bits + 7) / 8));
+        }
+        // Microseconds of audio in a frame.
+        inline uint32_t Duration() const
+        {
+            return ((Blocks() * Subbands() * 1000000UL) / SampleRate());
+        }
+        inline uint32_t BitRate() const
+        {
+            return ((8UL * FrameLength() * SampleRate()) / (Subbands() * Blocks()));
+        }
+
+    private:
+        uint16_t _packed;
+    };
+
+    class Encoder {
+    private:
+        static constexpr uint16_t HISTORY = (10 * MAX_SUBBANDS) + (32 * MAX_SUBBANDS);
+
+    public:
+        Encoder(const Encoder&) = delete;
+        Encoder& operator=(const Encoder&) = delete;
+
+        Encoder()
+            : _layout()
+            , _position(0)
+        {
+            Reset(Parameters());
+        }
+        ~Encoder() = default;
+
+    public:
+        // Encodes one frame, the input holds parameters.CodeSize() bytes of interleaved 16 bit
+        // (little endian) PCM, the output room for parameters.FrameLength() bytes. A change of
+        // the bitpool only is seamless, any other change starts from silence.
+        uint16_t Encode(const Parameters& parameters, const uint8_t input[], uint8_t output[]);
+
+    private:
+        void Reset(const Parameters& parameters);
+
+    private:
+        Parameters _layout;
+        uint16_t _position;
+        float _history[MAX_CHANNELS][HISTORY];
+    };
+
+    class Decoder {
+    private:
+        static constexpr uint16_t HISTORY = (20 * MAX_SUBBANDS) + (32 * MAX_SUBBANDS);
+
+    public:
+        Decoder(const Decoder&) = delete;
+        Decoder& operator=(const Decoder&) = delete;
+
+        Decoder()
+            : _layout()
+            , _position(0)
+        {
+            Reset(Parameters());
+        }
+        ~Decoder() = default;
+
+    public:
+        // Decodes one frame, as described by its own header. Returns the bytes consumed and
+        // the parameters the frame was encoded with, or -1 if it is not a valid frame or it
+        // does not fit in the input or the output.
+        int32_t Decode(const uint8_t input[], const uint16_t length, uint8_t output[], const uint16_t available, uint16_t& written, Parameters& parameters);
+
+    private:
+        void Reset(const Parameters& parameters);
+
+    private:
+        Parameters _layout;
+        uint16_t _position;
+        float _history[MAX_CHANNELS][HISTORY];
+    };
+
+} // namespace SBCCodec
+
+} // namespace A2DP
+
+} // namespace Bluetooth
+
+}
@@ -0,0 +1,697 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "DVBText.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace Thunder {
+namespace Broadcast {
+    namespace DVB {
+
+        namespace {
+
+            enum class Encoding : uint8_t {
+                ISO6937,
+                ISO8859,
+                UTF16,
+                UTF8,
+                UNSUPPORTED
+            };
+
+            // Figure A.1 of EN 300 468: ISO/IEC 6937 with the Euro sign at 0xA4, 0xA0-0xFF.
+            // 0xC1-0xCF are the non spacing diacritics, they precede the letter they go with.
+            constexpr uint16_t ISO6937[96] = {
+                0x00A0, 0x00A1, 0x00A2, 0x00A3, 0x20AC, 0x00A5, 0x0000, 0x00A7,
+                0x00A4, 0x2018, 0x201C, 0x00AB, 0x2190, 0x2191, 0x2192, 0x2193,
+                0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00D7, 0x00B5, 0x00B6, 0x00B7,
+                0x00F7, 0x2019, 0x201D, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00BF,
+                0x0000, 0x0300, 0x0301, 0x0302, 0x0303, 0x0304, 0x0306, 0x0307,
+                0x0308, 0x0308, 0x030A, 0x0327, 0x0332, 0x030B, 0x0328, 0x030C,
+                0x2015, 0x00B9, 0x00AE, 0x00A9, 0x2122, 0x266A, 0x00AC, 0x00A6,
+                0x0000, 0x0000, 0x0000, 0x0000, 0x215B, 0x215C, 0x215D, 0x215E,
+                0x2126, 0x00C6, 0x0110, 0x00AA, 0x0126, 0x0000, 0x0132, 0x013F,
+                0x0141, 0x00D8, 0x0152, 0x00BA, 0x00DE, 0x0166, 0x014A, 0x0149,
+                0x0138, 0x00E6, 0x0111, 0x00F0, 0x0127, 0x0131, 0x0133, 0x0140,
+                0x0142, 0x00F8, 0x0153, 0x00DF, 0x00FE, 0x0167, 0x014B, 0x00AD,
+            };
+
+            // ISO/IEC 8859-1 up to 8859-16 (there is no part 12), 0xA0-0xFF. 0: not defined.
+            constexpr uint16_t ISO8859[16][96] = {
+                // 8859-1
+                {
+                    0x00A0, 0x00A1, 0x00A2, 0x00A3, 0x00A4, 0x00A5, 0x00A6, 0x00A7,
+                    0x00A8, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x00AF,
+                    0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x00B6, 0x00B7,
+                    0x00B8, 0x00B9, 0x00BA, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00BF,
+                    0x00C0, 0x00C1, 0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x00C7,
+                    0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+                    0x00D0, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D7,
+                    0x00D8, 0x00D9, 0x00DA, 0x00DB, 0x00DC, 0x00DD, 0x00DE, 0x00DF,
+                    0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7,
+                    0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF,
+                    0x00F0, 0x00F1, 0x00F2, 0x00F3, 0x00F4, 0x00F5, 0x00F6, 0x00F7,
+                    0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x00FF,
+                },
+                // 8859-2
+                {
+                    0x00A0, 0x0104, 0x02D8, 0x0141, 0x00A4, 0x013D, 0x015A, 0x00A7,
+                    0x00A8, 0x0160, 0x015E, 0x0164, 0x0179, 0x00AD, 0x017D, 0x017B,
+                    0x00B0, 0x0105, 0x02DB, 0x0142, 0x00B4, 0x013E, 0x015B, 0x02C7,
+                    0x00B8, 0x0161, 0x015F, 0x0165, 0x017A, 0x02DD, 0x017E, 0x017C,
+                    0x0154, 0x00C1, 0x00C2, 0x0102, 0x00C4, 0x0139, 0x0106, 0x00C7,
+                    0x010C, 0x00C9, 0x0118, 0x00CB, 0x011A, 0x00CD, 0x00CE, 0x010E,
+                    0x0110, 0x0143, 0x0147, 0x00D3, 0x00D4, 0x0150, 0x00D6, 0x00D7,
+                    0x0158, 0x016E, 0x00DA, 0x0170, 0x00DC, 0x00DD, 0x0162, 0x00DF,
+                    0x0155, 0x00E1, 0x00E2, 0x0103, 0x00E4, 0x013A, 0x0107, 0x00E7,
+                    0x010D, 0x00E9, 0x0119, 0x00EB, 0x011B, 0x00ED, 0x00EE, 0x010F,
+                    0x0111, 0x0144, 0x0148, 0x00F3, 0x00F4, 0x0151, 0x00F6, 0x00F7,
+                    0x0159, 0x016F, 0x00FA, 0x0171, 0x00FC, 0x00FD, 0x0163, 0x02D9,
+                },
+                // 8859-3
+                {
+                    0x00A0, 0x0126, 0x02D8, 0x00A3, 0x00A4, 0x0000, 0x0124, 0x00A7,
+                    0x00A8, 0x0130, 0x015E, 0x011E, 0x0134, 0x00AD, 0x0000, 0x017B,
+                    0x00B0, 0x0127, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x0125, 0x00B7,
+                    0x00B8, 0x0131, 0x015F, 0x011F, 0x0135, 0x00BD, 0x0000, 0x017C,
+                    0x00C0, 0x00C1, 0x00C2, 0x0000, 0x00C4, 0x010A, 0x0108, 0x00C7,
+                    0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+                    0x0000, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x0120, 0x00D6, 0x00D7,
+                    0x011C, 0x00D9, 0x00DA, 0x00DB, 0x00DC, 0x016C, 0x015C, 0x00DF,
+                    0x00E0, 0x00E1, 0x00E2, 0x0000, 0x00E4, 0x010B, 0x0109, 0x00E7,
+                    0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF,
+                    0x0000, 0x00F1, 0x00F2, 0x00F3, 0x00F4, 0x0121, 0x00F6, 0x00F7,
+                    0x011D, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x016D, 0x015D, 0x02D9,
+                },
+                // 8859-4
+                {
+                    0x00A0, 0x0104, 0x0138, 0x0156, 0x00A4, 0x0128, 0x013B, 0x00A7,
+                    0x00A8, 0x0160, 0x0112, 0x0122, 0x0166, 0x00AD, 0x017D, 0x00AF,
+                    0x00B0, 0x0105, 0x02DB, 0x0157, 0x00B4, 0x0129, 0x013C, 0x02C7,
+                    0x00B8, 0x0161, 0x0113, 0x0123, 0x0167, 0x014A, 0x017E, 0x014B,
+                    0x0100, 0x00C1, 0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x012E,
+                    0x010C, 0x00C9, 0x0118, 0x00CB, 0x0116, 0x00CD, 0x00CE, 0x012A,
+                    0x0110, 0x0145, 0x014C, 0x0136, 0x00D4, 0x00D5, 0x00D6, 0x00D7,
+                    0x00D8, 0x0172, 0x00DA, 0x00DB, 0x00DC, 0x0168, 0x016A, 0x00DF,
+                    0x0101, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x012F,
+                    0x010D, 0x00E9, 0x0119, 0x00EB, 0x0117, 0x00ED, 0x00EE, 0x012B,
+                    0x0111, 0x0146, 0x014D, 0x0137, 0x00F4, 0x00F5, 0x00F6, 0x00F7,
+                    0x00F8, 0x0173, 0x00FA, 0x00FB, 0x00FC, 0x0169, 0x016B, 0x02D9,
+                },
+                // 8859-5
+                {
+                    0x00A0, 0x0401, 0x0402, 0x0403, 0x0404, 0x0405, 0x0406, 0x0407,
+                    0x0408, 0x0409, 0x040A, 0x040B, 0x040C, 0x00AD, 0x040E, 0x040F,
+                    0x0410, 0x0411, 0x0412, 0x0413, 0x0414, 0x0415, 0x0416, 0x0417,
+                    0x0418, 0x0419, 0x041A, 0x041B, 0x041C, 0x041D, 0x041E, 0x041F,
+                    0x0420, 0x0421, 0x0422, 0x0423, 0x0424, 0x0425, 0x0426, 0x0427,
+                    0x0428, 0x0429, 0x042A, 0x042B, 0x042C, 0x042D, 0x042E, 0x042F,
+                    0x0430, 0x0431, 0x0432, 0x0433, 0x0434, 0x0435, 0x0436, 0x0437,
+                    0x0438, 0x0439, 0x043A, 0x043B, 0x043C, 0x043D, 0x043E, 0x043F,
+                    0x0440, 0x0441, 0x0442, 0x0443, 0x0444, 0x0445, 0x0446, 0x0447,
+                    0x0448, 0x0449, 0x044A, 0x044B, 0x044C, 0x044D, 0x044E, 0x044F,
+                    0x2116, 0x0451, 0x0452, 0x0453, 0x0454, 0x0455, 0x0456, 0x0457,
+                    0x0458, 0x0459, 0x045A, 0x045B, 0x045C, 0x00A7, 0x045E, 0x045F,
+                },
+                // 8859-6
+                {
+                    0x00A0, 0x0000, 0x0000, 0x0000, 0x00A4, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x0000, 0x0000, 0x0000, 0x060C, 0x00AD, 0x0000, 0x0000,
+                    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x0000, 0x0000, 0x061B, 0x0000, 0x0000, 0x0000, 0x061F,
+                    0x0000, 0x0621, 0x0622, 0x0623, 0x0624, 0x0625, 0x0626, 0x0627,
+                    0x0628, 0x0629, 0x062A, 0x062B, 0x062C, 0x062D, 0x062E, 0x062F,
+                    0x0630, 0x0631, 0x0632, 0x0633, 0x0634, 0x0635, 0x0636, 0x0637,
+                    0x0638, 0x0639, 0x063A, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0640, 0x0641, 0x0642, 0x0643, 0x0644, 0x0645, 0x0646, 0x0647,
+                    0x0648, 0x0649, 0x064A, 0x064B, 0x064C, 0x064D, 0x064E, 0x064F,
+                    0x0650, 0x0651, 0x0652, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                },
+                // 8859-7
+                {
+                    0x00A0, 0x2018, 0x2019, 0x00A3, 0x20AC, 0x20AF, 0x00A6, 0x00A7,
+                    0x00A8, 0x00A9, 0x037A, 0x00AB, 0x00AC, 0x00AD, 0x0000, 0x2015,
+                    0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x0384, 0x0385, 0x0386, 0x00B7,
+                    0x0388, 0x0389, 0x038A, 0x00BB, 0x038C, 0x00BD, 0x038E, 0x038F,
+                    0x0390, 0x0391, 0x0392, 0x0393, 0x0394, 0x0395, 0x0396, 0x0397,
+                    0x0398, 0x0399, 0x039A, 0x039B, 0x039C, 0x039D, 0x039E, 0x039F,
+                    0x03A0, 0x03A1, 0x0000, 0x03A3, 0x03A4, 0x03A5, 0x03A6, 0x03A7,
+                    0x03A8, 0x03A9, 0x03AA, 0x03AB, 0x03AC, 0x03AD, 0x03AE, 0x03AF,
+                    0x03B0, 0x03B1, 0x03B2, 0x03B3, 0x03B4, 0x03B5, 0x03B6, 0x03B7,
+                    0x03B8, 0x03B9, 0x03BA, 0x03BB, 0x03BC, 0x03BD, 0x03BE, 0x03BF,
+                    0x03C0, 0x03C1, 0x03C2, 0x03C3, 0x03C4, 0x03C5, 0x03C6, 0x03C7,
+                    0x03C8, 0x03C9, 0x03CA, 0x03CB, 0x03CC, 0x03CD, 0x03CE, 0x0000,
+                },
+                // 8859-8
+                {
+                    0x00A0, 0x0000, 0x00A2, 0x00A3, 0x00A4, 0x00A5, 0x00A6, 0x00A7,
+                    0x00A8, 0x00A9, 0x00D7, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x00AF,
+                    0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x00B6, 0x00B7,
+                    0x00B8, 0x00B9, 0x00F7, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x0000,
+                    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x2017,
+                    0x05D0, 0x05D1, 0x05D2, 0x05D3, 0x05D4, 0x05D5, 0x05D6, 0x05D7,
+                    0x05D8, 0x05D9, 0x05DA, 0x05DB, 0x05DC, 0x05DD, 0x05DE, 0x05DF,
+                    0x05E0, 0x05E1, 0x05E2, 0x05E3, 0x05E4, 0x05E5, 0x05E6, 0x05E7,
+                    0x05E8, 0x05E9, 0x05EA, 0x0000, 0x0000, 0x200E, 0x200F, 0x0000,
+                },
+                // 8859-9
+                {
+                    0x00A0, 0x00A1, 0x00A2, 0x00A3, 0x00A4, 0x00A5, 0x00A6, 0x00A7,
+                    0x00A8, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x00AF,
+                    0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x00B4, 0x00B5, 0x00B6, 0x00B7,
+                    0x00B8, 0x00B9, 0x00BA, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00BF,
+                    0x00C0, 0x00C1, 0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x00C7,
+                    0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+                    0x011E, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D7,
+                    0x00D8, 0x00D9, 0x00DA, 0x00DB, 0x00DC, 0x0130, 0x015E, 0x00DF,
+                    0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7,
+                    0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF,
+                    0x011F, 0x00F1, 0x00F2, 0x00F3, 0x00F4, 0x00F5, 0x00F6, 0x00F7,
+                    0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x0131, 0x015F, 0x00FF,
+                },
+                // 8859-10
+                {
+                    0x00A0, 0x0104, 0x0112, 0x0122, 0x012A, 0x0128, 0x0136, 0x00A7,
+                    0x013B, 0x0110, 0x0160, 0x0166, 0x017D, 0x00AD, 0x016A, 0x014A,
+                    0x00B0, 0x0105, 0x0113, 0x0123, 0x012B, 0x0129, 0x0137, 0x00B7,
+                    0x013C, 0x0111, 0x0161, 0x0167, 0x017E, 0x2015, 0x016B, 0x014B,
+                    0x0100, 0x00C1, 0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x012E,
+                    0x010C, 0x00C9, 0x0118, 0x00CB, 0x0116, 0x00CD, 0x00CE, 0x00CF,
+                    0x00D0, 0x0145, 0x014C, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x0168,
+                    0x00D8, 0x0172, 0x00DA, 0x00DB, 0x00DC, 0x00DD, 0x00DE, 0x00DF,
+                    0x0101, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x012F,
+                    0x010D, 0x00E9, 0x0119, 0x00EB, 0x0117, 0x00ED, 0x00EE, 0x00EF,
+                    0x00F0, 0x0146, 0x014D, 0x00F3, 0x00F4, 0x00F5, 0x00F6, 0x0169,
+                    0x00F8, 0x0173, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x0138,
+                },
+                // 8859-11
+                {
+                    0x00A0, 0x0E01, 0x0E02, 0x0E03, 0x0E04, 0x0E05, 0x0E06, 0x0E07,
+                    0x0E08, 0x0E09, 0x0E0A, 0x0E0B, 0x0E0C, 0x0E0D, 0x0E0E, 0x0E0F,
+                    0x0E10, 0x0E11, 0x0E12, 0x0E13, 0x0E14, 0x0E15, 0x0E16, 0x0E17,
+                    0x0E18, 0x0E19, 0x0E1A, 0x0E1B, 0x0E1C, 0x0E1D, 0x0E1E, 0x0E1F,
+                    0x0E20, 0x0E21, 0x0E22, 0x0E23, 0x0E24, 0x0E25, 0x0E26, 0x0E27,
+                    0x0E28, 0x0E29, 0x0E2A, 0x0E2B, 0x0E2C, 0x0E2D, 0x0E2E, 0x0E2F,
+                    0x0E30, 0x0E31, 0x0E32, 0x0E33, 0x0E34, 0x0E35, 0x0E36, 0x0E37,
+                    0x0E38, 0x0E39, 0x0E3A, 0x0000, 0x0000, 0x0000, 0x0000, 0x0E3F,
+                    0x0E40, 0x0E41, 0x0E42, 0x0E43, 0x0E44, 0x0E45, 0x0E46, 0x0E47,
+                    0x0E48, 0x0E49, 0x0E4A, 0x0E4B, 0x0E4C, 0x0E4D, 0x0E4E, 0x0E4F,
+                    0x0E50, 0x0E51, 0x0E52, 0x0E53, 0x0E54, 0x0E55, 0x0E56, 0x0E57,
+                    0x0E58, 0x0E59, 0x0E5A, 0x0E5B, 0x0000, 0x0000, 0x0000, 0x0000,
+                },
+                // 8859-12 was never published
+                { 0 },
+                // 8859-13
+                {
+                    0x00A0, 0x201D, 0x00A2, 0x00A3, 0x00A4, 0x201E, 0x00A6, 0x00A7,
+                    0x00D8, 0x00A9, 0x0156, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x00C6,
+                    0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x201C, 0x00B5, 0x00B6, 0x00B7,
+                    0x00F8, 0x00B9, 0x0157, 0x00BB, 0x00BC, 0x00BD, 0x00BE, 0x00E6,
+                    0x0104, 0x012E, 0x0100, 0x0106, 0x00C4, 0x00C5, 0x0118, 0x0112,
+                    0x010C, 0x00C9, 0x0179, 0x0116, 0x0122, 0x0136, 0x012A, 0x013B,
+                    0x0160, 0x0143, 0x0145, 0x00D3, 0x014C, 0x00D5, 0x00D6, 0x00D7,
+                    0x0172, 0x0141, 0x015A, 0x016A, 0x00DC, 0x017B, 0x017D, 0x00DF,
+                    0x0105, 0x012F, 0x0101, 0x0107, 0x00E4, 0x00E5, 0x0119, 0x0113,
+                    0x010D, 0x00E9, 0x017A, 0x0117, 0x0123, 0x0137, 0x012B, 0x013C,
+                    0x0161, 0x0144, 0x0146, 0x00F3, 0x014D, 0x00F5, 0x00F6, 0x00F7,
+                    0x0173, 0x0142, 0x015B, 0x016B, 0x00FC, 0x017C, 0x017E, 0x2019,
+                },
+                // 8859-14
+                {
+                    0x00A0, 0x1E02, 0x1E03, 0x00A3, 0x010A, 0x010B, 0x1E0A, 0x00A7,
+                    0x1E80, 0x00A9, 0x1E82, 0x1E0B, 0x1EF2, 0x00AD, 0x00AE, 0x0178,
+                    0x1E1E, 0x1E1F, 0x0120, 0x0121, 0x1E40, 0x1E41, 0x00B6, 0x1E56,
+                    0x1E81, 0x1E57, 0x1E83, 0x1E60, 0x1EF3, 0x1E84, 0x1E85, 0x1E61,
+                    0x00C0, 0x00C1, 0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x00C7,
+                    0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+                    0x0174, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x1E6A,
+                    0x00D8, 0x00D9, 0x00DA, 0x00DB, 0x00DC, 0x00DD, 0x0176, 0x00DF,
+                    0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7,
+                    0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF,
+                    0x0175, 0x00F1, 0x00F2, 0x00F3, 0x00F4, 0x00F5, 0x00F6, 0x1E6B,
+                    0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x0177, 0x00FF,
+                },
+                // 8859-15
+                {
+                    0x00A0, 0x00A1, 0x00A2, 0x00A3, 0x20AC, 0x00A5, 0x0160, 0x00A7,
+                    0x0161, 0x00A9, 0x00AA, 0x00AB, 0x00AC, 0x00AD, 0x00AE, 0x00AF,
+                    0x00B0, 0x00B1, 0x00B2, 0x00B3, 0x017D, 0x00B5, 0x00B6, 0x00B7,
+                    0x017E, 0x00B9, 0x00BA, 0x00BB, 0x0152, 0x0153, 0x0178, 0x00BF,
+                    0x00C0, 0x00C1, 0x00C2, 0x00C3, 0x00C4, 0x00C5, 0x00C6, 0x00C7,
+                    0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+                    0x00D0, 0x00D1, 0x00D2, 0x00D3, 0x00D4, 0x00D5, 0x00D6, 0x00D7,
+                    0x00D8, 0x00D9, 0x00DA, 0x00DB, 0x00DC, 0x00DD, 0x00DE, 0x00DF,
+                    0x00E0, 0x00E1, 0x00E2, 0x00E3, 0x00E4, 0x00E5, 0x00E6, 0x00E7,
+                    0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF,
+                    0x00F0, 0x00F1, 0x00F2, 0x00F3, 0x00F4, 0x00F5, 0x00F6, 0x00F7,
+                    0x00F8, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x00FF,
+                },
+                // 8859-16
+                {
+                    0x00A0, 0x0104, 0x0105, 0x0141, 0x20AC, 0x201E, 0x0160, 0x00A7,
+                    0x0161, 0x00A9, 0x0218, 0x00AB, 0x0179, 0x00AD, 0x017A, 0x017B,
+                    0x00B0, 0x00B1, 0x010C, 0x0142, 0x017D, 0x201D, 0x00B6, 0x00B7,
+                    0x017E, 0x010D, 0x0219, 0x00BB, 0x0152, 0x0153, 0x0178, 0x017C,
+                    0x00C0, 0x00C1, 0x00C2, 0x0102, 0x00C4, 0x0106, 0x00C6, 0x00C7,
+                    0x00C8, 0x00C9, 0x00CA, 0x00CB, 0x00CC, 0x00CD, 0x00CE, 0x00CF,
+                    0x0110, 0x0143, 0x00D2, 0x00D3, 0x00D4, 0x0150, 0x00D6, 0x015A,
+                    0x0170, 0x00D9, 0x00DA, 0x00DB, 0x00DC, 0x0118, 0x021A, 0x00DF,
+                    0x00E0, 0x00E1, 0x00E2, 0x0103, 0x00E4, 0x0107, 0x00E6, 0x00E7,
+                    0x00E8, 0x00E9, 0x00EA, 0x00EB, 0x00EC, 0x00ED, 0x00EE, 0x00EF,
+                    0x0111, 0x0144, 0x00F2, 0x00F3, 0x00F4, 0x0151, 0x00F6, 0x015B,
+                    0x0171, 0x00F9, 0x00FA, 0x00FB, 0x00FC, 0x0119, 0x021B, 0x00FF,
+                },
+            };
+
+            // Precomposed forms of the ISO 6937 diacritics (0xC1-0xCF) on A-Z and a-z. 0: none.
+            constexpr uint16_t Composed[15][52] = {
+                // 0xC1, U+0300
+                {
+                    0x00C0, 0x0000, 0x0000, 0x0000, 0x00C8, 0x0000, 0x0000, 0x0000, 0x00CC, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x01F8, 0x00D2, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x00D9, 0x0000, 0x1E80, 0x0000, 0x1EF2, 0x0000,
+                    0x00E0, 0x0000, 0x0000, 0x0000, 0x00E8, 0x0000, 0x0000, 0x0000, 0x00EC, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x01F9, 0x00F2, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x00F9, 0x0000, 0x1E81, 0x0000, 0x1EF3, 0x0000,
+                },
+                // 0xC2, U+0301
+                {
+                    0x00C1, 0x0000, 0x0106, 0x0000, 0x00C9, 0x0000, 0x01F4, 0x0000, 0x00CD, 0x0000, 0x1E30, 0x0139, 0x1E3E,
+                    0x0143, 0x00D3, 0x1E54, 0x0000, 0x0154, 0x015A, 0x0000, 0x00DA, 0x0000, 0x1E82, 0x0000, 0x00DD, 0x0179,
+                    0x00E1, 0x0000, 0x0107, 0x0000, 0x00E9, 0x0000, 0x01F5, 0x0000, 0x00ED, 0x0000, 0x1E31, 0x013A, 0x1E3F,
+                    0x0144, 0x00F3, 0x1E55, 0x0000, 0x0155, 0x015B, 0x0000, 0x00FA, 0x0000, 0x1E83, 0x0000, 0x00FD, 0x017A,
+                },
+                // 0xC3, U+0302
+                {
+                    0x00C2, 0x0000, 0x0108, 0x0000, 0x00CA, 0x0000, 0x011C, 0x0124, 0x00CE, 0x0134, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x00D4, 0x0000, 0x0000, 0x0000, 0x015C, 0x0000, 0x00DB, 0x0000, 0x0174, 0x0000, 0x0176, 0x1E90,
+                    0x00E2, 0x0000, 0x0109, 0x0000, 0x00EA, 0x0000, 0x011D, 0x0125, 0x00EE, 0x0135, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x00F4, 0x0000, 0x0000, 0x0000, 0x015D, 0x0000, 0x00FB, 0x0000, 0x0175, 0x0000, 0x0177, 0x1E91,
+                },
+                // 0xC4, U+0303
+                {
+                    0x00C3, 0x0000, 0x0000, 0x0000, 0x1EBC, 0x0000, 0x0000, 0x0000, 0x0128, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x00D1, 0x00D5, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0168, 0x1E7C, 0x0000, 0x0000, 0x1EF8, 0x0000,
+                    0x00E3, 0x0000, 0x0000, 0x0000, 0x1EBD, 0x0000, 0x0000, 0x0000, 0x0129, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x00F1, 0x00F5, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0169, 0x1E7D, 0x0000, 0x0000, 0x1EF9, 0x0000,
+                },
+                // 0xC5, U+0304
+                {
+                    0x0100, 0x0000, 0x0000, 0x0000, 0x0112, 0x0000, 0x1E20, 0x0000, 0x012A, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x014C, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x016A, 0x0000, 0x0000, 0x0000, 0x0232, 0x0000,
+                    0x0101, 0x0000, 0x0000, 0x0000, 0x0113, 0x0000, 0x1E21, 0x0000, 0x012B, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x014D, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x016B, 0x0000, 0x0000, 0x0000, 0x0233, 0x0000,
+                },
+                // 0xC6, U+0306
+                {
+                    0x0102, 0x0000, 0x0000, 0x0000, 0x0114, 0x0000, 0x011E, 0x0000, 0x012C, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x014E, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x016C, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0103, 0x0000, 0x0000, 0x0000, 0x0115, 0x0000, 0x011F, 0x0000, 0x012D, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x014F, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x016D, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                },
+                // 0xC7, U+0307
+                {
+                    0x0226, 0x1E02, 0x010A, 0x1E0A, 0x0116, 0x1E1E, 0x0120, 0x1E22, 0x0130, 0x0000, 0x0000, 0x0000, 0x1E40,
+                    0x1E44, 0x022E, 0x1E56, 0x0000, 0x1E58, 0x1E60, 0x1E6A, 0x0000, 0x0000, 0x1E86, 0x1E8A, 0x1E8E, 0x017B,
+                    0x0227, 0x1E03, 0x010B, 0x1E0B, 0x0117, 0x1E1F, 0x0121, 0x1E23, 0x0000, 0x0000, 0x0000, 0x0000, 0x1E41,
+                    0x1E45, 0x022F, 0x1E57, 0x0000, 0x1E59, 0x1E61, 0x1E6B, 0x0000, 0x0000, 0x1E87, 0x1E8B, 0x1E8F, 0x017C,
+                },
+                // 0xC8, U+0308
+                {
+                    0x00C4, 0x0000, 0x0000, 0x0000, 0x00CB, 0x0000, 0x0000, 0x1E26, 0x00CF, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x00D6, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x00DC, 0x0000, 0x1E84, 0x1E8C, 0x0178, 0x0000,
+                    0x00E4, 0x0000, 0x0000, 0x0000, 0x00EB, 0x0000, 0x0000, 0x1E27, 0x00EF, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x00F6, 0x0000, 0x0000, 0x0000, 0x0000, 0x1E97, 0x00FC, 0x0000, 0x1E85, 0x1E8D, 0x00FF, 0x0000,
+                },
+                // 0xC9, U+0308
+                {
+                    0x00C4, 0x0000, 0x0000, 0x0000, 0x00CB, 0x0000, 0x0000, 0x1E26, 0x00CF, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x00D6, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x00DC, 0x0000, 0x1E84, 0x1E8C, 0x0178, 0x0000,
+                    0x00E4, 0x0000, 0x0000, 0x0000, 0x00EB, 0x0000, 0x0000, 0x1E27, 0x00EF, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x00F6, 0x0000, 0x0000, 0x0000, 0x0000, 0x1E97, 0x00FC, 0x0000, 0x1E85, 0x1E8D, 0x00FF, 0x0000,
+                },
+                // 0xCA, U+030A
+                {
+                    0x00C5, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x016E, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x00E5, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x016F, 0x0000, 0x1E98, 0x0000, 0x1E99, 0x0000,
+                },
+                // 0xCB, U+0327
+                {
+                    0x0000, 0x0000, 0x00C7, 0x1E10, 0x0228, 0x0000, 0x0122, 0x1E28, 0x0000, 0x0000, 0x0136, 0x013B, 0x0000,
+                    0x0145, 0x0000, 0x0000, 0x0000, 0x0156, 0x015E, 0x0162, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x0000, 0x00E7, 0x1E11, 0x0229, 0x0000, 0x0123, 0x1E29, 0x0000, 0x0000, 0x0137, 0x013C, 0x0000,
+                    0x0146, 0x0000, 0x0000, 0x0000, 0x0157, 0x015F, 0x0163, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                },
+                // 0xCC, U+0332
+                {
+                    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                },
+                // 0xCD, U+030B
+                {
+                    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x0150, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0170, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x0151, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0171, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                },
+                // 0xCE, U+0328
+                {
+                    0x0104, 0x0000, 0x0000, 0x0000, 0x0118, 0x0000, 0x0000, 0x0000, 0x012E, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x01EA, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0172, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0105, 0x0000, 0x0000, 0x0000, 0x0119, 0x0000, 0x0000, 0x0000, 0x012F, 0x0000, 0x0000, 0x0000, 0x0000,
+                    0x0000, 0x01EB, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000, 0x0173, 0x0000, 0x0000, 0x0000, 0x0000, 0x0000,
+                },
+                // 0xCF, U+030C
+                {
+                    0x01CD, 0x0000, 0x010C, 0x010E, 0x011A, 0x0000, 0x01E6, 0x021E, 0x01CF, 0x0000, 0x01E8, 0x013D, 0x0000,
+                    0x0147, 0x01D1, 0x0000, 0x0000, 0x0158, 0x0160, 0x0164, 0x01D3, 0x0000, 0x0000, 0x0000, 0x0000, 0x017D,
+                    0x01CE, 0x0000, 0x010D, 0x010F, 0x011B, 0x0000, 0x01E7, 0x021F, 0x01D0, 0x01F0, 0x01E9, 0x013E, 0x0000,
+                    0x0148, 0x01D2, 0x0000, 0x0000, 0x0159, 0x0161, 0x0165, 0x01D4, 0x0000, 0x0000, 0x0000, 0x0000, 0x017E,
+                },
+            };
+
+            inline uint32_t Encode(const uint32_t character, char buffer[], const uint32_t size)
+            {
+                uint32_t result = 0;
+
+                if (character < 0x80) {
+                    if (size >= 1) {
+                        buffer[0] = static_cast<char>(character);
+                        result = 1;
+                    }
+                } else if (character < 0x800) {
+                    if (size >= 2) {
+                        buffer[0] = static_cast<char>(0xC0 | (character >> 6));
+                        buffer[1] = static_cast<char>(0x80 | (character & 0x3F));
+                        result = 2;
+                    }
+                } else if (character < 0x10000) {
+                    if (size >= 3) {
+                        buffer[0] = static_cast<char>(0xE0 | (character >> 12));
+                        buffer[1] = static_cast<char>(0x80 | ((character >> 6) & 0x3F));
+                        buffer[2] = static_cast<char>(0x80 | (character & 0x3F));
+                        result = 3;
+                    }
+                } else if (size >= 4) {
+                    buffer[0] = static_cast<char>(0xF0 | (character >> 18));
+                    buffer[1] = static_cast<char>(0x80 | ((character >> 12) & 0x3F));
+                    buffer[2] = static_cast<char>(0x80 | ((character >> 6) & 0x3F));
+                    buffer[3] = static_cast<char>(0x80 | (character & 0x3F));
+                    result = 4;
+                }
+
+                return (result);
+            }
+
+            // Most SI text is plain ASCII, whatever the table. Returns the number of leading
+            // bytes below 0x80, these are the same in all single byte tables and in UTF-8.
+            inline uint16_t Plain(const uint8_t data[], const uint16_t length)
+            {
+                uint16_t index = 0;
+
+#if defined(__SSE2__)
+                for (; (index + 16) <= length; index += 16) {
+                    const int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&(data[index]))));
+
+                    if (mask != 0) {
+                        return (index + static_cast<uint16_t>(__builtin_ctz(mask)));
+                    }
+                }
+#endif
+                for (; (index + 8) <= length; index += 8) {
+                    uint64_t word;
+                    ::memcpy(&word, &(data[index]), sizeof(word));
+
+                    if ((word & 0x8080808080808080ULL) != 0) {
+                        break;
+                    }
+                }
+
+                while ((index < length) && (data[index] < 0x80)) {
+                    index++;
+                }
+
+                return (index);
+            }
+
+            // Strips the character table selector, if any, and returns how the rest is encoded.
+            Encoding Selector(const uint8_t data[], const uint16_t length, uint16_t& offset, const uint16_t*& table)
+            {
+                Encoding result = Encoding::ISO6937;
+
+                offset = 0;
+                table = ISO6937;
+
+                if ((length > 0) && (data[0] < 0x20)) {
+                    offset = 1;
+
+                    if ((data[0] >= 0x01) && (data[0] <= 0x0B) && (data[0] != 0x08)) {
+                        // ISO/IEC 8859-5 up to 8859-15
+                        table = ISO8859[data[0] + 4 - 1];
+                        result = Encoding::ISO8859;
+                    } else if (data[0] == 0x10) {
+                        // ISO/IEC 8859, the part number in the next two bytes
+                        const uint16_t part = (length >= 3 ? ((data[1] << 8) | data[2]) : 0);
+
+                        offset = 3;
+
+                        if ((part >= 1) && (part <= 16) && (part != 12)) {
+                            table = ISO8859[part - 1];
+                            result = Encoding::ISO8859;
+                        } else {
+                            result = Encoding::UNSUPPORTED;
+                        }
+                    } else if (data[0] == 0x11) {
+                        // ISO/IEC 10646, the Basic Multilingual Plane, big endian. Surrogate pairs
+                        // are accepted as well, so this is decoded as UTF-16.
+                        result = Encoding::UTF16;
+                    } else if (data[0] == 0x15) {
+                        result = Encoding::UTF8;
+                    } else if (data[0] == 0x1F) {
+                        // encoding_type_id follows
+                        offset = 2;
+                        result = Encoding::UNSUPPORTED;
+                    } else {
+                        // KS X 1001, GB-2312, Big5 and the reserved ones.
+                        result = Encoding::UNSUPPORTED;
+                    }
+                }
+
+                offset = std::min(offset, length);
+
+                return (result);
+            }
+
+            uint32_t SingleByte(const uint8_t data[], const uint16_t length, const uint16_t table[], const bool diacritics, char buffer[], const uint32_t size)
+            {
+                uint16_t index = 0;
+                uint32_t result = 0;
+
+                while ((index < length) && (result < size)) {
+                    const uint16_t run = Plain(&(data[index]), static_cast<uint16_t>(std::min(static_cast<uint32_t>(length - index), size - result)));
+
+                    ::memcpy(&(buffer[result]), &(data[index]), run);
+                    index += run;
+                    result += run;
+
+                    if ((index < length) && (result < size) && (data[index] >= 0x80)) {
+                        const uint8_t character = data[index++];
+
+                        if (character == 0x8A) {
+                            // CR/LF
+                            buffer[result++] = '\n';
+                        } else if (character >= 0xA0) {
+                            if ((diacritics == true) && (character >= 0xC1) && (character <= 0xCF)) {
+                                // The diacritic comes first, in Unicode it follows the letter. Use
+                                // the precomposed letter if there is one.
+                                const uint8_t base = (index < length ? data[index] : 0);
+                                uint16_t composed = 0;
+
+                                if ((base >= 'A') && (base <= 'Z')) {
+                                    composed = Composed[character - 0xC1][base - 'A'];
+                                } else if ((base >= 'a') && (base <= 'z')) {
+                                    composed = Composed[character - 0xC1][base - 'a' + 26];
+                                }
+
+                                if (composed != 0) {
+                                    result += Encode(composed, &(buffer[result]), size - result);
+                                    index++;
+                                } else if ((base >= 0x20) && (base < 0x80)) {
+                                    result += Encode(base, &(buffer[result]), size - result);
+                                    result += Encode(table[character - 0xA0], &(buffer[result]), size - result);
+                                    index++;
+                                }
+                                // A diacritic on nothing, or on a non ASCII character, is dropped.
+                            } else if (table[character - 0xA0] != 0) {
+                                result += Encode(table[character - 0xA0], &(buffer[result]), size - result);
+                            }
+                        }
+                        // The other control codes (emphasis on/off, ...) carry no text.
+                    }
+                }
+
+                return (result);
+            }
+
+            uint32_t UTF16(const uint8_t data[], const uint16_t length, char buffer[], const uint32_t size)
+            {
+                uint16_t index = 0;
+                uint32_t result = 0;
+
+                for (; ((index + 1) < length) && (result < size); index += 2) {
+                    uint32_t character = ((data[index] << 8) | data[index + 1]);
+
+                    if ((character >= 0xD800) && (character <= 0xDBFF)) {
+                        const uint32_t low = ((index + 3) < length ? ((data[index + 2] << 8) | data[index + 3]) : 0);
+
+                        if ((low >= 0xDC00) && (low <= 0xDFFF)) {
+                            character = 0x10000 + ((character - 0xD800) << 10) + (low - 0xDC00);
+                            index += 2;
+                        } else {
+                            character = 0;
+                        }
+                    } else if ((character >= 0xDC00) && (character <= 0xDFFF)) {
+                        character = 0;
+                    } else if ((character == 0xE08A) || (character == 0x008A)) {
+                        character = '\n';
+                    } else if (((character >= 0xE080) && (character <= 0xE09F)) || ((character >= 0x0080) && (character <= 0x009F))) {
+                        character = 0;
+                    }
+
+                    if (character != 0) {
+                        result += Encode(character, &(buffer[result]), size - result);
+                    }
+                }
+
+                return (result);
+            }
+
+            uint32_t UTF8(const uint8_t data[], const uint16_t length, char buffer[], const uint32_t size)
+            {
+                uint16_t index = 0;
+                uint32_t result = 0;
+
+                while ((index < length) && (result < size)) {
+                    const uint16_t run = Plain(&(data[index]), static_cast<uint16_t>(std::min(static_cast<uint32_t>(length - index), size - result)));
+
+                    ::memcpy(&(buffer[result]), &(data[index]), run);
+                    index += run;
+                    result += run;
+
+                    if ((index < length) && (result < size) && (data[index] >= 0x80)) {
+                        const uint8_t lead = data[index];
+                        const uint8_t bytes = (lead < 0xC2 ? 0 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : lead < 0xF5 ? 4 : 0);
+                        uint8_t valid = ((bytes != 0) && ((index + bytes) <= length) ? 1 : 0);
+
+                        while ((valid != 0) && (valid < bytes)) {
+                            valid = ((data[index + valid] & 0xC0) == 0x80 ? valid + 1 : 0);
+                        }
+
+                        if (valid == 0) {
+                            // Not UTF-8, skip the byte.
+                            index++;
+                        } else if ((lead == 0xC2) && (data[index + 1] < 0xA0)) {
+                            // The control codes, U+0080 up to U+009F.
+                            if (data[index + 1] == 0x8A) {
+                                buffer[result++] = '\n';
+                            }
+                            index += 2;
+                        } else if ((result + bytes) <= size) {
+                            ::memcpy(&(buffer[result]), &(data[index]), bytes);
+                            index += bytes;
+                            result += bytes;
+                        } else {
+                            // Never write half a character.
+                            break;
+                        }
+                    }
+                }
+
+                return (result);
+            }
+
+            uint32_t Printable(const uint8_t data[], const uint16_t length, char buffer[], const uint32_t size)
+            {
+                uint32_t result = 0;
+
+                for (uint16_t index = 0; (index < length) && (result < size); index++) {
+                    if ((data[index] >= 0x20) && (data[index] < 0x80)) {
+                        buffer[result++] = static_cast<char>(data[index]);
+                    }
+                }
+
+                return (result);
+            }
+        }
+
+        uint32_t Text(const uint8_t data[], const uint16_t length, char buffer[], const uint32_t size)
+        {
+            uint16_t offset;
+            const uint16_t* table;
+            uint32_t result = 0;
+
+            switch (Selector(data, length, offset, table)) {
+            case Encoding::ISO6937:
+                result = SingleByte(&(data[offset]), length - offset, table, true, buffer, size);
+                break;
+            case Encoding::ISO8859:
+                result = SingleByte(&(data[offset]), length - offset, table, false, buffer, size);
+                break;
+            case Encoding::UTF16:
+                result = UTF16(&(data[offset]), length - offset, buffer, size);
+                break;
+            case Encoding::UTF8:
+                result = UTF8(&(data[offset]), length - offset, buffer, size);
+                break;
+            default:
+                // At least keep what is ASCII, it is the best we can do.
+                result = Printable(&(data[offset]), length - offset, buffer, size);
+                break;
+            }
+
+            return (result);
+        }
+
+        string Text(const uint8_t data[], const uint16_t length)
+        {
+            string result;
+
+            if (length <= 0xFF) {
+                // Everything in a descriptor, no need to go to the heap twice.
+                char buffer[TextSize(0xFF)];
+                result.assign(buffer, Text(data, length, buffer, sizeof(buffer)));
+            } else {
+                result.resize(TextSize(length));
+                result.resize(Text(data, length, &(result[0]), static_cast<uint32_t>(result.size())));
+            }
+
+            return (result);
+        }
+
+    } // namespace DVB
+} // namespace Broadcast
+} // namespace Thunder
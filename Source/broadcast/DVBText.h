@@ -0,0 +1,48 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __DVBTEXT_H
+#define __DVBTEXT_H
+
+#include "Module.h"
+
+namespace Thunder {
+namespace Broadcast {
+    namespace DVB {
+
+        // SI text (ETSI EN 300 468, Annex A): an optional character table selector,
+        // followed by the characters in that table, with the control codes 0x80-0x9F.
+        // Supported are the default table (ISO/IEC 6937), ISO/IEC 8859-1 up to 8859-16,
+        // ISO/IEC 10646 (UTF-16) and UTF-8. Of other tables only the ASCII is kept.
+        // Converted to UTF-8, the text never takes more than 3 bytes per byte in.
+        inline constexpr uint32_t TextSize(const uint16_t length)
+        {
+            return (length * 3);
+        }
+
+        // Returns the number of bytes written to the buffer, the result is not zero terminated.
+        EXTERNAL uint32_t Text(const uint8_t data[], const uint16_t length, char buffer[], const uint32_t size);
+
+        EXTERNAL string Text(const uint8_t data[], const uint16_t length);
+
+    } // namespace DVB
+} // namespace Broadcast
+} // namespace Thunder
+
+#endif // __DVBTEXT_H
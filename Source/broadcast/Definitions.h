@@ -39,57 +39,97 @@ namespace Broadcast {
     struct IMonitor {
         virtual ~IMonitor() {}
         virtual void ChangePid(const uint16_t newpid, ISection* observer) = 0;
+
+        // Optional, additional PMT filters next to the one moved by ChangePid, to load
+        // the PMT's of multiple PIDs in parallel. A monitor that can not (or has no
+        // filters left) returns an error and the PMT's are loaded one PID at a time.
+        virtual uint32_t AddPid(const uint16_t pid VARIABLE_IS_NOT_USED, ISection* observer VARIABLE_IS_NOT_USED)
+        {
+            return (Core::ERROR_UNAVAILABLE);
+        }
+        virtual void RemovePid(const uint16_t pid VARIABLE_IS_NOT_USED)
+        {
+        }
     };
 
-    template <typename LISTOBJECT>
+    // Iterates over an immutable, shared, snapshot of a container. Creating and copying
+    // an iterator is O(1), all copies share the same storage, so administrators publish a
+    // new snapshot on an update (copy-on-write) instead of copying on every enumeration.
+    template <typename LISTOBJECT, typename CONTAINER = std::list<LISTOBJECT>>
     class IteratorType {
+    private:
+        template <typename TYPE>
+        struct Element {
+            static inline const LISTOBJECT& Value(const typename TYPE::const_iterator& index)
+            {
+                return (*index);
+            }
+        };
+        template <typename KEY>
+        struct Element<std::map<KEY, LISTOBJECT>> {
+            static inline const LISTOBJECT& Value(const typename std::map<KEY, LISTOBJECT>::const_iterator& index)
+            {
+                return (index->second);
+            }
+        };
+
     public:
+        typedef std::shared_ptr<const CONTAINER> Snapshot;
+
         IteratorType()
             : _position(0)
             , _index()
-            , _list()
+            , _container()
+        {
+        }
+        IteratorType(const Snapshot& container)
+            : _position(0)
+            , _index()
+            , _container(container)
+        {
+        }
+        IteratorType(CONTAINER&& container)
+            : _position(0)
+            , _index()
+            , _container(std::make_shared<const CONTAINER>(std::move(container)))
         {
         }
         IteratorType(const std::map<uint16_t, LISTOBJECT>& container)
             : _position(0)
             , _index()
-            , _list()
+            , _container()
         {
+            CONTAINER copy;
             typename std::map<uint16_t, LISTOBJECT>::const_iterator index(container.begin());
             while (index != container.end()) {
-                _list.emplace_back(index->second);
+                copy.emplace_back(index->second);
                 index++;
             }
+            _container = std::make_shared<const CONTAINER>(std::move(copy));
         }
-        IteratorType(const IteratorType<LISTOBJECT>& copy)
-            : _list()
+        IteratorType(const IteratorType<LISTOBJECT, CONTAINER>& copy)
+            : _position(copy._position)
+            , _index(copy._index)
+            , _container(copy._container)
         {
-            operator=(copy);
         }
         ~IteratorType()
         {
         }
 
-        IteratorType<LISTOBJECT>& operator=(const IteratorType<LISTOBJECT>& rhs)
+        IteratorType<LISTOBJECT, CONTAINER>& operator=(const IteratorType<LISTOBJECT, CONTAINER>& rhs)
         {
             _position = rhs._position;
-            _list.clear();
-            typename std::list<LISTOBJECT>::const_iterator index(rhs._list.begin());
+            _index = rhs._index;
+            _container = rhs._container;
 
-            while (index != rhs._list.end()) {
-                _list.emplace_back(*index);
-                if (_list.size() == rhs._position) {
-                    _index = --_list.end();
-                }
-                index++;
-            }
             return (*this);
         }
 
     public:
         bool IsValid() const
         {
-            return ((_position != 0) && (_position <= _list.size()));
+            return ((_position != 0) && (_position <= Count()));
         }
         void Reset()
         {
@@ -98,27 +138,33 @@ namespace Broadcast {
         bool Next()
         {
             if (_position == 0) {
-                _index = _list.begin();
+                if (_container != nullptr) {
+                    _index = _container->begin();
+                }
                 _position++;
-            } else if (_position <= _list.size()) {
+            } else if (_position <= Count()) {
                 _index++;
                 _position++;
             }
 
-            return (_position <= _list.size());
+            return (_position <= Count());
         }
         const LISTOBJECT& Current() const
         {
 
             ASSERT(IsValid() == true);
 
-            return (*_index);
+            return (Element<CONTAINER>::Value(_index));
+        }
+        inline uint32_t Count() const
+        {
+            return (_container != nullptr ? static_cast<uint32_t>(_container->size()) : 0);
         }
 
     private:
         uint32_t _position;
-        typename std::list<LISTOBJECT>::const_iterator _index;
-        typename std::list<LISTOBJECT> _list;
+        typename CONTAINER::const_iterator _index;
+        Snapshot _container;
     };
 
     template <typename TYPE>
@@ -138,6 +184,19 @@ namespace Broadcast {
         return (value);
     }
 
+    // DVB UTC time: 16 bits Modified Julian Date followed by 6 BCD digits hhmmss.
+    // Returns the number of seconds since the UNIX epoch (MJD 40587).
+    inline uint32_t ConvertMJD(const uint8_t buffer[])
+    {
+        uint16_t MJD = ((buffer[0] << 8) | buffer[1]);
+        uint32_t hours = ConvertBCD<uint32_t>(&(buffer[2]), 2, true);
+        uint32_t minutes = ConvertBCD<uint32_t>(&(buffer[3]), 2, true);
+        uint32_t seconds = ConvertBCD<uint32_t>(&(buffer[4]), 2, true);
+
+        // Unsigned, in int the days beyond 2038-01-19 overflow. Up to MJD 0xFFFF it fits 32 bits.
+        return (MJD < 40587 ? 0 : ((static_cast<uint32_t>(MJD - 40587) * 86400u) + (hours * 3600) + (minutes * 60) + seconds));
+    }
+
     enum SpectralInversion {
         Auto,
         Normal,
@@ -252,6 +311,24 @@ namespace Broadcast {
             STREAMING = 0x08
         };
 
+        // The moments (Core::Time ticks) a channel change passed its stages, 0 if not (yet) passed.
+        // A zap to another program on the same transport stream starts at Prepare, Tune up to PAT are 0.
+        struct Timeline {
+            uint64_t Tune; // Tune() requested
+            uint64_t Lock; // Frontend locked
+            uint64_t PAT; // First PAT section
+            uint64_t Prepare; // Prepare() requested
+            uint64_t PMT; // PMT of the program loaded, the PID's are known
+            uint64_t PES; // First PES packet of the program, after Attach()
+
+            // In ms, from the start of the zap up to the given stage, 0 if not passed.
+            inline uint32_t Elapsed(const uint64_t stage) const
+            {
+                const uint64_t start = (Tune != 0 ? Tune : Prepare);
+                return ((stage >= start) && (start != 0) ? static_cast<uint32_t>((stage - start) / Core::Time::TicksPerMillisecond) : 0);
+            }
+        };
+
         enum DTVStandard {
             DVB = 0x1000,
             ATSC = 0x2000,
@@ -361,6 +438,14 @@ namespace Broadcast {
             _adminLock.Unlock();
         }
 
+        // Additions to the interface go last, the slots of the existing methods stay where they were.
+
+        // The stages of the last channel change, for as far as the implementation can tell.
+        virtual uint32_t Timing(Timeline& timeline VARIABLE_IS_NOT_USED) const
+        {
+            return (Core::ERROR_UNAVAILABLE);
+        }
+
     private:
         mutable Core::CriticalSection _adminLock;
         ICallback* _callback;
@@ -20,6 +20,7 @@
 #ifndef DESCRIPTORS_H
 #define DESCRIPTORS_H
 
+#include "DVBText.h"
 #include "Definitions.h"
 #include "MPEGDescriptor.h"
 
@@ -55,7 +56,8 @@ namespace Broadcast {
             public:
                 string Name() const
                 {
-                    return (Core::ToString(reinterpret_cast<const char*>(&(_data[1])), _data[0]));
+                    // The whole descriptor is the name, there is no length field.
+                    return (_data.Length() > 2 ? DVB::Text(&(_data[0]), _data.Length() - 2) : string());
                 }
 
             private:
@@ -96,13 +98,19 @@ namespace Broadcast {
                 {
                     return (static_cast<Broadcast::Modulation>(((_data[6] >> 3) & 0x0C) | (_data[6] & 0x03)));
                 }
+                // Symbol rate in symbols/s, it is broadcasted in units of 100 symbols/s.
                 uint32_t SymbolRate() const
                 {
-                    return (Broadcast::ConvertBCD<uint32_t>(&(_data[7]), 7, true));
+                    return (Broadcast::ConvertBCD<uint32_t>(&(_data[7]), 7, true) * 100);
                 }
                 fec FECInner() const
                 {
-                    return (static_cast<fec>(_data[5] & 0xF));
+                    return (static_cast<fec>(_data[10] & 0x0F));
+                }
+                // DVB-S2, the S2SatelliteDeliverySystem descriptor might follow.
+                bool S2() const
+                {
+                    return ((_data[6] & 0x04) != 0);
                 }
 
             private:
@@ -144,17 +152,230 @@ namespace Broadcast {
                     uint8_t mod(_data[6]);
                     return (static_cast<Broadcast::Modulation>(((mod == 0) || (mod > 9)) ? 0 : (0x10 << (mod - 1))));
                 }
+                // Symbol rate in symbols/s, it is broadcasted in units of 100 symbols/s.
                 uint32_t SymbolRate() const
                 {
-                    return (Broadcast::ConvertBCD<uint32_t>(&(_data[7]), 7, true));
+                    return (Broadcast::ConvertBCD<uint32_t>(&(_data[7]), 7, true) * 100);
                 }
                 fec FECInner() const
                 {
-                    return (static_cast<fec>(_data[5] & 0xF));
+                    return (static_cast<fec>(_data[10] & 0x0F));
                 }
                 fec_outer FECOuter() const
                 {
-                    return (static_cast<fec_outer>(_data[10] & 0x3));
+                    return (static_cast<fec_outer>(_data[5] & 0x0F));
+                }
+
+            private:
+                MPEG::Descriptor _data;
+            };
+
+            class EXTERNAL TerrestrialDeliverySystem {
+            private:
+                TerrestrialDeliverySystem operator=(const TerrestrialDeliverySystem& rhs) = delete;
+
+            public:
+                constexpr static uint8_t TAG = 0x5A;
+
+            public:
+                TerrestrialDeliverySystem()
+                    : _data()
+                {
+                }
+                TerrestrialDeliverySystem(const TerrestrialDeliverySystem& copy)
+                    : _data(copy._data)
+                {
+                }
+                TerrestrialDeliverySystem(const MPEG::Descriptor& copy)
+                    : _data(copy)
+                {
+                }
+                ~TerrestrialDeliverySystem()
+                {
+                }
+
+            public:
+                // Frequency in KHz, it is broadcasted in units of 10Hz.
+                uint32_t Frequency() const
+                {
+                    return (((static_cast<uint32_t>(_data[0]) << 24) | (_data[1] << 16) | (_data[2] << 8) | _data[3]) / 100);
+                }
+                // Bandwidth in Hz, 0 if reserved.
+                uint32_t Bandwidth() const
+                {
+                    uint8_t value(_data[4] >> 5);
+                    return (value <= 3 ? (8 - value) * 1000000 : 0);
+                }
+                Broadcast::Modulation Modulation() const
+                {
+                    // QPSK is not a Modulation, leave it to the frontend.
+                    uint8_t value(_data[5] >> 6);
+                    return (value == 1 ? QAM16 : value == 2 ? QAM64 : MODULATION_UNKNOWN);
+                }
+                Broadcast::hierarchy Hierarchy() const
+                {
+                    uint8_t value((_data[5] >> 3) & 0x03);
+                    return (value == 0 ? NoHierarchy : value == 1 ? Hierarchy1 : value == 2 ? Hierarchy2 : Hierarchy4);
+                }
+                fec CodeRateHP() const
+                {
+                    return (CodeRate(_data[5] & 0x07));
+                }
+                fec CodeRateLP() const
+                {
+                    return (CodeRate(_data[6] >> 5));
+                }
+                Broadcast::guard Guard() const
+                {
+                    static constexpr Broadcast::guard table[] = { GUARD_1_32, GUARD_1_16, GUARD_1_8, GUARD_1_4 };
+                    return (table[(_data[6] >> 3) & 0x03]);
+                }
+                Broadcast::transmission Transmission() const
+                {
+                    uint8_t value((_data[6] >> 1) & 0x03);
+                    return (value == 0 ? TRANSMISSION_2K : value == 1 ? TRANSMISSION_8K : value == 2 ? TRANSMISSION_4K : TRANSMISSION_AUTO);
+                }
+                bool OtherFrequencies() const
+                {
+                    return ((_data[6] & 0x01) != 0);
+                }
+
+            private:
+                static fec CodeRate(const uint8_t value)
+                {
+                    static constexpr fec table[] = { FEC_1_2, FEC_2_3, FEC_3_4, FEC_5_6, FEC_7_8 };
+                    return (value < (sizeof(table) / sizeof(fec)) ? table[value] : FEC_INNER_UNKNOWN);
+                }
+
+            private:
+                MPEG::Descriptor _data;
+            };
+
+            class EXTERNAL S2SatelliteDeliverySystem {
+            private:
+                S2SatelliteDeliverySystem operator=(const S2SatelliteDeliverySystem& rhs) = delete;
+
+            public:
+                constexpr static uint8_t TAG = 0x79;
+
+            public:
+                S2SatelliteDeliverySystem()
+                    : _data()
+                {
+                }
+                S2SatelliteDeliverySystem(const S2SatelliteDeliverySystem& copy)
+                    : _data(copy._data)
+                {
+                }
+                S2SatelliteDeliverySystem(const MPEG::Descriptor& copy)
+                    : _data(copy)
+                {
+                }
+                ~S2SatelliteDeliverySystem()
+                {
+                }
+
+            public:
+                bool BackwardsCompatible() const
+                {
+                    return ((_data[0] & 0x20) != 0);
+                }
+                // Physical layer scrambling sequence, 0 if not scrambled.
+                uint32_t ScramblingSequence() const
+                {
+                    return ((_data[0] & 0x80) != 0 ? (((_data[1] & 0x03) << 16) | (_data[2] << 8) | _data[3]) : 0);
+                }
+                bool MultipleInputStreams() const
+                {
+                    return ((_data[0] & 0x40) != 0);
+                }
+                uint8_t InputStreamId() const
+                {
+                    return (MultipleInputStreams() == true ? _data[(_data[0] & 0x80) != 0 ? 4 : 1] : 0);
+                }
+
+            private:
+                MPEG::Descriptor _data;
+            };
+
+            // An extension descriptor (0x7F), the tag extension is the first byte.
+            class EXTERNAL T2DeliverySystem {
+            private:
+                T2DeliverySystem operator=(const T2DeliverySystem& rhs) = delete;
+
+            public:
+                constexpr static uint8_t TAG = 0x7F;
+                constexpr static uint8_t EXTENSION = 0x04;
+
+            public:
+                T2DeliverySystem()
+                    : _data()
+                {
+                }
+                T2DeliverySystem(const T2DeliverySystem& copy)
+                    : _data(copy._data)
+                {
+                }
+                T2DeliverySystem(const MPEG::Descriptor& copy)
+                    : _data(copy)
+                {
+                }
+                ~T2DeliverySystem()
+                {
+                }
+
+            public:
+                inline bool IsValid() const
+                {
+                    return ((_data.Length() >= (2 + 4)) && (_data[0] == EXTENSION));
+                }
+                uint8_t PLPId() const
+                {
+                    return (_data[1]);
+                }
+                uint16_t SystemId() const
+                {
+                    return ((_data[2] << 8) | _data[3]);
+                }
+                // The remainder is optional, it is not sent if an earlier descriptor has it already.
+                inline bool HasParameters() const
+                {
+                    return (_data.Length() >= (2 + 6));
+                }
+                // Bandwidth in Hz, 0 if not known.
+                uint32_t Bandwidth() const
+                {
+                    static constexpr uint32_t table[] = { 8000000, 7000000, 6000000, 5000000, 10000000, 1712000 };
+                    uint8_t value((_data[4] >> 2) & 0x0F);
+                    return ((HasParameters() == true) && (value < (sizeof(table) / sizeof(uint32_t))) ? table[value] : 0);
+                }
+                Broadcast::guard Guard() const
+                {
+                    static constexpr Broadcast::guard table[] = { GUARD_1_32, GUARD_1_16, GUARD_1_8, GUARD_1_4, GUARD_1_128, GUARD_19_128, GUARD_19_256 };
+                    uint8_t value(_data[5] >> 5);
+                    return ((HasParameters() == true) && (value < (sizeof(table) / sizeof(Broadcast::guard))) ? table[value] : GUARD_AUTO);
+                }
+                Broadcast::transmission Transmission() const
+                {
+                    static constexpr Broadcast::transmission table[] = { TRANSMISSION_2K, TRANSMISSION_8K, TRANSMISSION_4K, TRANSMISSION_1K, TRANSMISSION_16K, TRANSMISSION_32K };
+                    uint8_t value((_data[5] >> 2) & 0x07);
+                    return ((HasParameters() == true) && (value < (sizeof(table) / sizeof(Broadcast::transmission))) ? table[value] : TRANSMISSION_AUTO);
+                }
+                // Frequency in KHz of the first cell, 0 if not sent.
+                uint32_t Frequency() const
+                {
+                    uint32_t result = 0;
+
+                    // cell_id (16), followed by a frequency loop (TFS) or a single centre frequency.
+                    if ((HasParameters() == true) && (_data.Length() >= (2 + 6 + 2 + 4))) {
+                        uint8_t offset = ((_data[5] & 0x01) != 0 ? 6 + 2 + 1 : 6 + 2);
+
+                        if ((offset + 4 + 2) <= _data.Length()) {
+                            result = ((static_cast<uint32_t>(_data[offset]) << 24) | (_data[offset + 1] << 16) | (_data[offset + 2] << 8) | _data[offset + 3]) / 100;
+                        }
+                    }
+
+                    return (result);
                 }
 
             private:
@@ -210,12 +431,183 @@ namespace Broadcast {
                 }
                 string Provider() const
                 {
-                    return (Core::ToString(reinterpret_cast<const char*>(&(_data[2])), _data[1]));
+                    return (DVB::Text(&(_data[2]), _data[1]));
                 }
                 string Name() const
                 {
                     uint8_t offset = 1 /* service type */ + 1 /* length */ + _data[1];
-                    return (Core::ToString(reinterpret_cast<const char*>(&(_data[offset + 1])), _data[offset]));
+                    return (DVB::Text(&(_data[offset + 1]), _data[offset]));
+                }
+
+            private:
+                MPEG::Descriptor _data;
+            };
+
+            class EXTERNAL ShortEvent {
+            private:
+                ShortEvent operator=(const ShortEvent& rhs) = delete;
+
+            public:
+                constexpr static uint8_t TAG = 0x4D;
+
+            public:
+                ShortEvent()
+                    : _data()
+                {
+                }
+                ShortEvent(const ShortEvent& copy)
+                    : _data(copy._data)
+                {
+                }
+                ShortEvent(const MPEG::Descriptor& copy)
+                    : _data(copy)
+                {
+                }
+                ~ShortEvent()
+                {
+                }
+
+            public:
+                // ISO 639-2 language code, 3 characters
+                string Language() const
+                {
+                    return (Core::ToString(reinterpret_cast<const char*>(&(_data[0])), 3));
+                }
+                string Name() const
+                {
+                    return (DVB::Text(&(_data[4]), _data[3]));
+                }
+                string Text() const
+                {
+                    uint8_t offset = 3 /* language */ + 1 /* length */ + _data[3];
+                    return (DVB::Text(&(_data[offset + 1]), _data[offset]));
+                }
+
+            private:
+                MPEG::Descriptor _data;
+            };
+
+            class EXTERNAL ExtendedEvent {
+            private:
+                ExtendedEvent operator=(const ExtendedEvent& rhs) = delete;
+
+            public:
+                constexpr static uint8_t TAG = 0x4E;
+
+            public:
+                ExtendedEvent()
+                    : _data()
+                {
+                }
+                ExtendedEvent(const ExtendedEvent& copy)
+                    : _data(copy._data)
+                {
+                }
+                ExtendedEvent(const MPEG::Descriptor& copy)
+                    : _data(copy)
+                {
+                }
+                ~ExtendedEvent()
+                {
+                }
+
+            public:
+                // Long texts are split over multiple descriptors, Number() runs from 0 to LastNumber().
+                uint8_t Number() const
+                {
+                    return (_data[0] >> 4);
+                }
+                uint8_t LastNumber() const
+                {
+                    return (_data[0] & 0x0F);
+                }
+                string Language() const
+                {
+                    return (Core::ToString(reinterpret_cast<const char*>(&(_data[1])), 3));
+                }
+                string Text() const
+                {
+                    // Skip the (itemised) description/item pairs.
+                    uint8_t offset = 1 /* numbers */ + 3 /* language */ + 1 /* length */ + _data[4];
+                    return (DVB::Text(&(_data[offset + 1]), _data[offset]));
+                }
+
+            private:
+                MPEG::Descriptor _data;
+            };
+
+            // Carried in the TOT, per country (and region) the offset of the local time to UTC
+            // and the moment it changes (daylight saving time).
+            class EXTERNAL LocalTimeOffset {
+            private:
+                LocalTimeOffset operator=(const LocalTimeOffset& rhs) = delete;
+
+                static constexpr uint8_t ENTRY_SIZE = 13;
+
+            public:
+                constexpr static uint8_t TAG = 0x58;
+
+            public:
+                LocalTimeOffset()
+                    : _data()
+                {
+                }
+                LocalTimeOffset(const LocalTimeOffset& copy)
+                    : _data(copy._data)
+                {
+                }
+                LocalTimeOffset(const MPEG::Descriptor& copy)
+                    : _data(copy)
+                {
+                }
+                ~LocalTimeOffset()
+                {
+                }
+
+            public:
+                uint8_t Count() const
+                {
+                    return ((_data.Length() - 2) / ENTRY_SIZE);
+                }
+                // ISO 3166 country code, 3 characters
+                string Country(const uint8_t index) const
+                {
+                    return (Core::ToString(reinterpret_cast<const char*>(&(_data[index * ENTRY_SIZE])), 3));
+                }
+                // The 3 characters of the country code, packed in 24 bits.
+                uint32_t CountryCode(const uint8_t index) const
+                {
+                    const uint8_t offset = (index * ENTRY_SIZE);
+                    return ((_data[offset] << 16) | (_data[offset + 1] << 8) | _data[offset + 2]);
+                }
+                // 0 is the whole country.
+                uint8_t Region(const uint8_t index) const
+                {
+                    return (_data[(index * ENTRY_SIZE) + 3] >> 2);
+                }
+                // Minutes, local time is UTC plus the offset.
+                int16_t Offset(const uint8_t index) const
+                {
+                    return (Minutes(index, 4));
+                }
+                // Seconds since the epoch (UTC), from this moment on NextOffset() applies.
+                uint32_t TimeOfChange(const uint8_t index) const
+                {
+                    return (Broadcast::ConvertMJD(&(_data[(index * ENTRY_SIZE) + 6])));
+                }
+                int16_t NextOffset(const uint8_t index) const
+                {
+                    return (Minutes(index, 11));
+                }
+
+            private:
+                int16_t Minutes(const uint8_t index, const uint8_t field) const
+                {
+                    const uint8_t offset = (index * ENTRY_SIZE);
+                    int16_t minutes = (Broadcast::ConvertBCD<int16_t>(&(_data[offset + field]), 2, true) * 60) + Broadcast::ConvertBCD<int16_t>(&(_data[offset + field + 1]), 2, true);
+
+                    // The polarity applies to both offsets.
+                    return ((_data[offset + 3] & 0x01) != 0 ? -minutes : minutes);
                 }
 
             private:
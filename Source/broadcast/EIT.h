@@ -23,6 +23,7 @@
 // ---- Include system wide include files ----
 
 // ---- Include local include files ----
+#include "Definitions.h"
 #include "MPEGDescriptor.h"
 #include "MPEGSection.h"
 #include "Module.h"
@@ -41,8 +42,16 @@ namespace Broadcast {
 
         class EXTERNAL EIT {
         public:
-            static const uint16_t ACTUAL = 0x42;
-            static const uint16_t OTHER = 0x46;
+            static const uint16_t PID = 0x12;
+
+            // Present/Following
+            static const uint16_t ACTUAL = 0x4E;
+            static const uint16_t OTHER = 0x4F;
+
+            // Schedule, each table id holds 4 days of events.
+            static const uint16_t ACTUAL_SCHEDULE = 0x50;
+            static const uint16_t OTHER_SCHEDULE = 0x60;
+            static const uint8_t SCHEDULE_TABLES = 16;
 
         public:
             enum running {
@@ -54,26 +63,26 @@ namespace Broadcast {
             };
 
         public:
-            class ServiceIterator {
+            class EventIterator {
             public:
-                ServiceIterator()
+                EventIterator()
                     : _info()
                     , _offset(~0)
                 {
                 }
-                ServiceIterator(const Core::DataElement& data)
+                EventIterator(const Core::DataElement& data)
                     : _info(data)
                     , _offset(~0)
                 {
                 }
-                ServiceIterator(const ServiceIterator& copy)
+                EventIterator(const EventIterator& copy)
                     : _info(copy._info)
                     , _offset(copy._offset)
                 {
                 }
-                ~ServiceIterator() {}
+                ~EventIterator() {}
 
-                ServiceIterator& operator=(const ServiceIterator& RHS)
+                EventIterator& operator=(const EventIterator& RHS)
                 {
                     _info = RHS._info;
                     _offset = RHS._offset;
@@ -82,58 +91,70 @@ namespace Broadcast {
                 }
 
             public:
-                inline bool IsValid() const { return (_offset < _info.Size()); }
+                inline bool IsValid() const { return (static_cast<uint32_t>(_offset + 12) <= _info.Size()); }
                 inline void Reset() { _offset = ~0; }
                 inline bool Next()
                 {
                     if (_offset == static_cast<uint16_t>(~0)) {
                         _offset = 0;
                     } else if (_offset < _info.Size()) {
-                        _offset += (DescriptorSize() + 5);
+                        _offset += (DescriptorSize() + 12);
                     }
 
                     return (IsValid());
                 }
-                inline bool EIT_PF() const
+                inline uint16_t EventId() const
+                {
+                    return ((_info[_offset + 0] << 8) | _info[_offset + 1]);
+                }
+                // Seconds since the epoch (UTC), 0 if undefined (e.g. NVOD reference events).
+                inline uint32_t Start() const
                 {
-                    return ((_info[_offset + 2] & 0x01) != 0);
+                    return (HasStart() ? Broadcast::ConvertMJD(&(_info[_offset + 2])) : 0);
                 }
-                inline bool EIT_Schedule() const
+                inline Core::Time StartTime() const
                 {
-                    return ((_info[_offset + 2] & 0x02) != 0);
+                    return (Core::Time(static_cast<uint64_t>(Start()) * Core::Time::TicksPerMillisecond * 1000));
                 }
-                inline bool IsFreeToAir() const
+                // Duration in seconds.
+                inline uint32_t Duration() const
                 {
-                    return ((_info[_offset + 3] & 0x10) != 0);
+                    return ((Broadcast::ConvertBCD<uint32_t>(&(_info[_offset + 7]), 2, true) * 3600) +
+                            (Broadcast::ConvertBCD<uint32_t>(&(_info[_offset + 8]), 2, true) * 60) +
+                            Broadcast::ConvertBCD<uint32_t>(&(_info[_offset + 9]), 2, true));
                 }
                 inline running RunningMode() const
                 {
-                    return (static_cast<running>((_info[_offset + 3] & 0xE0) >> 5));
+                    return (static_cast<running>((_info[_offset + 10] & 0xE0) >> 5));
                 }
-                inline uint16_t ServiceId() const
+                inline bool IsFreeToAir() const
                 {
-                    return ((_info[_offset + 0] << 8) | _info[_offset + 1]);
+                    return ((_info[_offset + 10] & 0x10) == 0);
                 }
                 inline MPEG::DescriptorIterator Descriptors() const
                 {
                     return (MPEG::DescriptorIterator(
-                        Core::DataElement(_info, _offset + 5, DescriptorSize())));
+                        Core::DataElement(_info, _offset + 12, DescriptorSize())));
                 }
-                inline uint8_t Services() const
+                inline uint8_t Events() const
                 {
                     uint8_t count = 0;
                     uint16_t offset = 0;
-                    while (offset < _info.Size()) {
-                        offset += (((_info[offset + 3] << 8) | _info[offset + 4]) & 0x0FFF) + 5;
+                    while (static_cast<uint32_t>(offset + 12) <= _info.Size()) {
+                        offset += (((_info[offset + 10] << 8) | _info[offset + 11]) & 0x0FFF) + 12;
                         count++;
                     }
                     return (count);
                 }
 
             private:
+                inline bool HasStart() const
+                {
+                    return ((_info[_offset + 2] & _info[_offset + 3] & _info[_offset + 4] & _info[_offset + 5] & _info[_offset + 6]) != 0xFF);
+                }
                 inline uint16_t DescriptorSize() const
                 {
-                    return ((_info[_offset + 3] << 8) | _info[_offset + 4]) & 0x0FFF;
+                    return ((_info[_offset + 10] << 8) | _info[_offset + 11]) & 0x0FFF;
                 }
 
             private:
@@ -144,22 +165,27 @@ namespace Broadcast {
         public:
             EIT()
                 : _data()
-                , _transportStreamId(~0)
+                , _serviceId(~0)
+                , _tableId(0)
             {
             }
             EIT(const MPEG::Table& data)
                 : _data(data.Data())
-                , _transportStreamId(data.Extension())
+                , _serviceId(data.Extension())
+                , _tableId(static_cast<uint8_t>(data.TableId()))
             {
             }
-            EIT(const uint16_t transportStreamId, const Core::DataElement& data)
-                : _data(data)
-                , _transportStreamId(transportStreamId)
+            // Events are self contained per section, so an EIT can be processed section by section.
+            EIT(const MPEG::Section& data)
+                : _data(data.Data())
+                , _serviceId(data.Extension())
+                , _tableId(data.TableId())
             {
             }
             EIT(const EIT& copy)
                 : _data(copy._data)
-                , _transportStreamId(copy._transportStreamId)
+                , _serviceId(copy._serviceId)
+                , _tableId(copy._tableId)
             {
             }
             ~EIT() {}
@@ -167,33 +193,56 @@ namespace Broadcast {
             EIT& operator=(const EIT& rhs)
             {
                 _data = rhs._data;
-                _transportStreamId = rhs._transportStreamId;
+                _serviceId = rhs._serviceId;
+                _tableId = rhs._tableId;
                 return (*this);
             }
             bool operator==(const EIT& rhs) const
             {
-                return ((_transportStreamId == rhs._transportStreamId) && (_data == rhs._data));
+                return ((_serviceId == rhs._serviceId) && (_tableId == rhs._tableId) && (_data == rhs._data));
             }
             bool operator!=(const EIT& rhs) const { return (!operator==(rhs)); }
 
         public:
             inline bool IsValid() const
             {
-                return ((_transportStreamId != static_cast<uint16_t>(~0)) && (_data.Size() >= 2));
+                return ((_serviceId != static_cast<uint16_t>(~0)) && (_data.Size() >= 6));
+            }
+            inline bool IsActual() const
+            {
+                return ((_tableId == ACTUAL) || ((_tableId & 0xF0) == ACTUAL_SCHEDULE));
+            }
+            inline bool IsSchedule() const
+            {
+                return (_tableId >= ACTUAL_SCHEDULE);
+            }
+            inline uint8_t TableId() const { return (_tableId); }
+            inline uint16_t ServiceId() const { return (_serviceId); }
+            uint16_t TransportStreamId() const
+            {
+                return (_data.GetNumber<uint16_t, Core::ENDIAN_BIG>(0));
             }
-            inline uint16_t TransportStreamId() const { return (_transportStreamId); }
             uint16_t OriginalNetworkId() const
             {
-                return (_data.GetNumber<uint16_t, Core::ENDIAN_BIG>(0) & 0x1FFF);
+                return (_data.GetNumber<uint16_t, Core::ENDIAN_BIG>(2));
+            }
+            uint8_t SegmentLastSectionNumber() const
+            {
+                return (_data[4]);
+            }
+            uint8_t LastTableId() const
+            {
+                return (_data[5]);
             }
-            ServiceIterator Services() const
+            EventIterator Events() const
             {
-                return (ServiceIterator(Core::DataElement(_data, 3, _data.Size() - 3)));
+                return (EventIterator(Core::DataElement(_data, 6, _data.Size() - 6)));
             }
 
         private:
             Core::DataElement _data;
-            uint16_t _transportStreamId;
+            uint16_t _serviceId;
+            uint8_t _tableId;
         };
 
     } // namespace DVB
@@ -0,0 +1,535 @@
+
+ /*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Definitions.h"
+#include "MPEGDemux.h"
+#include "MPEGTable.h"
+#include "ProgramTable.h"
+#include "TunerAdministrator.h"
+
+// --------------------------------------------------------------------
+// Offline tuner: plays recorded transport streams (.ts files) through the
+// same Filter()/ISection contract as a real frontend, either at the wire
+// rate (paced on the PCR) or as fast as the parsers can consume it.
+// --------------------------------------------------------------------
+namespace Thunder {
+namespace Broadcast {
+
+    class __attribute__((visibility("hidden"))) Tuner : public ITuner, public IMonitor {
+    private:
+        Tuner(const Tuner&) = delete;
+        Tuner& operator=(const Tuner&) = delete;
+
+        static constexpr uint32_t ReadSize = (MPEG::Demux::PACKET_SIZE * 348);
+        static constexpr uint16_t NO_PID = 0xFFFF;
+
+        // Tracks the PCR of the first PID carrying one, to play the recording at the
+        // rate it was captured.
+        class Clock {
+        private:
+            Clock(const Clock&) = delete;
+            Clock& operator=(const Clock&) = delete;
+
+            // 33 bits base (90KHz) * 300 + 9 bits extension, counts at 27MHz.
+            static constexpr uint64_t PCR_WRAP = (static_cast<uint64_t>(1) << 33) * 300;
+            // A jump of more than this is a discontinuity (or a loop), not elapsed time.
+            static constexpr uint64_t MAX_GAP = 27000000ULL * 10;
+
+        public:
+            Clock()
+                : _pid(NO_PID)
+                , _pcr(0)
+                , _start(0)
+            {
+            }
+            ~Clock()
+            {
+            }
+
+        public:
+            inline void Reset()
+            {
+                _pid = NO_PID;
+            }
+            // Returns the number of milliseconds the stream is ahead of the wall clock.
+            uint32_t Pace(const uint8_t data[], const uint32_t length)
+            {
+                uint32_t ahead = 0;
+
+                for (uint32_t offset = 0; (offset + MPEG::Demux::PACKET_SIZE) <= length; offset += MPEG::Demux::PACKET_SIZE) {
+                    const uint8_t* packet = &(data[offset]);
+                    uint64_t pcr;
+
+                    if ((packet[0] == MPEG::Demux::SYNC_BYTE) && (PCR(packet, pcr) == true)) {
+                        const uint16_t pid = (((packet[1] & 0x1F) << 8) | packet[2]);
+
+                        if (_pid == NO_PID) {
+                            _pid = pid;
+                            _pcr = pcr;
+                            _start = Core::Time::Now().Ticks();
+                        } else if (pid == _pid) {
+                            const uint64_t elapsed = ((pcr + PCR_WRAP - _pcr) % PCR_WRAP);
+
+                            if (elapsed > MAX_GAP) {
+                                _pcr = pcr;
+                                _start = Core::Time::Now().Ticks();
+                            } else {
+                                // Ticks are in microseconds, the PCR runs at 27MHz.
+                                const uint64_t due = _start + (elapsed / 27);
+                                const uint64_t now = Core::Time::Now().Ticks();
+
+                                ahead = (due > now ? static_cast<uint32_t>((due - now) / 1000) : 0);
+                            }
+                        }
+                    }
+                }
+
+                return (ahead);
+            }
+
+        private:
+            static bool PCR(const uint8_t packet[], uint64_t& pcr)
+            {
+                // Adaptation field present, at least 7 bytes long and the PCR flag set.
+                bool result = (((packet[3] & 0x20) != 0) && (packet[4] >= 7) && ((packet[5] & 0x10) != 0));
+
+                if (result == true) {
+                    const uint64_t base = (static_cast<uint64_t>(packet[6]) << 25) | (packet[7] << 17) | (packet[8] << 9) | (packet[9] << 1) | (packet[10] >> 7);
+                    const uint16_t extension = ((packet[10] & 0x01) << 8) | packet[11];
+
+                    pcr = (base * 300) + extension;
+                }
+
+                return (result);
+            }
+
+        private:
+            uint16_t _pid;
+            uint64_t _pcr;
+            uint64_t _start;
+        };
+
+        class Player : public Core::Thread {
+        private:
+            Player() = delete;
+            Player(const Player&) = delete;
+            Player& operator=(const Player&) = delete;
+
+        public:
+            Player(Tuner& parent)
+                : Core::Thread(Core::Thread::DefaultStackSize(), _T("FileTuner"))
+                , _parent(parent)
+            {
+            }
+            ~Player() override
+            {
+                Stop();
+                Wait(Core::Thread::STOPPED, Core::infinite);
+            }
+
+        private:
+            uint32_t Worker() override
+            {
+                return (_parent.Play());
+            }
+
+        private:
+            Tuner& _parent;
+        };
+
+    public:
+        class Information {
+        private:
+            Information(const Information&) = delete;
+            Information& operator=(const Information&) = delete;
+
+        private:
+            class Config : public Core::JSON::Container {
+            private:
+                Config(const Config&);
+                Config& operator=(const Config&);
+
+            public:
+                Config()
+                    : Core::JSON::Container()
+                    , Frontends(1)
+                    , Standard(ITuner::DVB)
+                    , Annex(ITuner::NoAnnex)
+                    , Modus(ITuner::Terrestrial)
+                    , Path()
+                    , Pace(false)
+                    , Loop(false)
+                {
+                    Add(_T("frontends"), &Frontends);
+                    Add(_T("standard"), &Standard);
+                    Add(_T("annex"), &Annex);
+                    Add(_T("modus"), &Modus);
+                    Add(_T("path"), &Path);
+                    Add(_T("pace"), &Pace);
+                    Add(_T("loop"), &Loop);
+                }
+                ~Config()
+                {
+                }
+
+            public:
+                Core::JSON::DecUInt8 Frontends;
+                Core::JSON::EnumType<ITuner::DTVStandard> Standard;
+                Core::JSON::EnumType<ITuner::annex> Annex;
+                Core::JSON::EnumType<ITuner::modus> Modus;
+                Core::JSON::String Path;
+                Core::JSON::Boolean Pace;
+                Core::JSON::Boolean Loop;
+            };
+
+            Information()
+                : _frontends(0)
+                , _standard(ITuner::DVB)
+                , _annex(ITuner::NoAnnex)
+                , _modus(ITuner::Terrestrial)
+                , _path()
+                , _pace(false)
+                , _loop(false)
+            {
+            }
+
+        public:
+            static Information& Instance()
+            {
+                return (_instance);
+            }
+            ~Information()
+            {
+            }
+            void Initialize(const string& configuration)
+            {
+                Config config;
+                config.FromString(configuration);
+
+                _frontends = config.Frontends.Value();
+                _standard = config.Standard.Value();
+                _annex = config.Annex.Value();
+                _modus = config.Modus.Value();
+                _path = config.Path.Value();
+                _pace = config.Pace.Value();
+                _loop = config.Loop.Value();
+            }
+            void Deinitialize()
+            {
+            }
+
+        public:
+            inline bool IsSupported(const ITuner::modus mode) const
+            {
+                return ((_path.empty() == false) && (mode == _modus));
+            }
+            inline uint8_t Frontends() const
+            {
+                return (_frontends);
+            }
+            inline uint32_t Properties() const
+            {
+                return (_standard | _annex | _modus);
+            }
+            inline bool Pace() const
+            {
+                return (_pace);
+            }
+            inline bool Loop() const
+            {
+                return (_loop);
+            }
+            // The path is either a single recording, played for every frequency, or a
+            // directory holding a recording per frequency (in MHz): <path>/<frequency>.ts
+            string Recording(const uint16_t frequency) const
+            {
+                string result(_path);
+
+                if (Core::File(_path).IsDirectory() == true) {
+                    result = Core::Directory::Normalize(_path) + Core::NumberType<uint16_t>(frequency).Text() + _T(".ts");
+                }
+
+                return (result);
+            }
+
+        private:
+            uint8_t _frontends;
+            ITuner::DTVStandard _standard;
+            ITuner::annex _annex;
+            ITuner::modus _modus;
+            string _path;
+            bool _pace;
+            bool _loop;
+
+            static Information _instance;
+        };
+
+    private:
+        Tuner()
+            : _adminLock()
+            , _state(IDLE)
+            , _frequency(0)
+            , _file(-1)
+            , _demux()
+            , _clock()
+            , _pat(nullptr)
+            , _pmtPid(NO_PID)
+            , _player(*this)
+            , _callback(nullptr)
+        {
+            _callback = TunerAdministrator::Instance().Announce(this);
+        }
+
+    public:
+        ~Tuner() override
+        {
+            Close();
+
+            TunerAdministrator::Instance().Revoke(this);
+
+            _callback = nullptr;
+        }
+
+        static ITuner* Create(const string& info)
+        {
+            Tuner* result = nullptr;
+
+            uint8_t index = Core::NumberType<uint8_t>(Core::TextFragment(info)).Value();
+
+            if (index < Information::Instance().Frontends()) {
+                result = new Tuner();
+            }
+
+            return (result);
+        }
+
+    public:
+        uint32_t Properties() const override
+        {
+            return (Information::Instance().Properties());
+        }
+
+        // Currently locked on ID
+        // This method return a unique number that will identify the locked on Transport stream. The ID will always
+        // identify the uniquely locked on to Tune request. ID => 0 is reserved and means not locked on to anything.
+        uint16_t Id() const override
+        {
+            return (_state == IDLE ? 0 : _frequency);
+        }
+
+        state State() const override
+        {
+            return (_state);
+        }
+
+        // "Locking" is opening the recording for this frequency, the other parameters
+        // are meaningless for a file.
+        uint32_t Tune(const uint16_t frequency, const Modulation, const uint32_t, const uint16_t, const SpectralInversion) override
+        {
+            uint32_t result = Core::ERROR_NONE;
+
+            Close();
+
+            string recording(Information::Instance().Recording(frequency));
+
+            _adminLock.Lock();
+
+            _file = ::open(recording.c_str(), O_RDONLY);
+
+            if (_file == -1) {
+                TRACE_L1("Can not open recording %s error: %d.", recording.c_str(), errno);
+                result = Core::ERROR_OPENING_FAILED;
+            } else {
+                _frequency = frequency;
+                _clock.Reset();
+            }
+
+            _adminLock.Unlock();
+
+            if (result == Core::ERROR_NONE) {
+                Report(LOCKED);
+
+                // The PAT/PMT's are loaded through the ProgramTable, like any broadcast tuner.
+                _pat = ProgramTable::Instance().Register(this, _frequency);
+                _demux.Filter(0x00, MPEG::PAT::ID, _pat);
+
+                _player.Run();
+            }
+
+            return (result);
+        }
+
+        uint32_t Prepare(const uint16_t programId VARIABLE_IS_NOT_USED) override
+        {
+            return (Core::ERROR_UNAVAILABLE);
+        }
+
+        // A Tuner can be used to filter PSI/SI. Using the next call a callback can be installed to receive sections associated
+        // with a table. Each valid section received will be offered as a single section on the ISection interface for the user
+        // to process.
+        uint32_t Filter(const uint16_t pid, const uint8_t tableId, ISection* callback) override
+        {
+            return (_demux.Filter(pid, tableId, callback));
+        }
+
+        // There are no decoders behind a recording.
+        uint32_t Attach(const uint8_t index VARIABLE_IS_NOT_USED) override
+        {
+            return (Core::ERROR_UNAVAILABLE);
+        }
+        uint32_t Detach(const uint8_t index VARIABLE_IS_NOT_USED) override
+        {
+            return (Core::ERROR_UNAVAILABLE);
+        }
+
+        // IMonitor, the software demux has no limit on the number of PMT filters.
+        void ChangePid(const uint16_t newpid, ISection* observer) override
+        {
+            if (_pmtPid != NO_PID) {
+                _demux.Filter(_pmtPid, MPEG::PMT::ID, nullptr);
+            }
+
+            _pmtPid = newpid;
+
+            if (_pmtPid != NO_PID) {
+                _demux.Filter(_pmtPid, MPEG::PMT::ID, observer);
+            }
+        }
+        uint32_t AddPid(const uint16_t pid, ISection* observer) override
+        {
+            return (_demux.Filter(pid, MPEG::PMT::ID, observer));
+        }
+        void RemovePid(const uint16_t pid) override
+        {
+            _demux.Filter(pid, MPEG::PMT::ID, nullptr);
+        }
+
+    private:
+        // Runs on the Player thread, returns the time to wait (ms) for the next chunk.
+        uint32_t Play()
+        {
+            uint32_t result = 0;
+
+            _adminLock.Lock();
+
+            ssize_t loaded = (_file != -1 ? ::read(_file, _buffer, sizeof(_buffer)) : -1);
+
+            _adminLock.Unlock();
+
+            if (loaded > 0) {
+                _demux.Deliver(_buffer, static_cast<uint32_t>(loaded));
+
+                if (Information::Instance().Pace() == true) {
+                    result = _clock.Pace(_buffer, static_cast<uint32_t>(loaded));
+                }
+            } else if ((loaded == 0) && (Information::Instance().Loop() == true)) {
+                ::lseek(_file, 0, SEEK_SET);
+                _clock.Reset();
+            } else {
+                // End of the recording, for the outside world this is a loss of lock.
+                _player.Block();
+                result = Core::infinite;
+
+                Report(IDLE);
+            }
+
+            return (result);
+        }
+        void Close()
+        {
+            _player.Block();
+            _player.Wait(Core::Thread::BLOCKED | Core::Thread::STOPPED, Core::infinite);
+
+            if (_pat != nullptr) {
+                _demux.Filter(0x00, MPEG::PAT::ID, nullptr);
+                ProgramTable::Instance().Unregister(this);
+                _pat = nullptr;
+                ChangePid(NO_PID, nullptr);
+            }
+
+            _adminLock.Lock();
+
+            if (_file != -1) {
+                ::close(_file);
+                _file = -1;
+            }
+
+            _adminLock.Unlock();
+
+            // Whatever was parsed on the previous recording is no longer relevant.
+            Report(IDLE);
+        }
+        void Report(const state newState)
+        {
+            if (_state != newState) {
+                _state = newState;
+
+                if (_callback != nullptr) {
+                    _callback->StateChange(this);
+                }
+            }
+        }
+
+    private:
+        Core::CriticalSection _adminLock;
+        std::atomic<state> _state;
+        uint16_t _frequency;
+        int _file;
+        MPEG::Demux _demux;
+        Clock _clock;
+        ISection* _pat;
+        uint16_t _pmtPid;
+        Player _player;
+        TunerAdministrator::ICallback* _callback;
+        uint8_t _buffer[ReadSize];
+    };
+
+    /* static */ Tuner::Information Tuner::Information::_instance;
+
+    // The following methods will be called before any create is called. It allows for an initialization,
+    // if requires, and a deinitialization, if the Tuners will no longer be used.
+    /* static */ uint32_t ITuner::Initialize(const string& configuration)
+    {
+        Tuner::Information::Instance().Initialize(configuration);
+
+        return (Core::ERROR_NONE);
+    }
+
+    /* static */ uint32_t ITuner::Deinitialize()
+    {
+        Tuner::Information::Instance().Deinitialize();
+        return (Core::ERROR_NONE);
+    }
+
+    // See if the tuner supports the requested mode, or is configured for the requested mode. This method
+    // only returns proper values if the Initialize has been called before.
+    /* static */ bool ITuner::IsSupported(const ITuner::modus mode)
+    {
+        return (Tuner::Information::Instance().IsSupported(mode));
+    }
+
+    // Accessor to create a tuner.
+    /* static */ ITuner* ITuner::Create(const string& configuration)
+    {
+        return (Tuner::Create(configuration));
+    }
+
+} // namespace Broadcast
+} // namespace Thunder
@@ -19,9 +19,11 @@
  */
 
 #include "Definitions.h"
+#include "MPEGDemux.h"
 #include "ProgramTable.h"
 #include "TunerAdministrator.h"
 
+#include <dirent.h>
 #include <linux/dvb/frontend.h>
 #include <linux/dvb/dmx.h>
 #include <linux/dvb/version.h>
@@ -148,207 +150,759 @@ static constexpr conversion_entry _tableRollOff[] = {
         property.u.data = value;
     }
 
-    static uint16_t IndexToFrontend(const uint8_t /* index */)
+    static int OpenDemux(const string& path, const uint8_t index)
     {
-        uint8_t adapter = 0;
-        uint8_t frontend = 0;
+        static constexpr TCHAR MuxSuffix[] = _T("demux");
 
-        // Count the number of frontends you have per adapter, substract those from the index..
+        char deviceName[50];
+        char strIndex[4];
 
-        return ((adapter << 8) | frontend);
+        ::snprintf(strIndex, sizeof(strIndex), "%d", index);
+        ASSERT(sizeof(deviceName) > (path.size() + strlen(MuxSuffix) + strlen(strIndex)));
+
+        ::snprintf(deviceName, sizeof(deviceName), "%s%s%s", path.c_str(), MuxSuffix, strIndex);
+
+        int mux = open(deviceName, O_RDWR|O_NONBLOCK);
+
+        if (mux == -1) {
+            TRACE_L1("Could not open the filter[%s]: %d\n", deviceName, errno);
+        }
+
+        return (mux);
     }
 
-    class __attribute__((visibility("hidden"))) Tuner : public ITuner  {
+    class __attribute__((visibility("hidden"))) Tuner : public ITuner, public IMonitor {
     private:
         Tuner() = delete;
         Tuner(const Tuner&) = delete;
         Tuner& operator=(const Tuner&) = delete;
 
-        class Observer : public Core::Thread {
+        static constexpr uint16_t NO_PID = 0xFFFF;
+        // Program number 0 is the network PID in the PAT, it is never a program.
+        static constexpr uint16_t NO_PROGRAM = 0x0000;
+        static constexpr uint8_t NO_DECODER = 0xFF;
+        // PMT PIDs loaded in parallel, at most. With a limited number of section filters, at
+        // most half of them, the others are left for the SI tables.
+        static constexpr uint8_t PMT_FILTERS = 8;
+
+        // The PID's a program is fed with.
+        enum stream : uint8_t {
+            VIDEO = 0,
+            AUDIO = 1,
+            PCR = 2,
+            STREAMS = 3
+        };
+
+        // The frontend queues an event (and signals POLLPRI) on every status change, so
+        // lock and loss of lock are reported the moment they happen, nothing is polled.
+        class Frontend : public Core::IResource {
         public:
-            Observer(const Observer&) = delete;
-            Observer& operator=(const Observer&) = delete;
+            Frontend() = delete;
+            Frontend(const Frontend&) = delete;
+            Frontend& operator=(const Frontend&) = delete;
 
-            Observer() : Core::Thread(Thread::DefaultStackSize(), _T("Tuner")), _adminLock(), _entries() {
+            Frontend(Tuner& parent)
+                : _parent(parent)
+                , _registered(false)
+            {
             }
-            ~Observer() override {
+            ~Frontend()
+            {
+                Unregister();
             }
 
         public:
-            static Observer& Instance()
+            void Register()
             {
-                static Observer& _instance = Core::SingletonType<Observer>::Instance();
-                return (_instance);
-            }
-            void Register(Tuner& callback) {
-                _adminLock.Lock();
-                ASSERT (std::find(_entries.begin(), _entries.end(), &callback) == _entries.end());
-                _entries.push_back(&callback);
-                Thread::Run();
-                _adminLock.Unlock();
+                if (_registered == false) {
+                    _registered = true;
+                    Core::ResourceMonitor::Instance().Register(*this);
+                }
             }
-            void Unregister(Tuner& callback) {
-                _adminLock.Lock();
-                std::list<Tuner*>::iterator index (std::find(_entries.begin(), _entries.end(), &callback));
-                if (index != _entries.end()) {
-                    _entries.erase(index);
+            void Unregister()
+            {
+                if (_registered == true) {
+                    _registered = false;
+                    Core::ResourceMonitor::Instance().Unregister(*this);
                 }
-                _adminLock.Unlock();
             }
-
-        private:
-            uint32_t Worker() override {
-                Block();
-                _adminLock.Lock();
-                std::list<Tuner*>::iterator index (_entries.begin());
-                uint32_t result = (_entries.size() > 0 ? 100 : Core::infinite); // Slots of 100 mS;
-                while (index != _entries.end()) {
-                    if ((*index)->Dispatch() == true) {
-                        index = _entries.erase(index);
-                    }
-                    else {
-                        index++;
-                    }
+            handle Descriptor() const override
+            {
+                return (_parent._frontend);
+            }
+            uint16_t Events() override
+            {
+                return (POLLPRI);
+            }
+            void Handle(const uint16_t events) override
+            {
+                if ((events & POLLPRI) != 0) {
+                    _parent.Dispatch();
                 }
-                _adminLock.Unlock();
-                return (result);
             }
 
         private:
-            Core::CriticalSection _adminLock;
-            std::list<Tuner*> _entries;
+            Tuner& _parent;
+            bool _registered;
         };
+
+        // One kernel section filter per PID. All table_ids requested on the PID share it: the
+        // kernel filter is widened to the bits these table_ids have in common and the table_id
+        // is checked here. The EIT (0x4E-0x6F) on PID 0x12 takes one filter, not 34.
         class MuxFilter : public Core::IResource {
         public:
             MuxFilter() = delete;
             MuxFilter(const MuxFilter&) = delete;
             MuxFilter& operator= (const MuxFilter&) = delete;
 
-            MuxFilter(const string& path, const uint8_t index, const uint16_t pid, const uint8_t tableId, ISection* callback) 
-                : _mux(-1)
-                , _offset(0)
-                , _length(0)
-                , _size(1024)
-                , _buffer(reinterpret_cast<uint8_t*>(::malloc(_size)))
-                , _callback(callback) {
+            // Private sections can be up to 4096 bytes. A section filter returns at most one
+            // section per read, so all pending sections are read back to back in a large store,
+            // until there is nothing left (the descriptor is non-blocking).
+            static constexpr uint16_t MaxSectionSize = 4096;
+            static constexpr uint32_t StoreSize = (MaxSectionSize * 16);
+
+            typedef std::vector<std::pair<uint8_t, ISection*>> Callbacks;
+
+            // The dispatch lock is shared by all filters of a tuner, it is held while a callback runs.
+            MuxFilter(const string& path, const uint8_t index, const uint16_t pid, Core::CriticalSection& dispatch)
+                : _lock()
+                , _dispatch(dispatch)
+                , _mux(-1)
+                , _pid(pid)
+                , _begin(0)
+                , _end(0)
+                , _store()
+                , _callbacks() {
+
+                _mux = OpenDemux(path, index);
+            }
+            ~MuxFilter() {
+                if (_mux != -1) {
+                    if (_callbacks.empty() == false) {
+                        Core::ResourceMonitor::Instance().Unregister(*this);
+                    }
+                    ::close(_mux);
+                }
+            }
 
-                static constexpr TCHAR MuxSuffix[] = _T("demux");
+        public:
+            inline bool IsEmpty() const {
+                return (_callbacks.empty());
+            }
+            // Once removed, a callback is no longer called, but it might be handling a section right now,
+            // on the monitor thread. The caller waits for that on the dispatch lock, without the tuner lock.
+            uint32_t Filter(const uint8_t tableId, ISection* callback) {
+                uint32_t result = Core::ERROR_NONE;
 
-                char deviceName[50];
-                char strIndex[4];
+                _lock.Lock();
 
-                ::snprintf(strIndex, sizeof(strIndex), "%d", index);
-                ASSERT(sizeof(deviceName) > (path.size() + strlen(MuxSuffix) + strlen(strIndex)));
+                const bool active = (_callbacks.empty() == false);
 
-                ::snprintf(deviceName, sizeof(deviceName), "%s%s%s", path.c_str(), MuxSuffix, strIndex);
+                Callbacks::iterator index(std::find_if(_callbacks.begin(), _callbacks.end(),
+                    [tableId](const std::pair<uint8_t, ISection*>& entry) { return (entry.first == tableId); }));
 
-                _mux = open(deviceName, O_RDWR|O_NONBLOCK);
+                if (callback == nullptr) {
+                    if (index == _callbacks.end()) {
+                        result = Core::ERROR_UNAVAILABLE;
+                    } else {
+                        _callbacks.erase(index);
 
-                if (_mux == -1) {
-                    TRACE_L1("Could not open the filter[%s]: %d\n", deviceName, errno);
-                }
-                else {
-                
-                    struct dmx_sct_filter_params sctFilterParams;
-
-                    sctFilterParams.pid = pid;
-                    ::memset(&sctFilterParams.filter, 0, sizeof(sctFilterParams.filter));
-                    sctFilterParams.timeout = 0;
-                    sctFilterParams.flags = DMX_IMMEDIATE_START|DMX_CHECK_CRC;
-                    sctFilterParams.filter.filter[0] = tableId;
-                    sctFilterParams.filter.mask[0] = 0xFF;
-
-                    if (ioctl(_mux, DMX_SET_FILTER, &sctFilterParams) < 0) {
-                        TRACE_L1("Could not configue the filter[%d,%d]: %d\n", pid, tableId, errno);
-                        ::close(_mux);
-                        _mux = -1;
+                        if (_callbacks.empty() == true) {
+                            ::ioctl(_mux, DMX_STOP);
+                        } else {
+                            // Narrow it again, nobody wants the other tables.
+                            Configure();
+                        }
                     }
-                    else {
+                } else if (index != _callbacks.end()) {
+                    index->second = callback;
+                } else {
+                    _callbacks.emplace_back(tableId, callback);
+
+                    if (Configure() == false) {
+                        _callbacks.pop_back();
+                        result = Core::ERROR_GENERAL;
+
+                        if (_callbacks.empty() == false) {
+                            Configure();
+                        }
+                    }
+                }
+
+                const bool activated = (_callbacks.empty() == false);
+
+                _lock.Unlock();
+
+                // Outside the lock, the monitor might be waiting for it in Handle().
+                if (active != activated) {
+                    if (active == false) {
                         Core::ResourceMonitor::Instance().Register(*this);
+                    } else {
+                        Core::ResourceMonitor::Instance().Unregister(*this);
                     }
                 }
+
+                return (result);
             }
-            ~MuxFilter() {
+            bool IsValid() const {
+                return (_mux != -1);
+            }
+            handle Descriptor() const override {
+                return (_mux);
+            }
+            uint16_t Events() override {
+                return (POLLPRI);
+            }
+            void Handle(const uint16_t events VARIABLE_IS_NOT_USED) override {
+                int loaded;
+
+                do {
+                    if ((_store.IsValid() == false) || ((StoreSize - _end) < MaxSectionSize)) {
+                        if (_store.IsValid() == true) {
+                            // About to move on to another store, hand out what this one holds.
+                            Process();
+                        }
+                        Renew();
+                    }
+
+                    loaded = ::read(_mux, &(_store->Buffer()[_end]), (StoreSize - _end));
+
+                    if (loaded > 0) {
+                        _end += loaded;
+                    }
+                    else if ((loaded < 0) && ((errno == EOVERFLOW) || (errno == EBADMSG))) {
+                        // Overflow or CRC error, whatever we have is no longer reliable, the
+                        // sections queued after it are.
+                        _begin = _end;
+                        loaded = 1;
+                    }
+
+                // Until EAGAIN, or the filter is stopped (0).
+                } while (loaded > 0);
+
+                Process();
+            }
+
+        private:
+            void Process()
+            {
+                // The callbacks can be changed from another thread, through Tuner::Filter(), that
+                // thread holds the tuner lock. The callbacks are called without the lock taken,
+                // they might need the tuner lock (or whatever lock is taken before it).
+                _lock.Lock();
+
+                while ((_end - _begin) >= 3) {
+                    const uint8_t* header = &(_store->Buffer()[_begin]);
+                    uint16_t length = (((header[1] & 0x0F) << 8) | header[2]) + 3;
+
+                    if ((_end - _begin) < length) {
+                        break;
+                    }
+
+                    const uint8_t tableId = header[0];
+                    Callbacks::const_iterator index(std::find_if(_callbacks.begin(), _callbacks.end(),
+                        [tableId](const std::pair<uint8_t, ISection*>& entry) { return (entry.first == tableId); }));
+
+                    // With a widened filter, tables nobody asked for come along, drop those.
+                    if (index != _callbacks.end()) {
+                        ISection* callback = index->second;
+
+                        // The section refers to the store, no copy, it is released once nobody holds it.
+                        MPEG::Section newSection(Core::DataElement(_store, _begin, length));
+
+                        // Taken before the lock is released, a removal waits for it in Tuner::Drain().
+                        _dispatch.Lock();
+                        _lock.Unlock();
+
+                        callback->Handle(newSection);
+
+                        _dispatch.Unlock();
+                        _lock.Lock();
+                    }
+                    _begin += length;
+                }
+
+                _lock.Unlock();
+            }
+            bool Configure()
+            {
+                struct dmx_sct_filter_params sctFilterParams;
+                uint8_t differ = 0;
+
+                for (const std::pair<uint8_t, ISection*>& entry : _callbacks) {
+                    differ |= (entry.first ^ _callbacks.front().first);
+                }
+
+                ::memset(&sctFilterParams, 0, sizeof(sctFilterParams));
+                sctFilterParams.pid = _pid;
+                sctFilterParams.timeout = 0;
+                sctFilterParams.flags = DMX_IMMEDIATE_START|DMX_CHECK_CRC;
+                sctFilterParams.filter.mask[0] = static_cast<uint8_t>(~differ);
+                sctFilterParams.filter.filter[0] = (_callbacks.front().first & sctFilterParams.filter.mask[0]);
+
+                bool result = (::ioctl(_mux, DMX_SET_FILTER, &sctFilterParams) == 0);
+
+                if (result == false) {
+                    TRACE_L1("Could not configue the filter[%d,%02X/%02X]: %d\n", _pid, sctFilterParams.filter.filter[0], sctFilterParams.filter.mask[0], errno);
+                }
+
+                return (result);
+            }
+            void Renew()
+            {
+                // Sections handed out might still reference the current store, never overwrite
+                // it, continue in a (recycled) store and carry over the incomplete section.
+                Core::ProxyType<Core::DataStore> store(_storeFactory.Element());
+                store->Size(StoreSize);
+
+                uint32_t pending = (_end - _begin);
+
+                if (pending > 0) {
+                    ::memcpy(store->Buffer(), &(_store->Buffer()[_begin]), pending);
+                }
+
+                _store = store;
+                _begin = 0;
+                _end = pending;
+            }
+
+        private:
+            Core::CriticalSection _lock;
+            Core::CriticalSection& _dispatch;
+            int _mux;
+            uint16_t _pid;
+            uint32_t _begin;
+            uint32_t _end;
+            Core::ProxyType<Core::DataStore> _store;
+            Callbacks _callbacks;
+
+            static Core::ProxyPoolType<Core::DataStore> _storeFactory;
+        };
+        class StreamFilter : public Core::IResource {
+        public:
+            StreamFilter() = delete;
+            StreamFilter(const StreamFilter&) = delete;
+            StreamFilter& operator= (const StreamFilter&) = delete;
+
+            // Read enough packets per wakeup to drain the kernel buffer with a minimum of syscalls.
+            static constexpr uint32_t ReadSize = (MPEG::Demux::PACKET_SIZE * 128);
+            static constexpr uint32_t BufferSize = (MPEG::Demux::PACKET_SIZE * 1024);
+
+            StreamFilter(const string& path, const uint8_t index)
+                : _mux(OpenDemux(path, index))
+                , _pids(0)
+                , _demux() {
+
+                if ((_mux != -1) && (ioctl(_mux, DMX_SET_BUFFER_SIZE, BufferSize) < 0)) {
+                    TRACE_L1("Could not set the stream buffer size: %d\n", errno);
+                }
+            }
+            ~StreamFilter() {
                 if (_mux != -1) {
-                    Core::ResourceMonitor::Instance().Unregister(*this);
+                    if (_pids != 0) {
+                        Core::ResourceMonitor::Instance().Unregister(*this);
+                    }
                     ::close(_mux);
                 }
-                ::free(_buffer);
             }
 
         public:
             bool IsValid() const {
                 return (_mux != -1);
             }
+            bool IsActive(const uint16_t pid) const {
+                return (_demux.IsActive(pid));
+            }
+            // Called with the tuner lock taken, a removal does not wait for the callback, Drain() does.
+            uint32_t Filter(const uint16_t pid, const uint8_t tableId, ISection* callback) {
+                bool active = _demux.IsActive(pid);
+                uint32_t result = (callback != nullptr ? _demux.Filter(pid, tableId, callback) : _demux.Revoke(pid, tableId));
+
+                if ((result == Core::ERROR_NONE) && (active != _demux.IsActive(pid))) {
+                    if (active == false) {
+                        if (Add(pid) == false) {
+                            // The PID never made it into the stream, nothing was handed to the callback.
+                            _demux.Revoke(pid, tableId);
+                            result = Core::ERROR_GENERAL;
+                        }
+                    }
+                    else {
+                        Remove(pid);
+                    }
+                }
+
+                return (result);
+            }
+            void Drain() {
+                _demux.Drain();
+            }
             handle Descriptor() const override {
                 return (_mux);
             }
             uint16_t Events() override {
-                return (POLLPRI);
+                return (POLLIN);
             }
             void Handle(const uint16_t events VARIABLE_IS_NOT_USED) override {
-               if (LoadHeader() == true) {
-                    int loaded = ::read(_mux, &(_buffer[_offset]), (_length - (_offset - 3)));
-                    if (loaded < 0) {
-                        int result = errno;
-                        if ((result != EAGAIN) || (result != EWOULDBLOCK)) {
-                            _offset = 0;
-                        }
+                int loaded = ::read(_mux, _buffer, sizeof(_buffer));
+
+                if (loaded > 0) {
+                    _demux.Deliver(_buffer, static_cast<uint32_t>(loaded));
+                }
+                else if ((loaded < 0) && (errno == EOVERFLOW)) {
+                    // The kernel dropped data, the Demux will detect the continuity errors.
+                    TRACE_L1("Stream buffer overflow on the demux.\n");
+                }
+            }
+
+        private:
+            bool Add(uint16_t pid) {
+                bool added = false;
+
+                if (_pids == 0) {
+                    struct dmx_pes_filter_params pesFilterParams;
+
+                    ::memset(&pesFilterParams, 0, sizeof(pesFilterParams));
+                    pesFilterParams.pid = pid;
+                    pesFilterParams.input = DMX_IN_FRONTEND;
+                    pesFilterParams.output = DMX_OUT_TSDEMUX_TAP;
+                    pesFilterParams.pes_type = DMX_PES_OTHER;
+                    pesFilterParams.flags = DMX_IMMEDIATE_START;
+
+                    if (ioctl(_mux, DMX_SET_PES_FILTER, &pesFilterParams) < 0) {
+                        TRACE_L1("Could not configue the stream filter[%d]: %d\n", pid, errno);
                     }
                     else {
-                        _offset += loaded;
-                        if ((_offset - 3) == _length) {
-                            MPEG::Section newSection(Core::DataElement(_offset, _buffer));
-                            _callback->Handle(newSection);
-                            _offset = 0;
-                        }
+                        Core::ResourceMonitor::Instance().Register(*this);
+                        added = true;
                     }
                 }
+                else if (ioctl(_mux, DMX_ADD_PID, &pid) < 0) {
+                    TRACE_L1("Could not add PID [%d] to the stream filter: %d\n", pid, errno);
+                }
+                else {
+                    added = true;
+                }
+
+                if (added == true) {
+                    _pids++;
+                }
+
+                return (added);
+            }
+            void Remove(uint16_t pid) {
+                ASSERT (_pids > 0);
+
+                if (_pids == 1) {
+                    Core::ResourceMonitor::Instance().Unregister(*this);
+                    ioctl(_mux, DMX_STOP);
+                }
+                else if (ioctl(_mux, DMX_REMOVE_PID, &pid) < 0) {
+                    TRACE_L1("Could not remove PID [%d] from the stream filter: %d\n", pid, errno);
+                }
+
+                _pids--;
             }
 
         private:
-            bool LoadHeader() 
-            {
-                bool moreToLoad = true;
-                if (_offset < 3) {
-                    int loaded = ::read(_mux, &(_buffer[_offset]), (3 - _offset));
-                    if (loaded < 0) {
-                        int result = errno;
-                        if ((result != EAGAIN) || (result != EWOULDBLOCK)) {
-                            _offset = 0;
-                        }
-                        moreToLoad = false;
+            int _mux;
+            uint16_t _pids;
+            MPEG::Demux _demux;
+            uint8_t _buffer[ReadSize];
+        };
+
+        // Routes one PID of the program to a decoder (audio, video or PCR input) or, as transport
+        // stream, to the dvr device. Installed on Prepare(), started on Attach().
+        class PESFilter {
+        public:
+            PESFilter(const PESFilter&) = delete;
+            PESFilter& operator= (const PESFilter&) = delete;
+
+            PESFilter()
+                : _mux(-1)
+                , _pid(NO_PID)
+                , _started(false) {
+            }
+            ~PESFilter() {
+                Close();
+            }
+
+        public:
+            inline bool IsValid() const {
+                return (_mux != -1);
+            }
+            inline uint16_t Pid() const {
+                return (_pid);
+            }
+            uint32_t Open(const string& path, const uint8_t index, const uint16_t pid, const dmx_pes_type_t type, const dmx_output_t output) {
+                uint32_t result = Core::ERROR_NONE;
+
+                Close();
+
+                _mux = OpenDemux(path, index);
+
+                if (_mux == -1) {
+                    result = Core::ERROR_OPENING_FAILED;
+                } else {
+                    struct dmx_pes_filter_params pesFilterParams;
+
+                    ::memset(&pesFilterParams, 0, sizeof(pesFilterParams));
+                    pesFilterParams.pid = pid;
+                    pesFilterParams.input = DMX_IN_FRONTEND;
+                    pesFilterParams.output = output;
+                    pesFilterParams.pes_type = type;
+                    pesFilterParams.flags = 0;
+
+                    if (::ioctl(_mux, DMX_SET_PES_FILTER, &pesFilterParams) < 0) {
+                        TRACE_L1("Could not configure the PES filter[%d,%d]: %d\n", pid, type, errno);
+                        ::close(_mux);
+                        _mux = -1;
+                        result = Core::ERROR_GENERAL;
+                    } else {
+                        _pid = pid;
                     }
-                    else {
-                        _offset += loaded;
-                        if (_offset != 3) {
-                            moreToLoad = false;
-                        }
-                        else {
-                            _length = (_buffer[1] << 8) | (_buffer[2] & 0xFF);
-                            if ((_length + 3) > _size) {
-                                uint8_t copy = _buffer[0];
-                                ::free (_buffer);
-                                _size = _length + 3;
-                                _buffer = reinterpret_cast<uint8_t*>(::malloc(_size));
-                                _buffer[0] = copy;
-                                _buffer[1] = (_length >> 8) & 0xFF;
-                                _buffer[2] = _length & 0xFF;
-                            }
-                        }
+                }
+
+                return (result);
+            }
+            void Close() {
+                if (_mux != -1) {
+                    Stop();
+                    ::close(_mux);
+                    _mux = -1;
+                }
+                _pid = NO_PID;
+            }
+            // A restart of a running filter would interrupt the decoder, the streams that did
+            // not change on a PMT update keep running.
+            void Start() {
+                if ((_mux != -1) && (_started == false)) {
+                    if (::ioctl(_mux, DMX_START) < 0) {
+                        TRACE_L1("Could not start the PES filter[%d]: %d\n", _pid, errno);
+                    } else {
+                        _started = true;
                     }
                 }
-                return (moreToLoad);
             }
- 
+            void Stop() {
+                if (_started == true) {
+                    ::ioctl(_mux, DMX_STOP);
+                    _started = false;
+                }
+            }
 
         private:
             int _mux;
-            uint16_t _offset;
-            uint16_t _length;
-            uint16_t _size;
-            uint8_t* _buffer;
-            ISection* _callback;
+            uint16_t _pid;
+            bool _started;
+        };
+
+        // The first packet that starts a PES on the given PID, marks the end of a zap. Only the
+        // start is of interest, once seen, the filter is stopped, it is closed on the next zap.
+        class Probe : public Core::IResource {
+        public:
+            Probe() = delete;
+            Probe(const Probe&) = delete;
+            Probe& operator= (const Probe&) = delete;
+
+            Probe(Tuner& parent)
+                : _parent(parent)
+                , _mux(-1) {
+            }
+            ~Probe() {
+                Close();
+            }
+
+        public:
+            void Open(const string& path, const uint8_t index, const uint16_t pid) {
+                struct dmx_pes_filter_params pesFilterParams;
+
+                Close();
+
+                _mux = OpenDemux(path, index);
+
+                ::memset(&pesFilterParams, 0, sizeof(pesFilterParams));
+                pesFilterParams.pid = pid;
+                pesFilterParams.input = DMX_IN_FRONTEND;
+                pesFilterParams.output = DMX_OUT_TSDEMUX_TAP;
+                pesFilterParams.pes_type = DMX_PES_OTHER;
+                pesFilterParams.flags = DMX_IMMEDIATE_START;
+
+                if ((_mux != -1) && (::ioctl(_mux, DMX_SET_PES_FILTER, &pesFilterParams) < 0)) {
+                    TRACE_L1("Could not configure the PES probe[%d]: %d\n", pid, errno);
+                    ::close(_mux);
+                    _mux = -1;
+                }
+
+                if (_mux != -1) {
+                    Core::ResourceMonitor::Instance().Register(*this);
+                }
+            }
+            void Close() {
+                if (_mux != -1) {
+                    Core::ResourceMonitor::Instance().Unregister(*this);
+                    ::close(_mux);
+                    _mux = -1;
+                }
+            }
+            handle Descriptor() const override {
+                return (_mux);
+            }
+            uint16_t Events() override {
+                return (POLLIN);
+            }
+            void Handle(const uint16_t events VARIABLE_IS_NOT_USED) override {
+                uint8_t packets[MPEG::Demux::PACKET_SIZE * 8];
+                int loaded = ::read(_mux, packets, sizeof(packets));
+                bool started = false;
+
+                for (int offset = 0; (started == false) && ((offset + MPEG::Demux::PACKET_SIZE) <= loaded); offset += MPEG::Demux::PACKET_SIZE) {
+                    // payload_unit_start_indicator
+                    started = ((packets[offset] == 0x47) && ((packets[offset + 1] & 0x40) != 0));
+                }
+
+                if (started == true) {
+                    ::ioctl(_mux, DMX_STOP);
+                    _parent.Started();
+                }
+            }
+
+        private:
+            Tuner& _parent;
+            int _mux;
+        };
+
+        // The PAT/PMT sections are loaded into the ProgramTable, on the way the stages of the
+        // zap they complete are registered. The sections are handled on the monitor thread,
+        // while the tuner (lock taken) might be waiting for that to end in Filter(). So what
+        // needs the tuner lock, the PMT PIDs to filter and the tables loaded, is collected
+        // here and handed to the tuner on a worker thread.
+        class PSI : public ISection, private Core::WorkerPool::JobType<PSI&> {
+            friend class Core::ThreadPool::JobType<PSI&>;
+
+        public:
+            // Additional PMT PIDs to filter (true) or not anymore (false), in order.
+            typedef std::vector<std::pair<uint16_t, bool>> PIDs;
+
+            PSI() = delete;
+            PSI(const PSI&) = delete;
+            PSI& operator= (const PSI&) = delete;
+
+            PSI(Tuner& parent)
+                : Core::WorkerPool::JobType<PSI&>(*this)
+                , _parent(parent)
+                , _observer(nullptr)
+                , _lock()
+                , _pid(NO_PID)
+                , _moved(false)
+                , _pids()
+                , _pat(0)
+                , _pmt(false) {
+            }
+            ~PSI() override {
+                JobType::Revoke();
+            }
+
+        public:
+            inline ISection* Observer() const {
+                return (_observer);
+            }
+            inline void Observer(ISection* observer) {
+                _observer = observer;
+            }
+            void Handle(const MPEG::Section& section) override {
+                if (_observer != nullptr) {
+                    // Might move the PMT PID, through ChangePid().
+                    _observer->Handle(section);
+                }
+
+                _lock.Lock();
+                if (section.TableId() == MPEG::PAT::ID) {
+                    if (_pat == 0) {
+                        _pat = Core::Time::Now().Ticks();
+                    }
+                } else if (section.TableId() == MPEG::PMT::ID) {
+                    _pmt = true;
+                }
+                _lock.Unlock();
+
+                JobType::Submit();
+            }
+            void ChangePid(const uint16_t pid) {
+                _lock.Lock();
+                _pid = pid;
+                _moved = true;
+                _lock.Unlock();
+
+                JobType::Submit();
+            }
+            void AddPid(const uint16_t pid) {
+                _lock.Lock();
+                _pids.emplace_back(pid, true);
+                _lock.Unlock();
+
+                JobType::Submit();
+            }
+            void RemovePid(const uint16_t pid) {
+                _lock.Lock();
+                _pids.emplace_back(pid, false);
+                _lock.Unlock();
+
+                JobType::Submit();
+            }
+            // PIDs added, of which the filter is not opened yet.
+            uint8_t Adding() const {
+                _lock.Lock();
+                uint8_t result = static_cast<uint8_t>(std::count_if(_pids.begin(), _pids.end(), [](const std::pair<uint16_t, bool>& entry) { return (entry.second == true); }));
+                _lock.Unlock();
+
+                return (result);
+            }
+            // Whatever was collected, for the tuner to process. Returns false if there is nothing.
+            bool Collect(bool& moved, uint16_t& pid, PIDs& pids, uint64_t& pat, bool& pmt) {
+                _lock.Lock();
+
+                moved = _moved;
+                pid = _pid;
+                pat = _pat;
+                pmt = _pmt;
+                pids.swap(_pids);
+
+                _moved = false;
+                _pat = 0;
+                _pmt = false;
+                _pids.clear();
+
+                _lock.Unlock();
+
+                return ((moved == true) || (pids.empty() == false) || (pat != 0) || (pmt == true));
+            }
+            // The filters are gone, nothing is collected anymore, drop what is pending.
+            void Clear() {
+                JobType::Revoke();
+
+                _lock.Lock();
+                _pid = NO_PID;
+                _moved = false;
+                _pids.clear();
+                _pat = 0;
+                _pmt = false;
+                _lock.Unlock();
+            }
+
+        private:
+            void Dispatch() {
+                _parent.Loaded();
+            }
+
+        private:
+            Tuner& _parent;
+            ISection* _observer;
+            mutable Core::CriticalSection _lock;
+            uint16_t _pid;
+            bool _moved;
+            PIDs _pids;
+            uint64_t _pat;
+            bool _pmt;
         };
 
     public:
@@ -366,12 +920,14 @@ static constexpr conversion_entry _tableRollOff[] = {
             public:
                 Config()
                     : Core::JSON::Container()
-                    , Frontends(1)
+                    , Frontends(0)
                     , Decoders(1)
                     , Standard(ITuner::DVB)
                     , Annex(ITuner::A)
                     , Modus(ITuner::Terrestrial)
                     , Scan(false)
+                    , SoftwareDemux(false)
+                    , SectionFilters(0)
                     , Callsign("Streamer")
                 {
                     Add(_T("frontends"), &Frontends);
@@ -380,6 +936,8 @@ static constexpr conversion_entry _tableRollOff[] = {
                     Add(_T("annex"), &Annex);
                     Add(_T("modus"), &Modus); 
                     Add(_T("scan"), &Scan);
+                    Add(_T("softwaredemux"), &SoftwareDemux);
+                    Add(_T("sectionfilters"), &SectionFilters);
                     Add(_T("callsign"), &Callsign);
                 }
                 ~Config()
@@ -387,22 +945,36 @@ static constexpr conversion_entry _tableRollOff[] = {
                 }
 
             public:
+                // The maximum number of frontends to use, 0 uses all that support the configured system.
                 Core::JSON::DecUInt8 Frontends;
+                // The decoders behind the frontends, 0 sends the programs to the dvr device.
                 Core::JSON::DecUInt8 Decoders;
                 Core::JSON::EnumType<ITuner::DTVStandard> Standard;
                 Core::JSON::EnumType<ITuner::annex> Annex;
                 Core::JSON::EnumType<ITuner::modus> Modus; 
                 Core::JSON::Boolean Scan;
+                Core::JSON::Boolean SoftwareDemux;
+                // Hardware section filters per adapter, 0 if the driver is the only limit.
+                Core::JSON::DecUInt8 SectionFilters;
                 Core::JSON::String Callsign;
             };
 
+            // Frontends in use: adapter (8 bits) and frontend (8 bits).
+            typedef std::vector<uint16_t> Devices;
+
             Information()
                 : _frontends(0)
+                , _decoders(0)
+                , _devices()
                 , _standard()
                 , _annex()
                 , _modus()
                 , _type(SYS_UNDEFINED)
                 , _scan(false)
+                , _softwareDemux(false)
+                , _sectionFilters(0)
+                , _adminLock()
+                , _filters()
             {
             }
 
@@ -421,24 +993,52 @@ static constexpr conversion_entry _tableRollOff[] = {
                 config.FromString(configuration);
 
                 _frontends = config.Frontends.Value();
+                _decoders = config.Decoders.Value();
                 _standard = config.Standard.Value();
                 _annex = config.Annex.Value();
                 _scan = config.Scan.Value();
+                _softwareDemux = config.SoftwareDemux.Value();
+                _sectionFilters = config.SectionFilters.Value();
                 _modus = config.Modus.Value();
 
                 _type = Convert(_tableSystemType, _standard | _modus | _annex, SYS_UNDEFINED);
 
                 ASSERT(_type != SYS_UNDEFINED);
 
+                ProgramTable::Instance().Concurrency(((_sectionFilters == 0) || (_softwareDemux == true)) ? PMT_FILTERS : std::min(static_cast<uint8_t>(_sectionFilters / 2), PMT_FILTERS));
+
+                Enumerate();
             }
             void Deinitialize()
             {
+                _devices.clear();
             }
 
         public:
             inline bool IsSupported(const ITuner::modus mode)
             {
-                return ((_type != SYS_UNDEFINED) && (mode == _modus));
+                return ((_type != SYS_UNDEFINED) && (mode == _modus) && (_devices.empty() == false));
+            }
+            inline uint8_t Frontends() const
+            {
+                return (static_cast<uint8_t>(_devices.size()));
+            }
+            // Returns false if there is no such frontend.
+            bool Frontend(const uint8_t index, uint8_t& adapter, uint8_t& frontend) const
+            {
+                bool result = (index < _devices.size());
+
+                if (result == true) {
+                    adapter = (_devices[index] >> 8);
+                    frontend = (_devices[index] & 0xFF);
+                }
+
+                return (result);
+            }
+            // 0 if the programs go to the dvr device.
+            inline uint8_t Decoders() const
+            {
+                return (_decoders);
             }
             inline ITuner::DTVStandard Standard() const
             {
@@ -460,14 +1060,152 @@ static constexpr conversion_entry _tableRollOff[] = {
             {
                 return (_scan);
             }
+            inline bool SoftwareDemux() const
+            {
+                return (_softwareDemux);
+            }
+            // The section filters of an adapter are shared by all its frontends.
+            bool AcquireFilter(const uint8_t adapter)
+            {
+                _adminLock.Lock();
+
+                uint8_t& used(_filters[adapter]);
+                bool result = ((_sectionFilters == 0) || (used < _sectionFilters));
+
+                if (result == true) {
+                    used++;
+                }
+
+                _adminLock.Unlock();
+
+                return (result);
+            }
+            // Section filters left on the adapter, 0xFF if there is no limit.
+            uint8_t Available(const uint8_t adapter)
+            {
+                uint8_t result = 0xFF;
+
+                _adminLock.Lock();
+
+                if ((_sectionFilters != 0) && (_softwareDemux == false)) {
+                    const uint8_t used(_filters[adapter]);
+                    result = (used < _sectionFilters ? (_sectionFilters - used) : 0);
+                }
+
+                _adminLock.Unlock();
+
+                return (result);
+            }
+            void ReleaseFilter(const uint8_t adapter)
+            {
+                _adminLock.Lock();
+
+                ASSERT(_filters[adapter] > 0);
+
+                _filters[adapter]--;
+
+                _adminLock.Unlock();
+            }
+
+        private:
+            // All /dev/dvb/adapter<n>/frontend<m> that can do the configured delivery system,
+            // ordered on adapter and frontend, so the indexes are stable over restarts.
+            void Enumerate()
+            {
+                DIR* dvb = ::opendir("/dev/dvb");
+
+                _devices.clear();
+
+                if (dvb != nullptr) {
+                    struct dirent* entry;
+
+                    while ((entry = ::readdir(dvb)) != nullptr) {
+                        unsigned int adapter;
+
+                        if ((::sscanf(entry->d_name, "adapter%u", &adapter) == 1) && (adapter <= 0xFF)) {
+                            Enumerate(static_cast<uint8_t>(adapter));
+                        }
+                    }
+
+                    ::closedir(dvb);
+                }
+
+                std::sort(_devices.begin(), _devices.end());
+
+                if ((_frontends != 0) && (_devices.size() > _frontends)) {
+                    _devices.resize(_frontends);
+                }
+
+                TRACE_L1("Found %d frontends supporting delivery system %d", static_cast<uint32_t>(_devices.size()), _type);
+            }
+            void Enumerate(const uint8_t adapter)
+            {
+                char path[32];
+                ::snprintf(path, sizeof(path), "/dev/dvb/adapter%d", adapter);
+
+                DIR* directory = ::opendir(path);
+
+                if (directory != nullptr) {
+                    struct dirent* entry;
+
+                    while ((entry = ::readdir(directory)) != nullptr) {
+                        unsigned int frontend;
+
+                        if ((::sscanf(entry->d_name, "frontend%u", &frontend) == 1) && (frontend <= 0xFF) && (Supports(adapter, static_cast<uint8_t>(frontend)) == true)) {
+                            _devices.push_back((adapter << 8) | frontend);
+                        }
+                    }
+
+                    ::closedir(directory);
+                }
+            }
+            bool Supports(const uint8_t adapter, const uint8_t frontend) const
+            {
+                char deviceName[48];
+                bool result = false;
+
+                ::snprintf(deviceName, sizeof(deviceName), "/dev/dvb/adapter%d/frontend%d", adapter, frontend);
+
+                // Read only, it may be in use by someone else, the info is still available.
+                int device = open(deviceName, O_RDONLY | O_NONBLOCK);
+
+                if (device != -1) {
+                    struct dtv_property property;
+                    struct dtv_properties properties;
+
+                    ::memset(&property, 0, sizeof(property));
+                    property.cmd = DTV_ENUM_DELSYS;
+                    properties.num = 1;
+                    properties.props = &property;
+
+                    if (::ioctl(device, FE_GET_PROPERTY, &properties) == -1) {
+                        // Can not tell, let the tune find out.
+                        result = true;
+                    } else {
+                        for (uint32_t index = 0; (index < property.u.buffer.len) && (result == false); index++) {
+                            result = (property.u.buffer.data[index] == _type);
+                        }
+                    }
+
+                    close(device);
+                }
+
+                return (result);
+            }
 
         private:
             uint8_t _frontends;
+            uint8_t _decoders;
+            Devices _devices;
             ITuner::DTVStandard _standard;
             ITuner::annex _annex;
             ITuner::modus _modus;
             int _type;
             bool _scan;
+            bool _softwareDemux;
+            uint8_t _sectionFilters;
+            Core::CriticalSection _adminLock;
+            std::map<uint8_t, uint8_t> _filters;
 
             static Information _instance;
         };
@@ -476,30 +1214,48 @@ static constexpr conversion_entry _tableRollOff[] = {
 PUSH_WARNING(DISABLE_WARNING_MISSING_FIELD_INITIALIZERS)
         Tuner(uint8_t index, Broadcast::transmission transmission = Broadcast::TRANSMISSION_AUTO, Broadcast::guard guard = Broadcast::GUARD_AUTO, Broadcast::hierarchy hierarchy = Broadcast::AutoHierarchy)
             : _state(IDLE)
-            , _frontend()
+            , _frontend(-1)
             , _transmission()
             , _guard()
             , _hierarchy()
             , _info({ 0 })
+            , _filters()
+            , _dispatch()
+            , _retired()
             , _devicePath()
+            , _adapter(0)
             , _frontindex(0)
+            , _stream(nullptr)
+            , _events(*this)
             , _callback(nullptr)
+            , _frequency(0)
+            , _programId(NO_PROGRAM)
+            , _pmt()
+            , _streams()
+            , _decoder(NO_DECODER)
+            , _psi(*this)
+            , _pmtPid(NO_PID)
+            , _pmtPids()
+            , _probe(*this)
+            , _timeline({ 0 })
         {
 POP_WARNING()
             _callback = TunerAdministrator::Instance().Announce(this);
             if (Tuner::Information::Instance().Type() != SYS_UNDEFINED) {
                 char deviceName[32];
 
-                uint16_t info = IndexToFrontend(index);
-                _frontindex = (info & 0xFF);
+                if (Tuner::Information::Instance().Frontend(index, _adapter, _frontindex) == false) {
+                    TRACE_L1("There is no frontend %d.", index);
+                } else {
+                    ::snprintf(deviceName, sizeof(deviceName), "/dev/dvb/adapter%d/", _adapter);
 
-                ::snprintf(deviceName, sizeof(deviceName), "/dev/dvb/adapter%d/", (info >> 8));
+                    _devicePath = deviceName;
 
-                _devicePath = deviceName;
-              
-                ::snprintf(&(deviceName[_devicePath.length()]), (sizeof(deviceName) - _devicePath.length()), "frontend%d", _frontindex);
+                    ::snprintf(&(deviceName[_devicePath.length()]), (sizeof(deviceName) - _devicePath.length()), "frontend%d", _frontindex);
 
-                _frontend = open(deviceName, O_RDWR);
+                    // Non blocking, so all queued frontend events can be drained on a wakeup.
+                    _frontend = open(deviceName, O_RDWR | O_NONBLOCK);
+                }
 
                 if (_frontend != -1) {
                     if (::ioctl(_frontend, FE_GET_INFO, &_info) == -1) {
@@ -507,8 +1263,11 @@ POP_WARNING()
                         close(_frontend);
                         _frontend = -1;
                     }
-                    TRACE_L1("Opened frontend %s. Second Generation Support: %s", _info.name, (IsSecondGeneration() ? _T("true") : _T("false")));
-                    TRACE_L1("Support auto FEC: %s", (HasAutoFEC() ? _T("true") : _T("false")));
+                    else {
+                        TRACE_L1("Opened frontend %s. Second Generation Support: %s", _info.name, (IsSecondGeneration() ? _T("true") : _T("false")));
+                        TRACE_L1("Support auto FEC: %s", (HasAutoFEC() ? _T("true") : _T("false")));
+                        _events.Register();
+                    }
                 } else {
                     TRACE_L1("Can not open frontend %s error: %d.", deviceName, errno);
                 }
@@ -516,6 +1275,15 @@ POP_WARNING()
                 _transmission = Convert(_tableTransmission, transmission, TRANSMISSION_MODE_AUTO);
                 _guard = Convert(_tableGuard, guard, GUARD_INTERVAL_AUTO);
                 _hierarchy = Convert(_tableHierarchy, hierarchy, HIERARCHY_AUTO);                
+
+                if ((_frontend != -1) && (Tuner::Information::Instance().SoftwareDemux() == true)) {
+                    _stream = new StreamFilter(_devicePath, _frontindex);
+
+                    if (_stream->IsValid() == false) {
+                        delete _stream;
+                        _stream = nullptr;
+                    }
+                }
             }
         }
 
@@ -524,15 +1292,29 @@ POP_WARNING()
         {
             TunerAdministrator::Instance().Revoke(this);
 
-            Observer::Instance().Unregister(*this);
+            _events.Unregister();
+
+            // Revoked, nobody is to be notified of the changes from here on.
+            _callback = nullptr;
+
+            Close();
+
+            _state.Lock();
+            for (std::pair<const uint16_t, MuxFilter*>& entry : _filters) {
+                delete entry.second;
+                Information::Instance().ReleaseFilter(_adapter);
+            }
+            _filters.clear();
+            _state.Unlock();
 
-            Detach(0);
+            if (_stream != nullptr) {
+                delete _stream;
+                _stream = nullptr;
+            }
 
             if (_frontend != -1) {
                 close(_frontend);
             }
-
-            _callback = nullptr;
         }
 
         static ITuner* Create(const string& info)
@@ -570,15 +1352,7 @@ POP_WARNING()
         virtual uint32_t Properties() const override
         {
             Information& instance = Information::Instance();
-            return (instance.Annex() | instance.Standard() |
-            #ifdef SATELITE
-            ITuner::modus::Satellite 
-            #else
-            ITuner::modus::Terrestrial
-            #endif
-            );
-
-            // ITuner::modus::Cable
+            return (instance.Annex() | instance.Standard() | instance.Modus());
         }
 
         // Currently locked on ID
@@ -586,7 +1360,7 @@ POP_WARNING()
         // identify the uniquely locked on to Tune request. ID => 0 is reserved and means not locked on to anything.
         virtual uint16_t Id() const override
         {
-            return 0; //(_state == IDLE ? 0 : _settings.frequency / 1000000);
+            return (_state == IDLE ? 0 : _frequency);
         }
 
         // Using these methods the state of the tuner can be viewed.
@@ -632,7 +1406,23 @@ POP_WARNING()
             dtv_prop.num = propertyCount;
             dtv_prop.props = props;
 
-            _state = IDLE;
+            // The program and the PSI of the previous transport stream are gone with it.
+            Close();
+
+            _state.Lock();
+            _frequency = frequency;
+            _timeline = Timeline();
+            _timeline.Tune = Core::Time::Now().Ticks();
+            _state.Unlock();
+
+            if (_state != IDLE) {
+                // Whatever was parsed on the previous transport stream is no longer relevant.
+                _state = IDLE;
+
+                if (_callback != nullptr) {
+                    _callback->StateChange(this);
+                }
+            }
 
             if (ioctl(_frontend, FE_SET_PROPERTY, &dtv_prop) < 0) {
                 perror("ioctl");
@@ -655,7 +1445,6 @@ POP_WARNING()
                 }
                 _lastState = 0;
                 #endif
-                Observer::Instance().Register(*this);
             }
 
             return (Core::ERROR_NONE);
@@ -663,10 +1452,45 @@ POP_WARNING()
 
         // In case the tuner needs to be tuned to a specific programId, please list it here. Once the PID's associated to this
         // programId have been found, and set, the Tuner will reach its PREPARED state.
-        virtual uint32_t Prepare(const uint16_t programId VARIABLE_IS_NOT_USED) override
+        // The PMT is taken from the ProgramTable, if it is not loaded yet, the tuner gets PREPARED the moment it is.
+        virtual uint32_t Prepare(const uint16_t programId) override
         {
-            TRACE_L1("%s:%d %s", __FILE__, __LINE__, __FUNCTION__);
-            return 0;
+            uint32_t result = Core::ERROR_NONE;
+            bool changed = false;
+
+            _state.Lock();
+
+            if ((_frequency == 0) || (programId == NO_PROGRAM)) {
+                result = Core::ERROR_ILLEGAL_STATE;
+            } else if (programId != _programId) {
+                if (_timeline.PMT != 0) {
+                    // Another program on the same transport stream, a zap of its own.
+                    _timeline = Timeline();
+                }
+                _timeline.Prepare = Core::Time::Now().Ticks();
+                _timeline.PMT = 0;
+                _timeline.PES = 0;
+
+                _programId = programId;
+                _pmt = MPEG::PMT();
+
+                // If it is not loaded (yet), the previous program is no longer fed meanwhile.
+                ProgramTable::Instance().Program(_frequency, _programId, _pmt);
+
+                changed = Select();
+
+                if (_state != PREPARED) {
+                    result = Core::ERROR_INPROGRESS;
+                }
+            }
+
+            _state.Unlock();
+
+            if ((changed == true) && (_callback != nullptr)) {
+                _callback->StateChange(this);
+            }
+
+            return (result);
         }
 
         // A Tuner can be used to filter PSI/SI. Using the next call a callback can be installed to receive sections associated
@@ -674,46 +1498,132 @@ POP_WARNING()
         // to process.
         virtual uint32_t Filter(const uint16_t pid, const uint8_t tableId, ISection* callback) override
         {
-            uint32_t result = Core::ERROR_UNAVAILABLE; 
-            uint32_t id = (pid << 16) | tableId; 
- 
             _state.Lock();
 
-            if (callback != nullptr) { 
-                auto entry = _filters.emplace(
-                                 std::piecewise_construct, 
-                                 std::forward_as_tuple(id), 
-                                 std::forward_as_tuple(_devicePath, _frontindex, pid, tableId, callback)); 
+            uint32_t result = Install(pid, tableId, callback);
 
-                if (entry.first->second.IsValid() == true) {
-                    result = Core::ERROR_NONE;
+            _state.Unlock();
+
+            if (callback == nullptr) {
+                Drain();
+            }
+
+            return (result);
+        }
+        // Using the next two methods, the frontends will be hooked up to decoders or file, and be removed from a decoder or file.
+        // Without decoders (configured 0) the program goes as transport stream to the dvr device, the index is not used.
+        virtual uint32_t Attach(const uint8_t index) override
+        {
+            uint32_t result = Core::ERROR_NONE;
+            const uint8_t decoders = Information::Instance().Decoders();
+            const uint8_t decoder = (decoders == 0 ? 0 : index);
+            bool changed = false;
+
+            _state.Lock();
+
+            // The decoder PES types (DMX_PES_VIDEO0..3 etc.) go up to 4 decoders.
+            if ((decoders != 0) && ((index >= decoders) || (index > 3))) {
+                result = Core::ERROR_UNAVAILABLE;
+            } else if ((_decoder != NO_DECODER) && (_decoder != decoder)) {
+                result = Core::ERROR_ALREADY_CONNECTED;
+            } else if (_decoder == NO_DECODER) {
+                state previous = _state;
+
+                _decoder = decoder;
+
+                if (decoder != 0) {
+                    // Prepared for decoder 0, other decoders take other PES types.
+                    for (PESFilter& entry : _streams) {
+                        entry.Close();
+                    }
                 }
-                else {
-                    _filters.erase(entry.first);
-                    result =  Core::ERROR_GENERAL;
+
+                if (_pmt.IsValid() == true) {
+                    Install();
+                    Stream();
                 }
-            } else { 
-                std::map<uint32_t, MuxFilter>::iterator index(_filters.find(id)); 
-                if (index != _filters.end()) { 
-                    _filters.erase(index); 
-                    result = Core::ERROR_NONE; 
-                } 
-            } 
+
+                changed = (previous != _state);
+            }
 
             _state.Unlock();
 
-            return (result); 
-        } 
-        // Using the next two methods, the frontends will be hooked up to decoders or file, and be removed from a decoder or file.
-        virtual uint32_t Attach(const uint8_t index VARIABLE_IS_NOT_USED) override
+            if ((changed == true) && (_callback != nullptr)) {
+                _callback->StateChange(this);
+            }
+
+            return (result);
+        }
+        virtual uint32_t Detach(const uint8_t index) override
+        {
+            uint32_t result = Core::ERROR_NONE;
+            bool changed = false;
+
+            _state.Lock();
+
+            if (_decoder == NO_DECODER) {
+                result = Core::ERROR_ALREADY_RELEASED;
+            } else if ((_decoder != index) && (Information::Instance().Decoders() != 0)) {
+                result = Core::ERROR_UNAVAILABLE;
+            } else {
+                _decoder = NO_DECODER;
+
+                for (PESFilter& entry : _streams) {
+                    entry.Stop();
+                }
+                _probe.Close();
+
+                if (_state == STREAMING) {
+                    _state = PREPARED;
+                    changed = true;
+                }
+            }
+
+            _state.Unlock();
+
+            if ((changed == true) && (_callback != nullptr)) {
+                _callback->StateChange(this);
+            }
+
+            return (result);
+        }
+
+        // The stages of the last zap.
+        virtual uint32_t Timing(Timeline& timeline) const override
+        {
+            _state.Lock();
+            timeline = _timeline;
+            _state.Unlock();
+
+            return (Core::ERROR_NONE);
+        }
+
+        // IMonitor, the ProgramTable walks the PMT's of the PAT, next to the PID it moves the
+        // monitor to, it adds PIDs for as long as there are section filters left. These are
+        // called while a section is handled, the filters are changed later on, in Loaded().
+        void ChangePid(const uint16_t newpid, ISection* observer) override
         {
-            TRACE_L1("%s:%d %s\n", __FILE__, __LINE__, __FUNCTION__);
-            return 0;
+            ASSERT((observer == nullptr) || (observer == _psi.Observer()));
+
+            _psi.ChangePid(newpid);
+        }
+        uint32_t AddPid(const uint16_t pid, ISection* observer) override
+        {
+            uint32_t result = Core::ERROR_UNAVAILABLE;
+
+            ASSERT(observer == _psi.Observer());
+
+            // The PIDs added of which the filter is not opened yet, have a filter already.
+            if (Information::Instance().Available(_adapter) > _psi.Adding()) {
+                _psi.AddPid(pid);
+                result = Core::ERROR_NONE;
+            }
+
+            return (result);
         }
-        virtual uint32_t Detach(const uint8_t index VARIABLE_IS_NOT_USED) override
+        void RemovePid(const uint16_t pid) override
         {
-            TRACE_L1("%s:%d %s\n", __FILE__, __LINE__, __FUNCTION__);
-            return 0;
+            _psi.RemovePid(pid);
         }
 
     private:
@@ -723,9 +1633,10 @@ POP_WARNING()
         void Unlock() {
             _state.Unlock();
         }
-        bool Dispatch() {
-            bool remove = false;
-            unsigned int status;
+        void Dispatch() {
+            struct dvb_frontend_event event;
+            state previous = _state;
+            state current = previous;
 
             // IDLE = 0x01,
             //   FE_TIMEDOUT No lock within the last about 2 seconds.
@@ -739,20 +1650,21 @@ POP_WARNING()
             // PREPARED = 0x04,
             // STREAMING = 0x08
 
-            if (::ioctl(_frontend, FE_READ_STATUS, &status) < 0) {
-                TRACE_L1("Status could not be read!. Error: %d", errno);
-            }
-            else {
+            // Drain all queued events, only the last status counts.
+            while (::ioctl(_frontend, FE_GET_EVENT, &event) == 0) {
+                unsigned int status = event.status;
+
                 TRACE_L1("FE_HAS_LOCK: %s", status & FE_HAS_LOCK ? _T("true") : _T("false"));
                 TRACE_L1("FE_TIMEDOUT: %s", status & FE_TIMEDOUT ? _T("true") : _T("false"));
 
                 if ((status & FE_HAS_LOCK) != 0) {
-                    remove = true;
-                    _state = ITuner::LOCKED;
+                    if (current == ITuner::IDLE) {
+                        current = ITuner::LOCKED;
+                    }
                 }
-                else if ((status & FE_TIMEDOUT) != 0) {
-                    _state = ITuner::IDLE;
-                    remove = true;
+                else if (((status & FE_TIMEDOUT) != 0) || (current != ITuner::IDLE)) {
+                    // Could not lock, or lost the lock.
+                    current = ITuner::IDLE;
                 }
 
                 #ifdef __DEBUG__
@@ -760,8 +1672,6 @@ POP_WARNING()
                     uint16_t snr, signal;
                     uint32_t ber, uncorrected_blocks;
 
-                    TRACE_L1("Signal,SNR,BER,UNC,Status: %d,%d,%d,%d,%d", signal, snr, ber, uncorrected_blocks, status);
-
                     if (::ioctl(_frontend, FE_READ_SIGNAL_STRENGTH, &signal) < 0) {
                         signal = ~0;
                     }
@@ -775,20 +1685,365 @@ POP_WARNING()
                         uncorrected_blocks = ~0;
                     }
 
-                    unsigned int delta = _lastState ^ status;
-                    if (delta & FE_HAS_SIGNAL)  { TRACE_L1 ("FE_HAS_SIGNAL:  %s", status & FE_HAS_SIGNAL  ? _T("true") : _T("false")); }
-                    if (delta & FE_HAS_CARRIER) { TRACE_L1 ("FE_HAS_CARRIER: %s", status & FE_HAS_CARRIER ? _T("true") : _T("false")); }
-                    if (delta & FE_HAS_VITERBI) { TRACE_L1 ("FE_HAS_VITERBI: %s", status & FE_HAS_VITERBI ? _T("true") : _T("false")); }
-                    if (delta & FE_HAS_SYNC)    { TRACE_L1 ("FE_HAS_SYNC:    %s", status & FE_HAS_SYNC    ? _T("true") : _T("false")); }
-                    if (delta & FE_TIMEDOUT)    { TRACE_L1 ("FE_TIMEDOUT:    %s", status & FE_TIMEDOUT    ? _T("true") : _T("false")); }
-                    if (delta & FE_REINIT)      { TRACE_L1 ("FE_REINIT:      %s", status & FE_REINIT      ? _T("true") : _T("false")); }
-                    if (delta & FE_HAS_LOCK)    { TRACE_L1 ("FE_HAS_LOCK:    %s", status & FE_HAS_LOCK    ? _T("true") : _T("false")); }
-                    _lastState = status;
+                    TRACE_L1("Signal,SNR,BER,UNC,Status: %d,%d,%d,%d,%d", signal, snr, ber, uncorrected_blocks, status);
                 }
+
+                unsigned int delta = _lastState ^ status;
+                if (delta & FE_HAS_SIGNAL)  { TRACE_L1 ("FE_HAS_SIGNAL:  %s", status & FE_HAS_SIGNAL  ? _T("true") : _T("false")); }
+                if (delta & FE_HAS_CARRIER) { TRACE_L1 ("FE_HAS_CARRIER: %s", status & FE_HAS_CARRIER ? _T("true") : _T("false")); }
+                if (delta & FE_HAS_VITERBI) { TRACE_L1 ("FE_HAS_VITERBI: %s", status & FE_HAS_VITERBI ? _T("true") : _T("false")); }
+                if (delta & FE_HAS_SYNC)    { TRACE_L1 ("FE_HAS_SYNC:    %s", status & FE_HAS_SYNC    ? _T("true") : _T("false")); }
+                if (delta & FE_TIMEDOUT)    { TRACE_L1 ("FE_TIMEDOUT:    %s", status & FE_TIMEDOUT    ? _T("true") : _T("false")); }
+                if (delta & FE_REINIT)      { TRACE_L1 ("FE_REINIT:      %s", status & FE_REINIT      ? _T("true") : _T("false")); }
+                if (delta & FE_HAS_LOCK)    { TRACE_L1 ("FE_HAS_LOCK:    %s", status & FE_HAS_LOCK    ? _T("true") : _T("false")); }
+                _lastState = status;
                 #endif
             }
 
-            return (remove);
+            if ((errno != EWOULDBLOCK) && (errno != EAGAIN)) {
+                TRACE_L1("Frontend event could not be read!. Error: %d", errno);
+            }
+
+            if ((current == ITuner::LOCKED) && (previous == ITuner::IDLE)) {
+                current = Locked();
+            }
+
+            if (current != previous) {
+                _state = current;
+
+                if (_callback != nullptr) {
+                    _callback->StateChange(this);
+                }
+            }
+        }
+
+        // Returns the state the tuner is in now it is locked, a program might be waiting for it.
+        state Locked()
+        {
+            _state.Lock();
+
+            if (_timeline.Lock == 0) {
+                _timeline.Lock = Core::Time::Now().Ticks();
+            }
+
+            state result = ITuner::LOCKED;
+
+            if (_pmt.IsValid() == true) {
+                result = ITuner::PREPARED;
+
+                if (_decoder != NO_DECODER) {
+                    Stream();
+                    result = ITuner::STREAMING;
+                }
+            }
+
+            _state.Unlock();
+
+            // The PAT/PMT's of the transport stream are loaded through the ProgramTable, like any broadcast tuner.
+            if (_psi.Observer() == nullptr) {
+                _psi.Observer(ProgramTable::Instance().Register(this, _frequency));
+                Filter(0x00, MPEG::PAT::ID, &_psi);
+            }
+
+            return (result);
+        }
+        // With the lock taken, installs or removes a section callback. A removed callback might still
+        // be handling a section, on the monitor thread, and might need the lock for it. Drain() waits
+        // for it, once the lock is released. A filter left without callbacks is deleted there as well.
+        uint32_t Install(const uint16_t pid, const uint8_t tableId, ISection* callback)
+        {
+            uint32_t result = Core::ERROR_UNAVAILABLE;
+
+            std::map<uint16_t, MuxFilter*>::iterator index(_filters.find(pid));
+
+            if ((_stream != nullptr) && (Information::Instance().SoftwareDemux() == true)) {
+                // All PIDs are read as one transport stream, sections are assembled in user space.
+                result = _stream->Filter(pid, tableId, callback);
+            } else if (index != _filters.end()) {
+                result = index->second->Filter(tableId, callback);
+
+                if (index->second->IsEmpty() == true) {
+                    _retired.push_back(index->second);
+                    _filters.erase(index);
+                }
+            } else if ((_stream != nullptr) && (_stream->IsActive(pid) == true)) {
+                result = _stream->Filter(pid, tableId, callback);
+            } else if (callback != nullptr) {
+                if (Information::Instance().AcquireFilter(_adapter) == true) {
+                    MuxFilter* filter = new MuxFilter(_devicePath, _frontindex, pid, _dispatch);
+
+                    if ((filter->IsValid() == true) && (filter->Filter(tableId, callback) == Core::ERROR_NONE)) {
+                        _filters.emplace(pid, filter);
+                        result = Core::ERROR_NONE;
+                    } else {
+                        delete filter;
+                        Information::Instance().ReleaseFilter(_adapter);
+                    }
+                }
+
+                if (result != Core::ERROR_NONE) {
+                    // Out of section filters, take the PID in through a single TS filter and
+                    // assemble its sections in user space.
+                    if (_stream == nullptr) {
+                        _stream = new StreamFilter(_devicePath, _frontindex);
+
+                        if (_stream->IsValid() == false) {
+                            delete _stream;
+                            _stream = nullptr;
+                        }
+                    }
+
+                    if (_stream == nullptr) {
+                        result = Core::ERROR_GENERAL;
+                    } else {
+                        result = _stream->Filter(pid, tableId, callback);
+                    }
+
+                    TRACE_L1("Section filter [%d,%d] handled in software: %d", pid, tableId, result);
+                }
+            }
+
+            return (result);
+        }
+        // Without the lock, waits for the callbacks removed with it taken, they might be handling a
+        // section right now. Callbacks can take the tuner lock, or call back into the tuner.
+        void Drain()
+        {
+            std::vector<MuxFilter*> retired;
+
+            _state.Lock();
+            StreamFilter* stream = _stream;
+            retired.swap(_retired);
+            _state.Unlock();
+
+            // All section filters of the tuner dispatch under this lock, on the monitor thread.
+            _dispatch.Lock();
+            _dispatch.Unlock();
+
+            if (stream != nullptr) {
+                stream->Drain();
+            }
+
+            for (MuxFilter* entry : retired) {
+                delete entry;
+                Information::Instance().ReleaseFilter(_adapter);
+            }
+        }
+        void Close()
+        {
+            ISection* observer = _psi.Observer();
+
+            _state.Lock();
+
+            if (observer != nullptr) {
+                // Once removed, the filters do not call the PSI anymore.
+                Install(0x00, MPEG::PAT::ID, nullptr);
+
+                if (_pmtPid != NO_PID) {
+                    Install(_pmtPid, MPEG::PMT::ID, nullptr);
+                    _pmtPid = NO_PID;
+                }
+                for (const uint16_t pid : _pmtPids) {
+                    Install(pid, MPEG::PMT::ID, nullptr);
+                }
+                _pmtPids.clear();
+
+                _psi.Observer(nullptr);
+            }
+
+            for (PESFilter& entry : _streams) {
+                entry.Close();
+            }
+            _probe.Close();
+            _programId = NO_PROGRAM;
+            _pmt = MPEG::PMT();
+
+            _state.Unlock();
+
+            Drain();
+
+            if (observer != nullptr) {
+                // Outside the lock, a pending Loaded() might be waiting for it.
+                _psi.Clear();
+                ProgramTable::Instance().Unregister(this);
+            }
+        }
+        // On a worker thread, PAT or PMT sections went into the ProgramTable and (or) the
+        // ProgramTable moved on to another PMT PID.
+        void Loaded()
+        {
+            bool changed = false;
+            bool moved, pmt;
+            uint16_t pid;
+            uint64_t pat;
+            PSI::PIDs pids;
+
+            _state.Lock();
+
+            // Nothing is collected without an observer, a Close() dropped it all.
+            if ((_psi.Observer() != nullptr) && (_psi.Collect(moved, pid, pids, pat, pmt) == true)) {
+                if ((moved == true) && (pid != _pmtPid)) {
+                    if (_pmtPid != NO_PID) {
+                        Install(_pmtPid, MPEG::PMT::ID, nullptr);
+                    }
+
+                    _pmtPid = pid;
+
+                    if (_pmtPid != NO_PID) {
+                        Install(_pmtPid, MPEG::PMT::ID, &_psi);
+                    }
+                }
+
+                for (const std::pair<uint16_t, bool>& entry : pids) {
+                    std::vector<uint16_t>::iterator index(std::find(_pmtPids.begin(), _pmtPids.end(), entry.first));
+
+                    if ((entry.second == true) && (index == _pmtPids.end())) {
+                        _pmtPids.push_back(entry.first);
+                        Install(entry.first, MPEG::PMT::ID, &_psi);
+                    } else if ((entry.second == false) && (index != _pmtPids.end())) {
+                        _pmtPids.erase(index);
+                        Install(entry.first, MPEG::PMT::ID, nullptr);
+                    }
+                }
+
+                if ((pat != 0) && (_timeline.PAT == 0)) {
+                    _timeline.PAT = pat;
+                }
+
+                // Only true if the PMT of the program is new, or it is updated.
+                if ((pmt == true) && (_programId != NO_PROGRAM) && (ProgramTable::Instance().Program(_frequency, _programId, _pmt) == true)) {
+                    changed = Select();
+                }
+            }
+
+            _state.Unlock();
+
+            Drain();
+
+            if ((changed == true) && (_callback != nullptr)) {
+                _callback->StateChange(this);
+            }
+        }
+        // The probe saw the first PES of the program.
+        void Started()
+        {
+            _state.Lock();
+
+            if (_timeline.PES == 0) {
+                _timeline.PES = Core::Time::Now().Ticks();
+
+                TRACE_L1("Zap to program %d: lock %d ms, PAT %d ms, PMT %d ms, PES %d ms", _programId,
+                    _timeline.Elapsed(_timeline.Lock), _timeline.Elapsed(_timeline.PAT), _timeline.Elapsed(_timeline.PMT), _timeline.Elapsed(_timeline.PES));
+            }
+
+            _state.Unlock();
+        }
+        // Feeds the PID's of the PMT of the program (if loaded) to the decoder or dvr. Returns
+        // true if the state changed. Called with the lock taken.
+        bool Select()
+        {
+            state previous = _state;
+
+            if (_pmt.IsValid() == false) {
+                for (PESFilter& entry : _streams) {
+                    entry.Close();
+                }
+                _probe.Close();
+
+                if (_state != IDLE) {
+                    _state = LOCKED;
+                }
+            } else {
+                if (_timeline.PMT == 0) {
+                    _timeline.PMT = Core::Time::Now().Ticks();
+                }
+
+                Install();
+
+                if (_state != IDLE) {
+                    _state = PREPARED;
+
+                    if (_decoder != NO_DECODER) {
+                        Stream();
+                    }
+                }
+            }
+
+            return (previous != _state);
+        }
+        void Install()
+        {
+            uint16_t pids[STREAMS] = { NO_PID, NO_PID, _pmt.PCRPid() };
+            MPEG::PMT::StreamIterator streams(_pmt.Streams());
+
+            // The first video and audio stream, a selection of another language is up to the
+            // user of the decoder.
+            while (streams.Next() == true) {
+                if ((pids[VIDEO] == NO_PID) && (IsVideo(streams.StreamType()) == true)) {
+                    pids[VIDEO] = streams.Pid();
+                } else if ((pids[AUDIO] == NO_PID) && (IsAudio(streams) == true)) {
+                    pids[AUDIO] = streams.Pid();
+                }
+            }
+
+            const bool decoding = (Information::Instance().Decoders() != 0);
+
+            if ((pids[PCR] == 0x1FFF) || ((decoding == false) && ((pids[PCR] == pids[VIDEO]) || (pids[PCR] == pids[AUDIO])))) {
+                // No PCR, or it is on the dvr with the stream that carries it already.
+                pids[PCR] = NO_PID;
+            }
+
+            // DMX_PES_AUDIO0, VIDEO0, TELETEXT0, SUBTITLE0, PCR0, AUDIO1, VIDEO1... 5 types per decoder.
+            static constexpr dmx_pes_type_t types[STREAMS] = { DMX_PES_VIDEO0, DMX_PES_AUDIO0, DMX_PES_PCR0 };
+            const uint8_t decoder = (_decoder == NO_DECODER ? 0 : _decoder);
+
+            for (uint8_t index = 0; index < STREAMS; index++) {
+                if (pids[index] == NO_PID) {
+                    _streams[index].Close();
+                } else if (pids[index] != _streams[index].Pid()) {
+                    if (decoding == true) {
+                        _streams[index].Open(_devicePath, _frontindex, pids[index], static_cast<dmx_pes_type_t>(types[index] + (decoder * 5)), DMX_OUT_DECODER);
+                    } else {
+                        _streams[index].Open(_devicePath, _frontindex, pids[index], DMX_PES_OTHER, DMX_OUT_TS_TAP);
+                    }
+                }
+            }
+        }
+        void Stream()
+        {
+            for (PESFilter& entry : _streams) {
+                entry.Start();
+            }
+
+            if (_timeline.PES == 0) {
+                const uint16_t pid = (_streams[VIDEO].IsValid() == true ? _streams[VIDEO].Pid() : _streams[AUDIO].Pid());
+
+                if (pid != NO_PID) {
+                    _probe.Open(_devicePath, _frontindex, pid);
+                }
+            }
+
+            if (_state != IDLE) {
+                _state = STREAMING;
+            }
+        }
+        static bool IsVideo(const uint8_t streamType)
+        {
+            // MPEG-1, MPEG-2, MPEG-4 part 2, H.264, H.265
+            return ((streamType == 0x01) || (streamType == 0x02) || (streamType == 0x10) || (streamType == 0x1B) || (streamType == 0x24));
+        }
+        static bool IsAudio(const MPEG::PMT::StreamIterator& stream)
+        {
+            const uint8_t streamType = stream.StreamType();
+            bool result = ((streamType == 0x03) || (streamType == 0x04) || (streamType == 0x0F) || (streamType == 0x11) || (streamType == 0x81) || (streamType == 0x87));
+
+            if ((result == false) && (streamType == 0x06)) {
+                // DVB carries AC-3, E-AC-3 and AAC as private data, the descriptor tells.
+                MPEG::DescriptorIndex descriptors(stream.Descriptors());
+                result = ((descriptors.Has(0x6A) == true) || (descriptors.Has(0x7A) == true) || (descriptors.Has(0x7C) == true));
+            }
+
+            return (result);
         }
 
     private:
@@ -798,16 +2053,35 @@ POP_WARNING()
         int _guard;
         int _hierarchy;
         struct dvb_frontend_info _info;
-        std::map<uint32_t,MuxFilter> _filters;
+        std::map<uint16_t, MuxFilter*> _filters;
+        // Held while a section filter calls back, the filters emptied with the state lock taken wait
+        // here for Drain().
+        Core::CriticalSection _dispatch;
+        std::vector<MuxFilter*> _retired;
         string _devicePath;
+        uint8_t _adapter;
         uint8_t _frontindex;
+        StreamFilter* _stream;
+        Frontend _events;
         TunerAdministrator::ICallback* _callback;
+        uint16_t _frequency;
+        uint16_t _programId;
+        MPEG::PMT _pmt;
+        PESFilter _streams[STREAMS];
+        uint8_t _decoder;
+        PSI _psi;
+        uint16_t _pmtPid;
+        // The PMT PIDs filtered next to _pmtPid.
+        std::vector<uint16_t> _pmtPids;
+        Probe _probe;
+        Timeline _timeline;
         #ifdef __DEBUG__
         unsigned int _lastState;
         #endif
     };
 
     /* static */ Tuner::Information Tuner::Information::_instance;
+    /* static */ Core::ProxyPoolType<Core::DataStore> Tuner::MuxFilter::_storeFactory(4);
 
     // The following methods will be called before any create is called. It allows for an initialization,
     // if requires, and a deinitialization, if the Tuners will no longer be used.
@@ -0,0 +1,453 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MPEGDEMUX_H
+#define __MPEGDEMUX_H
+
+// ---- Include system wide include files ----
+
+// ---- Include local include files ----
+#include "Definitions.h"
+#include "MPEGSection.h"
+#include "Module.h"
+
+// ---- Referenced classes and types ----
+
+// ---- Helper types and constants ----
+
+// ---- Helper functions ----
+
+// ---- Class Definition ----
+
+namespace Thunder {
+namespace Broadcast {
+    namespace MPEG {
+
+        // The Demux takes a raw transport stream (a sequence of 188 byte packets, as
+        // read from a DVR/TS-TAP device or from a file) and reassembles the PSI/SI
+        // sections carried on the PIDs that have a filter installed. Each completed
+        // and valid section is offered to the ISection registered for its TableId.
+        // It allows a single read on a single descriptor to feed all table parsers.
+        // The sections are offered once the data delivered is processed, without the
+        // lock of the Demux taken, the callbacks are free to (un)install filters.
+        class EXTERNAL Demux {
+        private:
+            Demux(const Demux&) = delete;
+            Demux& operator=(const Demux&) = delete;
+
+        public:
+            static constexpr uint8_t PACKET_SIZE = 188;
+            static constexpr uint8_t SYNC_BYTE = 0x47;
+            static constexpr uint16_t MAX_SECTION_SIZE = 4096;
+
+        private:
+            typedef Core::ProxyPoolType<Core::DataStore> StoreFactory;
+
+            // A completed section, waiting to be offered to its callback.
+            struct Completed {
+                Completed(const uint16_t pid, ISection* callback, const Section& section)
+                    : Pid(pid)
+                    , Callback(callback)
+                    , Data(section)
+                {
+                }
+
+                uint16_t Pid;
+                ISection* Callback;
+                Section Data;
+            };
+
+            typedef std::vector<Completed> Sections;
+
+            class Assembler {
+            private:
+                Assembler(const Assembler&) = delete;
+                Assembler& operator=(const Assembler&) = delete;
+
+                static constexpr uint8_t NO_CONTINUITY = 0xFF;
+
+                typedef std::map<uint8_t, ISection*> Callbacks;
+
+            public:
+                Assembler()
+                    : _continuity(NO_CONTINUITY)
+                    , _loading(false)
+                    , _offset(0)
+                    , _length(0)
+                    , _callbacks()
+                    , _store()
+                {
+                }
+                ~Assembler() {}
+
+            public:
+                inline bool IsActive() const
+                {
+                    return (_callbacks.empty() == false);
+                }
+                void Add(const uint8_t tableId, ISection* callback)
+                {
+                    if (_callbacks.empty() == true) {
+                        // (Re)starting this PID, do not stitch on what we had before.
+                        Reset();
+                    }
+                    _callbacks.emplace(tableId, callback);
+                }
+                bool IsInstalled(const uint8_t tableId, const ISection* callback) const
+                {
+                    Callbacks::const_iterator index(_callbacks.find(tableId));
+
+                    return ((index != _callbacks.end()) && (index->second == callback));
+                }
+                bool Remove(const uint8_t tableId)
+                {
+                    Callbacks::iterator index(_callbacks.find(tableId));
+                    bool found = (index != _callbacks.end());
+
+                    if (found == true) {
+                        _callbacks.erase(index);
+                    }
+
+                    return (found);
+                }
+                // The sections completed by this packet are added to completed, the section
+                // data is assembled in stores of the factory.
+                void Deliver(const uint16_t pid, const uint8_t packet[], StoreFactory& factory, Sections& completed)
+                {
+                    uint8_t control = ((packet[3] >> 4) & 0x03);
+                    uint8_t continuity = (packet[3] & 0x0F);
+                    // The adaptation_field_length can be up to 255, beyond the packet.
+                    uint16_t offset = 4;
+
+                    if ((packet[3] & 0xC0) != 0) {
+                        // Scrambled PSI/SI is of no use to us..
+                        return;
+                    }
+
+                    if ((control & 0x02) != 0) {
+                        // Skip the adaptation field, but honour its discontinuity_indicator.
+                        if ((packet[4] > 0) && ((packet[5] & 0x80) != 0)) {
+                            _continuity = NO_CONTINUITY;
+                        }
+                        offset += (packet[4] + 1);
+                    }
+
+                    if (offset >= PACKET_SIZE) {
+                        // An adaptation field that does not fit, this packet is corrupt.
+                        _continuity = NO_CONTINUITY;
+                        _loading = false;
+                        return;
+                    }
+
+                    if ((control & 0x01) == 0) {
+                        // No payload, the continuity counter does not advance.
+                        return;
+                    }
+
+                    if (_continuity != NO_CONTINUITY) {
+                        if (continuity == _continuity) {
+                            // Duplicate packet, we already have this payload.
+                            return;
+                        } else if (continuity != ((_continuity + 1) & 0x0F)) {
+                            TRACE_L1("Continuity error, expected %d, received %d. Dropping section.", ((_continuity + 1) & 0x0F), continuity);
+                            _loading = false;
+                        }
+                    }
+                    _continuity = continuity;
+
+                    const uint8_t* payload = &(packet[offset]);
+                    uint8_t size = static_cast<uint8_t>(PACKET_SIZE - offset);
+
+                    if ((packet[1] & 0x40) != 0) {
+                        // payload_unit_start_indicator, the first byte is the pointer_field.
+                        uint8_t pointer = payload[0];
+
+                        payload++;
+                        size--;
+
+                        if (pointer > size) {
+                            _loading = false;
+                        } else {
+                            if (_loading == true) {
+                                // The first pointer bytes complete the running section
+                                Append(payload, pointer, pid, factory, completed);
+                                _loading = false;
+                            }
+
+                            payload += pointer;
+                            size -= pointer;
+
+                            // Multiple sections can start in this packet, 0xFF is stuffing.
+                            while ((size > 0) && (payload[0] != 0xFF)) {
+                                _loading = true;
+                                _offset = 0;
+
+                                uint8_t used = Append(payload, size, pid, factory, completed);
+
+                                payload += used;
+                                size -= used;
+                            }
+                        }
+                    } else if (_loading == true) {
+                        Append(payload, size, pid, factory, completed);
+                    }
+                }
+
+            private:
+                inline void Reset()
+                {
+                    _continuity = NO_CONTINUITY;
+                    _loading = false;
+                    _offset = 0;
+                }
+                uint8_t Append(const uint8_t data[], const uint8_t size, const uint16_t pid, StoreFactory& factory, Sections& completed)
+                {
+                    uint8_t used = 0;
+
+                    if (_store.IsValid() == false) {
+                        // The previous store went out with its section, it is returned to the
+                        // factory once nobody holds that section anymore.
+                        _store = factory.Element();
+                        _store->Size(MAX_SECTION_SIZE);
+                    }
+
+                    uint8_t* buffer = _store->Buffer();
+
+                    if (_offset < 3) {
+                        used = std::min(static_cast<uint8_t>(3 - _offset), size);
+                        ::memcpy(&(buffer[_offset]), data, used);
+                        _offset += used;
+
+                        if (_offset == 3) {
+                            _length = (((buffer[1] & 0x0F) << 8) | buffer[2]) + 3;
+
+                            if (_length > MAX_SECTION_SIZE) {
+                                // This can not be a section, skip the rest of this payload.
+                                _loading = false;
+                                used = size;
+                            }
+                        }
+                    }
+
+                    if ((_loading == true) && (_offset >= 3)) {
+                        uint16_t needed = std::min(static_cast<uint16_t>(_length - _offset), static_cast<uint16_t>(size - used));
+
+                        ::memcpy(&(buffer[_offset]), &(data[used]), needed);
+                        _offset += needed;
+                        used += static_cast<uint8_t>(needed);
+
+                        if (_offset == _length) {
+                            _loading = false;
+                            Complete(pid, completed);
+                        }
+                    }
+
+                    return (used);
+                }
+                void Complete(const uint16_t pid, Sections& completed)
+                {
+                    Callbacks::iterator index(_callbacks.find(_store->Buffer()[0]));
+
+                    if (index != _callbacks.end()) {
+                        MPEG::Section newSection(Core::DataElement(_store, 0, _length));
+
+                        if (newSection.IsValid() == true) {
+                            // The section holds on to the store, the next one goes in a new store.
+                            completed.emplace_back(pid, index->second, newSection);
+                            _store.Release();
+                        }
+                    }
+                }
+
+            private:
+                uint8_t _continuity;
+                bool _loading;
+                uint16_t _offset;
+                uint16_t _length;
+                Callbacks _callbacks;
+                Core::ProxyType<Core::DataStore> _store;
+            };
+
+            typedef std::map<uint16_t, Assembler> Assemblers;
+
+        public:
+            Demux()
+                : _adminLock()
+                , _dispatch()
+                , _assemblers()
+                , _storeFactory(4)
+                , _pending(0)
+            {
+            }
+            ~Demux() {}
+
+        public:
+            inline bool IsActive(const uint16_t pid) const
+            {
+                _adminLock.Lock();
+
+                Assemblers::const_iterator index(_assemblers.find(pid));
+                bool result = ((index != _assemblers.end()) && (index->second.IsActive() == true));
+
+                _adminLock.Unlock();
+
+                return (result);
+            }
+
+            // Install (callback != nullptr) or remove (callback == nullptr) the receiver of
+            // the sections with the given tableId, carried on the given PID.
+            uint32_t Filter(const uint16_t pid, const uint8_t tableId, ISection* callback)
+            {
+                uint32_t result = Core::ERROR_NONE;
+
+                if (callback == nullptr) {
+                    result = Revoke(pid, tableId);
+
+                    if (result == Core::ERROR_NONE) {
+                        Drain();
+                    }
+                } else {
+                    _adminLock.Lock();
+                    _assemblers[pid].Add(tableId, callback);
+                    _adminLock.Unlock();
+                }
+
+                return (result);
+            }
+
+            // Remove the receiver, without waiting for it. Once removed, a callback is not called
+            // anymore, but it might be handling a section right now, on the thread that delivers.
+            // A caller holding a lock that callback might need, calls Drain() once it released it.
+            uint32_t Revoke(const uint16_t pid, const uint8_t tableId)
+            {
+                uint32_t result = Core::ERROR_NONE;
+
+                _adminLock.Lock();
+
+                // Assemblers are never erased, the sections they completed might still
+                // have to be offered.
+                Assemblers::iterator index(_assemblers.find(pid));
+
+                if ((index == _assemblers.end()) || (index->second.Remove(tableId) == false)) {
+                    result = Core::ERROR_UNAVAILABLE;
+                }
+
+                _adminLock.Unlock();
+
+                return (result);
+            }
+
+            // Returns once the sections being offered, if any, are handled.
+            inline void Drain()
+            {
+                _dispatch.Lock();
+                _dispatch.Unlock();
+            }
+
+            // Feed raw transport stream data. The data does not need to be packet aligned, a
+            // partial packet at the end is kept until the next delivery. Returns the number
+            // of packets processed.
+            uint32_t Deliver(const uint8_t data[], const uint32_t length)
+            {
+                uint32_t packets = 0;
+                uint32_t offset = 0;
+                Sections completed;
+
+                // Held until all completed sections are offered, a removal waits for it in Drain().
+                _dispatch.Lock();
+                _adminLock.Lock();
+
+                if (_pending != 0) {
+                    uint8_t needed = (PACKET_SIZE - _pending);
+
+                    if (length < needed) {
+                        ::memcpy(&(_packet[_pending]), data, length);
+                        _pending += static_cast<uint8_t>(length);
+                        offset = length;
+                    } else {
+                        ::memcpy(&(_packet[_pending]), data, needed);
+                        Packet(_packet, completed);
+                        packets++;
+                        _pending = 0;
+                        offset = needed;
+                    }
+                }
+
+                while (offset < length) {
+                    if (data[offset] != SYNC_BYTE) {
+                        // Out of sync, hunt for the next sync byte.
+                        offset++;
+                    } else if ((length - offset) < PACKET_SIZE) {
+                        _pending = static_cast<uint8_t>(length - offset);
+                        ::memcpy(_packet, &(data[offset]), _pending);
+                        offset = length;
+                    } else {
+                        Packet(&(data[offset]), completed);
+                        packets++;
+                        offset += PACKET_SIZE;
+                    }
+                }
+
+                _adminLock.Unlock();
+
+                for (const Completed& entry : completed) {
+                    // A callback might have removed itself, or another, on an earlier section.
+                    _adminLock.Lock();
+                    const bool installed = _assemblers[entry.Pid].IsInstalled(entry.Data.TableId(), entry.Callback);
+                    _adminLock.Unlock();
+
+                    if (installed == true) {
+                        entry.Callback->Handle(entry.Data);
+                    }
+                }
+
+                _dispatch.Unlock();
+
+                return (packets);
+            }
+
+        private:
+            inline void Packet(const uint8_t packet[], Sections& completed)
+            {
+                // Drop packets flagged with the transport_error_indicator.
+                if ((packet[1] & 0x80) == 0) {
+                    uint16_t pid = (((packet[1] & 0x1F) << 8) | packet[2]);
+
+                    Assemblers::iterator index(_assemblers.find(pid));
+
+                    if ((index != _assemblers.end()) && (index->second.IsActive() == true)) {
+                        index->second.Deliver(pid, packet, _storeFactory, completed);
+                    }
+                }
+            }
+
+        private:
+            mutable Core::CriticalSection _adminLock;
+            Core::CriticalSection _dispatch;
+            Assemblers _assemblers;
+            StoreFactory _storeFactory;
+            uint8_t _pending;
+            uint8_t _packet[PACKET_SIZE];
+        };
+
+    } // namespace MPEG
+} // namespace Broadcast
+} // namespace Thunder
+
+#endif // __MPEGDEMUX_H
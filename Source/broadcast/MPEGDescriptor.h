@@ -104,20 +104,14 @@ namespace Broadcast {
             inline void Reset() { _index = NUMBER_MAX_UNSIGNED(uint32_t); }
             bool Next()
             {
-                uint8_t descriptorLength;
-
                 if (_index == NUMBER_MAX_UNSIGNED(uint32_t)) {
                     _index = 0;
-                    descriptorLength = _descriptors[1] + 2;
                 } else if (_index < _descriptors.Size()) {
                     _index += (_descriptors[_index + 1] + 2);
-                    if ((_index + 2) < _descriptors.Size()) {
-                        descriptorLength = _descriptors[_index + 1] + 2;
-                    }
                 }
 
                 // See if we have a valid descriptor, Does it fit the block we have ?
-                if ((_index + descriptorLength) > _descriptors.Size()) {
+                if (((_index + 2) > _descriptors.Size()) || ((_index + 2 + _descriptors[_index + 1]) > _descriptors.Size())) {
                     // It's too big, Jump to the end..
                     _index = static_cast<uint32_t>(_descriptors.Size());
                 }
@@ -139,12 +133,12 @@ namespace Broadcast {
                     _index = 0;
                 }
 
-                while (((_index + 2) < _descriptors.Size()) && (_descriptors[_index] != tagId)) {
-                    _index += _descriptors[1] + 2;
+                while (((_index + 2) <= _descriptors.Size()) && (_descriptors[_index] != tagId)) {
+                    _index += _descriptors[_index + 1] + 2;
                 }
 
                 // See if we have a valid descriptor, Does it fit the block we have ?
-                if (((_index + 2) >= _descriptors.Size()) || ((_descriptors[_index + 1] + 2 + _index) > _descriptors.Size())) {
+                if (((_index + 2) > _descriptors.Size()) || ((_descriptors[_index + 1] + 2 + _index) > _descriptors.Size())) {
                     // It's too big, or none was found, jump to the end..
                     _index = static_cast<uint32_t>(_descriptors.Size());
                 }
@@ -155,24 +149,128 @@ namespace Broadcast {
             {
                 uint32_t count = 0;
                 uint32_t offset = 0;
-                while (offset < _descriptors.Size()) {
-                    count++;
-                    offset += Descriptor(Core::DataElement(_descriptors, offset)).Length();
-                }
 
-                if (offset > _descriptors.Size()) {
-                    // reduce the count by one, the last one is toooooooo big
-                    count--;
+                // Only count the ones that fit, the last one might be toooooooo big
+                while (((offset + 2) <= _descriptors.Size()) && ((offset + 2 + _descriptors[offset + 1]) <= _descriptors.Size())) {
+                    count++;
+                    offset += (_descriptors[offset + 1] + 2);
                 }
 
                 return (count);
             }
 
         private:
+            friend class DescriptorIndex;
+
             Core::DataElement _descriptors;
             uint32_t _index;
         };
 
+        // Built in one pass over a descriptor loop: a bitmap of the tags present and the
+        // offset of the first descriptor of each tag. Looking up a tag is O(1) from then on,
+        // instead of a scan of the loop per tag with DescriptorIterator::Tag().
+        class EXTERNAL DescriptorIndex {
+        private:
+            DescriptorIndex() = delete;
+
+        public:
+            DescriptorIndex(const DescriptorIterator& loop)
+                : _descriptors(loop._descriptors)
+                , _count(0)
+            {
+                uint32_t offset = 0;
+
+                ::memset(_present, 0, sizeof(_present));
+
+                // Descriptor loop lengths are 12 bits, the offsets fit 16 bits.
+                ASSERT(_descriptors.Size() <= 0xFFFF);
+
+                while (((offset + 2) <= _descriptors.Size()) && ((offset + 2 + _descriptors[offset + 1]) <= _descriptors.Size())) {
+                    const uint8_t tag = _descriptors[offset];
+
+                    if (Has(tag) == false) {
+                        _present[tag >> 6] |= (1ULL << (tag & 0x3F));
+                        _offsets[tag] = static_cast<uint16_t>(offset);
+                    }
+
+                    _count++;
+                    offset += (_descriptors[offset + 1] + 2);
+                }
+            }
+            DescriptorIndex(const DescriptorIndex& copy) = default;
+            DescriptorIndex& operator=(const DescriptorIndex& rhs) = default;
+            ~DescriptorIndex() = default;
+
+        public:
+            inline uint32_t Count() const
+            {
+                return (_count);
+            }
+            inline bool Has(const uint8_t tag) const
+            {
+                return ((_present[tag >> 6] & (1ULL << (tag & 0x3F))) != 0);
+            }
+            // The first descriptor with this tag, check Has() first.
+            inline Descriptor operator[](const uint8_t tag) const
+            {
+                ASSERT(Has(tag) == true);
+                return (Descriptor(Core::DataElement(_descriptors, _offsets[tag])));
+            }
+
+        private:
+            Core::DataElement _descriptors;
+            uint32_t _count;
+            uint64_t _present[4];
+            uint16_t _offsets[256];
+        };
+
+        // Walks a descriptor loop once and hands every descriptor of one of the listed
+        // types, constructed as that type, to the handler:
+        //     DescriptorVisitor<DVB::Descriptors::ShortEvent, DVB::Descriptors::ExtendedEvent>::Visit(loop, handler);
+        // calls handler(const DVB::Descriptors::ShortEvent&) and so on. The types need a TAG.
+        // The others are skipped, the number of descriptors handled is returned.
+        template <typename... DESCRIPTORS>
+        class DescriptorVisitor {
+        private:
+            DescriptorVisitor() = delete;
+
+            template <typename HANDLER>
+            static inline bool Dispatch(HANDLER& /* handler */, const Descriptor& /* descriptor */)
+            {
+                return (false);
+            }
+            template <typename HANDLER, typename FIRST, typename... REST>
+            static inline bool Dispatch(HANDLER& handler, const Descriptor& descriptor)
+            {
+                bool result = true;
+
+                if (descriptor.Tag() == FIRST::TAG) {
+                    handler(FIRST(descriptor));
+                } else {
+                    result = Dispatch<HANDLER, REST...>(handler, descriptor);
+                }
+
+                return (result);
+            }
+
+        public:
+            template <typename HANDLER>
+            static uint32_t Visit(DescriptorIterator loop, HANDLER& handler)
+            {
+                uint32_t result = 0;
+
+                loop.Reset();
+
+                while (loop.Next() == true) {
+                    if (Dispatch<HANDLER, DESCRIPTORS...>(handler, loop.Current()) == true) {
+                        result++;
+                    }
+                }
+
+                return (result);
+            }
+        };
+
     } // namespace MPEG
 } // namespace Broadcast
 } // namespace Thunder
@@ -0,0 +1,95 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "MPEGSection.h"
+
+namespace Thunder {
+
+namespace Broadcast {
+
+    namespace MPEG {
+
+        // MPEG-2 CRC32 (polynomial 0x04C11DB7, MSB first, no reflection, no final XOR).
+        // The hardware CRC instructions (SSE4.2, ARMv8) implement other, reflected, polynomials,
+        // so a slice-by-8 table lookup is used: eight bytes per iteration instead of one.
+        class CRCTable {
+        private:
+            CRCTable(const CRCTable&) = delete;
+            CRCTable& operator=(const CRCTable&) = delete;
+
+            static constexpr uint32_t POLYNOMIAL = 0x04C11DB7;
+
+        public:
+            CRCTable()
+            {
+                for (uint16_t index = 0; index < 256; index++) {
+                    uint32_t crc = (static_cast<uint32_t>(index) << 24);
+
+                    for (uint8_t bit = 0; bit < 8; bit++) {
+                        crc = ((crc & 0x80000000) != 0 ? ((crc << 1) ^ POLYNOMIAL) : (crc << 1));
+                    }
+
+                    _table[0][index] = crc;
+                }
+                for (uint16_t index = 0; index < 256; index++) {
+                    for (uint8_t slice = 1; slice < 8; slice++) {
+                        uint32_t previous = _table[slice - 1][index];
+                        _table[slice][index] = ((previous << 8) ^ _table[0][previous >> 24]);
+                    }
+                }
+            }
+            ~CRCTable() = default;
+
+        public:
+            uint32_t Calculate(uint32_t crc, const uint8_t data[], uint32_t length) const
+            {
+                while (length >= 8) {
+                    uint32_t one = crc ^ ((static_cast<uint32_t>(data[0]) << 24) | (data[1] << 16) | (data[2] << 8) | data[3]);
+                    uint32_t two = ((static_cast<uint32_t>(data[4]) << 24) | (data[5] << 16) | (data[6] << 8) | data[7]);
+
+                    crc = _table[7][one >> 24] ^ _table[6][(one >> 16) & 0xFF] ^ _table[5][(one >> 8) & 0xFF] ^ _table[4][one & 0xFF] ^
+                          _table[3][two >> 24] ^ _table[2][(two >> 16) & 0xFF] ^ _table[1][(two >> 8) & 0xFF] ^ _table[0][two & 0xFF];
+
+                    data += 8;
+                    length -= 8;
+                }
+                while (length > 0) {
+                    crc = ((crc << 8) ^ _table[0][(crc >> 24) ^ *data]);
+                    data++;
+                    length--;
+                }
+
+                return (crc);
+            }
+
+        private:
+            uint32_t _table[8][256];
+        };
+
+        static const CRCTable _crcTable;
+
+        uint32_t CRC32(const uint8_t data[], const uint32_t length, const uint32_t crc)
+        {
+            return (_crcTable.Calculate(crc, data, length));
+        }
+
+    } // namespace MPEG
+
+} // namespace Broadcast
+} // namespace Thunder
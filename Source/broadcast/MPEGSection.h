@@ -36,18 +36,38 @@
 namespace Thunder {
 namespace Broadcast {
     namespace MPEG {
+
+        // MPEG-2 CRC32 over the given data, a section including its CRC_32 field yields 0.
+        EXTERNAL uint32_t CRC32(const uint8_t data[], const uint32_t length, const uint32_t crc = 0xFFFFFFFF);
+
         class EXTERNAL Section {
+        private:
+            enum validity : uint8_t {
+                UNKNOWN,
+                VALID,
+                INVALID
+            };
+
         public:
             inline Section()
                 : _section()
+                , _validity(UNKNOWN)
             {
             }
             inline Section(const Core::DataElement& data)
                 : _section(data)
+                , _validity(UNKNOWN)
+            {
+            }
+            // A copy of a section that has been validated already, its CRC is not checked again.
+            inline Section(const Core::DataElement& data, const bool valid)
+                : _section(data)
+                , _validity(valid == true ? VALID : INVALID)
             {
             }
             inline Section(const Section& copy)
                 : _section(copy._section)
+                , _validity(copy._validity)
             {
             }
             inline ~Section() {}
@@ -55,6 +75,7 @@ namespace Broadcast {
             inline Section& operator=(const Section& RHS)
             {
                 _section = RHS._section;
+                _validity = RHS._validity;
 
                 return (*this);
             }
@@ -62,7 +83,11 @@ namespace Broadcast {
         public:
             inline bool IsValid() const
             {
-                return ((_section.Size() >= Offset()) && (_section.Size() >= Length()) && (!HasSectionSyntax() || ValidCRC()));
+                // The CRC is only calculated once, whoever asks again gets the cached verdict.
+                if (_validity == UNKNOWN) {
+                    _validity = ((_section.Size() >= Offset()) && (_section.Size() >= Length()) && (!HasSectionSyntax() || ValidCRC()) ? VALID : INVALID);
+                }
+                return (_validity == VALID);
             }
             inline uint8_t TableId() const { return (_section[0]); }
             inline bool HasSectionSyntax() const { return ((_section[1] & 0x80) != 0); }
@@ -82,6 +107,10 @@ namespace Broadcast {
             inline bool IsNext() const { return (!IsCurrent()); }
             inline uint8_t SectionNumber() const { return (_section[6]); }
             inline uint8_t LastSectionNumber() const { return (_section[7]); }
+            inline uint32_t CRC() const
+            {
+                return (HasSectionSyntax() ? GetNumber<uint32_t>(Length() - 4) : 0);
+            }
             inline uint32_t Hash() const
             {
                 // Extension(16)/TableId(8)/Version(5)/CurNext(1)/SectionIndex(1)
@@ -95,6 +124,11 @@ namespace Broadcast {
             {
                 return (Core::DataElement(_section, Offset(), DataLength()));
             }
+            // The complete section, header and CRC included.
+            inline const uint8_t* Buffer() const
+            {
+                return (_section.Buffer());
+            }
             template <typename TYPE>
             TYPE GetNumber(const uint16_t offset) const
             {
@@ -106,7 +140,7 @@ namespace Broadcast {
             {
                 uint32_t size = Length() - 4;
                 uint32_t counterCRC = GetNumber<uint32_t>(size);
-                return (_section.CRC32(0, size) == counterCRC);
+                return (MPEG::CRC32(_section.Buffer(), size) == counterCRC);
             }
 
         private:
@@ -122,23 +156,36 @@ namespace Broadcast {
 
         private:
             Core::DataElement _section;
+            mutable validity _validity;
         };
 
+        // A Table collects the sections of one version of a table. Sections may arrive in any
+        // order, each section number is tracked in a bitmap. The payloads are appended to the
+        // storage as they come in and only put in section order once, when the table completes.
+        // EIT tables (0x4E-0x6F) are segmented: per segment of 8 sections only the sections up to
+        // the segment_last_section_number are transmitted, so gaps do not prevent completion.
+        // The storage to order the sections in, is taken from the given factory (if any), so
+        // a table stays on the storage of its owner.
         class EXTERNAL Table {
         private:
             Table() = delete;
             Table(const Table&) = delete;
             Table& operator=(const Table&) = delete;
 
+            static constexpr uint16_t MAX_SECTIONS = 256;
+
         public:
-            Table(const Core::ProxyType<Core::DataStore>& data)
-                : _extension(NUMBER_MAX_UNSIGNED(uint16_t))
+            Table(const Core::ProxyType<Core::DataStore>& data, Core::ProxyPoolType<Core::DataStore>* factory = nullptr)
+                : _factory(factory)
+                , _extension(NUMBER_MAX_UNSIGNED(uint16_t))
                 , _version(NUMBER_MAX_UNSIGNED(uint8_t))
                 , _lastSectionNumber(NUMBER_MAX_UNSIGNED(uint8_t))
                 , _tableId(0)
-                , _sections()
+                , _ordered(true)
+                , _highest(0)
                 , _data(Core::DataElement(data, 0, 0))
             {
+                Reset();
             }
             ~Table() {}
 
@@ -146,17 +193,23 @@ namespace Broadcast {
             inline void Storage(const Core::ProxyType<Core::DataStore>& data)
             {
                 // Drop the current table, load a new storage
-                _sections.clear();
                 _data = Core::DataElement(data);
-                _lastSectionNumber = NUMBER_MAX_UNSIGNED(uint8_t);
-                _version = NUMBER_MAX_UNSIGNED(uint8_t);
+                Clear();
             }
             inline bool IsValid() const
             {
-                return ((_sections.size() > 0) && ((_sections.size() - 1) == _lastSectionNumber));
+                bool complete = IsStarted();
+
+                for (uint8_t index = 0; (complete == true) && (index < (MAX_SECTIONS / 32)); index++) {
+                    complete = ((_received[index] & _required[index]) == _required[index]);
+                }
+
+                return (complete);
             }
             inline uint16_t TableId() const { return (_tableId); }
             inline uint16_t Extension() const { return (_extension); }
+            inline uint8_t Version() const { return (_version); }
+            inline uint8_t LastSectionNumber() const { return (_lastSectionNumber); }
             template <typename TYPE>
             TYPE GetNumber(const uint16_t offset) const
             {
@@ -165,10 +218,10 @@ namespace Broadcast {
             inline void Clear()
             {
                 // Drop the current table, load a new storage
-                _sections.clear();
                 _data.Size(0);
                 _lastSectionNumber = NUMBER_MAX_UNSIGNED(uint8_t);
                 _version = NUMBER_MAX_UNSIGNED(uint8_t);
+                Reset();
             }
             inline Core::DataElement& Data() { return (_data); }
             inline const Core::DataElement& Data() const { return (_data); }
@@ -177,7 +230,7 @@ namespace Broadcast {
                 bool addSection = section.IsValid();
 
                 if (addSection == true) {
-                    if (_sections.size() != 0) {
+                    if (IsStarted() == true) {
                         // Starting something for TableId A and then continue with other
                         // TableId's Seems to me like a programming error.
                         if (_tableId != section.TableId()) {
@@ -188,10 +241,10 @@ namespace Broadcast {
 
                         if ((addSection == true) && (section.Version() != _version)) {
                             // Give back all the elemts we do not use..
-                            _sections.clear();
                             _data.Size(0);
                             _lastSectionNumber = section.LastSectionNumber();
                             _version = section.Version();
+                            Reset();
 
                             if (_extension != section.Extension()) {
                                 printf("%s, %d -> Interesting the extensions differ\n",
@@ -204,37 +257,14 @@ namespace Broadcast {
                         _lastSectionNumber = section.LastSectionNumber();
                         _version = section.Version();
                         _extension = section.Extension();
+                        Reset();
                     }
 
-                    if (addSection == true) {
-                        uint32_t offset = 0;
-                        uint32_t slotValue = (section.SectionNumber() << 16) | section.Length();
-
-                        std::list<uint32_t>::iterator index(_sections.begin());
-
-                        while (index != _sections.end()) {
-                            uint16_t thisLength(*index & 0xFFFF);
-                            uint8_t thisSection((*index >> 16) & 0xFF);
-
-                            if (section.SectionNumber() == thisSection) {
-                                // Replace it..
-                                Insert(section.Data(), thisLength, offset);
-                                *index = slotValue;
-                                break;
-                            } else if (section.SectionNumber() < thisSection) {
-                                // We need to extend the last part
-                                Insert(section.Data(), 0, offset);
-                                index = _sections.insert(index, slotValue);
-                                break;
-                            }
-                            offset += thisLength;
-                        }
-
-                        if (index == _sections.end()) {
-                            ASSERT(offset == _data.Size());
+                    if ((addSection == true) && (IsReceived(section.SectionNumber()) == false)) {
+                        Append(section);
 
-                            Insert(section.Data(), 0, offset);
-                            _sections.push_back(slotValue);
+                        if ((_ordered == false) && (IsValid() == true)) {
+                            Order();
                         }
                     }
                 }
@@ -243,39 +273,205 @@ namespace Broadcast {
             }
 
         private:
-            void Insert(const Core::DataElement& data, const uint16_t allocatedLength,
-                const uint16_t offset)
-            {
-                if (offset < _data.Size()) {
-                    // We need to scrink or extend space...
-                    int32_t needed = (data.Size() - allocatedLength);
-                    uint32_t moveSize = (_data.Size() - offset - allocatedLength);
-                    if (needed > 0) {
-                        // Time to extend
-                        _data.Size(_data.Size() + needed);
-                        ::memmove(&(_data[offset + data.Size()]),
-                            &(_data[offset + allocatedLength]), moveSize);
-                    } else if (needed < 0) {
-                        // time to schrink
-                        ::memmove(&(_data[offset + data.Size()]),
-                            &(_data[offset + allocatedLength]), moveSize);
-                        _data.Size(_data.Size() + needed);
+            inline bool IsStarted() const
+            {
+                // A version is only 5 bits, so this can not be a real version.
+                return (_version != NUMBER_MAX_UNSIGNED(uint8_t));
+            }
+            inline bool IsSegmented() const
+            {
+                // DVB EIT present/following and schedule tables.
+                return ((_tableId >= 0x4E) && (_tableId <= 0x6F));
+            }
+            inline bool IsReceived(const uint8_t number) const
+            {
+                return ((_received[number >> 5] & (1u << (number & 0x1F))) != 0);
+            }
+            inline void Require(const uint8_t first, const uint8_t last)
+            {
+                for (uint16_t number = first; number <= last; number++) {
+                    _required[number >> 5] |= (1u << (number & 0x1F));
+                }
+            }
+            void Reset()
+            {
+                ::memset(_received, 0, sizeof(_received));
+                ::memset(_required, 0, sizeof(_required));
+                _ordered = true;
+                _highest = 0;
+
+                if (IsStarted() == true) {
+                    if (IsSegmented() == false) {
+                        Require(0, _lastSectionNumber);
+                    } else {
+                        // At least the first section of each segment, until we learn more.
+                        for (uint16_t number = 0; number <= _lastSectionNumber; number += 8) {
+                            Require(static_cast<uint8_t>(number), static_cast<uint8_t>(number));
+                        }
+                    }
+                }
+            }
+            void Append(const Section& section)
+            {
+                const uint8_t number = section.SectionNumber();
+                const Core::DataElement payload(section.Data());
+                const uint32_t offset = static_cast<uint32_t>(_data.Size());
+
+                _data.Size(offset + payload.Size());
+                ::memcpy(&(_data[offset]), payload.Buffer(), payload.Size());
+
+                _offsets[number] = offset;
+                _lengths[number] = static_cast<uint16_t>(payload.Size());
+                _received[number >> 5] |= (1u << (number & 0x1F));
+
+                if (number < _highest) {
+                    _ordered = false;
+                }
+                _highest = std::max(_highest, number);
+
+                if ((IsSegmented() == true) && (payload.Size() >= 5)) {
+                    // The segment_last_section_number tells which sections this segment holds.
+                    uint8_t first = (number & 0xF8);
+                    uint8_t last = std::min(std::max(payload[4], first), static_cast<uint8_t>(first | 0x07));
+
+                    Require(first, std::min(last, _lastSectionNumber));
+                }
+            }
+            void Order()
+            {
+                // Sections arrived out of order, put them in sequence, once.
+                Core::ProxyType<Core::DataStore> store(_factory != nullptr ? _factory->Element() : Core::ProxyType<Core::DataStore>::Create(static_cast<uint32_t>(_data.Size())));
+                store->Size(_data.Size());
+                Core::DataElement ordered(store, 0, 0);
+                uint32_t offset = 0;
+
+                ordered.Size(_data.Size());
+
+                for (uint16_t number = 0; number <= _highest; number++) {
+                    if (IsReceived(static_cast<uint8_t>(number)) == true) {
+                        ::memcpy(&(ordered[offset]), &(_data[_offsets[number]]), _lengths[number]);
+                        _offsets[number] = offset;
+                        offset += _lengths[number];
                     }
-                } else {
-                    _data.Size(_data.Size() + data.Size());
                 }
-                ::memcpy(&(_data[offset]), data.Buffer(), data.Size());
+
+                _data = ordered;
+                _ordered = true;
             }
 
         private:
+            Core::ProxyPoolType<Core::DataStore>* _factory;
             uint16_t _extension;
             uint8_t _version;
             uint8_t _lastSectionNumber;
             uint8_t _tableId;
-            std::list<uint32_t> _sections;
+            bool _ordered;
+            uint8_t _highest;
+            uint32_t _received[MAX_SECTIONS / 32];
+            uint32_t _required[MAX_SECTIONS / 32];
+            uint32_t _offsets[MAX_SECTIONS];
+            uint16_t _lengths[MAX_SECTIONS];
             Core::DataElement _data;
         };
 
+        // Broadcast SI is repeated cyclically. The RepetitionFilter remembers the sections of the
+        // tables that were completely received, so their repetitions can be dropped before they
+        // are assembled and parsed again. Sections are only remembered once their table is
+        // Completed, a table that has to restart halfway is never starved of its sections.
+        class EXTERNAL RepetitionFilter {
+        private:
+            RepetitionFilter(const RepetitionFilter&) = delete;
+            RepetitionFilter& operator=(const RepetitionFilter&) = delete;
+
+            // Key: Hash(32)/SectionNumber(8), Value: CRC
+            typedef std::map<uint64_t, uint32_t> Entries;
+
+        public:
+            RepetitionFilter()
+                : _accepted()
+                , _pending()
+            {
+            }
+            ~RepetitionFilter() {}
+
+        public:
+            // Returns true if this exact section was part of a table that was already completed.
+            bool IsRepetition(const Section& section)
+            {
+                bool repetition = false;
+
+                if (section.HasSectionSyntax() == true) {
+                    uint64_t key(Key(section));
+                    uint32_t crc(section.CRC());
+                    Entries::const_iterator index(_accepted.find(key));
+
+                    repetition = ((index != _accepted.end()) && (index->second == crc));
+
+                    if (repetition == false) {
+                        _pending[key] = crc;
+                    }
+                }
+
+                return (repetition);
+            }
+            // The table the given section belongs to is complete, its sections can be dropped from now on.
+            void Completed(const Section& section)
+            {
+                if (section.HasSectionSyntax() == true) {
+                    // All versions of this table: Extension/TableId, any Version/CurNext/SectionIndex
+                    uint64_t tableBegin(static_cast<uint64_t>(section.Hash() & 0xFFFFFF00) << 8);
+                    uint64_t tableEnd(tableBegin | 0xFFFF);
+                    uint64_t versionBegin(Key(section) & ~static_cast<uint64_t>(0xFF));
+                    uint64_t versionEnd(versionBegin | 0xFF);
+
+                    // Whatever we remembered of a previous version is outdated.
+                    _accepted.erase(_accepted.lower_bound(tableBegin), _accepted.upper_bound(tableEnd));
+
+                    _accepted.insert(_pending.lower_bound(versionBegin), _pending.upper_bound(versionEnd));
+                    _pending.erase(_pending.lower_bound(tableBegin), _pending.upper_bound(tableEnd));
+                }
+            }
+            // Only the given section can be dropped from now on. For tables of which the sections are
+            // self contained (EIT), and handled as they come in, without waiting for the table.
+            void Accepted(const Section& section)
+            {
+                if (section.HasSectionSyntax() == true) {
+                    const uint64_t key(Key(section));
+                    Entries::iterator index(_pending.find(key));
+
+                    if (index != _pending.end()) {
+                        uint64_t tableBegin(static_cast<uint64_t>(section.Hash() & 0xFFFFFF00) << 8);
+                        uint64_t tableEnd(tableBegin | 0xFFFF);
+                        uint64_t versionBegin(key & ~static_cast<uint64_t>(0xFF));
+                        uint64_t versionEnd(versionBegin | 0xFF);
+
+                        // Whatever we remembered of another version is outdated, of this version
+                        // the sections accepted before are kept.
+                        _accepted.erase(_accepted.lower_bound(tableBegin), _accepted.lower_bound(versionBegin));
+                        _accepted.erase(_accepted.upper_bound(versionEnd), _accepted.upper_bound(tableEnd));
+
+                        _accepted[key] = index->second;
+                        _pending.erase(index);
+                    }
+                }
+            }
+            void Clear()
+            {
+                _accepted.clear();
+                _pending.clear();
+            }
+
+        private:
+            inline uint64_t Key(const Section& section) const
+            {
+                return ((static_cast<uint64_t>(section.Hash()) << 8) | section.SectionNumber());
+            }
+
+        private:
+            Entries _accepted;
+            Entries _pending;
+        };
+
     } // namespace MPEG
 } // namespace Broadcast
 } // namespace Thunder
@@ -118,6 +118,11 @@ namespace Broadcast {
                 , _transportId(data.Extension())
             {
             }
+            PAT(const uint16_t transportId, const Core::DataElement& data)
+                : _data(data)
+                , _transportId(transportId)
+            {
+            }
             ~PAT() {}
 
         public:
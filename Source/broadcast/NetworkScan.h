@@ -0,0 +1,366 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NETWORKSCAN_H
+#define NETWORKSCAN_H
+
+#include <set>
+
+#include "Definitions.h"
+#include "Networks.h"
+
+namespace Thunder {
+
+namespace Broadcast {
+
+    // Scans all multiplexes of a network, on all tuners handed to it in parallel. It starts
+    // with the given seeds, every multiplex the NIT's (actual and other) received on the way
+    // point to, is added to the scan. While a tuner dwells on a multiplex, the administrators
+    // (Networks, Services, ...) pick up their tables from it, as they do for any tuner.
+    class NetworkScan : public Core::Thread {
+    private:
+        NetworkScan() = delete;
+        NetworkScan(const NetworkScan&) = delete;
+        NetworkScan& operator=(const NetworkScan&) = delete;
+
+        // Wakes the scan on a tuner state change and on every NIT that changed the networks,
+        // only signals, the lock of the scan is not taken with the lock of the caller.
+        class Sink : public ITuner::INotification, public Networks::IObserver {
+        private:
+            Sink() = delete;
+            Sink(const Sink&) = delete;
+            Sink& operator=(const Sink&) = delete;
+
+        public:
+            Sink(NetworkScan& parent)
+                : _parent(parent)
+            {
+            }
+            ~Sink() override
+            {
+            }
+
+        public:
+            void Activated(ITuner* /* tuner */) override
+            {
+            }
+            void Deactivated(ITuner* /* tuner */) override
+            {
+                _parent._signal.SetEvent();
+            }
+            void StateChange(ITuner* /* tuner */) override
+            {
+                _parent._signal.SetEvent();
+            }
+            void Updated() override
+            {
+                _parent._signal.SetEvent();
+            }
+
+        private:
+            NetworkScan& _parent;
+        };
+
+    public:
+        // The parameters of ITuner::Tune(), Frequency is in MHz.
+        struct Multiplex {
+            Multiplex()
+                : Modus(ITuner::Terrestrial)
+                , Frequency(0)
+                , Modulation(MODULATION_UNKNOWN)
+                , SymbolRate(0)
+                , FEC(FEC_INNER_UNKNOWN)
+                , Inversion(Auto)
+            {
+            }
+            Multiplex(const ITuner::modus modus, const uint16_t frequency, const Broadcast::Modulation modulation, const uint32_t symbolRate, const uint16_t fec, const SpectralInversion inversion)
+                : Modus(modus)
+                , Frequency(frequency)
+                , Modulation(modulation)
+                , SymbolRate(symbolRate)
+                , FEC(fec)
+                , Inversion(inversion)
+            {
+            }
+            Multiplex(const Networks::Network& network)
+                : Modus(network.Modus())
+                , Frequency(static_cast<uint16_t>((network.Frequency() + 500) / 1000))
+                , Modulation(static_cast<Broadcast::Modulation>(network.Modulation()))
+                , SymbolRate(network.SymbolRate())
+                , FEC(network.FEC())
+                , Inversion(Auto)
+            {
+                if (Modus == ITuner::Terrestrial) {
+                    // ITuner::Tune() takes the bandwidth for the symbol rate, and both code rates.
+                    SymbolRate = network.Bandwidth();
+                    FEC = (network.FEC() | (network.CodeRateLP() << 8));
+                }
+            }
+
+            // On satellite the polarization tells multiplexes on the same frequency apart.
+            inline uint32_t Key() const
+            {
+                return (Frequency | (Modus << 16) | (Modus == ITuner::Satellite ? ((Modulation & 0x0C) << 18) : 0));
+            }
+
+            ITuner::modus Modus;
+            uint16_t Frequency;
+            Broadcast::Modulation Modulation;
+            uint32_t SymbolRate;
+            uint16_t FEC;
+            SpectralInversion Inversion;
+        };
+
+    private:
+        struct Slot {
+            Slot(ITuner* tuner)
+                : Tuner(tuner)
+                , Current()
+                , Deadline(0)
+                , Busy(false)
+                , Locked(false)
+            {
+            }
+
+            ITuner* Tuner;
+            Multiplex Current;
+            uint64_t Deadline;
+            bool Busy;
+            bool Locked;
+        };
+
+        typedef std::list<Multiplex> Multiplexes;
+        typedef std::vector<Slot> Slots;
+
+    public:
+        // lockTimeout: time (ms) a multiplex gets to lock, dwellTime: time (ms) a tuner stays on
+        // a locked multiplex, it must cover the repetition rate of the NIT and the SDT.
+        NetworkScan(Networks& networks, const uint32_t lockTimeout = 2000, const uint32_t dwellTime = 12000)
+            : Core::Thread(Core::Thread::DefaultStackSize(), _T("NetworkScan"))
+            , _adminLock()
+            , _networks(networks)
+            , _lockTimeout(lockTimeout)
+            , _dwellTime(dwellTime)
+            , _slots()
+            , _pending()
+            , _seen()
+            , _running(false)
+            , _scanned(0)
+            , _locked(0)
+            , _signal(false, true)
+            , _sink(*this)
+        {
+            ITuner::Register(&_sink);
+            _networks.Register(&_sink);
+        }
+        ~NetworkScan() override
+        {
+            _networks.Unregister(&_sink);
+            ITuner::Unregister(&_sink);
+
+            Abort();
+            Stop();
+            _signal.SetEvent();
+            Wait(Core::Thread::STOPPED, Core::infinite);
+        }
+
+    public:
+        // The tuners are used until the scan completes or is aborted, they are not released.
+        uint32_t Start(const std::list<ITuner*>& tuners, const std::list<Multiplex>& seeds)
+        {
+            uint32_t result = Core::ERROR_INPROGRESS;
+
+            _adminLock.Lock();
+
+            if (_running == false) {
+                if (tuners.empty() == true) {
+                    result = Core::ERROR_UNAVAILABLE;
+                } else {
+                    _slots.clear();
+                    _pending.clear();
+                    _seen.clear();
+                    _scanned = 0;
+                    _locked = 0;
+
+                    for (ITuner* tuner : tuners) {
+                        _slots.emplace_back(tuner);
+                    }
+                    for (const Multiplex& entry : seeds) {
+                        Add(entry);
+                    }
+
+                    _running = true;
+                    result = Core::ERROR_NONE;
+
+                    _signal.SetEvent();
+                    Run();
+                }
+            }
+
+            _adminLock.Unlock();
+
+            return (result);
+        }
+        void Abort()
+        {
+            _adminLock.Lock();
+            _pending.clear();
+            _running = false;
+            _adminLock.Unlock();
+
+            _signal.SetEvent();
+        }
+        inline bool IsRunning() const
+        {
+            return (_running);
+        }
+        // Multiplexes not scanned yet.
+        uint32_t Pending() const
+        {
+            _adminLock.Lock();
+            uint32_t result = static_cast<uint32_t>(_pending.size());
+            _adminLock.Unlock();
+            return (result);
+        }
+        // Multiplexes scanned, and the ones of those that locked.
+        inline uint32_t Scanned() const
+        {
+            return (_scanned);
+        }
+        inline uint32_t Locked() const
+        {
+            return (_locked);
+        }
+
+    private:
+        void Add(const Multiplex& entry)
+        {
+            if ((entry.Frequency != 0) && (_seen.insert(entry.Key()).second == true)) {
+                _pending.push_back(entry);
+            }
+        }
+        // New multiplexes in the NIT's received so far.
+        void Discover()
+        {
+            Networks::Iterator index(_networks.List());
+
+            while (index.Next() == true) {
+                if (index.Current().IsValid() == true) {
+                    Add(Multiplex(index.Current()));
+                }
+            }
+        }
+        void Assign(Slot& slot, const uint64_t now)
+        {
+            const ITuner::modus modus(slot.Tuner->Modus());
+            Multiplexes::iterator index(_pending.begin());
+
+            while ((slot.Busy == false) && (index != _pending.end())) {
+                if (index->Modus != modus) {
+                    index++;
+                } else {
+                    slot.Current = *index;
+                    index = _pending.erase(index);
+
+                    if (slot.Tuner->Tune(slot.Current.Frequency, slot.Current.Modulation, slot.Current.SymbolRate, slot.Current.FEC, slot.Current.Inversion) == Core::ERROR_NONE) {
+                        TRACE_L1("Scanning %d MHz on tuner %p", slot.Current.Frequency, slot.Tuner);
+                        slot.Busy = true;
+                        slot.Locked = false;
+                        slot.Deadline = now + (_lockTimeout * Core::Time::TicksPerMillisecond);
+                    } else {
+                        _scanned++;
+                    }
+                }
+            }
+        }
+        uint32_t Worker() override
+        {
+            uint32_t delay = Core::infinite;
+
+            // Whatever is signalled from here on, is picked up in the next round.
+            _signal.ResetEvent();
+
+            _adminLock.Lock();
+
+            if (_running == true) {
+                const uint64_t now = Core::Time::Now().Ticks();
+                bool busy = false;
+
+                Discover();
+
+                for (Slot& slot : _slots) {
+                    if (slot.Busy == true) {
+                        if ((slot.Locked == false) && (slot.Tuner->State() != ITuner::IDLE)) {
+                            slot.Locked = true;
+                            slot.Deadline = now + (_dwellTime * Core::Time::TicksPerMillisecond);
+                            _locked++;
+                        } else if (now >= slot.Deadline) {
+                            slot.Busy = false;
+                            _scanned++;
+                        }
+                    }
+                    if (slot.Busy == false) {
+                        Assign(slot, now);
+                    }
+                    if (slot.Busy == true) {
+                        // Up to the first lock timeout or end of a dwell, if nothing wakes us before.
+                        delay = std::min(delay, static_cast<uint32_t>((slot.Deadline - now + Core::Time::TicksPerMillisecond - 1) / Core::Time::TicksPerMillisecond));
+                        busy = true;
+                    }
+                }
+
+                if (busy == false) {
+                    TRACE_L1("Scan completed, %d multiplexes of which %d locked", _scanned.load(), _locked.load());
+                    _running = false;
+                }
+            }
+
+            if (_running == false) {
+                Block();
+            }
+
+            _adminLock.Unlock();
+
+            if (_running == true) {
+                _signal.Lock(delay);
+                delay = 0;
+            }
+
+            return (delay);
+        }
+
+    private:
+        mutable Core::CriticalSection _adminLock;
+        Networks& _networks;
+        const uint32_t _lockTimeout;
+        const uint32_t _dwellTime;
+        Slots _slots;
+        Multiplexes _pending;
+        std::set<uint32_t> _seen;
+        std::atomic<bool> _running;
+        std::atomic<uint32_t> _scanned;
+        std::atomic<uint32_t> _locked;
+        Core::Event _signal;
+        Sink _sink;
+    };
+
+} // namespace Broadcast
+} // namespace Thunder
+
+#endif // NETWORKSCAN_H
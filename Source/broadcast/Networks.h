@@ -24,6 +24,9 @@
 #include "Descriptors.h"
 #include "NIT.h"
 #include "ProgramTable.h"
+#include "SectionBus.h"
+#include "Snapshot.h"
+#include "TextPool.h"
 
 namespace Thunder {
 
@@ -76,8 +79,10 @@ namespace Broadcast {
             Parser(Networks& parent, ITuner* source, const bool scan, const uint16_t pid)
                 : _parent(parent)
                 , _source(source)
+                , _link(parent._dispatcher, *this, 16384)
                 , _actual(Core::ProxyType<Core::DataStore>::Create(512))
                 , _others(Core::ProxyType<Core::DataStore>::Create(512))
+                , _repetitions()
                 , _pid(pid)
             {
                 if (scan == true) {
@@ -102,8 +107,8 @@ namespace Broadcast {
             {
                 if (scan == true) {
                     // Start loading the SDT info
-                    _source->Filter(_pid, DVB::NIT::ACTUAL, this);
-                    _source->Filter(_pid, DVB::NIT::OTHER, this);
+                    _source->Filter(_pid, DVB::NIT::ACTUAL, &_link);
+                    _source->Filter(_pid, DVB::NIT::OTHER, &_link);
                 } else {
                     _source->Filter(_pid, DVB::NIT::OTHER, nullptr);
                     _source->Filter(_pid, DVB::NIT::ACTUAL, nullptr);
@@ -116,15 +121,19 @@ namespace Broadcast {
 
                 ASSERT(section.IsValid());
 
-                if (section.TableId() == DVB::NIT::ACTUAL) {
+                if (_repetitions.IsRepetition(section) == true) {
+                    // Nothing changed since we loaded this table, skip it.
+                } else if (section.TableId() == DVB::NIT::ACTUAL) {
                     _actual.AddSection(section);
                     if (_actual.IsValid() == true) {
-                        _parent.Load(DVB::NIT(_actual));
+                        _parent.Update(_actual);
+                        _repetitions.Completed(section);
                     }
                 } else if (section.TableId() == DVB::NIT::OTHER) {
                     _others.AddSection(section);
                     if (_others.IsValid() == true) {
-                        _parent.Load(DVB::NIT(_others));
+                        _parent.Update(_others);
+                        _repetitions.Completed(section);
                     }
                 }
             }
@@ -132,89 +141,128 @@ namespace Broadcast {
         private:
             Networks& _parent;
             ITuner* _source;
+            SectionBus::Link _link;
             MPEG::Table _actual;
             MPEG::Table _others;
+            MPEG::RepetitionFilter _repetitions;
             uint16_t _pid;
         };
 
         typedef std::list<Parser> Scanners;
 
     public:
+        // Called, with the Networks locked, whenever a NIT changed the list of networks.
+        struct IObserver {
+            virtual ~IObserver() {}
+
+            virtual void Updated() = 0;
+        };
+
+        // Fixed size and trivially copyable, the name lives in the TextPool of the Networks.
         class Network {
+        public:
+            enum delivery : uint8_t {
+                UNKNOWN,
+                SATELLITE,
+                SATELLITE_S2,
+                CABLE,
+                TERRESTRIAL,
+                TERRESTRIAL_T2
+            };
+
         public:
             Network()
-                : _originalNetworkId(~0)
-                , _transportStreamId(~0)
+                : _names(nullptr)
+                , _name(TextPool::EMPTY)
                 , _frequency(0)
-                , _modulation(0)
                 , _symbolRate(0)
-                , _name()
+                , _bandwidth(0)
+                , _originalNetworkId(~0)
+                , _transportStreamId(~0)
+                , _modulation(0)
+                , _fec(0)
+                , _codeRateLP(0)
+                , _delivery(UNKNOWN)
             {
             }
-            Network(const DVB::NIT::NetworkIterator& info)
-                : _originalNetworkId(info.OriginalNetworkId())
-                , _transportStreamId(info.TransportStreamId())
+            Network(const DVB::NIT::NetworkIterator& info, TextPool& names)
+                : _names(&names)
+                , _name(TextPool::EMPTY)
                 , _frequency(0)
-                , _modulation(0)
                 , _symbolRate(0)
-                , _name()
+                , _bandwidth(0)
+                , _originalNetworkId(info.OriginalNetworkId())
+                , _transportStreamId(info.TransportStreamId())
+                , _modulation(0)
+                , _fec(0)
+                , _codeRateLP(0)
+                , _delivery(UNKNOWN)
             {
-                MPEG::DescriptorIterator index(info.Descriptors());
+                const MPEG::DescriptorIndex index(info.Descriptors());
 
-                if (index.Tag(DVB::Descriptors::NetworkName::TAG) == true) {
-                    DVB::Descriptors::NetworkName data(index.Current());
-                    _name = data.Name();
+                if (index.Has(DVB::Descriptors::NetworkName::TAG) == true) {
+                    DVB::Descriptors::NetworkName data(index[DVB::Descriptors::NetworkName::TAG]);
+                    _name = names.Intern(data.Name());
                 }
 
-                // Start searching from the beginning again !
-                index.Reset();
-
-                if (index.Tag(DVB::Descriptors::SatelliteDeliverySystem::TAG) == true) {
-                    DVB::Descriptors::SatelliteDeliverySystem data(index.Current());
+                if (index.Has(DVB::Descriptors::SatelliteDeliverySystem::TAG) == true) {
+                    DVB::Descriptors::SatelliteDeliverySystem data(index[DVB::Descriptors::SatelliteDeliverySystem::TAG]);
                     _frequency = data.Frequency();
                     _symbolRate = data.SymbolRate();
                     _modulation = data.Modulation();
-                } else {
-                    // Start searching from the beginning again !
-                    index.Reset();
-
-                    if (index.Tag(DVB::Descriptors::CableDeliverySystem::TAG) == true) {
-                        DVB::Descriptors::CableDeliverySystem data(index.Current());
-                        _frequency = data.Frequency();
-                        _symbolRate = data.SymbolRate();
-                        _modulation = data.Modulation();
+                    _fec = data.FECInner();
+                    _delivery = (data.S2() == true ? SATELLITE_S2 : SATELLITE);
+                } else if (index.Has(DVB::Descriptors::CableDeliverySystem::TAG) == true) {
+                    DVB::Descriptors::CableDeliverySystem data(index[DVB::Descriptors::CableDeliverySystem::TAG]);
+                    _frequency = data.Frequency();
+                    _symbolRate = data.SymbolRate();
+                    _modulation = data.Modulation();
+                    _fec = data.FECInner();
+                    _delivery = CABLE;
+                } else if (index.Has(DVB::Descriptors::TerrestrialDeliverySystem::TAG) == true) {
+                    DVB::Descriptors::TerrestrialDeliverySystem data(index[DVB::Descriptors::TerrestrialDeliverySystem::TAG]);
+                    _frequency = data.Frequency();
+                    _bandwidth = data.Bandwidth();
+                    _modulation = data.Modulation();
+                    _fec = data.CodeRateHP();
+                    _codeRateLP = data.CodeRateLP();
+                    _delivery = TERRESTRIAL;
+                } else if (index.Has(DVB::Descriptors::T2DeliverySystem::TAG) == true) {
+                    // Extension descriptors share the tag, look for the T2 one.
+                    MPEG::DescriptorIterator loop(info.Descriptors());
+
+                    while ((_delivery == UNKNOWN) && (loop.Tag(DVB::Descriptors::T2DeliverySystem::TAG) == true)) {
+                        DVB::Descriptors::T2DeliverySystem data(loop.Current());
+
+                        if ((data.IsValid() == true) && (data.Frequency() != 0)) {
+                            _frequency = data.Frequency();
+                            _bandwidth = data.Bandwidth();
+                            _delivery = TERRESTRIAL_T2;
+                        }
+                        loop.Next();
                     }
                 }
             }
-            Network(const Network& copy)
-                : _originalNetworkId(copy._originalNetworkId)
-                , _transportStreamId(copy._transportStreamId)
-                , _frequency(copy._frequency)
-                , _modulation(copy._modulation)
-                , _symbolRate(copy._symbolRate)
-                , _name(copy._name)
+
+        public:
+            bool IsValid() const
             {
+                return (_frequency != 0);
             }
-            ~Network()
+            inline string Name() const
             {
+                return (string(NameData()));
             }
-
-            Network& operator=(const Network& rhs)
+            // UTF-8, in the TextPool of the Networks. It is valid as long as the Networks, or an
+            // Iterator handed out by it, exist.
+            const char* NameData() const
             {
-                _originalNetworkId = rhs._originalNetworkId;
-                _transportStreamId = rhs._transportStreamId;
-                _frequency = rhs._frequency;
-                _modulation = rhs._modulation;
-                _symbolRate = rhs._symbolRate;
-                _name = rhs._name;
-
-                return (*this);
+                return (_names != nullptr ? _names->Data(_name) : _T(""));
             }
-
-        public:
-            bool IsValid() const
+            // Names are interned, equal names have equal handles.
+            inline TextPool::Handle NameHandle() const
             {
-                return (_frequency != 0);
+                return (_name);
             }
             inline uint16_t OriginalNetworkId() const
             {
@@ -224,7 +272,16 @@ namespace Broadcast {
             {
                 return (_transportStreamId);
             }
-            inline uint16_t Frequency() const
+            inline delivery Delivery() const
+            {
+                return (_delivery);
+            }
+            inline ITuner::modus Modus() const
+            {
+                return (_delivery == CABLE ? ITuner::Cable : ((_delivery == TERRESTRIAL) || (_delivery == TERRESTRIAL_T2)) ? ITuner::Terrestrial : ITuner::Satellite);
+            }
+            // Frequency in KHz
+            inline uint32_t Frequency() const
             {
                 return (_frequency);
             }
@@ -232,41 +289,85 @@ namespace Broadcast {
             {
                 return (_modulation);
             }
-            inline uint16_t SymbolRate() const
+            // Symbols/s, 0 for terrestrial networks.
+            inline uint32_t SymbolRate() const
             {
                 return (_symbolRate);
             }
+            // Terrestrial networks only, in Hz.
+            inline uint32_t Bandwidth() const
+            {
+                return (_bandwidth);
+            }
+            // The inner FEC, for terrestrial networks the code rate of the HP stream.
+            inline uint16_t FEC() const
+            {
+                return (_fec);
+            }
+            // Terrestrial networks only, the code rate of the LP stream.
+            inline uint16_t CodeRateLP() const
+            {
+                return (_codeRateLP);
+            }
 
         private:
+            const TextPool* _names;
+            TextPool::Handle _name;
+            uint32_t _frequency;
+            uint32_t _symbolRate;
+            uint32_t _bandwidth;
             uint16_t _originalNetworkId;
             uint16_t _transportStreamId;
-            uint16_t _frequency;
             uint16_t _modulation;
-            uint16_t _symbolRate;
-            string _name;
+            uint16_t _fec;
+            uint16_t _codeRateLP;
+            delivery _delivery;
         };
 
-        typedef IteratorType<Network> Iterator;
+        static_assert(std::is_trivially_copyable<Network>::value, "Network records are copied around a lot");
 
     private:
         typedef std::map<uint16_t, Network> NetworkMap;
+        typedef std::list<IObserver*> Observers;
 
     public:
+        // A snapshot of the list, it is not affected by updates received after it was taken.
+        typedef IteratorType<Network, NetworkMap> Iterator;
+
         Networks()
             : _adminLock()
+            , _dispatcher(_adminLock, _T("NetworkParser"))
             , _scanners()
             , _sink(*this)
             , _scan(true)
-            , _networks()
+            , _names(std::make_shared<TextPool>(12))
+            , _networks(std::make_shared<const NetworkMap>())
+            , _snapshot()
+            , _restored(true)
+            , _observers()
         {
             ITuner::Register(&_sink);
         }
         virtual ~Networks()
         {
             ITuner::Unregister(&_sink);
+
+            // The Links of the parsers are detached under the lock the Dispatcher runs with.
+            _adminLock.Lock();
+            _scanners.clear();
+            _adminLock.Unlock();
         }
 
     public:
+        // Time from the arrival of a section on the tuner, to it being parsed.
+        inline const SectionBus::Histogram& Latency() const
+        {
+            return (_dispatcher.Latency());
+        }
+        inline uint32_t Dropped() const
+        {
+            return (_dispatcher.Dropped());
+        }
         void Scan(const bool scan)
         {
             _adminLock.Lock();
@@ -281,13 +382,37 @@ namespace Broadcast {
             }
             _adminLock.Unlock();
         }
+        void Register(IObserver* observer)
+        {
+            _adminLock.Lock();
+
+            ASSERT(std::find(_observers.begin(), _observers.end(), observer) == _observers.end());
+
+            _observers.push_back(observer);
+
+            _adminLock.Unlock();
+        }
+        // Once returned, the observer is not called anymore.
+        void Unregister(IObserver* observer)
+        {
+            _adminLock.Lock();
+
+            Observers::iterator index(std::find(_observers.begin(), _observers.end(), observer));
+
+            if (index != _observers.end()) {
+                _observers.erase(index);
+            }
+
+            _adminLock.Unlock();
+        }
         Network Id(const uint16_t id) const
         {
             Network result;
 
             _adminLock.Lock();
-            NetworkMap::const_iterator index(_networks.find(id));
-            if (index != _networks.end()) {
+            Restored();
+            NetworkMap::const_iterator index(_networks->find(id));
+            if (index != _networks->end()) {
                 result = index->second;
             }
             _adminLock.Unlock();
@@ -298,13 +423,68 @@ namespace Broadcast {
         {
 
             _adminLock.Lock();
+            Restored();
             Iterator value(_networks);
             _adminLock.Unlock();
 
             return (value);
         }
 
+        // Load the networks from a Snapshot persisted with Store(). The file is mapped
+        // now, the tables are parsed on first use and are replaced by the broadcasted
+        // ones, as soon as these are received and turn out to be different.
+        uint32_t Restore(const string& fileName)
+        {
+            _adminLock.Lock();
+
+            uint32_t result = _snapshot.Open(fileName);
+
+            if (result == Core::ERROR_NONE) {
+                _restored = false;
+            }
+
+            _adminLock.Unlock();
+
+            return (result);
+        }
+        uint32_t Store(const string& fileName) const
+        {
+            _adminLock.Lock();
+
+            uint32_t result = _snapshot.Save(fileName);
+
+            _adminLock.Unlock();
+
+            return (result);
+        }
+
     private:
+        void Restored() const
+        {
+            if (_restored == false) {
+                _restored = true;
+
+                Snapshot::Iterator index(_snapshot.Tables());
+
+                while (index.Next() == true) {
+                    if ((index.TableId() == DVB::NIT::ACTUAL) || (index.TableId() == DVB::NIT::OTHER)) {
+                        const_cast<Networks&>(*this).Load(DVB::NIT(index.Extension(), index.Data()));
+                    }
+                }
+            }
+        }
+        void Update(const MPEG::Table& table)
+        {
+            _adminLock.Lock();
+
+            Restored();
+
+            if (_snapshot.Update(0, table) == true) {
+                Load(DVB::NIT(table));
+            }
+
+            _adminLock.Unlock();
+        }
         void Deactivated(ITuner* tuner)
         {
             _adminLock.Lock();
@@ -345,19 +525,42 @@ namespace Broadcast {
 
             DVB::NIT::NetworkIterator index = table.Networks();
 
+            // Copy on write, iterators handed out keep the previous version.
+            NetworkMap* entries(new NetworkMap(*_networks));
+
             while (index.Next() == true) {
-                _networks[index.TransportStreamId()] = Network(index);
+                (*entries)[index.TransportStreamId()] = Network(index, *_names);
+            }
+
+            _networks = Publish(entries);
+
+            for (IObserver* observer : _observers) {
+                observer->Updated();
             }
 
             _adminLock.Unlock();
         }
 
+        // The names of the records point into the pool, a snapshot keeps it alive for as long
+        // as it is iterated, even if the Networks are gone by then.
+        Iterator::Snapshot Publish(NetworkMap* entries) const
+        {
+            std::shared_ptr<TextPool> names(_names);
+
+            return (Iterator::Snapshot(entries, [names](const NetworkMap* map) { delete map; }));
+        }
+
     private:
         mutable Core::CriticalSection _adminLock;
+        SectionBus::Dispatcher _dispatcher;
         Scanners _scanners;
         Sink _sink;
         bool _scan;
-        NetworkMap _networks;
+        std::shared_ptr<TextPool> _names;
+        Iterator::Snapshot _networks;
+        Snapshot _snapshot;
+        mutable bool _restored;
+        Observers _observers;
     };
 
 } // namespace Broadcast
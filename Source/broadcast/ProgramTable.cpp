@@ -24,6 +24,7 @@ namespace Thunder {
 namespace Broadcast {
 
     /* static */ Core::ProxyPoolType<Core::DataStore> ProgramTable::_storeFactory(2);
+    /* static */ constexpr uint32_t ProgramTable::Index::EMPTY;
 
     /* static */ ProgramTable& ProgramTable::Instance()
     {
@@ -31,71 +32,186 @@ namespace Broadcast {
         return (_instance);
     }
 
+    void ProgramTable::Restored() const
+    {
+        if (_restored.load(std::memory_order_relaxed) == false) {
+            // Into the index being loaded, if there is one, it is published with the rest.
+            Programs current(std::atomic_load(&_programs));
+            std::shared_ptr<Index> next(_update != nullptr ? _update : std::make_shared<Index>(*current));
+            Snapshot::Iterator index(_snapshot.Tables());
+
+            while (index.Next() == true) {
+                if (index.TableId() == MPEG::PAT::ID) {
+                    MPEG::PAT patTable(index.Extension(), index.Data());
+                    MPEG::PAT::ProgramIterator program(patTable.Programs());
+
+                    while (program.Next() == true) {
+                        if (program.ProgramNumber() == 0) {
+                            _nitPids.emplace(index.KeyId(), program.Pid());
+                        }
+                    }
+                } else if (index.TableId() == MPEG::PMT::ID) {
+                    // What we received from the broadcast already, is leading.
+                    next->Insert(Key(index.KeyId(), index.Extension()), MPEG::PMT(index.Extension(), index.Data()), false);
+                }
+            }
+
+            if (_update == nullptr) {
+                std::atomic_store(&_programs, Programs(next));
+            }
+            _restored.store(true, std::memory_order_release);
+        }
+    }
+
     /* virtual */ void
     ProgramTable::Observer::Handle(const MPEG::Section& section)
     {
-        bool completedStep = false;
-
         if (section.IsValid() == true) {
             if (section.TableId() == MPEG::PAT::ID) {
-                _table.AddSection(section);
-
-                if (_table.IsValid() == true) {
-                    // Iterator over this table and find all program Pids
-                    MPEG::PAT patTable(_table);
-                    MPEG::PAT::ProgramIterator index(patTable.Programs());
-                    while (index.Next() == true) {
-
-                        if (index.ProgramNumber() == 0) {
-                            // ProgramNumber == 0 is reserved for the NIT pid
-                            _parent._nitPids[_keyId] = index.Pid();
-                        } else {
-                            _entries.push_back(index.Pid() | (index.ProgramNumber() << 16));
-                            TRACE_L1("ProgramNumber: %d on PID: %d", index.ProgramNumber(), index.Pid());
+                // Repetitions of a PAT we already processed, carry nothing new.
+                if (_repetitions.IsRepetition(section) == false) {
+                    _table.AddSection(section);
+
+                    if (_table.IsValid() == true) {
+                        // A new PAT, whatever we were loading is outdated.
+                        Release();
+
+                        // Iterator over this table and find all program Pids
+                        MPEG::PAT patTable(_table);
+                        MPEG::PAT::ProgramIterator index(patTable.Programs());
+                        while (index.Next() == true) {
+
+                            if (index.ProgramNumber() == 0) {
+                                // ProgramNumber == 0 is reserved for the NIT pid
+                                _parent._nitPids[_keyId] = index.Pid();
+                            } else {
+                                _entries.push_back(index.Pid() | (index.ProgramNumber() << 16));
+                                TRACE_L1("ProgramNumber: %d on PID: %d", index.ProgramNumber(), index.Pid());
+                            }
                         }
+                        _parent.AddNetwork(_keyId, _table);
+                        _repetitions.Completed(section);
+                        _table.Clear();
+
+                        Acquire();
                     }
-                    completedStep = true;
                 }
             } else if (section.TableId() == MPEG::PMT::ID) {
-                _table.AddSection(section);
+                // Only the PMT's of the current PAT that are still to load are looked at, these
+                // are not filtered on repetitions. After a new PAT all its PMT's are loaded again,
+                // also the ones that did not change.
+                const uint16_t programNumber = section.Extension();
+
+                ScanMap::iterator entry(std::find_if(_entries.begin(), _entries.end(),
+                    [programNumber](const uint32_t element) { return ((element >> 16) == programNumber); }));
 
-                if (_table.IsValid() == true) {
+                if (entry != _entries.end()) {
+                    MPEG::Table& table(Assembly(programNumber));
 
-                    completedStep = true;
+                    table.AddSection(section);
 
-                    uint32_t key = static_cast<uint16_t>(_entries.front() & 0xFFFF) | (_table.Extension() << 16);
+                    if (table.IsValid() == true) {
+                        const uint16_t pid = static_cast<uint16_t>(*entry & 0xFFFF);
 
-                    ScanMap::iterator index(_entries.begin());
+                        _entries.erase(entry);
 
-                    while (index != _entries.end()) {
-                        if (*index == key) {
-                            index = _entries.erase(index);
-                        } else {
-                            completedStep = completedStep && ((*index & 0xFFFF) != (key & 0xFFFF));
-                            index++;
+                        // Multiple PMT's can share a PID, only close it once they are all in.
+                        if (std::find_if(_entries.begin(), _entries.end(), [pid](const uint32_t element) { return ((element & 0xFFFF) == pid); }) == _entries.end()) {
+                            Close(pid);
                         }
-                    }
 
-                    if (_parent.AddProgram(_keyId, _table) == true) {
-                        // do not forget to get a new storage space, the previous one is now
-                        // with the AddProgram !!!
-                        _table.Storage(_storeFactory.Element());
+                        // If added, the storage of the table is now with the PMT and it is not
+                        // returned to the pool until the PMT is replaced.
+                        if (_parent.AddProgram(_keyId, table, _entries.empty()) == true) {
+                            TRACE_L1("PMT for %d loaded. PMTs left to load: %d", programNumber, static_cast<uint32_t>(_entries.size()));
+                        }
 
-                        TRACE_L1("PMT for %d loaded. PID load for PMTs completed: %s", _table.Extension(), completedStep ? _T("true") : _T("false"));
+                        _assemblies.remove_if([programNumber](const std::pair<uint16_t, MPEG::Table>& element) { return (element.first == programNumber); });
+
+                        Acquire();
                     }
                 }
             }
+        }
+    }
 
-            if (completedStep == true) {
-                _table.Clear();
-                if (_entries.size() > 0) {
-                    _callback->ChangePid(static_cast<uint16_t>(_entries.front() & 0xFFFF),
-                        this);
-                } else {
-                    _callback->ChangePid(0xFFFF, this);
+    MPEG::Table& ProgramTable::Observer::Assembly(const uint16_t programNumber)
+    {
+        Assemblies::iterator index(std::find_if(_assemblies.begin(), _assemblies.end(),
+            [programNumber](const std::pair<uint16_t, MPEG::Table>& element) { return (element.first == programNumber); }));
+
+        if (index == _assemblies.end()) {
+            _assemblies.emplace_back(std::piecewise_construct,
+                std::forward_as_tuple(programNumber),
+                std::forward_as_tuple(_storeFactory.Element(), &_storeFactory));
+            index = std::prev(_assemblies.end());
+        }
+
+        return (index->second);
+    }
+
+    // Open filters on the PIDs with PMT's still to load, in PAT order, up to the
+    // concurrency limit. The first one always is the PID of the monitor (ChangePid).
+    void ProgramTable::Observer::Acquire()
+    {
+        if (_entries.empty() == true) {
+            _primary = NO_PID;
+            _callback->ChangePid(NO_PID, this);
+        } else {
+            const uint8_t limit = _parent.Concurrency();
+            uint32_t open = static_cast<uint32_t>(_open.count()) + (_primary != NO_PID ? 1 : 0);
+            ScanMap::const_iterator index(_entries.begin());
+
+            while ((index != _entries.end()) && (open < limit)) {
+                const uint16_t pid = static_cast<uint16_t>(*index & 0xFFFF);
+
+                if ((pid != _primary) && (_open.test(pid) == false)) {
+                    if (_primary == NO_PID) {
+                        _primary = pid;
+                        _callback->ChangePid(pid, this);
+                    } else if (_callback->AddPid(pid, this) == Core::ERROR_NONE) {
+                        _open.set(pid);
+                    } else {
+                        // Out of filters, continue once one is closed.
+                        break;
+                    }
+                    open++;
                 }
+                index++;
+            }
+        }
+    }
+
+    void ProgramTable::Observer::Close(const uint16_t pid)
+    {
+        if (pid == _primary) {
+            // Acquire moves it to the next PID, no need to close it.
+            _primary = NO_PID;
+        } else if (_open.test(pid) == true) {
+            _callback->RemovePid(pid);
+            _open.reset(pid);
+        }
+    }
+
+    void ProgramTable::Observer::Release()
+    {
+        if (_entries.empty() == false) {
+            // Not completed, publish what was loaded so far.
+            _parent._adminLock.Lock();
+            _parent.Publish();
+            _parent._adminLock.Unlock();
+        }
+
+        for (uint16_t pid = 0; (_open.any() == true) && (pid < _open.size()); pid++) {
+            if (_open.test(pid) == true) {
+                _callback->RemovePid(pid);
+                _open.reset(pid);
             }
         }
+
+        _primary = NO_PID;
+        _entries.clear();
+        _assemblies.clear();
     }
 
 } // namespace Broadcast
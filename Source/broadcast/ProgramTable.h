@@ -20,19 +20,141 @@
 #ifndef PROGRAMTABLE_H
 #define PROGRAMTABLE_H
 
+#include <atomic>
+#include <bitset>
+
 #include "Definitions.h"
 #include "MPEGTable.h"
+#include "Snapshot.h"
 
 namespace Thunder {
 
 namespace Broadcast {
 
     class ProgramTable {
+    public:
+        // Flat, open addressing (linear probing), index of all PMT's. Once published an
+        // index is never changed, an update creates a new index, so readers do not need
+        // a lock (RCU like). PMT's only change on a version update, lookups happen on
+        // every zap.
+        class Index {
+        private:
+            Index& operator=(const Index&) = delete;
+
+            static constexpr uint32_t EMPTY = ~0;
+            static constexpr uint8_t INITIAL_BITS = 6;
+
+            // Keys and PMT's are kept apart, probing only touches the keys.
+            typedef std::vector<uint32_t> Keys;
+            typedef std::vector<MPEG::PMT> Values;
+
+        public:
+            Index()
+                : _bits(INITIAL_BITS)
+                , _count(0)
+                , _keys(1 << INITIAL_BITS, EMPTY)
+                , _values(1 << INITIAL_BITS)
+            {
+            }
+            Index(const Index& copy)
+                : _bits(copy._bits)
+                , _count(copy._count)
+                , _keys(copy._keys)
+                , _values(copy._values)
+            {
+            }
+            ~Index()
+            {
+            }
+
+        public:
+            inline uint32_t Count() const
+            {
+                return (_count);
+            }
+            const MPEG::PMT* Find(const uint32_t key) const
+            {
+                const uint32_t mask = static_cast<uint32_t>(_keys.size() - 1);
+                uint32_t slot = Slot(key);
+
+                while ((_keys[slot] != key) && (_keys[slot] != EMPTY)) {
+                    slot = (slot + 1) & mask;
+                }
+
+                return (_keys[slot] == key ? &(_values[slot]) : nullptr);
+            }
+            // Returns false if the key is already in the index and replace is not requested.
+            bool Insert(const uint32_t key, const MPEG::PMT& pmt, const bool replace)
+            {
+                ASSERT(key != EMPTY);
+
+                if (((_count + 1) * 2) > _keys.size()) {
+                    // Keep the load factor below 50%, probe sequences stay short.
+                    Grow();
+                }
+
+                const uint32_t mask = static_cast<uint32_t>(_keys.size() - 1);
+                uint32_t slot = Slot(key);
+
+                while ((_keys[slot] != key) && (_keys[slot] != EMPTY)) {
+                    slot = (slot + 1) & mask;
+                }
+
+                bool result = (_keys[slot] == EMPTY);
+
+                if (result == true) {
+                    _keys[slot] = key;
+                    _values[slot] = pmt;
+                    _count++;
+                } else if (replace == true) {
+                    _values[slot] = pmt;
+                    result = true;
+                }
+
+                return (result);
+            }
+
+        private:
+            inline uint32_t Slot(const uint32_t key) const
+            {
+                // Fibonacci hashing, the keys (keyId/programNumber) are far from random.
+                return ((key * 0x9E3779B1u) >> (32 - _bits));
+            }
+            void Grow()
+            {
+                Keys keys(static_cast<size_t>(1) << (_bits + 1), EMPTY);
+                Values values(keys.size());
+
+                _keys.swap(keys);
+                _values.swap(values);
+                _bits++;
+                _count = 0;
+
+                for (uint32_t index = 0; index < keys.size(); index++) {
+                    if (keys[index] != EMPTY) {
+                        Insert(keys[index], values[index], false);
+                    }
+                }
+            }
+
+        private:
+            uint8_t _bits;
+            uint32_t _count;
+            Keys _keys;
+            Values _values;
+        };
+
     private:
         ProgramTable()
             : _adminLock()
             , _observers()
-            , _programs()
+            , _programs(std::make_shared<const Index>())
+            , _update()
+            , _updating(false)
+            , _nitPids()
+            , _snapshot()
+            , _restored(true)
+            , _concurrency(1)
         {
         }
         ProgramTable(const ProgramTable&) = delete;
@@ -46,80 +168,163 @@ namespace Broadcast {
             Observer(const Observer&) = delete;
             Observer& operator=(const Observer&) = delete;
 
-            typedef std::list<uint32_t> ScanMap;
+            static constexpr uint16_t NO_PID = 0xFFFF;
+
+            // PMT's to load: ProgramNumber(16)/PID(16), in PAT order, and the PID's
+            // that have a filter open next to the one of the monitor.
+            typedef std::vector<uint32_t> ScanMap;
+            typedef std::bitset<0x2000> PIDs;
+
+            // PMT's being loaded in parallel are assembled per ProgramNumber.
+            typedef std::list<std::pair<uint16_t, MPEG::Table>> Assemblies;
 
         public:
             Observer(ProgramTable* parent, const uint16_t keyId, IMonitor* callback)
                 : _parent(*parent)
                 , _callback(callback)
                 , _keyId(keyId)
-                , _table(_storeFactory.Element())
+                , _table(_storeFactory.Element(), &_storeFactory)
                 , _entries()
+                , _open()
+                , _primary(NO_PID)
+                , _assemblies()
+                , _repetitions()
             {
             }
             virtual ~Observer() {}
 
+            inline bool operator==(const IMonitor* rhs) const
+            {
+                return (_callback == rhs);
+            }
+            inline bool operator!=(const IMonitor* rhs) const
+            {
+                return (!operator==(rhs));
+            }
+
         public:
             virtual void Handle(const MPEG::Section& section) override;
 
+        private:
+            MPEG::Table& Assembly(const uint16_t programNumber);
+            void Acquire();
+            void Close(const uint16_t pid);
+            void Release();
+
         private:
             ProgramTable& _parent;
             IMonitor* _callback;
             uint16_t _keyId;
             MPEG::Table _table;
             ScanMap _entries;
+            PIDs _open;
+            uint16_t _primary;
+            Assemblies _assemblies;
+            MPEG::RepetitionFilter _repetitions;
         };
 
-        typedef std::map<uint32_t, MPEG::PMT> Programs;
-        typedef std::map<IMonitor*, Observer> Observers;
+        typedef std::shared_ptr<const Index> Programs;
+        typedef std::vector<Observer*> Observers;
         typedef std::map<uint32_t, uint16_t> NITPids;
 
     public:
         static ProgramTable& Instance();
-        virtual ~ProgramTable() {}
+        virtual ~ProgramTable()
+        {
+            for (Observer* entry : _observers) {
+                delete entry;
+            }
+        }
 
     public:
-        inline void Reset() { _programs.clear(); }
+        inline void Reset()
+        {
+            _adminLock.Lock();
+            _update.reset();
+            _updating.store(false, std::memory_order_release);
+            std::atomic_store(&_programs, Programs(std::make_shared<const Index>()));
+            _adminLock.Unlock();
+        }
         ISection* Register(IMonitor* callback, const uint16_t keyId)
         {
             _adminLock.Lock();
 
-            ASSERT(_observers.find(callback) == _observers.end());
+            ASSERT(std::find_if(_observers.begin(), _observers.end(), [callback](const Observer* entry) { return (*entry == callback); }) == _observers.end());
 
-            auto index = _observers.emplace(
-                std::piecewise_construct, std::forward_as_tuple(callback),
-                std::forward_as_tuple(this, keyId, callback));
+            Observer* result = new Observer(this, keyId, callback);
+            _observers.push_back(result);
 
             _adminLock.Unlock();
 
-            return &(index.first->second);
+            return (result);
         }
         void Unregister(IMonitor* callback)
         {
 
             _adminLock.Lock();
 
-            Observers::iterator index(_observers.find(callback));
+            Observers::iterator index(std::find_if(_observers.begin(), _observers.end(), [callback](const Observer* entry) { return (*entry == callback); }));
 
             if (index != _observers.end()) {
+                delete *index;
                 _observers.erase(index);
             }
 
+            // Whatever it loaded so far, is loaded.
+            Publish();
+
             _adminLock.Unlock();
         }
+        // The number of PMT PIDs loaded in parallel, if the monitor supports it
+        // (IMonitor::AddPid). 1 loads the PMT's one PID at a time.
+        inline void Concurrency(const uint8_t maxPids)
+        {
+            _concurrency = std::max(maxPids, static_cast<uint8_t>(1));
+        }
+        inline uint8_t Concurrency() const
+        {
+            return (_concurrency);
+        }
+        // This is called on every channel change. Once the PMT's are loaded, it is lock free.
+        // While a restored snapshot is still to be taken into use, or PMT's are being loaded
+        // (and are not published yet), the lookup takes the lock.
         inline bool Program(const uint16_t keyId, const uint16_t programId, MPEG::PMT& pmt) const
         {
             bool updated = false;
+            bool found = false;
+            const uint32_t key(Key(keyId, programId));
 
-            _adminLock.Lock();
+            if (_restored.load(std::memory_order_acquire) == false) {
+                _adminLock.Lock();
+                Restored();
+                _adminLock.Unlock();
+            }
+
+            if (_updating.load(std::memory_order_acquire) == true) {
+                _adminLock.Lock();
+
+                if (_update != nullptr) {
+                    const MPEG::PMT* entry(_update->Find(key));
 
-            Programs::const_iterator index(_programs.find(Key(keyId, programId)));
-            if (index != _programs.end()) {
-                updated = (index->second != pmt);
-                pmt = index->second;
+                    if (entry != nullptr) {
+                        found = true;
+                        updated = (*entry != pmt);
+                        pmt = *entry;
+                    }
+                }
+
+                _adminLock.Unlock();
             }
 
-            _adminLock.Unlock();
+            if (found == false) {
+                Programs programs(std::atomic_load(&_programs));
+                const MPEG::PMT* entry(programs->Find(key));
+
+                if (entry != nullptr) {
+                    updated = (*entry != pmt);
+                    pmt = *entry;
+                }
+            }
 
             return (updated);
         }
@@ -127,51 +332,118 @@ namespace Broadcast {
         {
             uint16_t result(~0);
 
+            _adminLock.Lock();
+
+            Restored();
+
             NITPids::const_iterator index(_nitPids.find(keyId));
 
             if (index != _nitPids.end()) {
                 result = index->second;
             }
 
+            _adminLock.Unlock();
+
+            return (result);
+        }
+
+        // Load the PAT/PMT's from a Snapshot persisted with Store(). The PMT's point
+        // directly into the mapped file and are taken into use on the first lookup.
+        uint32_t Restore(const string& fileName)
+        {
+            _adminLock.Lock();
+
+            uint32_t result = _snapshot.Open(fileName);
+
+            if (result == Core::ERROR_NONE) {
+                _restored.store(false, std::memory_order_release);
+            }
+
+            _adminLock.Unlock();
+
+            return (result);
+        }
+        uint32_t Store(const string& fileName) const
+        {
+            _adminLock.Lock();
+
+            uint32_t result = _snapshot.Save(fileName);
+
+            _adminLock.Unlock();
+
             return (result);
         }
 
     private:
-        inline uint32_t Key(const uint16_t keyId, const uint16_t programId) const
+        static inline uint32_t Key(const uint16_t keyId, const uint16_t programId)
+        {
+            return ((static_cast<uint32_t>(keyId) << 16) | programId);
+        }
+        void Restored() const;
+        void AddNetwork(const uint16_t keyId, const MPEG::Table& data)
         {
-            uint64_t result = keyId;
-            return ((result << 16) | programId);
+            _adminLock.Lock();
+
+            Restored();
+
+            _snapshot.Update(keyId, data);
+
+            _adminLock.Unlock();
         }
-        bool AddProgram(const uint16_t keyId, const MPEG::Table& data)
+        // The PMT's of a PAT are collected in one writable copy of the index, which is
+        // published once the last of them is in (completed), not copied per PMT.
+        bool AddProgram(const uint16_t keyId, const MPEG::Table& data, const bool completed)
         {
             bool added = false;
-            uint64_t key(Key(keyId, data.Extension()));
+            uint32_t key(Key(keyId, data.Extension()));
+            MPEG::PMT entry(data);
 
             _adminLock.Lock();
 
-            Programs::iterator index(_programs.find(key));
-            if (index != _programs.end()) {
-                MPEG::PMT entry(data);
-                if (index->second != entry) {
-                    added = true;
-                    index->second = entry;
+            Restored();
+
+            _snapshot.Update(keyId, data);
+
+            // Writers are serialized by the lock, readers keep using the old index.
+            Programs current(std::atomic_load(&_programs));
+            const MPEG::PMT* existing(_update != nullptr ? _update->Find(key) : current->Find(key));
+
+            if ((existing == nullptr) || (*existing != entry)) {
+                if (_update == nullptr) {
+                    _update = std::make_shared<Index>(*current);
+                    _updating.store(true, std::memory_order_release);
                 }
-            } else {
-                _programs.emplace(std::piecewise_construct, std::forward_as_tuple(key),
-                    std::forward_as_tuple(data.Extension(), data.Data()));
+                _update->Insert(key, entry, true);
                 added = true;
             }
 
+            if (completed == true) {
+                Publish();
+            }
+
             _adminLock.Unlock();
 
             return (added);
         }
+        void Publish() const
+        {
+            if (_update != nullptr) {
+                std::atomic_store(&_programs, Programs(std::move(_update)));
+                _updating.store(false, std::memory_order_release);
+            }
+        }
 
     private:
         mutable Core::CriticalSection _adminLock;
         Observers _observers;
-        Programs _programs;
-        NITPids _nitPids;
+        mutable Programs _programs;
+        // Changes not yet published, only accessed under the lock.
+        mutable std::shared_ptr<Index> _update;
+        mutable std::atomic<bool> _updating;
+        mutable NITPids _nitPids;
+        Snapshot _snapshot;
+        mutable std::atomic<bool> _restored;
+        std::atomic<uint8_t> _concurrency;
     };
 
 } // namespace Broadcast
@@ -23,6 +23,8 @@
 #include "Definitions.h"
 #include "Descriptors.h"
 #include "EIT.h"
+#include "SectionBus.h"
+#include "TextPool.h"
 
 namespace Thunder {
 
@@ -71,12 +73,16 @@ namespace Broadcast {
             Parser(const Parser&) = delete;
             Parser& operator=(const Parser&) = delete;
 
+            // The EIT other carries the services of other transport streams, the service_id of the
+            // section is only unique per OriginalNetworkId(16)/TransportStreamId(16).
+            typedef std::map<uint32_t, MPEG::RepetitionFilter> Repetitions;
+
         public:
             Parser(Schedules& parent, ITuner* source, const bool scan)
                 : _parent(parent)
                 , _source(source)
-                , _actual(Core::ProxyType<Core::DataStore>::Create(512))
-                , _others(Core::ProxyType<Core::DataStore>::Create(512))
+                , _link(parent._dispatcher, *this, 65536)
+                , _repetitions()
             {
                 if (scan == true) {
                     Scan(true);
@@ -98,13 +104,24 @@ namespace Broadcast {
         public:
             void Scan(const bool scan)
             {
+                const uint8_t tables = _parent._tables;
+
                 if (scan == true) {
-                    // Start loading the SDT info
-                    _source->Filter(0x11, DVB::EIT::ACTUAL, this);
-                    _source->Filter(0x11, DVB::EIT::OTHER, this);
+                    // Start loading the EIT info, present/following and the schedule tables covering the days requested.
+                    _source->Filter(DVB::EIT::PID, DVB::EIT::ACTUAL, &_link);
+                    _source->Filter(DVB::EIT::PID, DVB::EIT::OTHER, &_link);
+                    for (uint8_t table = 0; table < tables; table++) {
+                        _source->Filter(DVB::EIT::PID, DVB::EIT::ACTUAL_SCHEDULE + table, &_link);
+                        _source->Filter(DVB::EIT::PID, DVB::EIT::OTHER_SCHEDULE + table, &_link);
+                    }
                 } else {
-                    _source->Filter(0x11, DVB::EIT::OTHER, nullptr);
-                    _source->Filter(0x11, DVB::EIT::ACTUAL, nullptr);
+                    for (uint8_t table = tables; table > 0; table--) {
+                        _source->Filter(DVB::EIT::PID, DVB::EIT::OTHER_SCHEDULE + table - 1, nullptr);
+                        _source->Filter(DVB::EIT::PID, DVB::EIT::ACTUAL_SCHEDULE + table - 1, nullptr);
+                    }
+                    _source->Filter(DVB::EIT::PID, DVB::EIT::OTHER, nullptr);
+                    _source->Filter(DVB::EIT::PID, DVB::EIT::ACTUAL, nullptr);
+                    _repetitions.clear();
                 }
             }
 
@@ -114,15 +131,22 @@ namespace Broadcast {
 
                 ASSERT(section.IsValid());
 
-                if (section.TableId() == DVB::EIT::ACTUAL) {
-                    _actual.AddSection(section);
-                    if (_actual.IsValid() == true) {
-                        _parent.Load(DVB::EIT(_actual));
-                    }
-                } else if (section.TableId() == DVB::EIT::OTHER) {
-                    _others.AddSection(section);
-                    if (_others.IsValid() == true) {
-                        _parent.Load(DVB::EIT(_others));
+                DVB::EIT table(section);
+
+                if (table.IsValid() == true) {
+                    const uint32_t stream = ((table.OriginalNetworkId() << 16) | table.TransportStreamId());
+                    MPEG::RepetitionFilter& repetitions(_repetitions[stream]);
+
+                    // EIT events are self contained per section, no need to wait for the full
+                    // table (which for the schedule can take up to 30s to complete), each
+                    // section is accepted on its own.
+                    if (repetitions.IsRepetition(section) == false) {
+                        _parent.Load(table);
+
+                        if (table.IsSchedule() == true) {
+                            _parent.Cover(table, section);
+                        }
+                        repetitions.Accepted(section);
                     }
                 }
             }
@@ -130,27 +154,233 @@ namespace Broadcast {
         private:
             Schedules& _parent;
             ITuner* _source;
-            MPEG::Table _actual;
-            MPEG::Table _others;
+            SectionBus::Link _link;
+            Repetitions _repetitions;
         };
 
         typedef std::list<Parser> Scanners;
 
+        // Fixed size event record, all text lives in the TextPool.
+        struct Record {
+            uint32_t Start; // Seconds since the epoch, UTC
+            uint32_t Duration; // Seconds
+            TextPool::Handle Name;
+            TextPool::Handle Text;
+            TextPool::Handle Extended;
+            uint16_t EventId;
+            uint8_t Info; // FreeToAir(1)/RunningMode(3)
+            char Language[3];
+
+            inline uint32_t End() const
+            {
+                return (Start + Duration);
+            }
+        };
+
+        typedef std::vector<Record> Records;
+        typedef std::map<uint64_t, Records> Channels;
+
+        // A schedule table holds 4 days in 32 segments of 3 hours, of at most 8 sections each.
+        static constexpr uint8_t SEGMENTS = 32;
+        static constexpr uint32_t SEGMENT_DURATION = (3 * 60 * 60);
+        static constexpr uint8_t NO_VERSION = 0xFF;
+
+        // The sections received of one schedule table of a service. A segment is complete if
+        // all sections up to its segment_last_section_number are received.
+        struct Segments {
+            Segments()
+                : Version(NO_VERSION)
+                , LastSection(0)
+            {
+                ::memset(Received, 0, sizeof(Received));
+                ::memset(Expected, 0, sizeof(Expected));
+            }
+
+            uint8_t Version;
+            uint8_t LastSection;
+            uint8_t Received[SEGMENTS];
+            uint8_t Expected[SEGMENTS];
+        };
+
+        // Per service, the actual and the other schedule (they have their own versions).
+        struct Coverage {
+            Coverage(const uint8_t tables)
+                : LastTable(0)
+                , Tables(tables)
+            {
+            }
+
+            // The last table the broadcaster has for this service, relative to the first one.
+            uint8_t LastTable;
+            std::vector<Segments> Tables;
+        };
+
+        // Key of the service shifted left by one, the lowest bit set for the other schedule.
+        typedef std::map<uint64_t, Coverage> Coverages;
+
+    public:
+        // Called, with the Schedules locked, whenever a segment of the schedule of a service on
+        // the given transport stream completed, see IsComplete().
+        struct IObserver {
+            virtual ~IObserver() {}
+
+            virtual void Completed(const uint16_t originalNetworkId, const uint16_t transportStreamId) = 0;
+        };
+
+    private:
+        typedef std::list<IObserver*> Observers;
+
+    public:
+        class Event {
+        public:
+            Event()
+                : _eventId(~0)
+                , _info(0)
+                , _start(0)
+                , _duration(0)
+                , _language()
+                , _name()
+                , _text()
+                , _extended()
+            {
+            }
+            Event(const Record& record, const TextPool& texts)
+                : _eventId(record.EventId)
+                , _info(record.Info)
+                , _start(record.Start)
+                , _duration(record.Duration)
+                , _language(record.Language, (record.Language[0] == '\0' ? 0 : sizeof(record.Language)))
+                , _name(texts.Text(record.Name))
+                , _text(texts.Text(record.Text))
+                , _extended(texts.Text(record.Extended))
+            {
+            }
+            Event(const Event& copy)
+                : _eventId(copy._eventId)
+                , _info(copy._info)
+                , _start(copy._start)
+                , _duration(copy._duration)
+                , _language(copy._language)
+                , _name(copy._name)
+                , _text(copy._text)
+                , _extended(copy._extended)
+            {
+            }
+            ~Event()
+            {
+            }
+
+            Event& operator=(const Event& rhs)
+            {
+                _eventId = rhs._eventId;
+                _info = rhs._info;
+                _start = rhs._start;
+                _duration = rhs._duration;
+                _language = rhs._language;
+                _name = rhs._name;
+                _text = rhs._text;
+                _extended = rhs._extended;
+
+                return (*this);
+            }
+
+        public:
+            bool IsValid() const
+            {
+                return (_start != 0);
+            }
+            inline uint16_t EventId() const
+            {
+                return (_eventId);
+            }
+            // Seconds since the epoch, UTC
+            inline uint32_t Start() const
+            {
+                return (_start);
+            }
+            inline Core::Time StartTime() const
+            {
+                return (Core::Time(static_cast<uint64_t>(_start) * Core::Time::TicksPerMillisecond * 1000));
+            }
+            // Seconds
+            inline uint32_t Duration() const
+            {
+                return (_duration);
+            }
+            inline bool IsFreeToAir() const
+            {
+                return ((_info & 0x08) != 0);
+            }
+            inline DVB::EIT::running RunningMode() const
+            {
+                return (static_cast<DVB::EIT::running>(_info & 0x07));
+            }
+            const string& Language() const
+            {
+                return (_language);
+            }
+            const string& Name() const
+            {
+                return (_name);
+            }
+            const string& Text() const
+            {
+                return (_text);
+            }
+            const string& ExtendedText() const
+            {
+                return (_extended);
+            }
+
+        private:
+            uint16_t _eventId;
+            uint8_t _info;
+            uint32_t _start;
+            uint32_t _duration;
+            string _language;
+            string _name;
+            string _text;
+            string _extended;
+        };
+
+        typedef IteratorType<Event> Iterator;
+
     public:
-        Schedules()
+        // days: the days of schedule to load, every 4 days take another table (up to 64 days).
+        Schedules(const uint8_t days = 8)
             : _adminLock()
+            , _dispatcher(_adminLock, _T("EventParser"))
             , _scanners()
             , _sink(*this)
             , _scan(true)
+            , _tables(static_cast<uint8_t>(std::min(std::max((days + 3) / 4, 1), static_cast<int>(DVB::EIT::SCHEDULE_TABLES))))
+            , _channels()
+            , _texts()
+            , _coverage()
+            , _observers()
         {
             ITuner::Register(&_sink);
         }
         virtual ~Schedules()
         {
             ITuner::Unregister(&_sink);
+
+            // The Links of the parsers are detached under the lock the Dispatcher runs with.
+            _adminLock.Lock();
+            _scanners.clear();
+            _adminLock.Unlock();
         }
 
     public:
+        // Time from the arrival of a section on the tuner, to it being parsed.
+        inline const SectionBus::Histogram& Latency() const
+        {
+            return (_dispatcher.Latency());
+        }
+        inline uint32_t Dropped() const
+        {
+            return (_dispatcher.Dropped());
+        }
         void Scan(const bool scan)
         {
             _adminLock.Lock();
@@ -166,7 +396,191 @@ namespace Broadcast {
             _adminLock.Unlock();
         }
 
+        void Register(IObserver* observer)
+        {
+            _adminLock.Lock();
+
+            ASSERT(std::find(_observers.begin(), _observers.end(), observer) == _observers.end());
+
+            _observers.push_back(observer);
+
+            _adminLock.Unlock();
+        }
+        // Once returned, the observer is not called anymore.
+        void Unregister(IObserver* observer)
+        {
+            _adminLock.Lock();
+
+            Observers::iterator index(std::find(_observers.begin(), _observers.end(), observer));
+
+            if (index != _observers.end()) {
+                _observers.erase(index);
+            }
+
+            _adminLock.Unlock();
+        }
+
+        // The event running at the given time (seconds since the epoch, UTC), 0 is now.
+        Event Present(const uint16_t originalNetworkId, const uint16_t transportStreamId, const uint16_t serviceId, const uint32_t time = 0) const
+        {
+            Event result;
+            uint32_t when = (time == 0 ? Now() : time);
+
+            _adminLock.Lock();
+
+            Channels::const_iterator channel(_channels.find(Key(originalNetworkId, transportStreamId, serviceId)));
+
+            if (channel != _channels.end()) {
+                Records::const_iterator index(UpperBound(channel->second, when));
+
+                if ((index != channel->second.begin()) && ((--index)->End() > when)) {
+                    result = Event(*index, _texts);
+                }
+            }
+
+            _adminLock.Unlock();
+
+            return (result);
+        }
+        // The first event starting after the given time (seconds since the epoch, UTC), 0 is now.
+        Event Following(const uint16_t originalNetworkId, const uint16_t transportStreamId, const uint16_t serviceId, const uint32_t time = 0) const
+        {
+            Event result;
+            uint32_t when = (time == 0 ? Now() : time);
+
+            _adminLock.Lock();
+
+            Channels::const_iterator channel(_channels.find(Key(originalNetworkId, transportStreamId, serviceId)));
+
+            if (channel != _channels.end()) {
+                Records::const_iterator index(UpperBound(channel->second, when));
+
+                if (index != channel->second.end()) {
+                    result = Event(*index, _texts);
+                }
+            }
+
+            _adminLock.Unlock();
+
+            return (result);
+        }
+        // All events (partially) airing in [from, to), in seconds since the epoch, UTC.
+        Iterator Window(const uint16_t originalNetworkId, const uint16_t transportStreamId, const uint16_t serviceId, const uint32_t from, const uint32_t to) const
+        {
+            std::list<Event> events;
+
+            _adminLock.Lock();
+
+            Channels::const_iterator channel(_channels.find(Key(originalNetworkId, transportStreamId, serviceId)));
+
+            if (channel != _channels.end()) {
+                Records::const_iterator index(UpperBound(channel->second, from));
+
+                if ((index != channel->second.begin()) && (std::prev(index)->End() > from)) {
+                    index--;
+                }
+
+                while ((index != channel->second.end()) && (index->Start < to)) {
+                    events.emplace_back(*index, _texts);
+                    index++;
+                }
+            }
+
+            _adminLock.Unlock();
+
+            return (Iterator(std::move(events)));
+        }
+        // Drop all events that ended before the given time, and compact the text arena.
+        void Purge(const uint32_t before)
+        {
+            TextPool texts;
+
+            _adminLock.Lock();
+
+            Channels::iterator channel(_channels.begin());
+
+            while (channel != _channels.end()) {
+                Records& records(channel->second);
+
+                records.erase(std::remove_if(records.begin(), records.end(),
+                                  [before](const Record& entry) { return (entry.End() <= before); }),
+                    records.end());
+
+                if (records.empty() == true) {
+                    channel = _channels.erase(channel);
+                } else {
+                    for (Record& entry : records) {
+                        entry.Name = texts.Intern(_texts.Text(entry.Name));
+                        entry.Text = texts.Intern(_texts.Text(entry.Text));
+                        entry.Extended = texts.Intern(_texts.Text(entry.Extended));
+                    }
+                    records.shrink_to_fit();
+                    channel++;
+                }
+            }
+
+            _texts.Swap(texts);
+
+            _adminLock.Unlock();
+        }
+        void Clear()
+        {
+            _adminLock.Lock();
+            _channels.clear();
+            _texts.Clear();
+            _coverage.clear();
+            _adminLock.Unlock();
+        }
+        // All schedule segments from now up to the given number of days ahead are loaded for all
+        // services that have a schedule on this transport stream (from its own or another one).
+        // If no schedule is seen for any of its services yet, it is not complete.
+        bool IsComplete(const uint16_t originalNetworkId, const uint16_t transportStreamId, const uint8_t days) const
+        {
+            const uint32_t now = Now();
+            const uint32_t midnight = now - (now % (24 * 60 * 60));
+            const uint16_t first = static_cast<uint16_t>((now - midnight) / SEGMENT_DURATION);
+            const uint16_t last = static_cast<uint16_t>(std::min((((now - midnight) + (days * 24 * 60 * 60) - 1) / SEGMENT_DURATION), static_cast<uint32_t>((_tables * SEGMENTS) - 1)));
+            bool result = true;
+            bool seen = false;
+
+            _adminLock.Lock();
+
+            Coverages::const_iterator index(_coverage.lower_bound(Key(originalNetworkId, transportStreamId, 0) << 1));
+            const Coverages::const_iterator end(_coverage.upper_bound((Key(originalNetworkId, transportStreamId, 0xFFFF) << 1) | 1));
+
+            while ((result == true) && (index != end)) {
+                const uint64_t service = (index->first >> 1);
+                bool complete = false;
+
+                // Either the actual or the other schedule of the service will do.
+                while ((index != end) && ((index->first >> 1) == service)) {
+                    complete = complete || IsComplete(index->second, first, last);
+                    index++;
+                }
+
+                result = complete;
+                seen = true;
+            }
+
+            _adminLock.Unlock();
+
+            return (result && seen);
+        }
+
     private:
+        static inline uint64_t Key(const uint16_t originalNetworkId, const uint16_t transportStreamId, const uint16_t serviceId)
+        {
+            return ((static_cast<uint64_t>(originalNetworkId) << 32) | (static_cast<uint64_t>(transportStreamId) << 16) | serviceId);
+        }
+        static inline uint32_t Now()
+        {
+            return (static_cast<uint32_t>(Core::Time::Now().Ticks() / (Core::Time::TicksPerMillisecond * 1000)));
+        }
+        static inline Records::const_iterator UpperBound(const Records& records, const uint32_t time)
+        {
+            return (std::upper_bound(records.begin(), records.end(), time,
+                [](const uint32_t value, const Record& entry) { return (value < entry.Start); }));
+        }
         void Deactivated(ITuner* tuner)
         {
             _adminLock.Lock();
@@ -202,14 +616,156 @@ namespace Broadcast {
         {
             _adminLock.Lock();
 
+            Records& records(_channels[Key(table.OriginalNetworkId(), table.TransportStreamId(), table.ServiceId())]);
+            DVB::EIT::EventIterator index = table.Events();
+
+            while (index.Next() == true) {
+                Record entry;
+
+                entry.Start = index.Start();
+
+                if (entry.Start != 0) {
+                    entry.Duration = index.Duration();
+                    entry.EventId = index.EventId();
+                    entry.Info = (index.IsFreeToAir() ? 0x08 : 0x00) | index.RunningMode();
+                    entry.Name = TextPool::EMPTY;
+                    entry.Text = TextPool::EMPTY;
+                    entry.Extended = TextPool::EMPTY;
+                    ::memset(entry.Language, 0, sizeof(entry.Language));
+
+                    Describe(entry, index.Descriptors());
+                    Insert(records, entry);
+                }
+            }
+
             _adminLock.Unlock();
         }
+        void Cover(const DVB::EIT& table, const MPEG::Section& section)
+        {
+            const uint8_t index = (table.TableId() & 0x0F);
+
+            if (index < _tables) {
+                const uint64_t key = (Key(table.OriginalNetworkId(), table.TransportStreamId(), table.ServiceId()) << 1) | (table.IsActual() ? 0 : 1);
+                const uint8_t segment = (section.SectionNumber() / 8);
+                const uint8_t segmentLast = std::max(table.SegmentLastSectionNumber(), section.SectionNumber());
+
+                _adminLock.Lock();
+
+                Coverage& coverage(_coverage.emplace(std::piecewise_construct, std::forward_as_tuple(key), std::forward_as_tuple(_tables)).first->second);
+                Segments& segments(coverage.Tables[index]);
+
+                coverage.LastTable = (table.LastTableId() & 0x0F);
+
+                if (segments.Version != section.Version()) {
+                    // A new version, whatever was received of the previous one tells nothing.
+                    segments = Segments();
+                    segments.Version = section.Version();
+                }
+
+                const bool completed = IsComplete(segments, segment);
+
+                segments.LastSection = section.LastSectionNumber();
+                segments.Received[segment] |= (1 << (section.SectionNumber() & 0x07));
+                segments.Expected[segment] = static_cast<uint8_t>((2 << std::min(segmentLast - (segment * 8), 7)) - 1);
+
+                if ((completed == false) && (IsComplete(segments, segment) == true)) {
+                    for (IObserver* observer : _observers) {
+                        observer->Completed(table.OriginalNetworkId(), table.TransportStreamId());
+                    }
+                }
+
+                _adminLock.Unlock();
+            }
+        }
+        // Segments [first, last] are counted from midnight (UTC) of the first table.
+        static bool IsComplete(const Coverage& coverage, const uint16_t first, const uint16_t last)
+        {
+            bool result = true;
+
+            // Beyond the last table of the broadcaster, there is nothing to wait for.
+            for (uint16_t index = first; (result == true) && (index <= last) && ((index / SEGMENTS) <= coverage.LastTable); index++) {
+                const Segments& segments(coverage.Tables[index / SEGMENTS]);
+                const uint8_t segment = (index % SEGMENTS);
+
+                if (segments.Version == NO_VERSION) {
+                    result = false;
+                } else if ((segment * 8) <= segments.LastSection) {
+                    result = IsComplete(segments, segment);
+                }
+            }
+
+            return (result);
+        }
+        static inline bool IsComplete(const Segments& segments, const uint8_t segment)
+        {
+            return ((segments.Expected[segment] != 0) && ((segments.Received[segment] & segments.Expected[segment]) == segments.Expected[segment]));
+        }
+        void Describe(Record& entry, const MPEG::DescriptorIterator& descriptors)
+        {
+            struct Handler {
+                void operator()(const DVB::Descriptors::ShortEvent& info)
+                {
+                    if (entry.Name == TextPool::EMPTY) {
+                        string language(info.Language());
+
+                        ::memcpy(entry.Language, language.c_str(), std::min(language.length(), sizeof(entry.Language)));
+                        entry.Name = texts.Intern(info.Name());
+                        entry.Text = texts.Intern(info.Text());
+                    }
+                }
+                void operator()(const DVB::Descriptors::ExtendedEvent& info)
+                {
+                    // The extended descriptors are broadcasted in order, concatenate them.
+                    extended += info.Text();
+                }
+
+                Record& entry;
+                TextPool& texts;
+                string extended;
+            } handler { entry, _texts, string() };
+
+            MPEG::DescriptorVisitor<DVB::Descriptors::ShortEvent, DVB::Descriptors::ExtendedEvent>::Visit(descriptors, handler);
+
+            entry.Extended = _texts.Intern(handler.extended);
+        }
+        // Keep the records sorted on start time, an incoming event replaces all the
+        // events it overlaps with (the broadcaster changed the schedule).
+        void Insert(Records& records, const Record& entry)
+        {
+            Records::iterator begin(std::lower_bound(records.begin(), records.end(), entry.Start,
+                [](const Record& element, const uint32_t value) { return (element.Start < value); }));
+
+            if ((begin != records.begin()) && (std::prev(begin)->End() > entry.Start)) {
+                begin--;
+            }
+
+            uint32_t end = std::max(entry.End(), entry.Start + 1);
+            Records::iterator last(begin);
+
+            while ((last != records.end()) && (last->Start < end)) {
+                last++;
+            }
+
+            if ((begin != records.end()) && (last == std::next(begin))) {
+                // Most common case, a repetition or an update of a known event.
+                *begin = entry;
+            } else {
+                begin = records.erase(begin, last);
+                records.insert(begin, entry);
+            }
+        }
 
     private:
         mutable Core::CriticalSection _adminLock;
+        SectionBus::Dispatcher _dispatcher;
         Scanners _scanners;
         Sink _sink;
         bool _scan;
+        const uint8_t _tables;
+        Channels _channels;
+        TextPool _texts;
+        Coverages _coverage;
+        Observers _observers;
     };
 
 } // namespace Broadcast
@@ -0,0 +1,444 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SCHEDULESCAN_H
+#define SCHEDULESCAN_H
+
+#include "Definitions.h"
+#include "NetworkScan.h"
+#include "Networks.h"
+#include "Schedule.h"
+#include "TunerPool.h"
+
+namespace Thunder {
+
+namespace Broadcast {
+
+    // Loads the EIT schedule of all multiplexes of the network (as found in the NIT's), on the
+    // tuners nobody else uses. A tuner stays on a multiplex until the Schedules administrator
+    // has all segments of the window for its services, then it moves on to the next one. Live
+    // viewing and recordings take the tuners back whenever they need them, the multiplex is
+    // picked up again later. Multiplexes that are complete (e.g. through EIT other) are skipped.
+    class ScheduleScan : public Core::Thread, public TunerPool::ICallback {
+    private:
+        ScheduleScan() = delete;
+        ScheduleScan(const ScheduleScan&) = delete;
+        ScheduleScan& operator=(const ScheduleScan&) = delete;
+
+        // The pool does not tell when a tuner is released, with multiplexes waiting for one
+        // it is looked for at this interval (ms).
+        static constexpr uint32_t RETRY = 1000;
+        // Attempts of a multiplex that did not lock, or did not complete in time.
+        static constexpr uint8_t ATTEMPTS = 3;
+
+        // Wakes the scan on a tuner state change and on every schedule segment that completed,
+        // only signals, the lock of the scan is not taken with the lock of the caller.
+        class Sink : public ITuner::INotification, public Schedules::IObserver {
+        private:
+            Sink() = delete;
+            Sink(const Sink&) = delete;
+            Sink& operator=(const Sink&) = delete;
+
+        public:
+            Sink(ScheduleScan& parent)
+                : _parent(parent)
+            {
+            }
+            ~Sink() override
+            {
+            }
+
+        public:
+            void Activated(ITuner* /* tuner */) override
+            {
+            }
+            void Deactivated(ITuner* /* tuner */) override
+            {
+                _parent._signal.SetEvent();
+            }
+            void StateChange(ITuner* /* tuner */) override
+            {
+                _parent._signal.SetEvent();
+            }
+            void Completed(const uint16_t /* originalNetworkId */, const uint16_t /* transportStreamId */) override
+            {
+                _parent._signal.SetEvent();
+            }
+
+        private:
+            ScheduleScan& _parent;
+        };
+
+        struct Multiplex : public NetworkScan::Multiplex {
+            Multiplex(const Networks::Network& network)
+                : NetworkScan::Multiplex(network)
+                , OriginalNetworkId(network.OriginalNetworkId())
+                , TransportStreamId(network.TransportStreamId())
+                , Attempts(0)
+            {
+            }
+
+            uint16_t OriginalNetworkId;
+            uint16_t TransportStreamId;
+            uint8_t Attempts;
+        };
+
+        struct Slot {
+            Slot()
+                : Tuner(nullptr)
+                , Current(nullptr)
+                , Deadline(0)
+                , Settled(0)
+                , Locked(false)
+                , Preempted(false)
+            {
+            }
+
+            // Only changed by the Worker, a preemption looks the slot up on it, with the lock taken.
+            std::atomic<ITuner*> Tuner;
+            Multiplex* Current;
+            uint64_t Deadline;
+            uint64_t Settled;
+            bool Locked;
+            std::atomic<bool> Preempted;
+        };
+
+        typedef std::list<Multiplex> Multiplexes;
+
+    public:
+        // days: the window to complete, lockTimeout: time (ms) a multiplex gets to lock, settleTime: time (ms)
+        // a tuner stays at least on a locked multiplex, so all services show up in the EIT, dwellTime: time (ms)
+        // a tuner stays at most on a multiplex, a broadcaster that never completes does not hold a tuner.
+        ScheduleScan(Networks& networks, Schedules& schedules, TunerPool& pool, const uint8_t days = 7, const uint32_t lockTimeout = 2000, const uint32_t settleTime = 10000, const uint32_t dwellTime = 120000)
+            : Core::Thread(Core::Thread::DefaultStackSize(), _T("ScheduleScan"))
+            , _adminLock()
+            , _networks(networks)
+            , _schedules(schedules)
+            , _pool(pool)
+            , _days(days)
+            , _lockTimeout(lockTimeout)
+            , _settleTime(settleTime)
+            , _dwellTime(dwellTime)
+            , _slots(nullptr)
+            , _count(0)
+            , _pending()
+            , _running(false)
+            , _completed(0)
+            , _signal(false, true)
+            , _sink(*this)
+        {
+            ITuner::Register(&_sink);
+            _schedules.Register(&_sink);
+        }
+        ~ScheduleScan() override
+        {
+            _schedules.Unregister(&_sink);
+            ITuner::Unregister(&_sink);
+
+            Abort();
+            Stop();
+            _signal.SetEvent();
+            Wait(Core::Thread::STOPPED, Core::infinite);
+
+            delete[] _slots;
+        }
+
+    public:
+        // Takes the multiplexes from the NIT's loaded so far, a NetworkScan typically ran before.
+        uint32_t Start()
+        {
+            uint32_t result = Core::ERROR_INPROGRESS;
+
+            _adminLock.Lock();
+
+            if (_running == false) {
+                Networks::Iterator index(_networks.List());
+                std::set<uint32_t> seen;
+
+                _pending.clear();
+                _completed = 0;
+
+                while (index.Next() == true) {
+                    const Networks::Network& network(index.Current());
+
+                    if ((network.IsValid() == true) && (network.Delivery() != Networks::Network::UNKNOWN)) {
+                        _pending.emplace_back(network);
+
+                        if ((_pending.back().Frequency == 0) || (seen.insert(_pending.back().Key()).second == false)) {
+                            _pending.pop_back();
+                        }
+                    }
+                }
+
+                if (_pending.empty() == true) {
+                    result = Core::ERROR_UNAVAILABLE;
+                } else {
+                    if (_slots == nullptr) {
+                        _count = _pool.Count();
+                        _slots = new Slot[_count];
+                    }
+
+                    _running = true;
+                    result = Core::ERROR_NONE;
+
+                    _signal.SetEvent();
+                    Run();
+                }
+            }
+
+            _adminLock.Unlock();
+
+            return (result);
+        }
+        void Abort()
+        {
+            _adminLock.Lock();
+
+            _pending.clear();
+            _running = false;
+
+            for (uint8_t index = 0; index < _count; index++) {
+                Leave(_slots[index]);
+            }
+
+            _adminLock.Unlock();
+
+            _signal.SetEvent();
+        }
+        inline bool IsRunning() const
+        {
+            return (_running);
+        }
+        // Multiplexes of which the schedule is not loaded yet, including the ones in progress.
+        uint32_t Pending() const
+        {
+            _adminLock.Lock();
+            uint32_t result = static_cast<uint32_t>(_pending.size());
+            _adminLock.Unlock();
+            return (result);
+        }
+        inline uint32_t Completed() const
+        {
+            return (_completed);
+        }
+
+    private:
+        // TunerPool::ICallback, called on the thread of the user that took the tuner, the pool is
+        // not locked, the worker holds the lock of the scan while it calls the pool.
+        void Preempted(ITuner* tuner) override
+        {
+            _adminLock.Lock();
+
+            for (uint8_t index = 0; index < _count; index++) {
+                if (_slots[index].Tuner == tuner) {
+                    _slots[index].Preempted = true;
+                    _signal.SetEvent();
+                }
+            }
+
+            _adminLock.Unlock();
+        }
+        void Leave(Slot& slot)
+        {
+            ITuner* tuner = slot.Tuner;
+
+            if (tuner != nullptr) {
+                // Also if preempted, the notification comes after the pool let go of it, the
+                // tuner might have been acquired again by then. Releasing twice does no harm.
+                _pool.Release(tuner, this);
+
+                slot.Tuner = nullptr;
+                slot.Current = nullptr;
+                slot.Preempted = false;
+            }
+        }
+        void Assign(Slot& slot, const uint64_t now)
+        {
+            Multiplexes::iterator index(_pending.begin());
+
+            while ((slot.Tuner == nullptr) && (index != _pending.end())) {
+                // A retry moves the multiplex, step over it first.
+                Multiplexes::iterator current(index++);
+                bool tuned = false;
+                ITuner* tuner = nullptr;
+
+                if ((InProgress(*current) == false) && ((tuner = _pool.Acquire(current->Modus, current->Frequency, current->Modulation, current->SymbolRate, current->FEC, current->Inversion, TunerPool::BACKGROUND, this, tuned)) != nullptr)) {
+                    slot.Current = &(*current);
+                    slot.Locked = false;
+                    slot.Preempted = false;
+                    slot.Tuner = tuner;
+                    slot.Deadline = now + (_lockTimeout * Core::Time::TicksPerMillisecond);
+
+                    // Shared with another user, it is on the multiplex already.
+                    if ((tuned == false) && (tuner->Tune(current->Frequency, current->Modulation, current->SymbolRate, current->FEC, current->Inversion) != Core::ERROR_NONE)) {
+                        Retry(slot);
+                    } else {
+                        TRACE_L1("Loading the schedule of %d MHz on tuner %p", current->Frequency, tuner);
+                    }
+                }
+            }
+        }
+        bool InProgress(const Multiplex& entry) const
+        {
+            bool result = false;
+
+            for (uint8_t index = 0; (index < _count) && (result == false); index++) {
+                result = (_slots[index].Current == &entry);
+            }
+
+            return (result);
+        }
+        // Gave up on the multiplex for now, it goes to the back of the queue.
+        void Retry(Slot& slot)
+        {
+            Multiplexes::iterator index(std::find_if(_pending.begin(), _pending.end(), [&slot](const Multiplex& entry) { return (&entry == slot.Current); }));
+
+            ASSERT(index != _pending.end());
+
+            Leave(slot);
+
+            if (++(index->Attempts) < ATTEMPTS) {
+                _pending.splice(_pending.end(), _pending, index);
+            } else {
+                TRACE_L1("Giving up on the schedule of %d MHz", index->Frequency);
+                _pending.erase(index);
+            }
+        }
+        void Complete(Slot& slot)
+        {
+            Multiplexes::iterator index(std::find_if(_pending.begin(), _pending.end(), [&slot](const Multiplex& entry) { return (&entry == slot.Current); }));
+
+            ASSERT(index != _pending.end());
+
+            Leave(slot);
+
+            _pending.erase(index);
+            _completed++;
+        }
+        // In ms, rounded up, from now to the given moment (ticks).
+        static inline uint32_t Remaining(const uint64_t moment, const uint64_t now)
+        {
+            return (moment > now ? static_cast<uint32_t>((moment - now + Core::Time::TicksPerMillisecond - 1) / Core::Time::TicksPerMillisecond) : 0);
+        }
+        uint32_t Worker() override
+        {
+            uint32_t delay = Core::infinite;
+
+            // Whatever is signalled from here on, is picked up in the next round.
+            _signal.ResetEvent();
+
+            _adminLock.Lock();
+
+            if (_running == true) {
+                const uint64_t now = Core::Time::Now().Ticks();
+                bool idle = false;
+
+                // Complete, without ever being tuned to, e.g. through the EIT other of others.
+                Multiplexes::iterator entry(_pending.begin());
+                while (entry != _pending.end()) {
+                    if ((InProgress(*entry) == false) && (_schedules.IsComplete(entry->OriginalNetworkId, entry->TransportStreamId, _days) == true)) {
+                        entry = _pending.erase(entry);
+                        _completed++;
+                    } else {
+                        entry++;
+                    }
+                }
+
+                for (uint8_t index = 0; index < _count; index++) {
+                    Slot& slot(_slots[index]);
+
+                    if (slot.Tuner != nullptr) {
+                        if (slot.Preempted == true) {
+                            // Taken by a live viewer or a recording, try again later.
+                            TRACE_L1("Schedule of %d MHz preempted", slot.Current->Frequency);
+                            Leave(slot);
+                        } else if (slot.Locked == false) {
+                            if (slot.Tuner.load()->State() != ITuner::IDLE) {
+                                slot.Locked = true;
+                                slot.Settled = now + (_settleTime * Core::Time::TicksPerMillisecond);
+                                slot.Deadline = now + (_dwellTime * Core::Time::TicksPerMillisecond);
+                            } else if (now >= slot.Deadline) {
+                                Retry(slot);
+                            }
+                        } else if ((now >= slot.Settled) && (_schedules.IsComplete(slot.Current->OriginalNetworkId, slot.Current->TransportStreamId, _days) == true)) {
+                            Complete(slot);
+                        } else if (now >= slot.Deadline) {
+                            Retry(slot);
+                        }
+                    }
+                    if (slot.Tuner == nullptr) {
+                        Assign(slot, now);
+                    }
+
+                    if (slot.Tuner == nullptr) {
+                        idle = true;
+                    } else if ((slot.Locked == true) && (now < slot.Settled)) {
+                        delay = std::min(delay, Remaining(slot.Settled, now));
+                    } else {
+                        delay = std::min(delay, Remaining(slot.Deadline, now));
+                    }
+                }
+
+                if ((idle == true) && (std::find_if(_pending.begin(), _pending.end(), [this](const Multiplex& multiplex) { return (InProgress(multiplex) == false); }) != _pending.end())) {
+                    // No tuner for the multiplexes left, yet.
+                    delay = std::min(delay, RETRY);
+                }
+
+                if (_pending.empty() == true) {
+                    TRACE_L1("Schedule loaded, %d multiplexes completed", _completed.load());
+                    _running = false;
+                }
+            }
+
+            if (_running == false) {
+                Block();
+            }
+
+            _adminLock.Unlock();
+
+            if (_running == true) {
+                _signal.Lock(delay);
+                delay = 0;
+            }
+
+            return (delay);
+        }
+
+    private:
+        mutable Core::CriticalSection _adminLock;
+        Networks& _networks;
+        Schedules& _schedules;
+        TunerPool& _pool;
+        const uint8_t _days;
+        const uint32_t _lockTimeout;
+        const uint32_t _settleTime;
+        const uint32_t _dwellTime;
+        Slot* _slots;
+        uint8_t _count;
+        Multiplexes _pending;
+        std::atomic<bool> _running;
+        std::atomic<uint32_t> _completed;
+        Core::Event _signal;
+        Sink _sink;
+    };
+
+} // namespace Broadcast
+} // namespace Thunder
+
+#endif // SCHEDULESCAN_H
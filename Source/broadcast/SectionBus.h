@@ -0,0 +1,455 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef SECTIONBUS_H
+#define SECTIONBUS_H
+
+#include <atomic>
+
+#include "Definitions.h"
+#include "MPEGSection.h"
+
+namespace Thunder {
+
+namespace Broadcast {
+
+    // Moves sections from the thread that receives them (the tuner I/O thread) to
+    // the thread that parses them. Every consumer gets its own single producer/single
+    // consumer ring (a Link), so the I/O thread only copies the section and never
+    // waits for a parser, nor for any of their locks. A Dispatcher drains the Links of
+    // one administrator on its own thread, so a slow EIT parse does not hold up any
+    // other consumer, nor the PAT/PMT handling that stays on the I/O thread.
+    class SectionBus {
+    public:
+        // The clock (us) the sections are stamped with on arrival, it does not jump if the
+        // system time is set while they are queued.
+        static inline uint64_t Monotonic()
+        {
+            struct timespec ts;
+            clock_gettime(CLOCK_MONOTONIC, &ts);
+            return ((static_cast<uint64_t>(ts.tv_sec) * 1000 * 1000) + (ts.tv_nsec / 1000));
+        }
+
+        // Section arrival to consumer latency, in power of 2 microsecond buckets.
+        class Histogram {
+        private:
+            Histogram(const Histogram&) = delete;
+            Histogram& operator=(const Histogram&) = delete;
+
+        public:
+            static constexpr uint8_t BUCKETS = 24;
+
+            Histogram()
+                : _count(0)
+            {
+                for (std::atomic<uint32_t>& bucket : _buckets) {
+                    bucket.store(0, std::memory_order_relaxed);
+                }
+            }
+            ~Histogram()
+            {
+            }
+
+        public:
+            // Bucket N holds the latencies below 2^N microseconds (the last one all others).
+            inline void Add(const uint64_t microSeconds)
+            {
+                uint8_t bucket = 0;
+
+                while ((bucket < (BUCKETS - 1)) && ((static_cast<uint64_t>(1) << bucket) <= microSeconds)) {
+                    bucket++;
+                }
+
+                _buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+                _count.fetch_add(1, std::memory_order_relaxed);
+            }
+            inline uint32_t Count() const
+            {
+                return (_count.load(std::memory_order_relaxed));
+            }
+            inline uint32_t Bucket(const uint8_t index) const
+            {
+                ASSERT(index < BUCKETS);
+
+                return (_buckets[index].load(std::memory_order_relaxed));
+            }
+            // Upper bound, in microseconds, of the given percentile (0-100).
+            uint64_t Percentile(const uint8_t percentage) const
+            {
+                const uint64_t threshold = ((static_cast<uint64_t>(Count()) * percentage) + 99) / 100;
+                uint64_t seen = 0;
+                uint8_t bucket = 0;
+
+                while ((bucket < (BUCKETS - 1)) && ((seen += Bucket(bucket)) < threshold)) {
+                    bucket++;
+                }
+
+                return (static_cast<uint64_t>(1) << bucket);
+            }
+            void Clear()
+            {
+                for (std::atomic<uint32_t>& bucket : _buckets) {
+                    bucket.store(0, std::memory_order_relaxed);
+                }
+                _count.store(0, std::memory_order_relaxed);
+            }
+
+        private:
+            std::atomic<uint32_t> _count;
+            std::atomic<uint32_t> _buckets[BUCKETS];
+        };
+
+        // Lock free, single producer/single consumer, ring of variable sized records.
+        // A record is never split, if it does not fit at the end of the ring the
+        // remainder is padded and the record starts at the beginning again.
+        class Ring {
+        private:
+            Ring() = delete;
+            Ring(const Ring&) = delete;
+            Ring& operator=(const Ring&) = delete;
+
+            static constexpr uint32_t PADDING = ~0;
+
+        public:
+            struct Header {
+                uint32_t Length;
+                uint32_t Reserved;
+                uint64_t Arrival;
+            };
+
+            Ring(const uint32_t capacity)
+                : _capacity(capacity)
+                , _buffer(new Header[capacity / sizeof(Header)])
+                , _head(0)
+                , _tail(0)
+            {
+                // Power of 2 and room for two of the largest sections, to be able to wrap.
+                ASSERT((capacity & (capacity - 1)) == 0);
+                ASSERT(capacity >= (2 * Size(4096)));
+            }
+            ~Ring()
+            {
+                delete[] _buffer;
+            }
+
+        public:
+            inline bool IsEmpty() const
+            {
+                return (_head.load(std::memory_order_acquire) == _tail.load(std::memory_order_relaxed));
+            }
+
+            // Producer side.
+            bool Push(const uint8_t data[], const uint16_t length, const uint64_t arrival)
+            {
+                const uint32_t size = Size(length);
+                uint32_t head = _head.load(std::memory_order_relaxed);
+                const uint32_t used = head - _tail.load(std::memory_order_acquire);
+                const uint32_t contiguous = _capacity - (head & (_capacity - 1));
+                const bool wrap = (contiguous < size);
+                const bool result = ((_capacity - used) >= (size + (wrap ? contiguous : 0)));
+
+                if (result == true) {
+                    if (wrap == true) {
+                        At(head)->Length = PADDING;
+                        head += contiguous;
+                    }
+
+                    Header* record = At(head);
+                    record->Length = length;
+                    record->Arrival = arrival;
+                    ::memcpy(&(record[1]), data, length);
+
+                    _head.store(head + size, std::memory_order_release);
+                }
+
+                return (result);
+            }
+
+            // Consumer side, the record stays valid until it is popped.
+            Header* Peek()
+            {
+                Header* result = nullptr;
+                uint32_t tail = _tail.load(std::memory_order_relaxed);
+                const uint32_t head = _head.load(std::memory_order_acquire);
+
+                if (tail != head) {
+                    result = At(tail);
+
+                    if (result->Length == PADDING) {
+                        tail += _capacity - (tail & (_capacity - 1));
+                        _tail.store(tail, std::memory_order_release);
+                        result = (tail != head ? At(tail) : nullptr);
+                    }
+                }
+
+                return (result);
+            }
+            void Pop(const Header* record)
+            {
+                _tail.store(_tail.load(std::memory_order_relaxed) + Size(record->Length), std::memory_order_release);
+            }
+
+        private:
+            static inline uint32_t Size(const uint32_t length)
+            {
+                return (((sizeof(Header) + length) + (sizeof(Header) - 1)) & ~static_cast<uint32_t>(sizeof(Header) - 1));
+            }
+            inline Header* At(const uint32_t position)
+            {
+                return (&(_buffer[(position & (_capacity - 1)) / sizeof(Header)]));
+            }
+
+        private:
+            const uint32_t _capacity;
+            Header* _buffer;
+            // Free running positions, producer and consumer each in their own cache line.
+            alignas(64) std::atomic<uint32_t> _head;
+            alignas(64) std::atomic<uint32_t> _tail;
+        };
+
+        class Link;
+
+        // Drains the Links attached to it, on its own thread. The sections are handed to
+        // the consumers with the lock of the consumer taken, the same lock that protects
+        // the lifetime of its Links, so a consumer can destroy a Link (under that lock)
+        // at any time. The lock is taken per section, a reader of the consumer waits for
+        // one section to be parsed at most.
+        class Dispatcher : public Core::Thread {
+        private:
+            Dispatcher() = delete;
+            Dispatcher(const Dispatcher&) = delete;
+            Dispatcher& operator=(const Dispatcher&) = delete;
+
+            // The number of sections handled per Link in a row, before the next Link
+            // gets its turn.
+            static constexpr uint8_t BATCH = 16;
+
+            typedef std::vector<Link*> Links;
+
+        public:
+            Dispatcher(Core::CriticalSection& lock, const TCHAR* name)
+                : Core::Thread(Core::Thread::DefaultStackSize(), name)
+                , _lock(lock)
+                , _links()
+                , _signal(false, true)
+                , _waiting(false)
+                , _dropped(0)
+                , _latency()
+            {
+                Run();
+            }
+            ~Dispatcher() override
+            {
+                Stop();
+                _signal.SetEvent();
+                Wait(Core::Thread::STOPPED, Core::infinite);
+
+                ASSERT(_links.empty() == true);
+            }
+
+        public:
+            inline const Histogram& Latency() const
+            {
+                return (_latency);
+            }
+            // Sections that did not fit in the ring of their Link.
+            inline uint32_t Dropped() const
+            {
+                return (_dropped.load(std::memory_order_relaxed));
+            }
+
+        private:
+            friend class Link;
+
+            // Called with the lock of the consumer taken.
+            void Attach(Link& link)
+            {
+                _links.push_back(&link);
+            }
+            void Detach(Link& link)
+            {
+                Links::iterator index(std::find(_links.begin(), _links.end(), &link));
+
+                if (index != _links.end()) {
+                    _links.erase(index);
+                }
+            }
+            // Producer side, only leaves the lock free path if the worker is asleep.
+            inline void Signal()
+            {
+                if (_waiting.exchange(false) == true) {
+                    _signal.SetEvent();
+                }
+            }
+            inline void Drop()
+            {
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            inline void Delivered(const uint64_t arrival)
+            {
+                const uint64_t now = Monotonic();
+
+                _latency.Add(now > arrival ? (now - arrival) : 0);
+            }
+
+            uint32_t Worker() override;
+
+        private:
+            Core::CriticalSection& _lock;
+            Links _links;
+            Core::Event _signal;
+            std::atomic<bool> _waiting;
+            std::atomic<uint32_t> _dropped;
+            Histogram _latency;
+        };
+
+        // The ISection to install on the tuner (producer side) for a consumer. The sections
+        // are copied in the ring and handed to the consumer on the thread of the Dispatcher.
+        // Construct and destruct it with the lock, given to the Dispatcher, taken.
+        class Link : public ISection {
+        private:
+            Link() = delete;
+            Link(const Link&) = delete;
+            Link& operator=(const Link&) = delete;
+
+        public:
+            Link(Dispatcher& dispatcher, ISection& consumer, const uint32_t capacity)
+                : _dispatcher(dispatcher)
+                , _consumer(consumer)
+                , _ring(capacity)
+                , _arrival(0)
+            {
+                _dispatcher.Attach(*this);
+            }
+            ~Link() override
+            {
+                _dispatcher.Detach(*this);
+            }
+
+        public:
+            void Handle(const MPEG::Section& section) override
+            {
+                if (_ring.Push(section.Buffer(), section.Length(), Monotonic()) == true) {
+                    _dispatcher.Signal();
+                } else {
+                    // The consumer will pick it up on the next repetition.
+                    _dispatcher.Drop();
+                }
+            }
+            // Time (SectionBus::Monotonic()) the section, handed to the consumer, arrived on the
+            // tuner. Only meaningful from within the Handle() of the consumer.
+            inline uint64_t Arrival() const
+            {
+                return (_arrival);
+            }
+
+        private:
+            friend class Dispatcher;
+
+            inline bool IsEmpty() const
+            {
+                return (_ring.IsEmpty());
+            }
+            // Consumer side, returns the number of sections handled.
+            uint8_t Dispatch(const uint8_t maxSections)
+            {
+                uint8_t count = 0;
+                Ring::Header* record;
+
+                while ((count < maxSections) && ((record = _ring.Peek()) != nullptr)) {
+                    MPEG::Section section(Core::DataElement(record->Length, reinterpret_cast<uint8_t*>(&(record[1]))), true);
+
+                    _arrival = record->Arrival;
+                    _consumer.Handle(section);
+                    _dispatcher.Delivered(record->Arrival);
+                    _ring.Pop(record);
+                    count++;
+                }
+
+                return (count);
+            }
+
+        private:
+            Dispatcher& _dispatcher;
+            ISection& _consumer;
+            Ring _ring;
+            uint64_t _arrival;
+        };
+    };
+
+    inline uint32_t SectionBus::Dispatcher::Worker()
+    {
+        bool busy = false;
+        bool more = true;
+        uint32_t index = 0;
+        uint8_t count = 0;
+
+        while (more == true) {
+            _lock.Lock();
+
+            // Links might come and go in between, at worst one gets a turn less or more.
+            more = (index < _links.size());
+
+            if ((more == true) && (_links[index]->Dispatch(1) != 0)) {
+                busy = true;
+                count++;
+            } else {
+                count = BATCH;
+            }
+
+            _lock.Unlock();
+
+            if (count >= BATCH) {
+                index++;
+                count = 0;
+            }
+        }
+
+        _lock.Lock();
+
+        if (busy == false) {
+            // Announce we are going to sleep, then make sure nothing slipped in before
+            // that, whatever is pushed from here on, signals us.
+            _signal.ResetEvent();
+            _waiting.store(true);
+
+            Links::const_iterator index(_links.begin());
+
+            while ((index != _links.end()) && ((*index)->IsEmpty() == true)) {
+                index++;
+            }
+
+            busy = (index != _links.end());
+        }
+
+        _lock.Unlock();
+
+        if (busy == false) {
+            _signal.Lock(Core::infinite);
+        }
+
+        _waiting.store(false);
+
+        return (0);
+    }
+
+} // namespace Broadcast
+} // namespace Thunder
+
+#endif // SECTIONBUS_H
@@ -23,6 +23,9 @@
 #include "Definitions.h"
 #include "Descriptors.h"
 #include "SDT.h"
+#include "SectionBus.h"
+#include "Snapshot.h"
+#include "TextPool.h"
 
 namespace Thunder {
 
@@ -75,8 +78,10 @@ namespace Broadcast {
             Parser(Services& parent, ITuner* source, const bool scan)
                 : _parent(parent)
                 , _source(source)
+                , _link(parent._dispatcher, *this, 16384)
                 , _actual(Core::ProxyType<Core::DataStore>::Create(512))
                 , _others(Core::ProxyType<Core::DataStore>::Create(512))
+                , _repetitions()
             {
                 if (scan == true) {
                     Scan(true);
@@ -100,8 +105,8 @@ namespace Broadcast {
             {
                 if (scan == true) {
                     // Start loading the SDT info
-                    _source->Filter(0x11, DVB::SDT::ACTUAL, this);
-                    _source->Filter(0x11, DVB::SDT::OTHER, this);
+                    _source->Filter(0x11, DVB::SDT::ACTUAL, &_link);
+                    _source->Filter(0x11, DVB::SDT::OTHER, &_link);
                 } else {
                     _source->Filter(0x11, DVB::SDT::OTHER, nullptr);
                     _source->Filter(0x11, DVB::SDT::ACTUAL, nullptr);
@@ -114,15 +119,19 @@ namespace Broadcast {
 
                 ASSERT(section.IsValid());
 
-                if (section.TableId() == DVB::SDT::ACTUAL) {
+                if (_repetitions.IsRepetition(section) == true) {
+                    // Nothing changed since we loaded this table, skip it.
+                } else if (section.TableId() == DVB::SDT::ACTUAL) {
                     _actual.AddSection(section);
                     if (_actual.IsValid() == true) {
-                        _parent.Load(DVB::SDT(_actual));
+                        _parent.Update(_actual);
+                        _repetitions.Completed(section);
                     }
                 } else if (section.TableId() == DVB::SDT::OTHER) {
                     _others.AddSection(section);
                     if (_others.IsValid() == true) {
-                        _parent.Load(DVB::SDT(_others));
+                        _parent.Update(_others);
+                        _repetitions.Completed(section);
                     }
                 }
             }
@@ -130,58 +139,58 @@ namespace Broadcast {
         private:
             Services& _parent;
             ITuner* _source;
+            SectionBus::Link _link;
             MPEG::Table _actual;
             MPEG::Table _others;
+            MPEG::RepetitionFilter _repetitions;
         };
 
         typedef std::list<Parser> Scanners;
 
     public:
+        // Fixed size and trivially copyable, the name lives in the TextPool of the Services.
         class Service {
         public:
             Service()
-                : _serviceId(~0)
+                : _names(nullptr)
+                , _name(TextPool::EMPTY)
+                , _serviceId(~0)
                 , _info(~0)
-                , _name()
             {
             }
-            Service(const DVB::SDT::ServiceIterator& info)
-                : _serviceId(info.ServiceId())
+            Service(const DVB::SDT::ServiceIterator& info, TextPool& names)
+                : _names(&names)
+                , _name(TextPool::EMPTY)
+                , _serviceId(info.ServiceId())
                 , _info((info.EIT_PF() ? 0x10 : 0x00) | (info.EIT_Schedule() ? 0x20 : 0x00) | (info.IsFreeToAir() ? 0x40 : 0x00) | info.RunningMode())
-                , _name(_T("Unknown"))
             {
                 MPEG::DescriptorIterator index(info.Descriptors());
 
                 if (index.Tag(DVB::Descriptors::Service::TAG) == true) {
                     DVB::Descriptors::Service nameDescriptor(index.Current());
-                    _name = nameDescriptor.Name();
+                    _name = names.Intern(nameDescriptor.Name());
+                } else {
+                    _name = names.Intern(_T("Unknown"), 7);
                 }
             }
-            Service(const Service& copy)
-                : _serviceId(copy._serviceId)
-                , _info(copy._info)
-                , _name(copy._name)
-            {
-            }
-            ~Service()
-            {
-            }
-
-            Service& operator=(const Service& rhs)
-            {
-                _serviceId = rhs._serviceId;
-                _info = rhs._info;
-                _name = rhs._name;
-
-                return (*this);
-            }
 
         public:
             bool IsValid() const
             {
                 return (_info != static_cast<uint8_t>(~0));
             }
-            const string& Name() const
+            inline string Name() const
+            {
+                return (string(NameData()));
+            }
+            // UTF-8, in the TextPool of the Services. It is valid as long as the Services, or an
+            // Iterator handed out by it, exist.
+            const char* NameData() const
+            {
+                return (_names != nullptr ? _names->Data(_name) : _T(""));
+            }
+            // Names are interned, equal names have equal handles.
+            inline TextPool::Handle NameHandle() const
             {
                 return (_name);
             }
@@ -207,32 +216,54 @@ namespace Broadcast {
             }
 
         private:
+            const TextPool* _names;
+            TextPool::Handle _name;
             uint16_t _serviceId;
             uint8_t _info;
-            string _name;
         };
 
-        typedef IteratorType<Service> Iterator;
+        static_assert(std::is_trivially_copyable<Service>::value, "Service records are copied around a lot");
 
     private:
         typedef std::map<uint16_t, Service> ServiceMap;
 
     public:
+        // A snapshot of the list, it is not affected by updates received after it was taken.
+        typedef IteratorType<Service, ServiceMap> Iterator;
+
         Services()
             : _adminLock()
+            , _dispatcher(_adminLock, _T("ServiceParser"))
             , _scanners()
             , _sink(*this)
             , _scan(true)
-            , _services()
+            , _names(std::make_shared<TextPool>(12))
+            , _services(std::make_shared<const ServiceMap>())
+            , _snapshot()
+            , _restored(true)
         {
             ITuner::Register(&_sink);
         }
         virtual ~Services()
         {
             ITuner::Unregister(&_sink);
+
+            // The Links of the parsers are detached under the lock the Dispatcher runs with.
+            _adminLock.Lock();
+            _scanners.clear();
+            _adminLock.Unlock();
         }
 
     public:
+        // Time from the arrival of a section on the tuner, to it being parsed.
+        inline const SectionBus::Histogram& Latency() const
+        {
+            return (_dispatcher.Latency());
+        }
+        inline uint32_t Dropped() const
+        {
+            return (_dispatcher.Dropped());
+        }
         void Scan(const bool scan)
         {
             _adminLock.Lock();
@@ -252,8 +283,9 @@ namespace Broadcast {
             Service result;
 
             _adminLock.Lock();
-            ServiceMap::const_iterator index(_services.find(id));
-            if (index != _services.end()) {
+            Restored();
+            ServiceMap::const_iterator index(_services->find(id));
+            if (index != _services->end()) {
                 result = index->second;
             }
             _adminLock.Unlock();
@@ -264,13 +296,68 @@ namespace Broadcast {
         {
 
             _adminLock.Lock();
+            Restored();
             Iterator value(_services);
             _adminLock.Unlock();
 
             return (value);
         }
 
+        // Load the services from a Snapshot persisted with Store(). The file is mapped
+        // now, the tables are parsed on first use and are replaced by the broadcasted
+        // ones, as soon as these are received and turn out to be different.
+        uint32_t Restore(const string& fileName)
+        {
+            _adminLock.Lock();
+
+            uint32_t result = _snapshot.Open(fileName);
+
+            if (result == Core::ERROR_NONE) {
+                _restored = false;
+            }
+
+            _adminLock.Unlock();
+
+            return (result);
+        }
+        uint32_t Store(const string& fileName) const
+        {
+            _adminLock.Lock();
+
+            uint32_t result = _snapshot.Save(fileName);
+
+            _adminLock.Unlock();
+
+            return (result);
+        }
+
     private:
+        void Restored() const
+        {
+            if (_restored == false) {
+                _restored = true;
+
+                Snapshot::Iterator index(_snapshot.Tables());
+
+                while (index.Next() == true) {
+                    if ((index.TableId() == DVB::SDT::ACTUAL) || (index.TableId() == DVB::SDT::OTHER)) {
+                        const_cast<Services&>(*this).Load(DVB::SDT(index.Extension(), index.Data()));
+                    }
+                }
+            }
+        }
+        void Update(const MPEG::Table& table)
+        {
+            _adminLock.Lock();
+
+            Restored();
+
+            if (_snapshot.Update(0, table) == true) {
+                Load(DVB::SDT(table));
+            }
+
+            _adminLock.Unlock();
+        }
         void Deactivated(ITuner* tuner)
         {
             _adminLock.Lock();
@@ -308,19 +395,37 @@ namespace Broadcast {
 
             DVB::SDT::ServiceIterator index = table.Services();
 
+            // Copy on write, iterators handed out keep the previous version.
+            ServiceMap* entries(new ServiceMap(*_services));
+
             while (index.Next() == true) {
-                _services[index.ServiceId()] = Service(index);
+                (*entries)[index.ServiceId()] = Service(index, *_names);
             }
 
+            _services = Publish(entries);
+
             _adminLock.Unlock();
         }
 
+        // The names of the records point into the pool, a snapshot keeps it alive for as long
+        // as it is iterated, even if the Services are gone by then.
+        Iterator::Snapshot Publish(ServiceMap* entries) const
+        {
+            std::shared_ptr<TextPool> names(_names);
+
+            return (Iterator::Snapshot(entries, [names](const ServiceMap* map) { delete map; }));
+        }
+
     private:
         mutable Core::CriticalSection _adminLock;
+        SectionBus::Dispatcher _dispatcher;
         Scanners _scanners;
         Sink _sink;
         bool _scan;
-        ServiceMap _services;
+        std::shared_ptr<TextPool> _names;
+        Iterator::Snapshot _services;
+        Snapshot _snapshot;
+        mutable bool _restored;
     };
 
 } // namespace Broadcast
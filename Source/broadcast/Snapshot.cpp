@@ -0,0 +1,180 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Snapshot.h"
+
+namespace Thunder {
+
+namespace Broadcast {
+
+    uint32_t Snapshot::Open(const string& fileName)
+    {
+        uint32_t result = Core::ERROR_ILLEGAL_STATE;
+
+        if (_file == nullptr) {
+            _file = new Core::DataElementFile(fileName, Core::File::USER_READ);
+
+            if ((_file->IsValid() == false) || (_file->Size() < HEADER_SIZE)) {
+                result = Core::ERROR_OPENING_FAILED;
+            } else if ((_file->GetNumber<uint32_t, Core::ENDIAN_BIG>(0) != MAGIC) || (_file->GetNumber<uint16_t, Core::ENDIAN_BIG>(4) != FORMAT)) {
+                TRACE_L1("Snapshot %s has an unknown format, ignoring it.", fileName.c_str());
+                result = Core::ERROR_INVALID_SIGNATURE;
+            } else if (MPEG::CRC32(&(_file->Buffer()[HEADER_SIZE]), static_cast<uint32_t>(_file->Size() - HEADER_SIZE)) != _file->GetNumber<uint32_t, Core::ENDIAN_BIG>(12)) {
+                TRACE_L1("Snapshot %s is corrupt, ignoring it.", fileName.c_str());
+                result = Core::ERROR_INVALID_SIGNATURE;
+            } else {
+                uint32_t count = _file->GetNumber<uint32_t, Core::ENDIAN_BIG>(8);
+                uint64_t offset = HEADER_SIZE;
+
+                result = Core::ERROR_NONE;
+
+                while ((count != 0) && ((offset + RECORD_SIZE) <= _file->Size())) {
+                    uint16_t keyId = _file->GetNumber<uint16_t, Core::ENDIAN_BIG>(offset);
+                    uint8_t tableId = (*_file)[static_cast<uint32_t>(offset + 2)];
+                    uint8_t version = (*_file)[static_cast<uint32_t>(offset + 3)];
+                    uint16_t extension = _file->GetNumber<uint16_t, Core::ENDIAN_BIG>(offset + 4);
+                    uint32_t length = _file->GetNumber<uint32_t, Core::ENDIAN_BIG>(offset + 6);
+
+                    offset += RECORD_SIZE;
+
+                    if ((offset + length) > _file->Size()) {
+                        break;
+                    }
+
+                    // Tables that were updated before the Snapshot got opened are more recent.
+                    _tables.emplace(std::piecewise_construct,
+                        std::forward_as_tuple(Key(keyId, tableId, extension)),
+                        std::forward_as_tuple(Entry { version, Core::DataElement(*_file, offset, length) }));
+
+                    offset += length;
+                    count--;
+                }
+
+                if (count != 0) {
+                    TRACE_L1("Snapshot %s is truncated, %d tables missing.", fileName.c_str(), count);
+                }
+            }
+
+            if (result != Core::ERROR_NONE) {
+                delete _file;
+                _file = nullptr;
+            }
+        }
+
+        return (result);
+    }
+
+    void Snapshot::Close()
+    {
+        if (_file != nullptr) {
+            // Do not leave entries pointing into the mapped file.
+            _tables.clear();
+            delete _file;
+            _file = nullptr;
+        }
+    }
+
+    uint32_t Snapshot::Save(const string& fileName) const
+    {
+        uint32_t result = Core::ERROR_WRITE_ERROR;
+        uint64_t size = HEADER_SIZE;
+
+        for (const std::pair<const uint64_t, Entry>& entry : _tables) {
+            size += RECORD_SIZE + entry.second.Data.Size();
+        }
+
+        Core::ProxyType<Core::DataStore> store(Core::ProxyType<Core::DataStore>::Create(static_cast<uint32_t>(size)));
+        uint8_t* buffer = store->Buffer();
+        uint32_t offset = HEADER_SIZE;
+
+        for (const std::pair<const uint64_t, Entry>& entry : _tables) {
+            uint32_t length = static_cast<uint32_t>(entry.second.Data.Size());
+
+            buffer[offset + 0] = static_cast<uint8_t>(entry.first >> 40);
+            buffer[offset + 1] = static_cast<uint8_t>(entry.first >> 32);
+            buffer[offset + 2] = static_cast<uint8_t>(entry.first >> 16);
+            buffer[offset + 3] = entry.second.Version;
+            buffer[offset + 4] = static_cast<uint8_t>(entry.first >> 8);
+            buffer[offset + 5] = static_cast<uint8_t>(entry.first);
+            buffer[offset + 6] = static_cast<uint8_t>(length >> 24);
+            buffer[offset + 7] = static_cast<uint8_t>(length >> 16);
+            buffer[offset + 8] = static_cast<uint8_t>(length >> 8);
+            buffer[offset + 9] = static_cast<uint8_t>(length);
+            ::memcpy(&(buffer[offset + RECORD_SIZE]), entry.second.Data.Buffer(), length);
+
+            offset += RECORD_SIZE + length;
+        }
+
+        uint32_t count = static_cast<uint32_t>(_tables.size());
+        uint32_t crc = MPEG::CRC32(&(buffer[HEADER_SIZE]), offset - HEADER_SIZE);
+        const uint32_t header[] = { MAGIC, (static_cast<uint32_t>(FORMAT) << 16), count, crc };
+
+        for (uint8_t index = 0; index < (sizeof(header) / sizeof(uint32_t)); index++) {
+            buffer[(index * 4) + 0] = static_cast<uint8_t>(header[index] >> 24);
+            buffer[(index * 4) + 1] = static_cast<uint8_t>(header[index] >> 16);
+            buffer[(index * 4) + 2] = static_cast<uint8_t>(header[index] >> 8);
+            buffer[(index * 4) + 3] = static_cast<uint8_t>(header[index]);
+        }
+
+        // Write aside and move it in place, a reader (or our own mapping) never sees a partial file.
+        Core::File file(fileName + _T(".tmp"));
+
+        if (file.Create() == true) {
+            uint32_t written = file.Write(buffer, offset);
+            file.Close();
+
+            if ((written == offset) && (file.Move(fileName) == true)) {
+                result = Core::ERROR_NONE;
+            } else {
+                file.Destroy();
+            }
+        }
+
+        return (result);
+    }
+
+    bool Snapshot::Update(const uint16_t keyId, const MPEG::Table& table)
+    {
+        const Core::DataElement& data(table.Data());
+        uint64_t key(Key(keyId, static_cast<uint8_t>(table.TableId()), table.Extension()));
+        TableMap::iterator index(_tables.find(key));
+        bool updated = ((index == _tables.end()) || (index->second.Version != table.Version()) || (index->second.Data != data));
+
+        if (updated == true) {
+            // Take a copy, the table storage is reused for the next version.
+            Core::ProxyType<Core::DataStore> store(Core::ProxyType<Core::DataStore>::Create(static_cast<uint32_t>(data.Size())));
+            Core::DataElement copy(store, 0, data.Size());
+
+            ::memcpy(copy.Buffer(), data.Buffer(), data.Size());
+
+            if (index == _tables.end()) {
+                _tables.emplace(std::piecewise_construct,
+                    std::forward_as_tuple(key),
+                    std::forward_as_tuple(Entry { table.Version(), copy }));
+            } else {
+                index->second.Version = table.Version();
+                index->second.Data = copy;
+            }
+        }
+
+        return (updated);
+    }
+
+} // namespace Broadcast
+} // namespace Thunder
@@ -0,0 +1,211 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __SNAPSHOT_H
+#define __SNAPSHOT_H
+
+// ---- Include system wide include files ----
+
+// ---- Include local include files ----
+#include "MPEGSection.h"
+#include "Module.h"
+
+// ---- Referenced classes and types ----
+
+// ---- Helper types and constants ----
+
+// ---- Helper functions ----
+
+// ---- Class Definition ----
+
+namespace Thunder {
+namespace Broadcast {
+
+    // A Snapshot holds the last complete version of a set of SI tables (the payload
+    // of all sections, as assembled by MPEG::Table) and can persist them to disk.
+    // A persisted Snapshot is memory mapped on Open, the tables restored from it
+    // point directly into the mapped file, nothing is copied or parsed until used.
+    // Incoming tables are validated against the Snapshot with Update(), which tells
+    // if the table changed (and needs to be (re)loaded) or is what we already have.
+    // A Snapshot is not thread safe, the owner is expected to lock it.
+    //
+    // File layout (all numbers big endian):
+    //   header: magic(32) format(16) reserved(16) count(32) crc32(32) over all records
+    //   record: keyId(16) tableId(8) version(8) extension(16) length(32) payload(length)
+    // A table can be up to 256 sections of 4096 bytes, more than a 16 bit length holds.
+    class EXTERNAL Snapshot {
+    private:
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        static constexpr uint32_t MAGIC = 0x42534E50; // "BSNP"
+        static constexpr uint16_t FORMAT = 2;
+        static constexpr uint8_t HEADER_SIZE = 16;
+        static constexpr uint8_t RECORD_SIZE = 10;
+
+        struct Entry {
+            uint8_t Version;
+            Core::DataElement Data;
+        };
+
+        typedef std::map<uint64_t, Entry> TableMap;
+
+    public:
+        class Iterator {
+        public:
+            Iterator()
+                : _tables(nullptr)
+                , _index()
+                , _start(true)
+            {
+            }
+            Iterator(const TableMap& tables)
+                : _tables(&tables)
+                , _index(tables.begin())
+                , _start(true)
+            {
+            }
+            Iterator(const Iterator& copy)
+                : _tables(copy._tables)
+                , _index(copy._index)
+                , _start(copy._start)
+            {
+            }
+            ~Iterator() {}
+
+            Iterator& operator=(const Iterator& rhs)
+            {
+                _tables = rhs._tables;
+                _index = rhs._index;
+                _start = rhs._start;
+
+                return (*this);
+            }
+
+        public:
+            inline bool IsValid() const
+            {
+                return ((_tables != nullptr) && (_start == false) && (_index != _tables->end()));
+            }
+            inline void Reset()
+            {
+                if (_tables != nullptr) {
+                    _index = _tables->begin();
+                }
+                _start = true;
+            }
+            bool Next()
+            {
+                if (_tables != nullptr) {
+                    if (_start == true) {
+                        _start = false;
+                    } else if (_index != _tables->end()) {
+                        _index++;
+                    }
+                }
+
+                return (IsValid());
+            }
+            inline uint16_t KeyId() const
+            {
+                return (static_cast<uint16_t>(_index->first >> 32));
+            }
+            inline uint8_t TableId() const
+            {
+                return (static_cast<uint8_t>(_index->first >> 16));
+            }
+            inline uint16_t Extension() const
+            {
+                return (static_cast<uint16_t>(_index->first));
+            }
+            inline uint8_t Version() const
+            {
+                return (_index->second.Version);
+            }
+            inline const Core::DataElement& Data() const
+            {
+                return (_index->second.Data);
+            }
+
+        private:
+            const TableMap* _tables;
+            TableMap::const_iterator _index;
+            bool _start;
+        };
+
+    public:
+        Snapshot()
+            : _file(nullptr)
+            , _tables()
+        {
+        }
+        ~Snapshot()
+        {
+            Close();
+        }
+
+    public:
+        inline bool IsOpen() const
+        {
+            return (_file != nullptr);
+        }
+        inline uint32_t Count() const
+        {
+            return (static_cast<uint32_t>(_tables.size()));
+        }
+        inline Iterator Tables() const
+        {
+            return (Iterator(_tables));
+        }
+
+        // Map a persisted Snapshot. Tables already added to this Snapshot, take precedence.
+        uint32_t Open(const string& fileName);
+        void Close();
+
+        // Write all tables to the given file. The file is replaced atomically, so
+        // an open Snapshot on the same file, remains valid.
+        uint32_t Save(const string& fileName) const;
+
+        // Returns true if the table is new, or differs from the one in the Snapshot,
+        // in which case the Snapshot now holds a copy of this table.
+        bool Update(const uint16_t keyId, const MPEG::Table& table);
+        void Remove(const uint16_t keyId, const uint8_t tableId, const uint16_t extension)
+        {
+            _tables.erase(Key(keyId, tableId, extension));
+        }
+        void Clear()
+        {
+            _tables.clear();
+        }
+
+    private:
+        static inline uint64_t Key(const uint16_t keyId, const uint8_t tableId, const uint16_t extension)
+        {
+            return ((static_cast<uint64_t>(keyId) << 32) | (static_cast<uint64_t>(tableId) << 16) | extension);
+        }
+
+    private:
+        Core::DataElementFile* _file;
+        TableMap _tables;
+    };
+
+} // namespace Broadcast
+} // namespace Thunder
+
+#endif // __SNAPSHOT_H
@@ -23,6 +23,7 @@
 // ---- Include system wide include files ----
 
 // ---- Include local include files ----
+#include "Definitions.h"
 #include "MPEGDescriptor.h"
 #include "MPEGSection.h"
 #include "Module.h"
@@ -48,36 +49,19 @@ namespace Broadcast {
 
         public:
             TDT()
-                : _time()
+                : _time(0)
             {
             }
             TDT(const MPEG::Section& data)
-                : _time()
+                : _time(0)
             {
                 if (data.IsValid() == true) {
                     const Core::DataElement info(data.Data());
 
-                    // EXAMPLE: 93/10/13 12:45:00 is coded as "0xC079 124500".
-                    uint16_t MJD = (info[0] << 8) | info[1];
-                    uint32_t J, C, Y, M;
-
-                    J = MJD + 2400001 + 68569;
-                    C = 4 * J / 146097;
-                    J = J - (146097 * C + 3) / 4;
-                    Y = 4000 * (J + 1) / 1461001;
-                    J = J - 1461 * Y / 4 + 31;
-                    M = 80 * J / 2447;
-
-                    uint8_t day = static_cast<uint8_t>(J - 2447 * M / 80);
-                    J = M / 11;
-                    uint8_t month = static_cast<uint8_t>(M + 2 - (12 * J));
-                    uint16_t year = static_cast<uint16_t>(100 * (C - 49) + Y + J);
-                    uint8_t uren = ((info[2] >> 4) * 10) + (info[2] & 0xF);
-                    uint8_t minuten = ((info[3] >> 4) * 10) + (info[3] & 0xF);
-                    uint8_t seconden = ((info[4] >> 4) * 10) + (info[4] & 0xF);
-
-                    printf("Loadeded: %d-%d-%d %d:%d.%d\n", day, month, year, uren, minuten, seconden);
-                    _time = Core::Time(year, month, day, uren, minuten, seconden, 0, false);
+                    // MJD(16) and UTC(24, BCD), EXAMPLE: 93/10/13 12:45:00 is coded as "0xC079 124500".
+                    if (info.Size() >= 5) {
+                        _time = Broadcast::ConvertMJD(&(info[0]));
+                    }
                 }
             }
             TDT(const TDT& copy)
@@ -89,12 +73,20 @@ namespace Broadcast {
         public:
             inline bool IsValid() const
             {
-                return (_time.IsValid());
+                return (_time != 0);
+            }
+            // Seconds since the epoch, UTC.
+            inline uint32_t Seconds() const
+            {
+                return (_time);
+            }
+            inline Core::Time Time() const
+            {
+                return (Core::Time(static_cast<uint64_t>(_time) * Core::Time::TicksPerMillisecond * 1000));
             }
-            inline const Core::Time& Time() const { return (_time); }
 
         private:
-            Core::Time _time;
+            uint32_t _time;
         };
 
         class EXTERNAL TOT : public TDT {
@@ -125,8 +117,18 @@ namespace Broadcast {
         public:
             MPEG::DescriptorIterator Descriptors() const
             {
-                uint16_t size(((_data[6] & 0xF) << 8) | _data[7]);
-                return (MPEG::DescriptorIterator(Core::DataElement(_data, 8, size)));
+                MPEG::DescriptorIterator result;
+
+                // UTC(40), reserved(4), descriptors_loop_length(12), descriptors, CRC(32)
+                if (_data.Size() > 7) {
+                    uint16_t size = std::min(static_cast<uint16_t>(((_data[5] & 0x0F) << 8) | _data[6]), static_cast<uint16_t>(_data.Size() - 7));
+
+                    if (size > 0) {
+                        result = MPEG::DescriptorIterator(Core::DataElement(_data, 7, size));
+                    }
+                }
+
+                return (result);
             }
 
         private:
@@ -0,0 +1,222 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __TEXTPOOL_H
+#define __TEXTPOOL_H
+
+// ---- Include system wide include files ----
+#include <atomic>
+#include <unordered_map>
+
+// ---- Include local include files ----
+#include "Module.h"
+
+// ---- Referenced classes and types ----
+
+// ---- Helper types and constants ----
+
+// ---- Helper functions ----
+
+// ---- Class Definition ----
+
+namespace Thunder {
+namespace Broadcast {
+
+    // SI text (event names, descriptions, service names) repeats a lot. The TextPool
+    // stores every distinct string once, zero terminated, and hands out a 32 bits
+    // handle so records referring to text can be kept fixed size. Handle 0 is always
+    // the empty string.
+    // The text is stored in chunks that never move, so the text of a handle that has
+    // been handed out can be read without a lock, while new text is added. Adding text
+    // (Intern), Swap and Clear are not thread safe, the owner is expected to lock them.
+    class EXTERNAL TextPool {
+    private:
+        TextPool(const TextPool&) = delete;
+        TextPool& operator=(const TextPool&) = delete;
+
+        typedef std::unordered_multimap<uint32_t, uint32_t> Index;
+
+        static constexpr uint16_t MAX_CHUNKS = 1024;
+
+    public:
+        typedef uint32_t Handle;
+
+        static constexpr Handle EMPTY = 0;
+
+    public:
+        // Text is allocated in chunks of 2^chunkBits bytes, no text can be longer.
+        TextPool(const uint8_t chunkBits = 16)
+            : _chunkBits(chunkBits)
+            , _current(0)
+            , _used(0)
+            , _size(0)
+            , _index()
+        {
+            ASSERT((chunkBits >= 10) && (chunkBits <= 20));
+
+            for (std::atomic<char*>& chunk : _chunks) {
+                chunk.store(nullptr, std::memory_order_relaxed);
+            }
+
+            Initialize();
+        }
+        ~TextPool()
+        {
+            Release();
+        }
+
+    public:
+        Handle Intern(const char text[], uint32_t length)
+        {
+            Handle result = EMPTY;
+
+            if (length > 0) {
+                const uint32_t chunkSize = (1 << _chunkBits);
+
+                if (length >= chunkSize) {
+                    length = (chunkSize - 1);
+                }
+
+                uint32_t hash = Hash(text, length);
+                std::pair<Index::const_iterator, Index::const_iterator> range(_index.equal_range(hash));
+
+                while ((range.first != range.second) && (result == EMPTY)) {
+                    const char* entry = Data(range.first->second);
+
+                    if ((::strncmp(entry, text, length) == 0) && (entry[length] == '\0')) {
+                        result = range.first->second;
+                    } else {
+                        range.first++;
+                    }
+                }
+
+                if (result == EMPTY) {
+                    if ((_used + length + 1) > chunkSize) {
+                        if ((_current + 1) < MAX_CHUNKS) {
+                            _current++;
+                            _used = 0;
+                            _chunks[_current].store(new char[chunkSize], std::memory_order_release);
+                        }
+                    }
+
+                    if ((_used + length + 1) <= chunkSize) {
+                        char* chunk = _chunks[_current].load(std::memory_order_relaxed);
+
+                        ::memcpy(&(chunk[_used]), text, length);
+                        chunk[_used + length] = '\0';
+
+                        result = ((_current << _chunkBits) | _used);
+                        _used += (length + 1);
+                        _size += (length + 1);
+                        _index.emplace(hash, result);
+                    } else {
+                        TRACE_L1("TextPool is full, %d bytes in use.", _size);
+                    }
+                }
+            }
+
+            return (result);
+        }
+        inline Handle Intern(const string& text)
+        {
+            return (Intern(text.c_str(), static_cast<uint32_t>(text.length())));
+        }
+        // Lock free, valid until the TextPool is cleared.
+        inline const char* Data(const Handle handle) const
+        {
+            ASSERT((handle >> _chunkBits) <= _current);
+
+            return (&(_chunks[handle >> _chunkBits].load(std::memory_order_acquire)[handle & ((1 << _chunkBits) - 1)]));
+        }
+        inline string Text(const Handle handle) const
+        {
+            return (string(Data(handle)));
+        }
+        // Bytes used by the text, the index not included.
+        inline uint32_t Size() const
+        {
+            return (_size);
+        }
+        inline uint32_t Count() const
+        {
+            return (static_cast<uint32_t>(_index.size()));
+        }
+        void Swap(TextPool& other)
+        {
+            ASSERT(_chunkBits == other._chunkBits);
+
+            for (uint16_t index = 0; index < MAX_CHUNKS; index++) {
+                char* chunk = _chunks[index].load(std::memory_order_relaxed);
+                _chunks[index].store(other._chunks[index].load(std::memory_order_relaxed), std::memory_order_relaxed);
+                other._chunks[index].store(chunk, std::memory_order_relaxed);
+            }
+
+            std::swap(_current, other._current);
+            std::swap(_used, other._used);
+            std::swap(_size, other._size);
+            _index.swap(other._index);
+        }
+        void Clear()
+        {
+            Release();
+            Initialize();
+        }
+
+    private:
+        void Initialize()
+        {
+            char* chunk = new char[1 << _chunkBits];
+
+            chunk[0] = '\0';
+            _chunks[0].store(chunk, std::memory_order_release);
+            _current = 0;
+            _used = 1;
+            _size = 1;
+        }
+        void Release()
+        {
+            for (uint16_t index = 0; index <= _current; index++) {
+                delete[] _chunks[index].exchange(nullptr, std::memory_order_relaxed);
+            }
+            _index.clear();
+        }
+        // FNV-1a, 32 bits
+        static uint32_t Hash(const char text[], const uint32_t length)
+        {
+            uint32_t hash = 2166136261u;
+            for (uint32_t index = 0; index < length; index++) {
+                hash ^= static_cast<uint8_t>(text[index]);
+                hash *= 16777619u;
+            }
+            return (hash);
+        }
+
+    private:
+        const uint8_t _chunkBits;
+        uint16_t _current;
+        uint32_t _used;
+        uint32_t _size;
+        Index _index;
+        std::atomic<char*> _chunks[MAX_CHUNKS];
+    };
+
+} // namespace Broadcast
+} // namespace Thunder
+
+#endif // __TEXTPOOL_H
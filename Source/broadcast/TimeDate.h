@@ -22,6 +22,7 @@
 
 #include "Definitions.h"
 #include "Descriptors.h"
+#include "SectionBus.h"
 #include "TDT.h"
 
 namespace Thunder {
@@ -75,6 +76,7 @@ namespace Broadcast {
             Parser(TimeDate& parent, ITuner* source, const bool scan)
                 : _parent(parent)
                 , _source(source)
+                , _link(parent._dispatcher, *this, 16384)
             {
                 if (scan == true) {
                     Scan(true);
@@ -98,8 +100,8 @@ namespace Broadcast {
             {
                 if (scan == true) {
                     // Start loading the SDT info
-                    _source->Filter(0x14, DVB::TDT::ID, this);
-                    _source->Filter(0x14, DVB::TOT::ID, this);
+                    _source->Filter(0x14, DVB::TDT::ID, &_link);
+                    _source->Filter(0x14, DVB::TOT::ID, &_link);
                 } else {
                     _source->Filter(0x14, DVB::TOT::ID, nullptr);
                     _source->Filter(0x14, DVB::TDT::ID, nullptr);
@@ -112,36 +114,94 @@ namespace Broadcast {
 
                 ASSERT(section.IsValid());
 
+                // The section waited in the ring of the link, take the time it arrived.
+                const uint64_t arrival = _link.Arrival();
+
                 if (section.TableId() == DVB::TDT::ID) {
-                    _parent.Load(DVB::TDT(section));
+                    _parent.Load(DVB::TDT(section), arrival);
                 } else if (section.TableId() == DVB::TOT::ID) {
-                    _parent.Load(DVB::TOT(section));
+                    _parent.Load(DVB::TOT(section), arrival);
                 }
             }
 
         private:
             TimeDate& _parent;
             ITuner* _source;
+            SectionBus::Link _link;
         };
 
         typedef std::list<Parser> Scanners;
 
+        // The TDT has a resolution of a second, the broadcast time is somewhere in the
+        // second following the one that is sent. Each sample is the range [Offset, Offset +
+        // Width) the offset (in ticks) of the broadcast time to the monotonic clock is in.
+        struct Sample {
+            uint64_t Monotonic;
+            int64_t Offset;
+            int64_t Width;
+        };
+
+        struct Zone {
+            int16_t Offset;
+            uint32_t Change;
+            int16_t Next;
+        };
+
+        typedef std::unordered_map<uint32_t, Zone> Zones;
+
+        // Samples used for the model, at least the spacing (s) apart. If all are taken, every
+        // other sample is dropped and the spacing doubles, so they cover an ever longer period.
+        static constexpr uint8_t SAMPLES = 32;
+        static constexpr uint32_t SPACING = 10;
+        static constexpr uint32_t MAX_SPACING = 1800;
+        // The span (s) the samples must cover before the drift is estimated.
+        static constexpr uint32_t DRIFT_SPAN = 300;
+        // A crystal is not off by more than this (ppb), anything more is noise.
+        static constexpr int32_t MAX_DRIFT = 500000;
+        // A sample further off (ticks) is a step of the broadcast clock, start over.
+        static constexpr int64_t STEP = 2 * 1000 * 1000;
+        static constexpr int64_t RESOLUTION = 1000 * 1000;
+
     public:
         TimeDate()
             : _adminLock()
+            , _dispatcher(_adminLock, _T("TimeParser"))
             , _scanners()
             , _sink(*this)
             , _scan(true)
-            , _time()
+            , _samples()
+            , _count(0)
+            , _spacing(SPACING)
+            , _opened(0)
+            , _zones()
+            , _sequence(0)
+            , _anchor(0)
+            , _offset(0)
+            , _drift(0)
+            , _precision(0)
         {
             ITuner::Register(&_sink);
         }
         virtual ~TimeDate()
         {
             ITuner::Unregister(&_sink);
+
+            // The Links of the parsers are detached under the lock the Dispatcher runs with.
+            _adminLock.Lock();
+            _scanners.clear();
+            _adminLock.Unlock();
         }
 
     public:
+        // Time from the arrival of a section on the tuner, to it being parsed.
+        inline const SectionBus::Histogram& Latency() const
+        {
+            return (_dispatcher.Latency());
+        }
+        inline uint32_t Dropped() const
+        {
+            return (_dispatcher.Dropped());
+        }
         void Scan(const bool scan)
         {
             _adminLock.Lock();
@@ -157,7 +217,253 @@ namespace Broadcast {
             _adminLock.Unlock();
         }
 
+        // A TDT or TOT was received, Now() tells the broadcast time.
+        inline bool IsValid() const
+        {
+            return (_sequence.load(std::memory_order_acquire) != 0);
+        }
+        // The broadcast time (UTC), lock free and without parsing, derived from the monotonic
+        // clock, so it does not jump if the system time is set.
+        Core::Time Now() const
+        {
+            uint64_t anchor;
+            int64_t offset;
+            int32_t drift;
+
+            Model(anchor, offset, drift);
+
+            const uint64_t now = Monotonic();
+
+            return (Core::Time(static_cast<uint64_t>(static_cast<int64_t>(now) + offset + Correction(now, anchor, drift))));
+        }
+        // Speed of the broadcast clock relative to the monotonic clock, in parts per billion.
+        inline int32_t Drift() const
+        {
+            return (_drift.load(std::memory_order_relaxed));
+        }
+        // Worst case error (ms) of Now(), as far as the received TDT's tell.
+        inline uint32_t Precision() const
+        {
+            return (_precision.load(std::memory_order_relaxed));
+        }
+        // The offset (minutes) of the local time to UTC, as broadcasted in the TOT. The country is
+        // the ISO 3166 code (3 characters), if the region is not known, the whole country is taken.
+        int16_t LocalOffset(const string& country, const uint8_t region = 0) const
+        {
+            int16_t result = 0;
+
+            if (country.length() >= 3) {
+                const uint32_t code = ((static_cast<uint8_t>(country[0]) << 16) | (static_cast<uint8_t>(country[1]) << 8) | static_cast<uint8_t>(country[2]));
+                const uint32_t now = static_cast<uint32_t>(Now().Ticks() / (Core::Time::TicksPerMillisecond * 1000));
+
+                _adminLock.Lock();
+
+                Zones::const_iterator index(_zones.find((code << 8) | region));
+
+                if ((index == _zones.end()) && (region != 0)) {
+                    index = _zones.find(code << 8);
+                }
+                if (index != _zones.end()) {
+                    result = ((index->second.Change != 0) && (now >= index->second.Change) ? index->second.Next : index->second.Offset);
+                }
+
+                _adminLock.Unlock();
+            }
+
+            return (result);
+        }
+        Core::Time LocalNow(const string& country, const uint8_t region = 0) const
+        {
+            const int64_t offset = static_cast<int64_t>(LocalOffset(country, region)) * 60 * 1000 * Core::Time::TicksPerMillisecond;
+
+            return (Core::Time(static_cast<uint64_t>(static_cast<int64_t>(Now().Ticks()) + offset)));
+        }
+
     private:
+        // The clock the Links stamp the sections with, the arrivals are on the same scale.
+        static inline uint64_t Monotonic()
+        {
+            return (SectionBus::Monotonic());
+        }
+        static int64_t Correction(const uint64_t now, const uint64_t anchor, const int32_t drift)
+        {
+            const int64_t elapsed = static_cast<int64_t>(now - anchor);
+
+            return ((elapsed / 1000) * drift / (1000 * 1000));
+        }
+        // Seqlock reader, the model is only written on the thread of the Dispatcher.
+        void Model(uint64_t& anchor, int64_t& offset, int32_t& drift) const
+        {
+            uint32_t sequence;
+
+            do {
+                while (((sequence = _sequence.load(std::memory_order_acquire)) & 1) != 0) {
+                    std::this_thread::yield();
+                }
+
+                anchor = _anchor.load(std::memory_order_relaxed);
+                offset = _offset.load(std::memory_order_relaxed);
+                drift = _drift.load(std::memory_order_relaxed);
+
+                std::atomic_thread_fence(std::memory_order_acquire);
+
+            } while (_sequence.load(std::memory_order_relaxed) != sequence);
+        }
+        void Publish(const uint64_t anchor, const int64_t offset, const int32_t drift)
+        {
+            const uint32_t sequence = _sequence.load(std::memory_order_relaxed);
+
+            _sequence.store(sequence + 1, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+
+            _anchor.store(anchor, std::memory_order_relaxed);
+            _offset.store(offset, std::memory_order_relaxed);
+            _drift.store(drift, std::memory_order_relaxed);
+
+            _sequence.store(sequence + 2, std::memory_order_release);
+        }
+        // Called with the lock taken.
+        void Discipline(const uint32_t seconds, const uint64_t arrival)
+        {
+            const int64_t offset = (static_cast<int64_t>(seconds) * RESOLUTION) - static_cast<int64_t>(arrival);
+
+            if (_count > 0) {
+                uint64_t anchor;
+                int64_t current;
+                int32_t drift;
+
+                Model(anchor, current, drift);
+
+                const int64_t predicted = current + Correction(arrival, anchor, drift);
+
+                if ((offset > (predicted + STEP)) || ((offset + RESOLUTION) < (predicted - STEP))) {
+                    TRACE_L1("Broadcast time stepped %d ms, restarting the clock model", static_cast<int32_t>((offset - predicted) / 1000));
+                    _count = 0;
+                    _spacing = SPACING;
+                }
+            }
+
+            if ((_count == 0) || ((arrival - _opened) >= (static_cast<uint64_t>(_spacing) * 1000 * 1000))) {
+                _opened = arrival;
+                Add(arrival, offset);
+            } else {
+                Tighten(arrival, offset);
+            }
+        }
+        // Within the spacing, the range of the last sample is narrowed down.
+        void Tighten(const uint64_t arrival, const int64_t offset)
+        {
+            Sample& last(_samples[_count - 1]);
+            const int64_t projected = last.Offset + Correction(arrival, last.Monotonic, _drift.load(std::memory_order_relaxed));
+            const int64_t lower = std::max(projected, offset);
+            const int64_t upper = std::min(projected + last.Width, offset + RESOLUTION);
+
+            if (lower < upper) {
+                last = { arrival, lower, upper - lower };
+            } else {
+                // Jitter on the arrival, the latest one is the best guess.
+                last = { arrival, offset, RESOLUTION };
+            }
+
+            Estimate();
+        }
+        void Add(const uint64_t arrival, const int64_t offset)
+        {
+            if (_count == SAMPLES) {
+                for (uint8_t index = 1; index < (SAMPLES / 2); index++) {
+                    _samples[index] = _samples[index * 2];
+                }
+                _count = (SAMPLES / 2);
+                _spacing = ((_spacing * 2) < MAX_SPACING ? (_spacing * 2) : MAX_SPACING);
+            }
+
+            _samples[_count++] = { arrival, offset, RESOLUTION };
+
+            Estimate();
+        }
+        // The offset is a line over time, every sample is on it or at most its width below it.
+        // The samples close to the line (the section arrived just after the second changed)
+        // form the upper hull, the edge of it that spans the middle of the samples is the
+        // line that stays closest to all of them.
+        int32_t Slope() const
+        {
+            uint8_t hull[SAMPLES];
+            uint8_t size = 0;
+            double middle = 0;
+
+            for (uint8_t index = 0; index < _count; index++) {
+                const double x = static_cast<double>(_samples[index].Monotonic - _samples[0].Monotonic);
+                const double y = static_cast<double>(_samples[index].Offset - _samples[0].Offset);
+
+                while (size >= 2) {
+                    const Sample& first(_samples[hull[size - 2]]);
+                    const Sample& second(_samples[hull[size - 1]]);
+                    const double x1 = static_cast<double>(first.Monotonic - _samples[0].Monotonic);
+                    const double y1 = static_cast<double>(first.Offset - _samples[0].Offset);
+                    const double x2 = static_cast<double>(second.Monotonic - _samples[0].Monotonic);
+                    const double y2 = static_cast<double>(second.Offset - _samples[0].Offset);
+
+                    // The second is on or below the line from the first to this one, it is not on the hull.
+                    if (((x2 - x1) * (y - y1)) - ((y2 - y1) * (x - x1)) < 0) {
+                        break;
+                    }
+                    size--;
+                }
+
+                hull[size++] = index;
+                middle += x / _count;
+            }
+
+            double slope = 0;
+
+            for (uint8_t index = 1; index < size; index++) {
+                const Sample& first(_samples[hull[index - 1]]);
+                const Sample& second(_samples[hull[index]]);
+
+                if ((static_cast<double>(second.Monotonic - _samples[0].Monotonic) >= middle) || (index == (size - 1))) {
+                    // Offset in ticks over the time in ticks, in ppb.
+                    slope = (static_cast<double>(second.Offset - first.Offset) / static_cast<double>(second.Monotonic - first.Monotonic)) * 1000000000.0;
+                    break;
+                }
+            }
+
+            return (static_cast<int32_t>(std::max(std::min(slope, static_cast<double>(MAX_DRIFT)), static_cast<double>(-MAX_DRIFT))));
+        }
+        void Estimate()
+        {
+            const Sample& newest(_samples[_count - 1]);
+            const uint64_t anchor = newest.Monotonic;
+            const int32_t drift = ((anchor - _samples[0].Monotonic) >= (DRIFT_SPAN * 1000ULL * 1000ULL) ? Slope() : 0);
+
+            // Every sample tells a range of the offset at the anchor, intersect them.
+            int64_t lower = std::numeric_limits<int64_t>::min();
+            int64_t upper = std::numeric_limits<int64_t>::max();
+            int64_t sum = 0;
+
+            for (uint8_t index = 0; index < _count; index++) {
+                const int64_t projected = _samples[index].Offset + Correction(anchor, _samples[index].Monotonic, drift);
+
+                lower = std::max(lower, projected);
+                upper = std::min(upper, projected + _samples[index].Width);
+                sum += (projected + (_samples[index].Width / 2) - newest.Offset);
+            }
+
+            int64_t offset;
+            uint32_t precision;
+
+            if (lower <= upper) {
+                offset = lower + ((upper - lower) / 2);
+                precision = static_cast<uint32_t>((upper - lower) / (2 * 1000));
+            } else {
+                // Not consistent (jitter on the arrival, or the drift is off), take the average.
+                offset = newest.Offset + (sum / _count);
+                precision = static_cast<uint32_t>(RESOLUTION / (2 * 1000));
+            }
+
+            _precision.store(precision, std::memory_order_relaxed);
+
+            Publish(anchor, offset, drift);
+        }
         void Deactivated(ITuner* tuner)
         {
             _adminLock.Lock();
@@ -189,36 +495,56 @@ namespace Broadcast {
 
             _adminLock.Unlock();
         }
-        void Load(const DVB::TOT& table)
+        void Load(const DVB::TOT& table, const uint64_t arrival)
         {
+            struct Handler {
+                void operator()(const DVB::Descriptors::LocalTimeOffset& info)
+                {
+                    for (uint8_t index = 0; index < info.Count(); index++) {
+                        zones[(info.CountryCode(index) << 8) | info.Region(index)] = { info.Offset(index), info.TimeOfChange(index), info.NextOffset(index) };
+                    }
+                }
+
+                Zones& zones;
+            } handler { _zones };
 
             _adminLock.Lock();
 
-            MPEG::DescriptorIterator index = table.Descriptors();
+            MPEG::DescriptorVisitor<DVB::Descriptors::LocalTimeOffset>::Visit(table.Descriptors(), handler);
 
-            while (index.Next() == true) {
+            if (table.IsValid() == true) {
+                Discipline(table.Seconds(), arrival);
             }
 
-            _time = table.Time();
-
             _adminLock.Unlock();
         }
-        void Load(const DVB::TDT& table)
+        void Load(const DVB::TDT& table, const uint64_t arrival)
         {
+            if (table.IsValid() == true) {
+                _adminLock.Lock();
 
-            _adminLock.Lock();
-
-            _time = table.Time();
+                Discipline(table.Seconds(), arrival);
 
-            _adminLock.Unlock();
+                _adminLock.Unlock();
+            }
         }
 
     private:
         mutable Core::CriticalSection _adminLock;
+        SectionBus::Dispatcher _dispatcher;
         Scanners _scanners;
         Sink _sink;
         bool _scan;
-        Core::Time _time;
+        Sample _samples[SAMPLES];
+        uint8_t _count;
+        uint32_t _spacing;
+        uint64_t _opened;
+        Zones _zones;
+        std::atomic<uint32_t> _sequence;
+        std::atomic<uint64_t> _anchor;
+        std::atomic<int64_t> _offset;
+        std::atomic<int32_t> _drift;
+        std::atomic<uint32_t> _precision;
     };
 
 } // namespace Broadcast
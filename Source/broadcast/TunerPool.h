@@ -0,0 +1,258 @@
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TUNERPOOL_H
+#define TUNERPOOL_H
+
+#include "Definitions.h"
+
+namespace Thunder {
+
+namespace Broadcast {
+
+    // Owns all tuners (frontends) the implementation offers and hands them out to the users:
+    // live view, recordings and background work like EPG and network scans. Users of the
+    // same multiplex share a tuner. Background users give way to the others if there is
+    // no free tuner left, they are told so through their ICallback.
+    class TunerPool {
+    public:
+        enum priority : uint8_t {
+            BACKGROUND = 0,
+            RECORDING = 1,
+            LIVE = 2
+        };
+
+        struct ICallback {
+            virtual ~ICallback() {}
+
+            // The tuner is taken over by a user with a higher priority, it is released already.
+            // Called without the pool locked, the user can take its own lock, that it might hold
+            // while it calls the pool.
+            virtual void Preempted(ITuner* tuner) = 0;
+        };
+
+    private:
+        TunerPool(const TunerPool&) = delete;
+        TunerPool& operator=(const TunerPool&) = delete;
+
+        struct User {
+            priority Level;
+            ICallback* Callback;
+        };
+
+        // The parameters of ITuner::Tune(), the multiplex the tuner is on. On satellite two
+        // multiplexes can share a frequency, the polarization (in the Modulation) differs.
+        struct Tuning {
+            bool operator==(const Tuning& rhs) const
+            {
+                return ((Frequency == rhs.Frequency) && (Modulation == rhs.Modulation) && (SymbolRate == rhs.SymbolRate) && (FEC == rhs.FEC) && (Inversion == rhs.Inversion));
+            }
+
+            uint16_t Frequency;
+            Broadcast::Modulation Modulation;
+            uint32_t SymbolRate;
+            uint16_t FEC;
+            SpectralInversion Inversion;
+        };
+
+        struct Slot {
+            Slot(ITuner* tuner)
+                : Tuner(tuner)
+                , Multiplex({ 0, MODULATION_UNKNOWN, 0, 0, Auto })
+                , Users()
+                , Leases(0)
+            {
+            }
+
+            // Only background users, or none, it can be taken.
+            bool IsBackground() const
+            {
+                return (std::find_if(Users.begin(), Users.end(), [](const User& user) { return (user.Level != BACKGROUND); }) == Users.end());
+            }
+
+            ITuner* Tuner;
+            Tuning Multiplex;
+            std::vector<User> Users;
+            uint32_t Leases;
+        };
+
+        typedef std::list<Slot> Slots;
+
+    public:
+        TunerPool()
+            : _adminLock()
+            , _slots()
+        {
+        }
+        ~TunerPool()
+        {
+            Clear();
+        }
+
+    public:
+        // Creates the tuners, ITuner::Initialize() must have been called. Returns the
+        // number of tuners in the pool.
+        uint8_t Load(const uint8_t maxTuners = 0xFF)
+        {
+            _adminLock.Lock();
+
+            ASSERT(_slots.empty() == true);
+
+            ITuner* tuner;
+
+            while ((_slots.size() < maxTuners) && ((tuner = ITuner::Create(Core::NumberType<uint8_t>(static_cast<uint8_t>(_slots.size())).Text())) != nullptr)) {
+                _slots.emplace_back(tuner);
+            }
+
+            uint8_t result = static_cast<uint8_t>(_slots.size());
+
+            _adminLock.Unlock();
+
+            return (result);
+        }
+        void Clear()
+        {
+            _adminLock.Lock();
+
+            for (Slot& slot : _slots) {
+                ASSERT(slot.Users.empty() == true);
+                delete slot.Tuner;
+            }
+
+            _slots.clear();
+
+            _adminLock.Unlock();
+        }
+        uint8_t Count() const
+        {
+            _adminLock.Lock();
+            uint8_t result = static_cast<uint8_t>(_slots.size());
+            _adminLock.Unlock();
+            return (result);
+        }
+        // Tuners without users.
+        uint8_t Available(const ITuner::modus modus) const
+        {
+            uint8_t result = 0;
+
+            _adminLock.Lock();
+
+            for (const Slot& slot : _slots) {
+                if ((slot.Users.empty() == true) && (slot.Tuner->Modus() == modus)) {
+                    result++;
+                }
+            }
+
+            _adminLock.Unlock();
+
+            return (result);
+        }
+
+        // A tuner for the multiplex with these parameters (as ITuner::Tune() takes them), nullptr
+        // if there is none left. If tuned is true, the tuner is shared with another user and it
+        // is tuned to the multiplex already, do not tune it again, it would interrupt the other
+        // user(s).
+        ITuner* Acquire(const ITuner::modus modus, const uint16_t frequency, const Modulation modulation, const uint32_t symbolRate, const uint16_t fec, const SpectralInversion inversion, const priority level, ICallback* callback, bool& tuned)
+        {
+            const Tuning multiplex { frequency, modulation, symbolRate, fec, inversion };
+            std::vector<User> preempted;
+            Slot* selected = nullptr;
+
+            ASSERT((level != BACKGROUND) || (callback != nullptr));
+
+            _adminLock.Lock();
+
+            // On the multiplex already, sharing is free.
+            for (Slot& slot : _slots) {
+                if ((slot.Users.empty() == false) && (slot.Multiplex == multiplex) && (slot.Tuner->Modus() == modus)) {
+                    selected = &slot;
+                    break;
+                }
+            }
+
+            tuned = (selected != nullptr);
+
+            if (selected == nullptr) {
+                // The least used free tuner, that spreads the wear and the heat.
+                for (Slot& slot : _slots) {
+                    if ((slot.Users.empty() == true) && (slot.Tuner->Modus() == modus) && ((selected == nullptr) || (slot.Leases < selected->Leases))) {
+                        selected = &slot;
+                    }
+                }
+            }
+
+            if ((selected == nullptr) && (level != BACKGROUND)) {
+                // Take the tuner with the least background users.
+                for (Slot& slot : _slots) {
+                    if ((slot.Tuner->Modus() == modus) && (slot.IsBackground() == true) && ((selected == nullptr) || (slot.Users.size() < selected->Users.size()))) {
+                        selected = &slot;
+                    }
+                }
+
+                if (selected != nullptr) {
+                    preempted.swap(selected->Users);
+                }
+            }
+
+            ITuner* result = nullptr;
+
+            if (selected != nullptr) {
+                selected->Multiplex = multiplex;
+                selected->Users.push_back({ level, callback });
+                selected->Leases++;
+                result = selected->Tuner;
+            }
+
+            _adminLock.Unlock();
+
+            for (const User& user : preempted) {
+                user.Callback->Preempted(result);
+            }
+
+            return (result);
+        }
+        void Release(ITuner* tuner, ICallback* callback)
+        {
+            _adminLock.Lock();
+
+            Slots::iterator index(std::find_if(_slots.begin(), _slots.end(), [tuner](const Slot& slot) { return (slot.Tuner == tuner); }));
+
+            ASSERT(index != _slots.end());
+
+            if (index != _slots.end()) {
+                std::vector<User>::iterator user(std::find_if(index->Users.begin(), index->Users.end(), [callback](const User& entry) { return (entry.Callback == callback); }));
+
+                // Released by a preemption already, if not found.
+                if (user != index->Users.end()) {
+                    index->Users.erase(user);
+                }
+            }
+
+            _adminLock.Unlock();
+        }
+
+    private:
+        mutable Core::CriticalSection _adminLock;
+        Slots _slots;
+    };
+
+} // namespace Broadcast
+} // namespace Thunder
+
+#endif // TUNERPOOL_H
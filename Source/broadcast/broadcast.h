@@ -25,17 +25,27 @@
 
 #include "Module.h"
 #include "Definitions.h"
+#include "DVBText.h"
 #include "Descriptors.h"
+#include "EIT.h"
+#include "MPEGDemux.h"
 #include "MPEGDescriptor.h"
 #include "MPEGSection.h"
 #include "MPEGTable.h"
 #include "NIT.h"
+#include "NetworkScan.h"
 #include "Networks.h"
 #include "ProgramTable.h"
 #include "SDT.h"
+#include "Schedule.h"
+#include "ScheduleScan.h"
+#include "SectionBus.h"
 #include "Services.h"
+#include "Snapshot.h"
 #include "TDT.h"
+#include "TextPool.h"
 #include "TimeDate.h"
+#include "TunerPool.h"
 
 #ifdef __WINDOWS__
 #pragma comment(lib, "broadcast.lib")
@@ -0,0 +1,341 @@
+
+/*
+ * If not stated otherwise in this file or this component's LICENSE file the
+ * following copyright and licenses apply:
+ *
+ * Copyright 2020 Metrological
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Module.h"
+
+#include <sys/resource.h>
+
+using namespace Thunder;
+
+// Replays a recorded transport stream through the PSI/SI stack, to measure it
+// without a frontend. Needs the library build with BROADCAST_FILE_TUNER.
+//
+//   BroadcastReplay <recording.ts> [-pace] [-concurrency <pids>]
+//
+// Pass 1 feeds the recording, from memory, straight into an MPEG::Demux that
+// assembles all PSI/SI tables: raw sections/s and tables/s.
+// Pass 2 plays it through the file tuner into the ProgramTable, Networks,
+// Services and Schedules administrators: time to the full channel list.
+
+static constexpr uint16_t Frequency = 474;
+static constexpr uint32_t ChunkSize = 188 * 348;
+
+static uint64_t PeakMemory()
+{
+    struct rusage usage;
+
+    ::getrusage(RUSAGE_SELF, &usage);
+
+    // Linux reports kilobytes.
+    return (static_cast<uint64_t>(usage.ru_maxrss));
+}
+
+class Counter : public Broadcast::ISection {
+private:
+    Counter() = delete;
+    Counter(const Counter&) = delete;
+    Counter& operator=(const Counter&) = delete;
+
+    typedef std::map<uint32_t, Broadcast::MPEG::Table> Assemblies;
+
+public:
+    Counter(Broadcast::MPEG::Demux& demux)
+        : _demux(demux)
+        , _assemblies()
+        , _programs()
+        , _sections(0)
+        , _tables(0)
+    {
+        struct Filter {
+            uint16_t pid;
+            uint8_t first;
+            uint8_t last;
+        };
+        static constexpr Filter filters[] = {
+            { 0x00, 0x00, 0x00 }, // PAT
+            { 0x10, 0x40, 0x41 }, // NIT actual/other
+            { 0x11, 0x42, 0x42 }, // SDT actual
+            { 0x11, 0x46, 0x46 }, // SDT other
+            { 0x11, 0x4A, 0x4A }, // BAT
+            { 0x12, 0x4E, 0x6F }, // EIT present/following and schedules
+            { 0x14, 0x70, 0x70 }, // TDT
+            { 0x14, 0x73, 0x73 }  // TOT
+        };
+
+        for (const Filter& filter : filters) {
+            for (uint16_t tableId = filter.first; tableId <= filter.last; tableId++) {
+                _demux.Filter(filter.pid, static_cast<uint8_t>(tableId), this);
+            }
+        }
+    }
+    ~Counter() override
+    {
+    }
+
+public:
+    inline uint64_t Sections() const
+    {
+        return (_sections);
+    }
+    inline uint64_t Tables() const
+    {
+        return (_tables);
+    }
+    inline const std::vector<uint16_t>& Programs() const
+    {
+        return (_programs);
+    }
+
+    void Handle(const Broadcast::MPEG::Section& section) override
+    {
+        _sections++;
+
+        if (section.HasSectionSyntax() == false) {
+            // TDT/TOT, a single section is the table.
+            _tables++;
+        } else {
+            const uint32_t key = (section.TableId() << 16) | section.Extension();
+
+            Assemblies::iterator index(_assemblies.find(key));
+
+            if (index == _assemblies.end()) {
+                index = _assemblies.emplace(std::piecewise_construct,
+                    std::forward_as_tuple(key),
+                    std::forward_as_tuple(Core::ProxyType<Core::DataStore>::Create(1024))).first;
+            }
+
+            Broadcast::MPEG::Table& table(index->second);
+
+            table.AddSection(section);
+
+            if (table.IsValid() == true) {
+                _tables++;
+
+                if ((section.TableId() == Broadcast::MPEG::PAT::ID) && (_programs.empty() == true)) {
+                    Broadcast::MPEG::PAT pat(table);
+                    Broadcast::MPEG::PAT::ProgramIterator program(pat.Programs());
+
+                    while (program.Next() == true) {
+                        if (program.ProgramNumber() != 0) {
+                            _programs.push_back(program.ProgramNumber());
+                            _demux.Filter(program.Pid(), Broadcast::MPEG::PMT::ID, this);
+                        }
+                    }
+                }
+
+                // Count every completion, repetitions included, that is the work a parser does.
+                table.Clear();
+            }
+        }
+    }
+
+private:
+    Broadcast::MPEG::Demux& _demux;
+    Assemblies _assemblies;
+    std::vector<uint16_t> _programs;
+    uint64_t _sections;
+    uint64_t _tables;
+};
+
+class Sink : public Broadcast::ITuner::INotification {
+private:
+    Sink(const Sink&) = delete;
+    Sink& operator=(const Sink&) = delete;
+
+public:
+    Sink()
+        : _ended(false, true)
+    {
+    }
+    ~Sink() override
+    {
+    }
+
+public:
+    inline bool Ended(const uint32_t waitTime)
+    {
+        return (_ended.Lock(waitTime) == Core::ERROR_NONE);
+    }
+    void Activated(Broadcast::ITuner* /* tuner */) override
+    {
+    }
+    void Deactivated(Broadcast::ITuner* /* tuner */) override
+    {
+    }
+    void StateChange(Broadcast::ITuner* tuner) override
+    {
+        // The file tuner loses its "lock" at the end of the recording.
+        if (tuner->State() == Broadcast::ITuner::IDLE) {
+            _ended.SetEvent();
+        }
+    }
+
+private:
+    Core::Event _ended;
+};
+
+static bool Load(const string& fileName, std::vector<uint8_t>& recording)
+{
+    FILE* file = ::fopen(fileName.c_str(), "rb");
+
+    if (file != nullptr) {
+        uint8_t buffer[ChunkSize];
+        size_t loaded;
+
+        while ((loaded = ::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+            recording.insert(recording.end(), buffer, buffer + loaded);
+        }
+
+        ::fclose(file);
+    }
+
+    return (recording.empty() == false);
+}
+
+static std::vector<uint16_t> Demultiplex(const std::vector<uint8_t>& recording)
+{
+    Broadcast::MPEG::Demux demux;
+    Counter counter(demux);
+    uint64_t packets = 0;
+
+    uint64_t start = Core::Time::Now().Ticks();
+    for (size_t offset = 0; offset < recording.size(); offset += ChunkSize) {
+        packets += demux.Deliver(&(recording[offset]), static_cast<uint32_t>(std::min(recording.size() - offset, static_cast<size_t>(ChunkSize))));
+    }
+    uint64_t duration = Core::Time::Now().Ticks() - start;
+
+    // Ticks are in microseconds.
+    duration = (duration != 0 ? duration : 1);
+
+    printf("Demux, %llu packets (%llu MB) in %llu ms:\n", static_cast<unsigned long long>(packets), static_cast<unsigned long long>(recording.size() >> 20), static_cast<unsigned long long>(duration / 1000));
+    printf("    throughput:        %llu MB/s\n", static_cast<unsigned long long>(recording.size() / duration));
+    printf("    sections:          %llu (%llu/s)\n", static_cast<unsigned long long>(counter.Sections()), static_cast<unsigned long long>((counter.Sections() * 1000000) / duration));
+    printf("    tables completed:  %llu (%llu/s)\n", static_cast<unsigned long long>(counter.Tables()), static_cast<unsigned long long>((counter.Tables() * 1000000) / duration));
+    printf("    peak memory:       %llu KB\n", static_cast<unsigned long long>(PeakMemory()));
+
+    return (counter.Programs());
+}
+
+static void Replay(const string& fileName, const bool pace, const std::vector<uint16_t>& programs)
+{
+    const string configuration = "{ \"frontends\":1, \"standard\":\"DVB\", \"annex\":\"None\", \"modus\":\"Terrestrial\", \"path\":\"" + fileName + "\", \"pace\":" + (pace ? "true" : "false") + " }";
+
+    Broadcast::ITuner::Initialize(configuration);
+
+    Sink sink;
+    Broadcast::ProgramTable& programTable(Broadcast::ProgramTable::Instance());
+    Broadcast::Networks networks;
+    Broadcast::Services services;
+    Broadcast::Schedules schedules;
+
+    Broadcast::ITuner::Register(&sink);
+
+    Broadcast::ITuner* tuner = Broadcast::ITuner::Create(_T("0"));
+
+    if (tuner == nullptr) {
+        printf("Could not create the file tuner, is the library build with BROADCAST_FILE_TUNER?\n");
+    } else {
+        uint32_t serviceCount = 0;
+        uint32_t programCount = 0;
+        uint64_t complete = 0;
+
+        uint64_t start = Core::Time::Now().Ticks();
+
+        if (tuner->Tune(Frequency, Broadcast::QAM64, 0, 0, Broadcast::Auto) != Core::ERROR_NONE) {
+            printf("Could not play %s\n", fileName.c_str());
+        } else {
+            bool ended = false;
+
+            do {
+                ended = sink.Ended(1);
+
+                uint32_t serviceLoaded = services.List().Count();
+                uint32_t programLoaded = 0;
+
+                for (const uint16_t program : programs) {
+                    Broadcast::MPEG::PMT pmt;
+                    programTable.Program(Frequency, program, pmt);
+                    programLoaded += (pmt.IsValid() == true ? 1 : 0);
+                }
+
+                // The channel list is complete at the last change we see before the end.
+                if ((serviceLoaded != serviceCount) || (programLoaded != programCount)) {
+                    serviceCount = serviceLoaded;
+                    programCount = programLoaded;
+                    complete = Core::Time::Now().Ticks() - start;
+                }
+            } while (ended == false);
+
+            uint64_t duration = Core::Time::Now().Ticks() - start;
+
+            printf("Replay (%s, %d PMT PIDs in parallel) in %llu ms:\n", (pace ? "wire rate" : "as fast as possible"), programTable.Concurrency(), static_cast<unsigned long long>(duration / 1000));
+            printf("    services:          %d\n", serviceCount);
+            printf("    PMTs:              %d/%d\n", programCount, static_cast<uint32_t>(programs.size()));
+            printf("    full channel list: %llu ms\n", static_cast<unsigned long long>(complete / 1000));
+            printf("    peak memory:       %llu KB\n", static_cast<unsigned long long>(PeakMemory()));
+            printf("    SDT latency:       %llu us (p50), %llu us (p99), %d dropped\n", static_cast<unsigned long long>(services.Latency().Percentile(50)), static_cast<unsigned long long>(services.Latency().Percentile(99)), services.Dropped());
+            printf("    EIT latency:       %llu us (p50), %llu us (p99), %d dropped\n", static_cast<unsigned long long>(schedules.Latency().Percentile(50)), static_cast<unsigned long long>(schedules.Latency().Percentile(99)), schedules.Dropped());
+        }
+
+        delete tuner;
+    }
+
+    Broadcast::ITuner::Unregister(&sink);
+    Broadcast::ITuner::Deinitialize();
+}
+
+int main(int argc, const char* argv[])
+{
+    string fileName;
+    bool pace = false;
+    uint8_t concurrency = 1;
+
+    for (int index = 1; index < argc; index++) {
+        if (::strcmp(argv[index], "-pace") == 0) {
+            pace = true;
+        } else if ((::strcmp(argv[index], "-concurrency") == 0) && ((index + 1) < argc)) {
+            concurrency = static_cast<uint8_t>(::atoi(argv[++index]));
+        } else {
+            fileName = argv[index];
+        }
+    }
+
+    std::vector<uint8_t> recording;
+
+    if (fileName.empty() == true) {
+        printf("Usage: %s <recording.ts> [-pace] [-concurrency <pids>]\n", argv[0]);
+    } else if (Load(fileName, recording) == false) {
+        printf("Could not load %s\n", fileName.c_str());
+    } else {
+        std::vector<uint16_t> programs(Demultiplex(recording));
+
+        // Only the replay is measured from here on.
+        recording.clear();
+        recording.shrink_to_fit();
+
+        Broadcast::ProgramTable::Instance().Concurrency(concurrency);
+
+        Replay(fileName, pace, programs);
+    }
+
+    Core::Singleton::Dispose();
+
+    return (0);
+}
@@ -22,6 +22,196 @@
 
 using namespace Thunder;
 
+static void BenchmarkCRC()
+{
+    static constexpr uint32_t SectionSize = 4096;
+    static constexpr uint32_t Iterations = 10000;
+
+    Core::ProxyType<Core::DataStore> store(Core::ProxyType<Core::DataStore>::Create(SectionSize));
+    Core::DataElement section(store, 0, SectionSize);
+
+    for (uint32_t index = 0; index < SectionSize; index++) {
+        section[index] = static_cast<uint8_t>(::rand());
+    }
+
+    uint32_t check = 0;
+    uint64_t start = Core::Time::Now().Ticks();
+    for (uint32_t loop = 0; loop < Iterations; loop++) {
+        check ^= section.CRC32(0, SectionSize);
+    }
+    uint64_t reference = Core::Time::Now().Ticks() - start;
+
+    start = Core::Time::Now().Ticks();
+    for (uint32_t loop = 0; loop < Iterations; loop++) {
+        check ^= Broadcast::MPEG::CRC32(section.Buffer(), SectionSize);
+    }
+    uint64_t optimized = Core::Time::Now().Ticks() - start;
+
+    // Ticks are in microseconds, bytes per microsecond equals MB/s.
+    uint64_t bytes = static_cast<uint64_t>(SectionSize) * Iterations;
+    printf("CRC32 over %d sections of %d bytes [%08X]:\n", Iterations, SectionSize, check);
+    printf("    Core::DataElement::CRC32: %llu MB/s\n", static_cast<unsigned long long>(bytes / (reference != 0 ? reference : 1)));
+    printf("    MPEG::CRC32:              %llu MB/s\n", static_cast<unsigned long long>(bytes / (optimized != 0 ? optimized : 1)));
+}
+
+static void BenchmarkPrograms()
+{
+    static constexpr uint16_t Streams = 16;
+    static constexpr uint16_t ProgramsPerStream = 80;
+    static constexpr uint32_t Lookups = 1000000;
+    static constexpr uint32_t Keys = 4096;
+
+    typedef std::shared_ptr<const Broadcast::ProgramTable::Index> Published;
+
+    uint8_t data[] = { 0xE1, 0x00, 0xF0, 0x00, 0x02, 0xE1, 0x00, 0xF0, 0x00 };
+    Broadcast::MPEG::PMT pmt(1, Core::DataElement(sizeof(data), data));
+    std::map<uint32_t, Broadcast::MPEG::PMT> reference;
+    Published published(std::make_shared<const Broadcast::ProgramTable::Index>());
+    Core::CriticalSection lock;
+    std::vector<uint32_t> keys(Keys);
+
+    for (uint32_t& key : keys) {
+        key = ((::rand() % Streams) << 16) | ((::rand() % ProgramsPerStream) + 1);
+    }
+
+    uint64_t start = Core::Time::Now().Ticks();
+    for (uint16_t stream = 0; stream < Streams; stream++) {
+        for (uint16_t program = 1; program <= ProgramsPerStream; program++) {
+            lock.Lock();
+            reference[(stream << 16) | program] = pmt;
+            lock.Unlock();
+        }
+    }
+    uint64_t mapInsert = Core::Time::Now().Ticks() - start;
+
+    start = Core::Time::Now().Ticks();
+    for (uint16_t stream = 0; stream < Streams; stream++) {
+        // Copy on write, as the ProgramTable does: one copy per PAT, published once all
+        // its PMT's are in.
+        lock.Lock();
+        std::shared_ptr<Broadcast::ProgramTable::Index> next(std::make_shared<Broadcast::ProgramTable::Index>(*std::atomic_load(&published)));
+        for (uint16_t program = 1; program <= ProgramsPerStream; program++) {
+            next->Insert((stream << 16) | program, pmt, true);
+        }
+        std::atomic_store(&published, Published(std::move(next)));
+        lock.Unlock();
+    }
+    uint64_t indexInsert = Core::Time::Now().Ticks() - start;
+
+    uint32_t found = 0;
+    start = Core::Time::Now().Ticks();
+    for (uint32_t loop = 0; loop < Lookups; loop++) {
+        lock.Lock();
+        std::map<uint32_t, Broadcast::MPEG::PMT>::const_iterator index(reference.find(keys[loop % Keys]));
+        if (index != reference.end()) {
+            Broadcast::MPEG::PMT copy(index->second);
+            found += (copy.IsValid() ? 1 : 0);
+        }
+        lock.Unlock();
+    }
+    uint64_t mapLookup = Core::Time::Now().Ticks() - start;
+
+    start = Core::Time::Now().Ticks();
+    for (uint32_t loop = 0; loop < Lookups; loop++) {
+        Published current(std::atomic_load(&published));
+        const Broadcast::MPEG::PMT* entry(current->Find(keys[loop % Keys]));
+        if (entry != nullptr) {
+            Broadcast::MPEG::PMT copy(*entry);
+            found += (copy.IsValid() ? 1 : 0);
+        }
+    }
+    uint64_t indexLookup = Core::Time::Now().Ticks() - start;
+
+    // Ticks are in microseconds.
+    uint32_t programs = Streams * ProgramsPerStream;
+    printf("%d programs in %d transport streams [%d]:\n", programs, Streams, found);
+    printf("    std::map insert:            %llu ns/program\n", static_cast<unsigned long long>((mapInsert * 1000) / programs));
+    printf("    ProgramTable::Index insert: %llu ns/program (one copy per PAT)\n", static_cast<unsigned long long>((indexInsert * 1000) / programs));
+    printf("    std::map lookup:            %llu ns/lookup\n", static_cast<unsigned long long>((mapLookup * 1000) / Lookups));
+    printf("    ProgramTable::Index lookup: %llu ns/lookup\n", static_cast<unsigned long long>((indexLookup * 1000) / Lookups));
+}
+
+// A section with section syntax, current, a single section, the CRC_32 is added.
+static Broadcast::MPEG::Section BuildSection(std::vector<uint8_t>& buffer, const uint8_t tableId, const uint16_t extension, const uint8_t version, const std::vector<uint8_t>& payload)
+{
+    const uint16_t length = static_cast<uint16_t>(5 + payload.size() + 4);
+
+    buffer = { tableId, static_cast<uint8_t>(0xB0 | (length >> 8)), static_cast<uint8_t>(length & 0xFF),
+        static_cast<uint8_t>(extension >> 8), static_cast<uint8_t>(extension & 0xFF), static_cast<uint8_t>(0xC1 | ((version & 0x1F) << 1)), 0x00, 0x00 };
+    buffer.insert(buffer.end(), payload.begin(), payload.end());
+
+    const uint32_t crc = Broadcast::MPEG::CRC32(buffer.data(), static_cast<uint32_t>(buffer.size()));
+
+    buffer.push_back(static_cast<uint8_t>(crc >> 24));
+    buffer.push_back(static_cast<uint8_t>(crc >> 16));
+    buffer.push_back(static_cast<uint8_t>(crc >> 8));
+    buffer.push_back(static_cast<uint8_t>(crc));
+
+    return (Broadcast::MPEG::Section(Core::DataElement(buffer.size(), buffer.data())));
+}
+
+// A new PAT version with the same PMT's, loads (and publishes) all of them again.
+static bool CheckProgramReload()
+{
+    static constexpr uint16_t KeyId = 0xFFFE;
+    static constexpr uint16_t NoPid = 0xFFFF;
+
+    class Monitor : public Broadcast::IMonitor {
+    public:
+        Monitor()
+            : Pid(NoPid)
+        {
+        }
+        ~Monitor() override = default;
+
+        void ChangePid(const uint16_t newpid, Broadcast::ISection* /* observer */) override
+        {
+            Pid = newpid;
+        }
+
+        uint16_t Pid;
+    };
+
+    const std::vector<uint8_t> programs = { 0x00, 0x01, 0xE1, 0x00, 0x00, 0x02, 0xE1, 0x01 };
+    // PCR PID 0x200 and 0x210, one MPEG-2 video stream.
+    const uint16_t pcrPids[2] = { 0x200, 0x210 };
+    const std::vector<uint8_t> streams[2] = {
+        { 0xE2, 0x00, 0xF0, 0x00, 0x02, 0xE2, 0x00, 0xF0, 0x00 },
+        { 0xE2, 0x10, 0xF0, 0x00, 0x02, 0xE2, 0x10, 0xF0, 0x00 }
+    };
+
+    Broadcast::ProgramTable& table(Broadcast::ProgramTable::Instance());
+    Monitor monitor;
+    Broadcast::ISection* observer(table.Register(&monitor, KeyId));
+    std::vector<uint8_t> buffer;
+    bool result = true;
+
+    for (uint8_t version = 0; version < 2; version++) {
+        observer->Handle(BuildSection(buffer, Broadcast::MPEG::PAT::ID, 1, version, programs));
+
+        result = result && (monitor.Pid == 0x100);
+
+        for (uint16_t program = 1; program <= 2; program++) {
+            observer->Handle(BuildSection(buffer, Broadcast::MPEG::PMT::ID, program, 0, streams[program - 1]));
+        }
+
+        // All PMT's loaded, the monitor is released.
+        result = result && (monitor.Pid == NoPid);
+
+        for (uint16_t program = 1; program <= 2; program++) {
+            Broadcast::MPEG::PMT pmt;
+            table.Program(KeyId, program, pmt);
+            result = result && (pmt.IsValid() == true) && (pmt.PCRPid() == pcrPids[program - 1]);
+        }
+    }
+
+    table.Unregister(&monitor);
+
+    printf("PMT's reloaded on a new PAT version: %s\n", (result == true ? _T("OK") : _T("FAILED")));
+
+    return (result);
+}
+
 void printHelp(){
     printf("Keys to use:\n");
     printf("i -> Initialize \n");
@@ -29,6 +219,10 @@ void printHelp(){
     printf("c -> Request a tuner\n");
     printf("t -> Tune\n");
     printf("s -> Switch stream\n");
+    printf("n -> Scan the network (NIT), on all tuners, or show the progress\n");
+    printf("b -> Benchmark section CRC\n");
+    printf("p -> Benchmark program lookups\n");
+    printf("r -> Check the PMT's are reloaded on a new PAT version\n");
     printf("? -> This message\n");
     printf("q -> Quit\n");
 }
@@ -36,7 +230,7 @@ void printHelp(){
 int main(int /* argc */, const char** /* argv */)
 {
     const string configuration = "{ \
-        \"frontends\":1, \
+        \"frontends\":0, \
         \"decoders\":1, \
         \"standard\":\"DVB\", \
         \"annex\":\"None\", \
@@ -44,8 +238,6 @@ int main(int /* argc */, const char** /* argv */)
         \"modus\":\"Terrestrial\" \
     }";
 
-    const string information = "0";
-
     std::list<Broadcast::ITuner*> tuners;
     std::list<Broadcast::ITuner*>::iterator tuner = tuners.begin();
 
@@ -77,6 +269,10 @@ int main(int /* argc */, const char** /* argv */)
 
     std::list<streamInfo>::iterator stream = streams.begin();
 
+    Broadcast::Networks networks;
+    Broadcast::Services services;
+    Broadcast::NetworkScan scan(networks);
+
     char keyPress;
 
     printf("Ready to start processing events, start with 0 to connect.\n");
@@ -97,7 +293,8 @@ int main(int /* argc */, const char** /* argv */)
 
         case 'C': {
             printf("%s:%d %s Create tuner\n", __FILE__, __LINE__, __FUNCTION__);
-            Broadcast::ITuner* newTuner = Broadcast::ITuner::Create(information);
+            // Every create takes the next frontend.
+            Broadcast::ITuner* newTuner = Broadcast::ITuner::Create(Core::NumberType<uint8_t>(static_cast<uint8_t>(tuners.size())).Text());
 
             if (newTuner != nullptr) {
                 printf("%s:%d %s\n", __FILE__, __LINE__, __FUNCTION__);
@@ -136,6 +333,33 @@ int main(int /* argc */, const char** /* argv */)
             }
         } break;
 
+        case 'N': {
+            if (scan.IsRunning() == false) {
+                std::list<Broadcast::NetworkScan::Multiplex> seeds;
+
+                for (const streamInfo& entry : streams) {
+                    seeds.emplace_back(Broadcast::ITuner::Terrestrial, entry.frequency, entry.modulation, entry.symbolRate, entry.fec, entry.si);
+                }
+
+                uint32_t result = scan.Start(tuners, seeds);
+                printf("Network scan started on %d tuners [%d]\n", static_cast<uint32_t>(tuners.size()), result);
+            } else {
+                printf("Network scan: %d scanned, %d locked, %d pending, %d services\n", scan.Scanned(), scan.Locked(), scan.Pending(), services.List().Count());
+            }
+        } break;
+
+        case 'B': {
+            BenchmarkCRC();
+        } break;
+
+        case 'P': {
+            BenchmarkPrograms();
+        } break;
+
+        case 'R': {
+            CheckProgramReload();
+        } break;
+
         case 'Q':
             break;
 